@@ -0,0 +1,57 @@
+use std::fs;
+use std::time::Instant;
+
+use trace_utils::unwind::UnwindTable;
+
+use log::info;
+
+// Load the unwind tables of many processes sharing the same objects
+//
+// Usage: unwind_table_bench <comm>   all processes named <comm>
+//        unwind_table_bench <pid>... the given processes
+fn main() {
+    env_logger::init();
+    let args: Vec<String> = std::env::args().skip(1).collect();
+    let pids: Vec<u32> = match args.first().map(|a| a.parse::<u32>()) {
+        Some(Ok(_)) => args.iter().filter_map(|a| a.parse().ok()).collect(),
+        Some(Err(_)) => fs::read_dir("/proc")
+            .unwrap()
+            .filter_map(|e| e.ok()?.file_name().to_str()?.parse::<u32>().ok())
+            .filter(|pid| {
+                fs::read_to_string(format!("/proc/{pid}/comm"))
+                    .map(|c| c.trim_end() == args[0])
+                    .unwrap_or_default()
+            })
+            .collect(),
+        None => panic!("usage: unwind_table_bench <comm> | <pid>..."),
+    };
+    info!("load {} processes", pids.len());
+
+    unsafe {
+        let mut table = UnwindTable::new(0, 0);
+        let start = Instant::now();
+        for pid in pids.iter() {
+            let t = Instant::now();
+            table.load(*pid);
+            info!("process#{pid} loaded in {:?}", t.elapsed());
+        }
+        let elapsed = start.elapsed();
+        let stats = table.stats();
+        println!(
+            "{} processes loaded in {elapsed:?}, avg {:?} max {:?} per process",
+            pids.len(),
+            elapsed / pids.len().max(1) as u32,
+            stats.max_load_time
+        );
+        println!(
+            "{} objects looked up, hit rate {:.1}% (metadata {} build-id {} content {}), {} misses",
+            stats.object_lookups,
+            stats.hit_rate() * 100.0,
+            stats.metadata_hits,
+            stats.build_id_hits,
+            stats.content_hits,
+            stats.misses
+        );
+        table.unload_all();
+    }
+}
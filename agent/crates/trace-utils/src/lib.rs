@@ -51,6 +51,29 @@ cfg_if::cfg_if! {
             (*table).load(pid);
         }
 
+        #[no_mangle]
+        pub unsafe extern "C" fn unwind_table_is_loaded(table: *mut UnwindTable, pid: u32) -> bool {
+            (*table).is_loaded(pid)
+        }
+
+        // Copies at most `size` PIDs of the loaded processes into `pids`,
+        // returns the number of loaded processes
+        #[no_mangle]
+        pub unsafe extern "C" fn unwind_table_loaded_pids(
+            table: *mut UnwindTable,
+            pids: *mut u32,
+            size: usize,
+        ) -> usize {
+            let mut count = 0;
+            for pid in (*table).loaded_processes() {
+                if count < size {
+                    *pids.add(count) = *pid;
+                }
+                count += 1;
+            }
+            count
+        }
+
         #[no_mangle]
         pub unsafe extern "C" fn unwind_table_unload(table: *mut UnwindTable, pid: u32) {
             (*table).unload(pid);
@@ -61,6 +84,14 @@ cfg_if::cfg_if! {
             (*table).unload_all();
         }
 
+        #[no_mangle]
+        pub unsafe extern "C" fn set_proc_maps_provider(
+            get: maps::ProcMapsGet,
+            put: maps::ProcMapsPut,
+        ) {
+            maps::set_proc_maps_provider(get, put);
+        }
+
         #[no_mangle]
         pub unsafe extern "C" fn frame_pointer_heuristic_check(pid: u32) -> bool {
             unwind::dwarf::frame_pointer_heuristic_check(pid)
@@ -14,11 +14,14 @@
  * limitations under the License.
  */
 
+use std::ffi::{c_void, CStr};
 use std::fmt;
 use std::fs::File;
 use std::io::{self, BufRead};
 use std::path::PathBuf;
+use std::sync::OnceLock;
 
+use libc::c_char;
 use log::trace;
 
 #[derive(Debug)]
@@ -35,14 +38,82 @@ impl fmt::Display for MemoryArea {
     }
 }
 
+const PROC_MAPS_PERM_EXEC: u32 = 1 << 2;
+
+// A region of /proc/<pid>/maps, the layout is shared with `struct proc_maps_region` in proc.h
+#[repr(C)]
+pub struct ProcMapsRegion {
+    pub start: u64,
+    pub end: u64,
+    pub offset: u64,
+    pub perms: u32,
+    pub reserved: u32,
+    pub path: *const c_char, // NULL for anonymous mappings
+}
+
+// Returns a handle of the maps snapshot of a process with its regions sorted by address,
+// or NULL if the maps can not be read. The handle is released with `ProcMapsPut`.
+pub type ProcMapsGet = unsafe extern "C" fn(
+    pid: u32,
+    regions: *mut *const ProcMapsRegion,
+    count: *mut u32,
+) -> *mut c_void;
+pub type ProcMapsPut = unsafe extern "C" fn(handle: *mut c_void);
+
+static PROC_MAPS_PROVIDER: OnceLock<(ProcMapsGet, ProcMapsPut)> = OnceLock::new();
+
+// Reads the maps snapshots cached by the agent instead of parsing /proc/<pid>/maps
+pub fn set_proc_maps_provider(get: ProcMapsGet, put: ProcMapsPut) {
+    let _ = PROC_MAPS_PROVIDER.set((get, put));
+}
+
+// Merges the mappings of a file into one area, only files with executable mappings are kept
+#[derive(Default)]
+struct AreaMerger {
+    areas: Vec<MemoryArea>,
+    last_area: Option<MemoryArea>,
+    last_executable: bool,
+}
+
+impl AreaMerger {
+    fn push(&mut self, m_start: u64, m_end: u64, executable: bool, path: &str) {
+        match self.last_area.as_mut() {
+            Some(area) if area.path == path => {
+                if executable {
+                    area.mx_start = m_start;
+                    self.last_executable = true;
+                }
+                area.m_start = area.m_start.min(m_start);
+                area.m_end = area.m_end.max(m_end);
+            }
+            _ => {
+                if self.last_executable {
+                    let la = self.last_area.take().unwrap();
+                    trace!("found {:?}", la);
+                    self.areas.push(la);
+                }
+                self.last_area.replace(MemoryArea {
+                    m_start,
+                    mx_start: if executable { m_start } else { 0 },
+                    m_end,
+                    path: path.to_owned(),
+                });
+                self.last_executable = executable;
+            }
+        }
+    }
+}
+
 pub fn get_memory_mappings(pid: u32) -> io::Result<Vec<MemoryArea>> {
+    if let Some((get, put)) = PROC_MAPS_PROVIDER.get() {
+        return get_cached_memory_mappings(pid, *get, *put);
+    }
+
     let path: PathBuf = ["/proc", &pid.to_string(), "maps"].iter().collect();
     trace!("read process#{pid} maps from {}", path.display());
     let reader = io::BufReader::new(File::open(&path)?);
 
-    let mut areas = vec![];
-    let mut last_area: Option<MemoryArea> = None;
-    let mut last_executable = false;
+    let mut merger = AreaMerger::default();
     for line in reader.lines() {
         let line = line?;
         let mut segs = line.split_whitespace();
@@ -61,31 +132,39 @@ pub fn get_memory_mappings(pid: u32) -> io::Result<Vec<MemoryArea>> {
         let Some(Ok(m_end)) = addrs.next() else {
             continue;
         };
-        let perms = perms.unwrap();
-        match last_area.as_mut() {
-            Some(area) if area.path == path => {
-                if perms.contains('x') {
-                    area.mx_start = m_start;
-                    last_executable = true;
-                }
-                area.m_start = area.m_start.min(m_start);
-                area.m_end = area.m_end.max(m_end);
-            }
-            _ => {
-                if last_executable {
-                    let la = last_area.take().unwrap();
-                    trace!("found {:?}", la);
-                    areas.push(la);
-                }
-                last_area.replace(MemoryArea {
-                    m_start,
-                    mx_start: if perms.contains('x') { m_start } else { 0 },
-                    m_end,
-                    path: path.to_owned(),
-                });
-                last_executable = perms.contains('x');
-            }
+        merger.push(m_start, m_end, perms.unwrap().contains('x'), path);
+    }
+    Ok(merger.areas)
+}
+
+fn get_cached_memory_mappings(
+    pid: u32,
+    get: ProcMapsGet,
+    put: ProcMapsPut,
+) -> io::Result<Vec<MemoryArea>> {
+    trace!("read process#{pid} maps from snapshot");
+    let mut regions = std::ptr::null();
+    let mut count = 0;
+    let handle = unsafe { get(pid, &mut regions, &mut count) };
+    if handle.is_null() {
+        return Err(io::Error::new(
+            io::ErrorKind::NotFound,
+            format!("no maps snapshot for process#{pid}"),
+        ));
+    }
+
+    let mut merger = AreaMerger::default();
+    if count > 0 {
+        let regions = unsafe { std::slice::from_raw_parts(regions, count as usize) };
+        for r in regions.iter().filter(|r| !r.path.is_null()) {
+            // keep the first word as parsing the file does, e.g. drop " (deleted)"
+            let path = unsafe { CStr::from_ptr(r.path) }.to_string_lossy();
+            let Some(path) = path.split_whitespace().next() else {
+                continue;
+            };
+            merger.push(r.start, r.end, r.perms & PROC_MAPS_PERM_EXEC != 0, path);
         }
     }
-    Ok(areas)
+    unsafe { put(handle) };
+    Ok(merger.areas)
 }
@@ -149,6 +149,19 @@ typedef struct {
     py_type_object_t type_object;
 } python_offsets_t;
 
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;
+    uint32_t perms;
+    uint32_t reserved;
+    const char *path;
+} proc_maps_region_t;
+
+typedef void *(*proc_maps_get_fn)(uint32_t pid, const proc_maps_region_t **regions, uint32_t *count);
+
+typedef void (*proc_maps_put_fn)(void *handle);
+
 bool frame_pointer_heuristic_check(uint32_t pid);
 
 bool is_python_process(uint32_t pid);
@@ -170,13 +183,19 @@ int32_t read_offset_of_stack_in_task_struct(void);
 
 int rustc_demangle(const char *mangled, char *out, size_t out_size);
 
+void set_proc_maps_provider(proc_maps_get_fn get, proc_maps_put_fn put);
+
 unwind_table_t *unwind_table_create(int32_t process_shard_list_map_fd,
                                     int32_t unwind_entry_shard_map_fd);
 
 void unwind_table_destroy(unwind_table_t *table);
 
+bool unwind_table_is_loaded(unwind_table_t *table, uint32_t pid);
+
 void unwind_table_load(unwind_table_t *table, uint32_t pid);
 
+size_t unwind_table_loaded_pids(unwind_table_t *table, uint32_t *pids, size_t size);
+
 void unwind_table_unload(unwind_table_t *table, uint32_t pid);
 
 void unwind_table_unload_all(unwind_table_t *table);
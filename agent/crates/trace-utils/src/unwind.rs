@@ -19,19 +19,23 @@ pub mod python;
 
 use std::alloc::{alloc, dealloc, handle_alloc_error, Layout};
 use std::collections::{hash_map::Entry, HashMap, HashSet};
-use std::fs;
+use std::fs::{self, File};
 use std::hash::Hasher;
+use std::io::{self, Read, Seek, SeekFrom};
 use std::mem;
-use std::path::PathBuf;
+use std::os::unix::fs::MetadataExt;
+use std::path::{Path, PathBuf};
 use std::ptr::NonNull;
 use std::slice;
+use std::time::{Duration, Instant};
 
 use ahash::AHasher;
 use libc::c_void;
 use log::{debug, trace, warn};
 use object::{
     elf::{self, FileHeader64},
-    read::elf::FileHeader,
+    read::{elf::FileHeader, ReadCache},
+    Object,
 };
 
 use dwarf::UnwindEntry;
@@ -44,8 +48,17 @@ use crate::{
 #[derive(Default)]
 pub struct UnwindTable {
     id_gen: IdGenerator,
+    // keyed by build-id, or content digest for objects without build-id
     object_cache: HashMap<u64, ObjectInfo>,
+    // first level cache, file metadata to object_cache key, so that files
+    // shared by processes are not opened again
+    file_index: HashMap<FileKey, u64>,
+    // files without usable unwind entries
+    bad_files: HashSet<FileKey>,
     shard_rc: HashMap<u32, usize>,
+    // processes with a shard list in bpf map
+    processes: HashSet<u32>,
+    stats: UnwindTableStats,
 
     process_shard_list_map_fd: i32,
     unwind_entry_shard_map_fd: i32,
@@ -55,6 +68,8 @@ impl UnwindTable {
     // libraries with unwind entries larger than this margin will be
     // stored in separated shards
     const SHARD_THRESHOLD: usize = UNWIND_ENTRIES_PER_SHARD * 90 / 100;
+    // forget the bad files when there are more than this
+    const BAD_FILES_MAX: usize = 4096;
 
     pub unsafe fn new(process_shard_list_map_fd: i32, unwind_entry_shard_map_fd: i32) -> Self {
         Self {
@@ -64,12 +79,158 @@ impl UnwindTable {
         }
     }
 
+    pub fn stats(&self) -> &UnwindTableStats {
+        &self.stats
+    }
+
+    pub fn is_loaded(&self, pid: u32) -> bool {
+        self.processes.contains(&pid)
+    }
+
+    pub fn loaded_processes(&self) -> impl Iterator<Item = &u32> {
+        self.processes.iter()
+    }
+
     pub fn load(&mut self, pid: u32) {
+        let start = Instant::now();
+        let (lookups, hits) = (self.stats.object_lookups, self.stats.hits());
+
+        // A loaded process is loaded again after exec. The new shard list replaces the old one
+        // in bpf map, and the objects of the old one are released afterwards, so that the
+        // shards still in use are never deleted or reused in between.
+        let reloading = self.processes.contains(&pid);
+        let old_objects = if reloading {
+            self.objects_of(pid)
+        } else {
+            HashSet::new()
+        };
+        if self.load_process(pid) {
+            self.processes.insert(pid);
+        } else if reloading {
+            self.processes.remove(&pid);
+            self.delete_process_shard_list(pid);
+        }
+        self.release_objects(pid, &old_objects);
+
+        let elapsed = start.elapsed();
+        self.stats.process_loads += 1;
+        self.stats.load_time += elapsed;
+        self.stats.max_load_time = self.stats.max_load_time.max(elapsed);
+        debug!(
+            "process#{pid} dwarf entries loaded in {elapsed:?}, {} of {} objects from cache, cache hit rate {:.1}%",
+            self.stats.hits() - hits,
+            self.stats.object_lookups - lookups,
+            self.stats.hit_rate() * 100.0,
+        );
+    }
+
+    // Find the object of a mapped file in cache, the file is read only on a true miss
+    fn lookup_object(&mut self, path: &Path) -> ObjectLookup {
+        let key = match fs::metadata(path) {
+            Ok(m) => FileKey::from(&m),
+            Err(e) => {
+                debug!("stat file {} failed: {e}", path.display());
+                return ObjectLookup::Skip;
+            }
+        };
+        if self.bad_files.contains(&key) {
+            trace!("ignore file {} without unwind entries", path.display());
+            return ObjectLookup::Skip;
+        }
+        self.stats.object_lookups += 1;
+        if let Some(digest) = self.file_index.get(&key) {
+            if self.object_cache.contains_key(digest) {
+                self.stats.metadata_hits += 1;
+                return ObjectLookup::Cached(*digest);
+            }
+        }
+
+        // The file may be truncated or replaced while it is read, so it is read
+        // with read(2) rather than mapped: a short read only fails the parsing,
+        // an access past the end of a mapping raises SIGBUS.
+        let (build_id, mut file) = match Self::read_build_id(path) {
+            Ok(r) => r,
+            Err(e) => {
+                debug!("load file {} failed: {e}", path.display());
+                return ObjectLookup::Skip;
+            }
+        };
+        let mut data = None;
+        let mut hasher = AHasher::default();
+        match build_id.as_ref() {
+            Some(id) => {
+                hasher.write(b"build-id");
+                hasher.write(id);
+            }
+            // reads the whole file
+            None => match Self::read_all(&mut file) {
+                Ok(d) => {
+                    hasher.write(&d);
+                    data = Some(d);
+                }
+                Err(e) => {
+                    debug!("load file {} failed: {e}", path.display());
+                    return ObjectLookup::Skip;
+                }
+            },
+        }
+        let digest = hasher.finish();
+        if self.object_cache.contains_key(&digest) {
+            if build_id.is_some() {
+                self.stats.build_id_hits += 1;
+            } else {
+                self.stats.content_hits += 1;
+            }
+            self.file_index.insert(key, digest);
+            return ObjectLookup::Cached(digest);
+        }
+
+        self.stats.misses += 1;
+        let data = match data {
+            Some(d) => d,
+            None => match Self::read_all(&mut file) {
+                Ok(d) => d,
+                Err(e) => {
+                    debug!("load file {} failed: {e}", path.display());
+                    return ObjectLookup::Skip;
+                }
+            },
+        };
+        ObjectLookup::Miss(digest, data, key)
+    }
+
+    // Read the GNU build-id note, only the ELF headers and the notes are read
+    fn read_build_id(path: &Path) -> io::Result<(Option<Vec<u8>>, File)> {
+        let cache = ReadCache::new(File::open(path)?);
+        let build_id = object::File::parse(&cache)
+            .ok()
+            .and_then(|f| f.build_id().ok().flatten())
+            .map(|id| id.to_vec());
+        Ok((build_id, cache.into_inner()))
+    }
+
+    // Read the whole file from the same open file the build-id was read from
+    fn read_all(file: &mut File) -> io::Result<Vec<u8>> {
+        let mut data = Vec::new();
+        file.seek(SeekFrom::Start(0))?;
+        file.read_to_end(&mut data)?;
+        Ok(data)
+    }
+
+    fn add_bad_file(&mut self, key: FileKey) {
+        if self.bad_files.len() >= Self::BAD_FILES_MAX {
+            self.bad_files.clear();
+        }
+        self.bad_files.insert(key);
+    }
+
+    // Returns true if the shard list of the process is updated
+    fn load_process(&mut self, pid: u32) -> bool {
         let mm = match get_memory_mappings(pid) {
             Ok(m) => m,
             Err(e) => {
                 debug!("failed loading maps for process#{pid}: {e}");
-                return;
+                return false;
             }
         };
         trace!("load dwarf entries for process#{pid}");
@@ -86,41 +247,35 @@ impl UnwindTable {
             }
             let mut path = base_path.clone();
             path.push(&m.path[1..]);
-            let data = match fs::read(&path) {
-                Ok(d) => d,
-                Err(e) => {
-                    debug!("load file {} failed: {e}", path.display());
+            let (digest, data, key) = match self.lookup_object(&path) {
+                ObjectLookup::Cached(digest) => {
+                    trace!(
+                        "object {} found in cache, use loaded shards",
+                        path.display()
+                    );
+                    let obj = self.object_cache.get_mut(&digest).unwrap();
+                    obj.pids.push(pid);
+                    for s in obj.shards.iter() {
+                        if shard_list.len as usize >= UNWIND_SHARDS_PER_PROCESS {
+                            warn!(
+                                "process#{pid} unwind shard list full, cannot add entries for {}",
+                                m.path
+                            );
+                            break;
+                        }
+                        shard_list.entries[shard_list.len as usize] = *s;
+                        // offset is 0 iff object is not PIC/PIE, otherwise set offset according to proc maps
+                        if shard_list.entries[shard_list.len as usize].offset != 0 {
+                            shard_list.entries[shard_list.len as usize].offset = m.m_start;
+                        }
+                        shard_list.len += 1;
+                    }
                     continue;
                 }
+                ObjectLookup::Miss(digest, data, key) => (digest, data, key),
+                ObjectLookup::Skip => continue,
             };
 
-            let mut hasher = AHasher::default();
-            hasher.write(&data);
-            let digest = hasher.finish();
-            if let Some(obj) = self.object_cache.get_mut(&digest) {
-                trace!(
-                    "object {} found in cache, use loaded shards",
-                    path.display()
-                );
-                obj.pids.push(pid);
-                for s in obj.shards.iter() {
-                    if shard_list.len as usize >= UNWIND_SHARDS_PER_PROCESS {
-                        warn!(
-                            "process#{pid} unwind shard list full, cannot add entries for {}",
-                            m.path
-                        );
-                        break;
-                    }
-                    shard_list.entries[shard_list.len as usize] = *s;
-                    // offset is 0 iff object is not PIC/PIE, otherwise set offset according to proc maps
-                    if shard_list.entries[shard_list.len as usize].offset != 0 {
-                        shard_list.entries[shard_list.len as usize].offset = m.m_start;
-                    }
-                    shard_list.len += 1;
-                }
-                continue;
-            }
-
             // for binaries compiled without "-fPIE" or "-pie", the symbols will not get relocated
             // so shard offset should be set to 0
             let is_pic = match FileHeader64::<object::Endianness>::parse(&*data) {
@@ -131,6 +286,7 @@ impl UnwindTable {
                             "read elf header endian for process#{pid} in {} failed: {e}",
                             path.display()
                         );
+                        self.add_bad_file(key);
                         continue;
                     }
                 },
@@ -139,6 +295,7 @@ impl UnwindTable {
                         "read elf header for process#{pid} in {} failed: {e}",
                         path.display()
                     );
+                    self.add_bad_file(key);
                     continue;
                 }
             };
@@ -148,6 +305,7 @@ impl UnwindTable {
             let entries = match dwarf::read_unwind_entries(&data) {
                 Ok(ue) if ue.is_empty() => {
                     debug!("process#{pid} in {} has no unwind entries", path.display());
+                    self.add_bad_file(key);
                     continue;
                 }
                 Ok(ue) => ue,
@@ -156,6 +314,7 @@ impl UnwindTable {
                         "read unwind entries for process#{pid} in {} failed: {e}",
                         path.display()
                     );
+                    self.add_bad_file(key);
                     continue;
                 }
             };
@@ -171,6 +330,7 @@ impl UnwindTable {
                     self.split_into_shards(pid, &m, &entries, max_pc, &mut shard_list, is_pic);
                 shard_count += object_info.shards.len();
                 self.object_cache.insert(digest, object_info);
+                self.file_index.insert(key, digest);
                 continue;
             }
 
@@ -229,6 +389,7 @@ impl UnwindTable {
                     shards: vec![shard_info.clone()],
                 },
             );
+            self.file_index.insert(key, digest);
             *self.shard_rc.entry(shard.id).or_insert(0) += 1;
             trace!(
                 "increase shard#{} ref count to {}",
@@ -245,7 +406,7 @@ impl UnwindTable {
 
         if shard_list.len == 0 {
             trace!("no dwarf entry shards loaded for process#{pid}");
-            return;
+            return false;
         }
 
         if log::log_enabled!(log::Level::Debug) {
@@ -262,17 +423,41 @@ impl UnwindTable {
         (&mut shard_list.entries[..shard_list.len as usize])
             .sort_unstable_by_key(|e| e.offset + e.pc_min);
         self.update_process_shard_list(pid, &shard_list);
+        true
     }
 
     pub fn unload(&mut self, pid: u32) {
         trace!("unload dwarf entries for process#{pid}");
+        let objects = self.objects_of(pid);
+        let removed = self.release_objects(pid, &objects);
+        if self.processes.remove(&pid) || !objects.is_empty() {
+            debug!("process#{pid} unloaded {removed} dwarf entry shards");
+            self.delete_process_shard_list(pid);
+        }
+    }
+
+    fn objects_of(&self, pid: u32) -> HashSet<u64> {
+        self.object_cache
+            .iter()
+            .filter(|(_, obj)| obj.pids.contains(&pid))
+            .map(|(digest, _)| *digest)
+            .collect()
+    }
+
+    // Drop one reference of the process to each of the objects,
+    // returns the number of shards removed
+    fn release_objects(&mut self, pid: u32, objects: &HashSet<u64>) -> usize {
+        if objects.is_empty() {
+            return 0;
+        }
         let mut shards_to_remove = vec![];
-        let mut found_process = false;
-        self.object_cache.retain(|_, obj| {
+        self.object_cache.retain(|digest, obj| {
+            if !objects.contains(digest) {
+                return true;
+            }
             match obj.pids.iter().position(|p| *p == pid) {
                 None => true,
                 Some(index) => {
-                    found_process = true;
                     obj.pids.swap_remove(index);
                     if !obj.pids.is_empty() {
                         return true;
@@ -302,17 +487,13 @@ impl UnwindTable {
                 }
             }
         });
-        if found_process {
-            for id in shards_to_remove.iter() {
-                self.delete_unwind_entry_shard(*id);
-                self.id_gen.release(*id);
-            }
-            debug!(
-                "process#{pid} unloaded {} dwarf entry shards",
-                shards_to_remove.len()
-            );
-            self.delete_process_shard_list(pid);
+        self.file_index
+            .retain(|_, digest| self.object_cache.contains_key(digest));
+        for id in shards_to_remove.iter() {
+            self.delete_unwind_entry_shard(*id);
+            self.id_gen.release(*id);
         }
+        shards_to_remove.len()
     }
 
     pub fn unload_all(&mut self) {
@@ -328,7 +509,10 @@ impl UnwindTable {
             .object_cache
             .drain()
             .flat_map(|(_, obj)| obj.pids.into_iter())
+            .chain(self.processes.drain())
             .collect();
+        self.file_index.clear();
+        self.bad_files.clear();
         for pid in processes.iter() {
             self.delete_process_shard_list(*pid);
         }
@@ -494,6 +678,63 @@ impl UnwindTable {
     }
 }
 
+enum ObjectLookup {
+    Cached(u64),
+    Miss(u64, Vec<u8>, FileKey),
+    Skip,
+}
+
+// Identifies a file without reading it
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+struct FileKey {
+    dev: u64,
+    ino: u64,
+    size: u64,
+    mtime: i64,
+    mtime_nsec: i64,
+}
+
+impl From<&fs::Metadata> for FileKey {
+    fn from(m: &fs::Metadata) -> Self {
+        Self {
+            dev: m.dev(),
+            ino: m.ino(),
+            size: m.size(),
+            mtime: m.mtime(),
+            mtime_nsec: m.mtime_nsec(),
+        }
+    }
+}
+
+#[derive(Clone, Copy, Debug, Default)]
+pub struct UnwindTableStats {
+    pub process_loads: u64,
+    pub load_time: Duration,
+    pub max_load_time: Duration,
+    // mapped files looked up in object cache
+    pub object_lookups: u64,
+    // found by (st_dev, st_ino, size, mtime)
+    pub metadata_hits: u64,
+    // found by GNU build-id
+    pub build_id_hits: u64,
+    // found by content digest, for objects without build-id
+    pub content_hits: u64,
+    pub misses: u64,
+}
+
+impl UnwindTableStats {
+    pub fn hits(&self) -> u64 {
+        self.metadata_hits + self.build_id_hits + self.content_hits
+    }
+
+    pub fn hit_rate(&self) -> f64 {
+        if self.object_lookups == 0 {
+            return 0.0;
+        }
+        self.hits() as f64 / self.object_lookups as f64
+    }
+}
+
 #[derive(Debug, Default)]
 struct ObjectInfo {
     shards: Vec<ShardInfo>,
@@ -1107,6 +1107,10 @@ pub struct EbpfTunning {
     pub max_socket_entries: u32,
     pub socket_map_reclaim_threshold: u32,
     pub max_trace_entries: u32,
+    pub dispatch_spin_budget: u32,
+    pub socket_ring_buffers: u32,
+    pub socket_ring_buffer_pages: u32,
+    pub socket_ring_buffer_wakeup_bytes: u32,
 }
 
 impl Default for EbpfTunning {
@@ -1119,6 +1123,10 @@ impl Default for EbpfTunning {
             max_socket_entries: 131072,
             socket_map_reclaim_threshold: 120000,
             max_trace_entries: 131072,
+            dispatch_spin_budget: 2000,
+            socket_ring_buffers: 0,
+            socket_ring_buffer_pages: 0,
+            socket_ring_buffer_wakeup_bytes: 0,
         }
     }
 }
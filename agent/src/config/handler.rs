@@ -3407,6 +3407,38 @@ impl ConfigHandler {
             tunning.userspace_worker_threads = new_tunning.userspace_worker_threads;
             restart_agent = !first_run;
         }
+        if tunning.dispatch_spin_budget != new_tunning.dispatch_spin_budget {
+            info!(
+                "Update inputs.ebpf.tunning.dispatch_spin_budget from {:?} to {:?}.",
+                tunning.dispatch_spin_budget, new_tunning.dispatch_spin_budget
+            );
+            tunning.dispatch_spin_budget = new_tunning.dispatch_spin_budget;
+            restart_agent = !first_run;
+        }
+        if tunning.socket_ring_buffers != new_tunning.socket_ring_buffers {
+            info!(
+                "Update inputs.ebpf.tunning.socket_ring_buffers from {:?} to {:?}.",
+                tunning.socket_ring_buffers, new_tunning.socket_ring_buffers
+            );
+            tunning.socket_ring_buffers = new_tunning.socket_ring_buffers;
+            restart_agent = !first_run;
+        }
+        if tunning.socket_ring_buffer_pages != new_tunning.socket_ring_buffer_pages {
+            info!(
+                "Update inputs.ebpf.tunning.socket_ring_buffer_pages from {:?} to {:?}.",
+                tunning.socket_ring_buffer_pages, new_tunning.socket_ring_buffer_pages
+            );
+            tunning.socket_ring_buffer_pages = new_tunning.socket_ring_buffer_pages;
+            restart_agent = !first_run;
+        }
+        if tunning.socket_ring_buffer_wakeup_bytes != new_tunning.socket_ring_buffer_wakeup_bytes {
+            info!(
+                "Update inputs.ebpf.tunning.socket_ring_buffer_wakeup_bytes from {:?} to {:?}.",
+                tunning.socket_ring_buffer_wakeup_bytes, new_tunning.socket_ring_buffer_wakeup_bytes
+            );
+            tunning.socket_ring_buffer_wakeup_bytes = new_tunning.socket_ring_buffer_wakeup_bytes;
+            restart_agent = !first_run;
+        }
 
         let integration = &mut config.inputs.integration;
         let new_integration = &mut new_config.user_config.inputs.integration;
@@ -211,8 +211,7 @@ static __inline void report_http2_header(struct pt_regs *ctx)
 	    (sizeof(stack->send_buffer.data) - 1);
 
 	if (send_size < SEND_SIZE_MAX && send_size > 0) {
-		bpf_perf_event_output(ctx, &NAME(socket_data),
-				      BPF_F_CURRENT_CPU, stack, 1 + send_size);
+		socket_data_output(ctx, stack, 1 + send_size);
 	}
 	return;
 }
@@ -42,7 +42,7 @@ do { \
   dbg_data.fun = (F); \
   dbg_data.num = (N); \
   dbg_data.len = (L); \
-  bpf_perf_event_output(ctx, &NAME(socket_data), BPF_F_CURRENT_CPU, &dbg_data, sizeof(dbg_data)); \
+  socket_data_output(ctx, &dbg_data, sizeof(dbg_data)); \
 } while(0)
 
 #define submit_debug_str(F, N, P)  \
@@ -52,7 +52,7 @@ do { \
   dbg_data.num = (N); \
   __builtin_memset(dbg_data.buf, 0, sizeof(dbg_data.buf)); \
   bpf_probe_read_user(dbg_data.buf, sizeof(dbg_data.buf), (P)); \
-  bpf_perf_event_output(ctx, &NAME(socket_data), BPF_F_CURRENT_CPU, &dbg_data, sizeof(dbg_data)); \
+  socket_data_output(ctx, &dbg_data, sizeof(dbg_data)); \
 } while(0)
 #else
 #define DEFINE_DBG_DATA(x)
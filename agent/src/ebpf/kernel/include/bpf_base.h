@@ -110,6 +110,17 @@ static long
 							       *unsafe_ptr) =
     (void *)115;
 
+static long
+    __attribute__ ((__unused__)) (*bpf_ringbuf_output) (void *ringbuf,
+							void *data,
+							__u64 size,
+							__u64 flags) =
+    (void *)130;
+static __u64
+    __attribute__ ((__unused__)) (*bpf_ringbuf_query) (void *ringbuf,
+						       __u64 flags) =
+    (void *)134;
+
 static int
     __attribute__ ((__unused__)) (*bpf_get_stackid) (void *ctx, void *map,
 						     int flags) = (void *)27;
@@ -442,6 +453,19 @@ struct bpf_map_def SEC("maps") __ ## name = \
     __BPF_MAP_DEF(key_type, value_type, max_entries, feat), \
 };
 
+/*
+ * 'size' is the ring size in bytes, a power of 2 multiple of the page size.
+ */
+#define MAP_RINGBUF(name, size, feat) \
+struct bpf_map_def SEC("maps") __ ## name = \
+{   \
+    .type = BPF_MAP_TYPE_RINGBUF, \
+    .key_size = 0, \
+    .value_size = 0, \
+    .max_entries = (size), \
+    .feat_flags = (feat), \
+};
+
 #define MAP_PROG_ARRAY(name, key_type, value_type, max_entries, feat) \
 struct bpf_map_def SEC("maps") __ ## name = \
 {   \
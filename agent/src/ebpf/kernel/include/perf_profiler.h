@@ -23,14 +23,15 @@
 #define DF_BPF_PERF_PROFILER_H
 
 #define STACK_MAP_ENTRIES 65536
+#define STACK_AGG_MAP_ENTRIES 65536
 
 /*
- * The meaning of the "__profiler_state_map" index.
+ * The meaning of the "__profiler_state_map" slots.
  */
 typedef enum {
 	TRANSFER_CNT_IDX = 0,	/* buffer-a and buffer-b transfer count. */
-	SAMPLE_CNT_A_IDX,	/* sample count A */
-	SAMPLE_CNT_B_IDX,	/* sample count B */
+	SAMPLE_CNT_A_IDX,	/* sample count A, cumulative. */
+	SAMPLE_CNT_B_IDX,	/* sample count B, cumulative. */
 	SAMPLE_CNT_DROP,	/* sample drop */
 	SAMPLE_ITER_CNT_MAX,	/* Iteration sample number max value */
 	OUTPUT_CNT_IDX,		/* Count the total number of data outputs. */
@@ -39,9 +40,31 @@ typedef enum {
 				   0: disable sampling; 1: enable sampling. */
 	MINBLOCK_TIME_IDX,	/* The minimum blocking time, applied in the profiler extension.*/
 	RT_KERN,                /* Indicates whether it is a real-time kernel.*/
+	SAMPLE_AGG_IDX,		/* Count samples in the aggregation maps instead
+				   of outputting each one. 0: off; 1: on. */
+	SAMPLE_AGG_CNT_IDX,	/* Count the samples folded into the aggregation maps. */
+	SAMPLE_CNT_A_BASE_IDX,	/* SAMPLE_CNT_A_IDX when buffer-a became active. */
+	SAMPLE_CNT_B_BASE_IDX,	/* SAMPLE_CNT_B_IDX when buffer-b became active. */
 	PROFILER_CNT
 } profiler_idx;
 
+/*
+ * "__profiler_state_map" has two elements of profiler_state_t. The slots
+ * written by user space (TRANSFER_CNT_IDX, ENABLE_IDX, MINBLOCK_TIME_IDX,
+ * RT_KERN, SAMPLE_AGG_IDX and the SAMPLE_CNT_*_BASE_IDX) live in the
+ * PROFILER_STATE_CTRL element, the counters updated by BPF live in the
+ * PROFILER_STATE_CNT element. User space writes a whole element at a
+ * time, so it never writes the counters element, otherwise it would
+ * overwrite the increments done by BPF since it read the element.
+ */
+#define PROFILER_STATE_CTRL	0
+#define PROFILER_STATE_CNT	1
+#define PROFILER_STATE_NUM	2
+
+typedef struct {
+	__u64 vals[PROFILER_CNT];
+} profiler_state_t;
+
 #define JAVA_SYMBOL_MAX_LENGTH 128
 #define MAP_MEMORY_JAVA_SYMBOL_MAP_NAME "__memory_java_symbol_map"
 
@@ -72,6 +95,9 @@ struct stack_trace_key_t {
 		struct {
 			__u64 duration_ns;
 		} off_cpu;
+		struct {
+			__u64 count; // samples folded into this key, 0 means 1
+		} on_cpu;
 		struct {
 			__u64 addr; // allocated or deallocating address
 			__u64 size; // non-zero for allocated size, zero for deallocs
@@ -80,6 +106,26 @@ struct stack_trace_key_t {
 	};
 };
 
+/*
+ * Key of the on-CPU sample aggregation maps. Samples with the same key
+ * within one a/b iteration are counted rather than output one by one.
+ */
+struct stack_trace_agg_key_t {
+	__u32 pid;
+	__u32 tgid;
+	__u32 cpu;
+	char comm[TASK_COMM_LEN];
+	int kernstack;
+	int userstack;
+	int intpstack;
+	__u32 flags;
+};
+
+struct stack_trace_agg_value_t {
+	__u64 count;
+	__u64 timestamp;	// timestamp of the first sample
+};
+
 typedef struct {
 	__u32 task_struct_stack_offset;
 } unwind_sysinfo_t;
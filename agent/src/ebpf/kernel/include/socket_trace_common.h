@@ -100,6 +100,7 @@ struct trace_stats {
 	__u64 period_event_max_delay; /**< The maximum latency for periodic data push. */
 	__u64 period_event_total_time; /**< The total elapsed time for periodic event. */
 	__u64 period_event_count; /**< The number of occurrences of periodic events. */
+	__u64 ringbuf_lost_count; /**< Records dropped because the ring buffer was full (SUPPORTS_RINGBUF only). */
 };
 
 struct socket_info_s {
@@ -187,6 +188,9 @@ struct tracer_ctx_s {
 	int push_buffer_refcnt;	/**< Reference count of the data push buffer */
 	__u64 last_period_timestamp; /**< Record the timestamp of the last periodic check of the push buffer. */
 	__u64 period_timestamp;	/**< Record the timestamp of the periodic check of the push buffer. */
+	__u64 buffered_timestamp; /**< Time the push buffer became non-empty, 0 while it is empty. */
+	__u32 ringbuf_idx;	/**< Ring buffer used by this CPU (SUPPORTS_RINGBUF only). */
+	__u32 ringbuf_wakeup_bytes; /**< Wake up the reader once this much data is pending in the ring. */
 	bool disable_tracing;  /**< Disable tracing feature. */
 	struct socket_info_s sk_info; /**< Prevent stack overflow; this option is used as an alternative to stack allocation. */
 };
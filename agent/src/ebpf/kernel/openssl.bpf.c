@@ -36,8 +36,19 @@ struct ssl_ctx_struct {
 // key: pid_tgid
 // value: SSL_* arguments
 BPF_HASH(ssl_ctx_map, __u64, struct ssl_ctx_struct, MAP_MAX_ENTRIES_DEF, FEATURE_FLAG_UPROBE_OPENSSL)
+// The uprobes are attached once per OpenSSL library file for all processes,
+// only the processes traced are handled.
+// key: tgid
+// value: not used
+BPF_HASH(ssl_pids_map, __u32, __u8, MAP_MAX_ENTRIES_DEF, FEATURE_FLAG_UPROBE_OPENSSL)
 /* *INDENT-ON* */
 
+static __inline bool is_ssl_pid_traced(__u64 id)
+{
+	__u32 tgid = id >> 32;
+	return ssl_pids_map__lookup(&tgid) != NULL;
+}
+
 static int get_fd_from_openssl_ssl(void *ssl)
 {
 	int fd;
@@ -64,9 +75,12 @@ static int get_fd_from_openssl_ssl(void *ssl)
 // int SSL_write(SSL *ssl, const void *buf, int num);
 UPROG(openssl_write_enter) (struct pt_regs *ctx)
 {
+	__u64 id = bpf_get_current_pid_tgid();
+	if (!is_ssl_pid_traced(id))
+		return 0;
+
 	void *ssl = (void *)PT_REGS_PARM1(ctx);
 	int fd = get_fd_from_openssl_ssl(ssl);
-	__u64 id = bpf_get_current_pid_tgid();
 	struct ssl_ctx_struct ssl_ctx = {
 		.fd = fd,
 		.buf = (void *)PT_REGS_PARM2(ctx),
@@ -121,9 +135,12 @@ UPROG(openssl_write_exit) (struct pt_regs *ctx)
 // int SSL_read(SSL *ssl, void *buf, int num);
 UPROG(openssl_read_enter) (struct pt_regs *ctx)
 {
+	__u64 id = bpf_get_current_pid_tgid();
+	if (!is_ssl_pid_traced(id))
+		return 0;
+
 	void *ssl = (void *)PT_REGS_PARM1(ctx);
 	int fd = get_fd_from_openssl_ssl(ssl);
-	__u64 id = bpf_get_current_pid_tgid();
 	struct ssl_ctx_struct ssl_ctx = {
 		.fd = fd,
 		.buf = (void *)PT_REGS_PARM2(ctx),
@@ -73,6 +73,20 @@ MAP_PROG_ARRAY(cp_progs_jmp_pe_map, __u32, __u32, CP_PROG_PE_NUM, FEATURE_FLAG_P
 MAP_STACK_TRACE(stack_map_a, STACK_MAP_ENTRIES, FEATURE_FLAG_PROFILE_ONCPU)
 MAP_STACK_TRACE(stack_map_b, STACK_MAP_ENTRIES, FEATURE_FLAG_PROFILE_ONCPU)
 
+/*
+ * When sample aggregation is on (SAMPLE_AGG_IDX), samples are counted in
+ * these maps by key instead of being output one by one, and user space
+ * drains the inactive map with batch operations. They follow the same a/b
+ * switching as the stack maps. The CPU is part of the key, so CPUs never
+ * update the same element. Map sizes are configured in user space program.
+ */
+MAP_HASH(stack_agg_map_a, struct stack_trace_agg_key_t,
+	 struct stack_trace_agg_value_t, STACK_AGG_MAP_ENTRIES,
+	 FEATURE_FLAG_PROFILE_ONCPU)
+MAP_HASH(stack_agg_map_b, struct stack_trace_agg_key_t,
+	 struct stack_trace_agg_value_t, STACK_AGG_MAP_ENTRIES,
+	 FEATURE_FLAG_PROFILE_ONCPU)
+
 typedef struct {
 	struct bpf_map_def *state;
 	struct bpf_map_def *stack_map_a;
@@ -81,6 +95,8 @@ typedef struct {
 	struct bpf_map_def *custom_stack_map_b;
 	struct bpf_map_def *profiler_output_a;
 	struct bpf_map_def *profiler_output_b;
+	struct bpf_map_def *stack_agg_map_a;	// NULL if not aggregated
+	struct bpf_map_def *stack_agg_map_b;
 	struct bpf_map_def *progs_jmp;
 } map_group_t;
 
@@ -179,9 +195,11 @@ typedef void stack_t;		// placeholder
 
 /*
  * Used for communication between user space and BPF to control the
- * switching between buffer a and buffer b.
+ * switching between buffer a and buffer b. The control element and
+ * the counters element, see profiler_state_t.
  */
-MAP_ARRAY(profiler_state_map, __u32, __u64, PROFILER_CNT, FEATURE_FLAG_PROFILE_ONCPU)
+MAP_ARRAY(profiler_state_map, __u32, profiler_state_t, PROFILER_STATE_NUM,
+	  FEATURE_FLAG_PROFILE_ONCPU)
 #ifdef LINUX_VER_5_2_PLUS
 static inline __attribute__ ((always_inline))
 void add_frame(stack_t * stack, __u64 frame)
@@ -409,47 +427,58 @@ int get_usermode_regs(struct pt_regs *regs, regs_t * dst)
 
 #endif
 
+static inline __attribute__ ((always_inline))
+bool aggregate_sample(struct bpf_map_def *agg_map,
+		      struct stack_trace_key_t *key)
+{
+	struct stack_trace_agg_key_t agg_key = {};
+	agg_key.pid = key->pid;
+	agg_key.tgid = key->tgid;
+	agg_key.cpu = key->cpu;
+	__builtin_memcpy(agg_key.comm, key->comm, sizeof(agg_key.comm));
+	agg_key.kernstack = key->kernstack;
+	agg_key.userstack = key->userstack;
+	agg_key.intpstack = key->intpstack;
+	agg_key.flags = key->flags;
+
+	struct stack_trace_agg_value_t *agg_val =
+	    bpf_map_lookup_elem(agg_map, &agg_key);
+	if (agg_val == NULL) {
+		struct stack_trace_agg_value_t new_val = {
+			.count = 1,
+			.timestamp = key->timestamp,
+		};
+		if (bpf_map_update_elem(agg_map, &agg_key, &new_val,
+					BPF_NOEXIST) == 0)
+			return true;
+
+		/* Either the map is full or another CPU inserted it. */
+		agg_val = bpf_map_lookup_elem(agg_map, &agg_key);
+		if (agg_val == NULL)
+			return false;
+	}
+
+	__sync_fetch_and_add(&agg_val->count, 1);
+	return true;
+}
+
 static inline __attribute__ ((always_inline))
 int collect_stack_and_send_output(struct pt_regs *ctx,
 				  struct stack_trace_key_t *key,
 				  stack_t * stack, stack_t * intp_stack,
 				  map_group_t * maps, bool user_only)
 {
-	__u32 count_idx;
-
-	count_idx = TRANSFER_CNT_IDX;
-	__u64 *transfer_count_ptr =
-	    bpf_map_lookup_elem(maps->state, &count_idx);
-
-	__u64 *sample_count_ptrs[2];
-
-	count_idx = SAMPLE_CNT_A_IDX;
-	sample_count_ptrs[0] = bpf_map_lookup_elem(maps->state, &count_idx);
-
-	count_idx = SAMPLE_CNT_B_IDX;
-	sample_count_ptrs[1] = bpf_map_lookup_elem(maps->state, &count_idx);
-
-	count_idx = SAMPLE_CNT_DROP;
-	__u64 *drop_count_ptr = bpf_map_lookup_elem(maps->state, &count_idx);
-
-	count_idx = SAMPLE_ITER_CNT_MAX;
-	__u64 *iter_count_ptr = bpf_map_lookup_elem(maps->state, &count_idx);
-
-	count_idx = OUTPUT_CNT_IDX;
-	__u64 *output_count_ptr = bpf_map_lookup_elem(maps->state, &count_idx);
-
-	count_idx = ERROR_IDX;
-	__u64 *error_count_ptr = bpf_map_lookup_elem(maps->state, &count_idx);
-
-	if (transfer_count_ptr == NULL || sample_count_ptrs[0] == NULL
-	    || sample_count_ptrs[1] == NULL || drop_count_ptr == NULL
-	    || iter_count_ptr == NULL || error_count_ptr == NULL
-	    || output_count_ptr == NULL) {
-		count_idx = ERROR_IDX;
-		__u64 err_val = 1;
-		bpf_map_update_elem(maps->state, &count_idx, &err_val, BPF_ANY);
+	__u32 ctrl_idx = PROFILER_STATE_CTRL, cnt_idx = PROFILER_STATE_CNT;
+	profiler_state_t *ctrl = bpf_map_lookup_elem(maps->state, &ctrl_idx);
+	profiler_state_t *cnt = bpf_map_lookup_elem(maps->state, &cnt_idx);
+	if (ctrl == NULL || cnt == NULL)
 		return 0;
-	}
+
+	__u64 *transfer_count_ptr = &ctrl->vals[TRANSFER_CNT_IDX];
+	__u64 *drop_count_ptr = &cnt->vals[SAMPLE_CNT_DROP];
+	__u64 *iter_count_ptr = &cnt->vals[SAMPLE_ITER_CNT_MAX];
+	__u64 *output_count_ptr = &cnt->vals[OUTPUT_CNT_IDX];
+	__u64 *error_count_ptr = &cnt->vals[ERROR_IDX];
 
 	struct bpf_map_def *stack_map = NULL;
 
@@ -470,16 +499,22 @@ int collect_stack_and_send_output(struct pt_regs *ctx,
 #endif
 
 	__u64 sample_count = 0;
+	__u64 sample_count_base = 0;
 	__u64 *sample_count_ptr = NULL;
 	struct bpf_map_def *profiler_output = NULL;
+	struct bpf_map_def *agg_map = NULL;
 	if (!((*transfer_count_ptr) & 0x1ULL)) {
-		sample_count_ptr = sample_count_ptrs[0];
+		sample_count_ptr = &cnt->vals[SAMPLE_CNT_A_IDX];
+		sample_count_base = ctrl->vals[SAMPLE_CNT_A_BASE_IDX];
 		stack_map = maps->stack_map_a;
 		profiler_output = maps->profiler_output_a;
+		agg_map = maps->stack_agg_map_a;
 	} else {
-		sample_count_ptr = sample_count_ptrs[1];
+		sample_count_ptr = &cnt->vals[SAMPLE_CNT_B_IDX];
+		sample_count_base = ctrl->vals[SAMPLE_CNT_B_BASE_IDX];
 		stack_map = maps->stack_map_b;
 		profiler_output = maps->profiler_output_b;
+		agg_map = maps->stack_agg_map_b;
 	}
 
 	key->kernstack = bpf_get_stackid(ctx, stack_map, KERN_STACKID_FLAGS);
@@ -504,19 +539,28 @@ int collect_stack_and_send_output(struct pt_regs *ctx,
 		return 0;
 	}
 
-	sample_count = *sample_count_ptr;
+	sample_count = *sample_count_ptr - sample_count_base;
 	__sync_fetch_and_add(sample_count_ptr, 1);
 
-	if (bpf_perf_event_output
-	    (ctx, profiler_output, BPF_F_CURRENT_CPU, key,
-	     sizeof(struct stack_trace_key_t))) {
+	/*
+	 * Count the sample in the aggregation map. If the map is full,
+	 * fall back to outputting it.
+	 */
+	if (agg_map != NULL && ctrl->vals[SAMPLE_AGG_IDX]
+	    && aggregate_sample(agg_map, key)) {
+		__sync_fetch_and_add(&cnt->vals[SAMPLE_AGG_CNT_IDX], 1);
+	} else if (bpf_perf_event_output
+		   (ctx, profiler_output, BPF_F_CURRENT_CPU, key,
+		    sizeof(struct stack_trace_key_t))) {
 		__sync_fetch_and_add(error_count_ptr, 1);
 	} else {
 		__sync_fetch_and_add(output_count_ptr, 1);
 	}
 
 	/*
-	 * Each iteration in user mode sets the sample_count to 0. If
+	 * The sample counts are never reset, each time user mode makes a
+	 * buffer active, it records the buffer's count as the base, so
+	 * sample_count is the count of this iteration. If
 	 * sample_count > 0, it means that the user mode program is
 	 * currently in the process of iteration and has not completed
 	 * the stringifier task. If sample_count is too large, it is
@@ -544,28 +588,25 @@ static map_group_t oncpu_maps = {.state = &NAME(profiler_state_map),
 #endif
 	.profiler_output_a = &NAME(profiler_output_a),
 	.profiler_output_b = &NAME(profiler_output_b),
+	.stack_agg_map_a = &NAME(stack_agg_map_a),
+	.stack_agg_map_b = &NAME(stack_agg_map_b),
 	.progs_jmp = &NAME(cp_progs_jmp_pe_map),
 };
 
 PERF_EVENT_PROG(oncpu_profile) (struct bpf_perf_event_data * ctx) {
-	__u32 count_idx = ENABLE_IDX;
-	__u64 *enable_ptr = profiler_state_map__lookup(&count_idx);
-
-	count_idx = ERROR_IDX;
-	__u64 *error_count_ptr = profiler_state_map__lookup(&count_idx);
-
-	if (enable_ptr == NULL || error_count_ptr == NULL) {
-		count_idx = ERROR_IDX;
-		__u64 err_val = 1;
-		profiler_state_map__update(&count_idx, &err_val);
+	__u32 zero = 0;
+	__u32 ctrl_idx = PROFILER_STATE_CTRL, cnt_idx = PROFILER_STATE_CNT;
+	profiler_state_t *ctrl = profiler_state_map__lookup(&ctrl_idx);
+	profiler_state_t *cnt = profiler_state_map__lookup(&cnt_idx);
+	if (ctrl == NULL || cnt == NULL)
 		return 0;
-	}
 
-	if (unlikely(*enable_ptr == 0))
+	__u64 *error_count_ptr = &cnt->vals[ERROR_IDX];
+
+	if (unlikely(ctrl->vals[ENABLE_IDX] == 0))
 		return 0;
 
 #ifdef LINUX_VER_5_2_PLUS
-	__u32 zero = 0;
 	unwind_state_t *state = heap__lookup(&zero);
 	if (state == NULL) {
 		return 0;
@@ -688,20 +729,13 @@ static inline __attribute__ ((always_inline))
 int dwarf_unwind(void *ctx, unwind_state_t * state,
 		 map_group_t *maps, int jmp_idx)
 {
-	__u32 count_idx;
-
-	count_idx = SAMPLE_CNT_DROP;
-	__u64 *drop_count_ptr = bpf_map_lookup_elem(maps->state, &count_idx);
-
-	count_idx = ERROR_IDX;
-	__u64 *error_count_ptr = bpf_map_lookup_elem(maps->state, &count_idx);
-
-	if (drop_count_ptr == NULL || error_count_ptr == NULL) {
-		count_idx = ERROR_IDX;
-		__u64 err_val = 1;
-		bpf_map_update_elem(maps->state, &count_idx, &err_val, BPF_ANY);
+	__u32 cnt_idx = PROFILER_STATE_CNT;
+	profiler_state_t *profiler_state =
+	    bpf_map_lookup_elem(maps->state, &cnt_idx);
+	if (profiler_state == NULL)
 		return -1;
-	}
+
+	__u64 *error_count_ptr = &profiler_state->vals[ERROR_IDX];
 
 	process_shard_list_t *shard_list =
 	    process_shard_list_table__lookup(&state->key.tgid);
@@ -1003,19 +1037,14 @@ output:
 }
 
 PROGPE(python_unwind) (struct bpf_perf_event_data * ctx) {
-	__u32 count_idx;
-
-	count_idx = ERROR_IDX;
-	__u64 *error_count_ptr = profiler_state_map__lookup(&count_idx);
-
-	if (error_count_ptr == NULL) {
-		count_idx = ERROR_IDX;
-		__u64 err_val = 1;
-		profiler_state_map__update(&count_idx, &err_val);
+	__u32 zero = 0;
+	__u32 cnt_idx = PROFILER_STATE_CNT;
+	profiler_state_t *profiler_state = profiler_state_map__lookup(&cnt_idx);
+	if (profiler_state == NULL)
 		return -1;
-	}
 
-	__u32 zero = 0;
+	__u64 *error_count_ptr = &profiler_state->vals[ERROR_IDX];
+
 	unwind_state_t *state = heap__lookup(&zero);
 	if (state == NULL) {
 		return 0;
@@ -46,7 +46,19 @@
 /*
  * 向用户态传递数据的专用map
  */
+#ifdef SUPPORTS_RINGBUF
+/*
+ * Shared ring buffers used instead of the per-CPU 'socket_data' perf
+ * buffers, each one serves a group of CPUs (tracer_ctx_s.ringbuf_idx).
+ * User space sizes them before loading, unused rings shrink to one page.
+ */
+MAP_RINGBUF(socket_ringbuf_0, SOCKET_RINGBUF_SIZE_DEF, FEATURE_FLAG_SOCKET_TRACER)
+MAP_RINGBUF(socket_ringbuf_1, SOCKET_RINGBUF_SIZE_DEF, FEATURE_FLAG_SOCKET_TRACER)
+MAP_RINGBUF(socket_ringbuf_2, SOCKET_RINGBUF_SIZE_DEF, FEATURE_FLAG_SOCKET_TRACER)
+MAP_RINGBUF(socket_ringbuf_3, SOCKET_RINGBUF_SIZE_DEF, FEATURE_FLAG_SOCKET_TRACER)
+#else
 MAP_PERF_EVENT(socket_data, int, __u32, MAX_CPU, FEATURE_FLAG_SOCKET_TRACER)
+#endif
 
 /*
  * Why use two Tail Calls jmp tables ?
@@ -459,6 +471,69 @@ static __inline struct member_fields_offset *retrieve_ready_kern_offset(void)
 	return offset;
 }
 
+#ifdef SUPPORTS_RINGBUF
+static __inline long ringbuf_output(void *ringbuf, void *data, __u64 size,
+				    __u32 wakeup_bytes)
+{
+	__u64 flags = BPF_RB_NO_WAKEUP;
+	if (bpf_ringbuf_query(ringbuf, BPF_RB_AVAIL_DATA) + size >= wakeup_bytes)
+		flags = BPF_RB_FORCE_WAKEUP;
+
+	return bpf_ringbuf_output(ringbuf, data, size, flags);
+}
+#endif
+
+/*
+ * Send data to the user-space reader, through the per-CPU perf buffer or,
+ * for SUPPORTS_RINGBUF builds, the ring buffer of this CPU's group.
+ *
+ * Ring buffer wakeups are batched: the reader is only woken once the ring
+ * holds 'ringbuf_wakeup_bytes' of data, otherwise it picks the data up
+ * when its poll times out.
+ */
+static __inline long socket_data_output(void *ctx, void *data, __u64 size)
+{
+#ifdef SUPPORTS_RINGBUF
+	__u32 k0 = 0;
+	long ret;
+	struct tracer_ctx_s *tracer_ctx = tracer_ctx_map__lookup(&k0);
+	if (tracer_ctx == NULL)
+		return -1;
+
+	__u32 wakeup_bytes = tracer_ctx->ringbuf_wakeup_bytes;
+	switch (tracer_ctx->ringbuf_idx) {
+	case 1:
+		ret = ringbuf_output(&NAME(socket_ringbuf_1), data, size,
+				     wakeup_bytes);
+		break;
+	case 2:
+		ret = ringbuf_output(&NAME(socket_ringbuf_2), data, size,
+				     wakeup_bytes);
+		break;
+	case 3:
+		ret = ringbuf_output(&NAME(socket_ringbuf_3), data, size,
+				     wakeup_bytes);
+		break;
+	default:
+		ret = ringbuf_output(&NAME(socket_ringbuf_0), data, size,
+				     wakeup_bytes);
+		break;
+	}
+
+	if (ret < 0) {
+		struct trace_stats *trace_stats = trace_stats_map__lookup(&k0);
+		if (trace_stats)
+			__sync_fetch_and_add(&trace_stats->ringbuf_lost_count,
+					     1);
+	}
+
+	return ret;
+#else
+	return bpf_perf_event_output(ctx, &NAME(socket_data),
+				     BPF_F_CURRENT_CPU, data, size);
+#endif
+}
+
 #include "uprobe_base.bpf.c"
 #include "include/protocol_inference.h"
 #define CONN_PERSIST_TIME_MAX_NS   100000000000ULL
@@ -782,8 +857,7 @@ static __inline void connect_submit(struct pt_regs *ctx, struct conn_info_s *v,
 		return;
 	}
 
-	bpf_perf_event_output(ctx, &NAME(socket_data),
-			      BPF_F_CURRENT_CPU, v, 128);
+	socket_data_output(ctx, v, 128);
 }
 #endif
 
@@ -2988,16 +3062,14 @@ static __inline int finalize_data_output(void *ctx,
 		 * Use 'buf_size + 1' instead of 'buf_size' to circumvent
 		 * (Linux 4.14.x) length checks.
 		 */
-		bpf_perf_event_output(ctx, &NAME(socket_data),
-				      BPF_F_CURRENT_CPU, v_buff, buf_size + 1);
+		socket_data_output(ctx, v_buff, buf_size + 1);
 	} else {
-		bpf_perf_event_output(ctx, &NAME(socket_data),
-				      BPF_F_CURRENT_CPU, v_buff,
-				      sizeof(*v_buff));
+		socket_data_output(ctx, v_buff, sizeof(*v_buff));
 	}
 
 	v_buff->events_num = 0;
 	v_buff->len = 0;
+	tracer_ctx->buffered_timestamp = 0;
 	if (diff > PERIODIC_PUSH_DELAY_THRESHOLD_NS) {
 		tracer_ctx->last_period_timestamp =
 		    tracer_ctx->period_timestamp;
@@ -3130,6 +3202,8 @@ skip_copy:
 	 * will be pushed immediately.
 	 */
 	__u64 curr_time = bpf_ktime_get_ns();
+	if (v_buff->events_num == 1)
+		tracer_ctx->buffered_timestamp = curr_time;
 	__u64 diff = curr_time - tracer_ctx->last_period_timestamp;
 	if (diff > PERIODIC_PUSH_DELAY_THRESHOLD_NS ||
 	    v_buff->events_num >= MAX_EVENTS_BURST ||
@@ -3229,6 +3303,8 @@ skip_copy:
 	 * will be pushed immediately.
 	 */
 	__u64 curr_time = bpf_ktime_get_ns();
+	if (v_buff->events_num == 1)
+		tracer_ctx->buffered_timestamp = curr_time;
 	__u64 diff = curr_time - tracer_ctx->last_period_timestamp;
 	if (diff > PERIODIC_PUSH_DELAY_THRESHOLD_NS ||
 	    v_buff->events_num >= MAX_EVENTS_BURST ||
@@ -3413,14 +3489,25 @@ static __inline int push_socket_data(struct syscall_comm_enter_ctx *ctx)
 
 	/*
 	 * Monitor the maximum and average delay time of periodic push events.
+	 *
+	 * The delay is measured from the time the push buffer became non-empty
+	 * rather than from the previous kick, which may be arbitrarily old on an
+	 * idle CPU. Kicks of CPUs with nothing buffered (the periodic sweep of
+	 * all CPUs) push nothing and are not accounted.
 	 */
 	tracer_ctx->last_period_timestamp = tracer_ctx->period_timestamp;
 	tracer_ctx->period_timestamp = bpf_ktime_get_ns();
-	__u64 diff = tracer_ctx->period_timestamp -
-	    tracer_ctx->last_period_timestamp;
+	__u64 diff = 0;
+	if (tracer_ctx->buffered_timestamp > 0) {
+		if (tracer_ctx->period_timestamp >
+		    tracer_ctx->buffered_timestamp)
+			diff = tracer_ctx->period_timestamp -
+			    tracer_ctx->buffered_timestamp;
 
-	__sync_fetch_and_add(&trace_stats->period_event_total_time, diff);
-	__sync_fetch_and_add(&trace_stats->period_event_count, 1);
+		__sync_fetch_and_add(&trace_stats->period_event_total_time,
+				     diff);
+		__sync_fetch_and_add(&trace_stats->period_event_count, 1);
+	}
 
 	/*
 	 * If a previous system call is in the process of modifying the push buffer to
@@ -3452,21 +3539,16 @@ static __inline int push_socket_data(struct syscall_comm_enter_ctx *ctx)
 				 * Use 'buf_size + 1' instead of 'buf_size' to circumvent
 				 * (Linux 4.14.x) length checks.
 				 */
-				bpf_perf_event_output(ctx,
-						      &NAME
-						      (socket_data),
-						      BPF_F_CURRENT_CPU,
-						      v_buff, buf_size + 1);
+				socket_data_output(ctx, v_buff,
+						   buf_size + 1);
 			} else {
-				bpf_perf_event_output(ctx,
-						      &NAME
-						      (socket_data),
-						      BPF_F_CURRENT_CPU,
-						      v_buff, sizeof(*v_buff));
+				socket_data_output(ctx, v_buff,
+						   sizeof(*v_buff));
 			}
 
 			v_buff->events_num = 0;
 			v_buff->len = 0;
+			tracer_ctx->buffered_timestamp = 0;
 			if (diff > MAX_PUSH_DELAY_TIME_NS) {
 				// Indicates that a delay occurred in this data push.
 				__sync_fetch_and_add(&trace_stats->period_event_max_delay, 1);
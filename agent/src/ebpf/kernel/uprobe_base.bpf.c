@@ -634,8 +634,7 @@ static __inline int do_process_exit(void *ctx)
 		data.pid = pid;
 		data.meta.event_type = EVENT_TYPE_PROC_EXIT;
 		bpf_get_current_comm(data.name, sizeof(data.name));
-		bpf_perf_event_output(ctx, &NAME(socket_data),
-				      BPF_F_CURRENT_CPU, &data, sizeof(data));
+		socket_data_output(ctx, &data, sizeof(data));
 	}
 
 	bpf_map_delete_elem(&goroutines_map, &id);
@@ -683,8 +682,7 @@ static inline int kernel_clone_exit(bool is_kprobe, bool maybe_thread,
 		data.pid = pid;
 	data.maybe_thread = maybe_thread;
 	bpf_get_current_comm(data.name, sizeof(data.name));
-	bpf_perf_event_output(ctx, &NAME(socket_data),
-			      BPF_F_CURRENT_CPU, &data, sizeof(data));
+	socket_data_output(ctx, &data, sizeof(data));
 	return 0;
 }
 
@@ -744,8 +742,7 @@ static __inline int __process_exec(void *ctx)
 		data.pid = pid;
 		data.maybe_thread = false;
 		bpf_get_current_comm(data.name, sizeof(data.name));
-		bpf_perf_event_output(ctx, &NAME(socket_data),
-				      BPF_F_CURRENT_CPU, &data, sizeof(data));
+		socket_data_output(ctx, &data, sizeof(data));
 	}
 
 	return 0;
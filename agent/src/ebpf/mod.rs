@@ -438,6 +438,16 @@ pub struct SK_TRACE_STATS {
     pub dropped_packets: u64,
     pub kern_missed_packets: u64,
     pub invalid_packets: u64,
+    pub worker_wakeup_count: u64,
+    pub queue_depth_max: u64,  // The deepest dispatch queue when collected.
+    pub flow_steal_count: u64, // Flow buckets moved to idle dispatch workers.
+    pub proc_maps_parse_count: u64, // /proc/<pid>/maps files parsed.
+    pub proc_maps_hit_count: u64, // Lookups served by a cached maps snapshot.
+    pub proc_maps_parse_max_us: u64, // The longest maps parse, in microseconds.
+    pub proc_maps_parse_avg_us: u64, // The average maps parse, in microseconds.
+    pub kick_count: u64,             // CPUs kicked to push buffered data.
+    pub kick_cpu_us: u64,            // CPU time of the kick thread, in microseconds.
+    pub kick_sweep_max_us: u64,      // The longest sweep over the CPUs, in microseconds.
 }
 
 #[repr(C)]
@@ -505,6 +515,16 @@ extern "C" {
     pub fn set_go_tracing_timeout(timeout: c_int) -> c_int;
     pub fn set_io_event_collect_mode(mode: c_int) -> c_int;
     pub fn set_io_event_minimal_duration(duration: c_ulonglong) -> c_int;
+    pub fn set_dispatch_spin_budget(budget: c_uint) -> c_int;
+    /*
+     * Use BPF ring buffers instead of per-CPU perf buffers for socket data,
+     * must be called before running_socket_tracer().
+     *
+     * @rings_num Number of rings, CPUs are split into as many groups (0 disables).
+     * @ring_pages Memory pages per ring, 0 uses the default (4MB).
+     * @wakeup_bytes Wake up the reader once this much data is pending, 0 uses the default.
+     */
+    pub fn set_socket_ringbuf(rings_num: c_int, ring_pages: c_uint, wakeup_bytes: c_uint) -> c_int;
     pub fn set_allow_port_bitmap(bitmap: *const c_uchar) -> c_int;
     pub fn set_bypass_port_bitmap(bitmap: *const c_uchar) -> c_int;
     pub fn enable_ebpf_protocol(protocol: c_int) -> c_int;
@@ -662,6 +682,20 @@ extern "C" {
      */
     pub fn set_profiler_cpu_aggregation(flag: c_int) -> c_int;
 
+    /*
+     * Java JIT symbols are resolved from memory. This enables also writing
+     * them to /tmp/perf-<pid>.map for external tools, disabled by default.
+     */
+    pub fn set_java_perf_map_export(enabled: bool);
+
+    /*
+     * Count the on-CPU samples by key in kernel and drain the counts once
+     * per iteration, instead of outputting every sample through the perf
+     * buffer. Must be called before start_continuous_profiler(), disabled
+     * by default.
+     */
+    pub fn set_profiler_sample_aggregation(enabled: bool);
+
     /*
      * test flame graph
      */
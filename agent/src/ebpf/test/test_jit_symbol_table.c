@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../user/types.h"
+#include "../user/clib.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+#include "../user/profile/java/jit_symbol_table.h"
+
+#define TEST_PID 1234
+
+static int check(u64 addr, const char *expect)
+{
+	char name[256];
+	int ret = java_jit_symbol_lookup(TEST_PID, addr, name, sizeof(name));
+	if (expect == NULL) {
+		if (ret == 0) {
+			printf("0x%lx: expect none, got '%s'\n", addr, name);
+			return -1;
+		}
+		return 0;
+	}
+
+	if (ret != 0 || strcmp(name, expect)) {
+		printf("0x%lx: expect '%s', got '%s'\n", addr, expect,
+		       ret == 0 ? name : "none");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int add(jit_symbol_table_t * t, u64 start, u32 size, const char *name)
+{
+	return jit_symbol_table_add(t, start, size, name, strlen(name));
+}
+
+int main(void)
+{
+	int ret = 0;
+	log_to_stdout = true;
+	clib_mem_init();
+
+	jit_symbol_table_t *t = jit_symbol_table_create(TEST_PID);
+	if (t == NULL)
+		return -1;
+
+	/* Replay: symbols arrive unordered, not visible until sorted. */
+	add(t, 0x3000, 0x100, "LC;::c");
+	add(t, 0x1000, 0x100, "LA;::a");
+	add(t, 0x2000, 0x100, "LB;::b");
+	jit_symbol_table_remove(t, 0x2000);
+	add(t, 0x2000, 0x80, "LB;::b2");
+	ret |= check(0x1010, NULL);
+
+	jit_symbol_table_sort(t);
+	ret |= check(0x1010, "LA;::a");
+	ret |= check(0x10ff, "LA;::a");
+	ret |= check(0x1100, NULL);
+	ret |= check(0x2010, "LB;::b2");
+	ret |= check(0x2090, NULL);
+	ret |= check(0x3000, "LC;::c");
+	ret |= check(0x0fff, NULL);
+
+	/* Incremental updates after replay. */
+	add(t, 0x1800, 0x100, "LD;::d");
+	ret |= check(0x1850, "LD;::d");
+	jit_symbol_table_remove(t, 0x1000);
+	ret |= check(0x1010, NULL);
+
+	/* The code cache is reused, overlapping symbols are replaced. */
+	add(t, 0x2fc0, 0x80, "LE;::e");
+	ret |= check(0x2fd0, "LE;::e");
+	ret |= check(0x3010, "LE;::e");
+	ret |= check(0x3050, NULL);
+	if (java_jit_symbols_count(TEST_PID) != 3) {
+		printf("symbols count %u, expect 3\n",
+		       java_jit_symbols_count(TEST_PID));
+		ret = -1;
+	}
+
+	char path[] = "/tmp/test_jit_symbol_table.map";
+	if (jit_symbol_table_export(t, path) != 3)
+		ret = -1;
+	unlink(path);
+
+	jit_symbol_table_destroy(t);
+	ret |= check(0x1850, NULL);
+
+	printf("[%s] %s\n", __func__, ret == 0 ? "success" : "failed");
+	return ret;
+}
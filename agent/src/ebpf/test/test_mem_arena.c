@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../user/types.h"
+#include "../user/clib.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+
+#define THREADS_NUM	8
+#define ALLOC_NUM	100000
+
+/* Allocate and free on several threads, and keep some memory alive. */
+static void *worker(void *arg)
+{
+	void **keep = arg;
+	int i;
+	for (i = 0; i < ALLOC_NUM; i++) {
+		void *p = clib_mem_alloc_aligned("test_mem", 64 + (i & 255),
+						 0, NULL);
+		if (p == NULL)
+			return NULL;
+		clib_mem_free(p);
+	}
+
+	*keep = clib_mem_alloc_aligned("test_mem", 4096, 0, NULL);
+	return NULL;
+}
+
+static int test_thread_stat(void)
+{
+	pthread_t tids[THREADS_NUM];
+	void *keep[THREADS_NUM];
+	u64 alloc_b, free_b, use;
+	int i, round;
+
+	/* The second round reuses the stats of the exited threads. */
+	for (round = 0; round < 2; round++) {
+		for (i = 0; i < THREADS_NUM; i++)
+			pthread_create(&tids[i], NULL, worker, &keep[i]);
+		for (i = 0; i < THREADS_NUM; i++)
+			pthread_join(tids[i], NULL);
+
+		get_mem_stat(&alloc_b, &free_b);
+		use = alloc_b - free_b;
+		/* Freed by another thread than the allocating one. */
+		for (i = 0; i < THREADS_NUM; i++)
+			clib_mem_free(keep[i]);
+		get_mem_stat(&alloc_b, &free_b);
+		if (use - (alloc_b - free_b) != THREADS_NUM * (4096 + 8)) {
+			printf("round %d: use %lu, after free %lu\n", round,
+			       use, alloc_b - free_b);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int test_arena(void)
+{
+	clib_mem_arena_t a;
+	u64 alloc_b, free_b, use;
+	char *p, *q, *big;
+	int i;
+
+	get_mem_stat(&alloc_b, &free_b);
+	use = alloc_b - free_b;
+
+	clib_mem_arena_init(&a, "test_arena", 4096);
+	for (i = 0; i < 3; i++) {
+		p = clib_mem_arena_alloc(&a, 3000);
+		q = clib_mem_arena_alloc(&a, 3000);
+		big = clib_mem_arena_alloc(&a, 10000);
+		if (p == NULL || q == NULL || big == NULL)
+			return -1;
+		if (((uword) p | (uword) q) & (CLIB_MEM_MIN_ALIGN - 1))
+			return -1;
+		memset(p, 'p', 3000);
+		memset(q, 'q', 3000);
+		memset(big, 'b', 10000);
+		if (p[2999] != 'p' || q[0] != 'q')
+			return -1;
+		if (a.used_bytes != 3000 + 3000 + 10000) {
+			printf("used %lu\n", a.used_bytes);
+			return -1;
+		}
+		show_mem_list();
+		clib_mem_arena_reset(&a);
+		/* The two regular chunks are kept, the oversized one freed. */
+		if (a.used_bytes != 0 || a.reserved_bytes != 2 * 4096) {
+			printf("reserved %lu\n", a.reserved_bytes);
+			return -1;
+		}
+	}
+	if (a.peak_bytes != 16000 || a.reset_count != 3)
+		return -1;
+
+	clib_mem_arena_release(&a);
+	get_mem_stat(&alloc_b, &free_b);
+	if (alloc_b - free_b != use) {
+		printf("arena leaked %lu bytes\n", alloc_b - free_b - use);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	int ret;
+	log_to_stdout = true;
+	clib_mem_init();
+
+	ret = test_thread_stat();
+	if (ret == 0)
+		ret = test_arena();
+	show_mem_list();
+
+	printf("[%s] %s\n", __func__, ret == 0 ? "success" : "failed");
+	return ret;
+}
@@ -15,22 +15,75 @@
  */
 
 #include "../user/offset.h"
+#include "../user/utils.h"
 #include <stdio.h>
+#include <time.h>
 
 const char *test_go_file = "../../../resources/test/ebpf/go-elf";
 
-int main(void)
+static struct member_offset targets[] = {
+	{"runtime.g", "goid"},
+	{"runtime.g", "m"},
+	{"runtime.m", "procid"},
+	{"crypto/tls.Conn", "conn"},
+	{"internal/poll.FD", "Sysfd"},
+	{"net/http.http2serverConn", "conn"},
+	{"net/http.http2ClientConn", "tconn"},
+	{"net/http.http2ClientConn", "nextStreamID"},
+	{"net/http.http2FrameHeader", "StreamID"},
+	{"net/http.http2MetaHeadersFrame", "Fields"},
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * Resolve all the targets one by one and in a single pass, the results
+ * must be the same. Usage: test_offset [binary], the default is the Go
+ * fixture; pass a large binary with debug info to compare the timings.
+ */
+int main(int argc, char **argv)
 {
+	const char *bin = argc > 1 ? argv[1] : test_go_file;
+	int expect[NELEMS(targets)];
+	double start, single_ms, batch_ms;
+	int i, found;
 
-	int offset = struct_member_offset_analyze(test_go_file, "runtime.g", "goid");
+	int offset = struct_member_offset_analyze(bin, "runtime.g", "goid");
 
 	// 偏移量预期输出 152
-	if (offset != 152)
+	if (argc == 1 && offset != 152)
 	{
 		printf("[FAIL]\n");
 		return -1;
 	}
 
+	start = now_ms();
+	for (i = 0; i < NELEMS(targets); i++)
+		expect[i] = struct_member_offset_analyze(bin,
+							 targets[i].structure,
+							 targets[i].member);
+	single_ms = now_ms() - start;
+
+	start = now_ms();
+	found = struct_member_offsets_analyze(bin, targets, NELEMS(targets));
+	batch_ms = now_ms() - start;
+
+	for (i = 0; i < NELEMS(targets); i++) {
+		if (targets[i].offset != expect[i]) {
+			printf("[FAIL] %s.%s: %d, expect %d\n",
+			       targets[i].structure, targets[i].member,
+			       targets[i].offset, expect[i]);
+			return -1;
+		}
+	}
+
+	printf("%d/%lu members found, one by one %.1fms, single pass %.1fms\n",
+	       found, NELEMS(targets), single_ms, batch_ms);
 	printf("[OK]\n");
 
 	return 0;
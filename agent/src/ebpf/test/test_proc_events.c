@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../user/config.h"
+#include "../user/types.h"
+#include "../user/clib.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+#include "../user/symbol.h"
+#include "../user/proc.h"
+
+#define EVENTS_NUM	10000
+
+static int drain_all(proc_event_list_t * list, int *pids, int max)
+{
+	struct process_create_event *e, *n;
+	struct list_head expired;
+	int count = 0;
+
+	init_list_head(&expired);
+	while (proc_event_list_drain(list, &expired, 64) > 0) {
+		list_for_each_entry_safe(e, n, &expired, list) {
+			list_head_del(&e->list);
+			if (count < max)
+				pids[count] = e->pid;
+			count++;
+			process_event_free(e);
+		}
+	}
+
+	return count;
+}
+
+/* Events expire in arrival order, a newer event of a PID replaces the old. */
+static int test_drain_order(void)
+{
+	proc_event_list_t list;
+	static int pids[EVENTS_NUM];
+	int i, count;
+
+	proc_event_list_init(&list, 0);
+	for (i = 0; i < EVENTS_NUM; i++)
+		add_event_to_proc_list(&list, NULL, i + 1, strdup("/bin/true"));
+	// Re-queued to the end
+	add_event_to_proc_list(&list, NULL, 1, NULL);
+	if (proc_event_list_count(&list) != EVENTS_NUM)
+		return -1;
+
+	count = drain_all(&list, pids, EVENTS_NUM);
+	if (count != EVENTS_NUM) {
+		printf("drained %d, expect %d\n", count, EVENTS_NUM);
+		return -1;
+	}
+	for (i = 0; i < EVENTS_NUM - 1; i++) {
+		if (pids[i] != i + 2) {
+			printf("pids[%d] = %d, expect %d\n", i, pids[i], i + 2);
+			return -1;
+		}
+	}
+	if (pids[EVENTS_NUM - 1] != 1)
+		return -1;
+
+	return proc_event_list_count(&list) == 0 ? 0 : -1;
+}
+
+/* Exits cancel the pending events, nothing expires before the delay. */
+static int test_cancel(void)
+{
+	proc_event_list_t delayed, list;
+	static int pids[EVENTS_NUM];
+	int i, count;
+
+	proc_event_list_init(&delayed, 3600);
+	proc_event_list_init(&list, 0);
+	for (i = 0; i < EVENTS_NUM; i++) {
+		add_event_to_proc_list(&delayed, NULL, i + 1, NULL);
+		add_event_to_proc_list(&list, NULL, i + 1, NULL);
+	}
+
+	for (i = 0; i < EVENTS_NUM; i += 2) {
+		proc_event_list_cancel(&delayed, i + 1);
+		proc_event_list_cancel(&list, i + 1);
+	}
+	// Not queued
+	proc_event_list_cancel(&list, EVENTS_NUM + 1);
+
+	if (drain_all(&delayed, pids, EVENTS_NUM) != 0 ||
+	    proc_event_list_count(&delayed) != EVENTS_NUM / 2)
+		return -1;
+
+	count = drain_all(&list, pids, EVENTS_NUM);
+	if (count != EVENTS_NUM / 2)
+		return -1;
+	for (i = 0; i < count; i++) {
+		if (pids[i] != 2 * i + 2)
+			return -1;
+	}
+
+	for (i = 0; i < EVENTS_NUM; i++)
+		proc_event_list_cancel(&delayed, i + 1);
+
+	return proc_event_list_count(&delayed) == 0 ? 0 : -1;
+}
+
+int main(void)
+{
+	int ret;
+	log_to_stdout = true;
+	clib_mem_init();
+
+	ret = test_drain_order();
+	if (ret == 0)
+		ret = test_cancel();
+
+	printf("[%s] %s\n", __func__, ret == 0 ? "success" : "failed");
+	return ret;
+}
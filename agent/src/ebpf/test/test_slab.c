@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Simulate reader_raw_cb(): one producer allocates socket data bursts and
+ * hands them to a worker which frees them. Compare malloc() with the slab
+ * allocator on allocation tail latency and RSS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../user/types.h"
+#include "../user/clib.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+
+#define ALLOC_NUM	(1 << 21)
+#define RING_SZ		(1 << 12)
+#define LAT_SAMPLES	(1 << 16)
+
+struct spsc_ring {
+	void *slots[RING_SZ];
+	volatile u64 head __attribute__ ((aligned(64)));
+	volatile u64 tail __attribute__ ((aligned(64)));
+};
+
+static struct spsc_ring ring;
+static clib_slab_t slab;
+static bool use_slab;
+static u64 lat_ns[LAT_SAMPLES];
+
+static inline u64 now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Peak resident set size (VmHWM) of the process. */
+static long peak_rss_kb(void)
+{
+	char line[128];
+	long kb = -1;
+	FILE *f = fopen("/proc/self/status", "r");
+	if (f == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "VmHWM: %ld kB", &kb) == 1)
+			break;
+	}
+	fclose(f);
+	return kb;
+}
+
+static void *worker(void *arg)
+{
+	u64 n = 0;
+	while (n < ALLOC_NUM) {
+		if (ring.tail == __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE)) {
+			CLIB_PAUSE();
+			continue;
+		}
+		void *p = ring.slots[ring.tail & (RING_SZ - 1)];
+		__atomic_store_n(&ring.tail, ring.tail + 1, __ATOMIC_RELEASE);
+		if (use_slab)
+			clib_slab_free(p);
+		else
+			free(p);
+		n++;
+	}
+
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(u64 *) a, y = *(u64 *) b;
+	return x < y ? -1 : x > y;
+}
+
+static int run(bool slab_mode)
+{
+	pthread_t tid;
+	u32 seed = 1;
+	u64 i;
+
+	use_slab = slab_mode;
+	ring.head = ring.tail = 0;
+	if (pthread_create(&tid, NULL, worker, NULL))
+		return -1;
+
+	for (i = 0; i < ALLOC_NUM; i++) {
+		/* A burst of socket data, mostly small and sometimes large. */
+		seed = seed * 1103515245 + 12345;
+		uword size = 512 + (seed >> 8) % ((seed & 0xf) ? 4096 : 65536);
+
+		while (i - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) >=
+		       RING_SZ)
+			CLIB_PAUSE();
+
+		u64 start = now_ns();
+		void *p = slab_mode ? clib_slab_alloc(&slab, size) :
+		    malloc(size);
+		lat_ns[i & (LAT_SAMPLES - 1)] = now_ns() - start;
+		if (p == NULL) {
+			printf("alloc failed\n");
+			return -1;
+		}
+		memset(p, 0, size);
+		ring.slots[i & (RING_SZ - 1)] = p;
+		__atomic_store_n(&ring.head, i + 1, __ATOMIC_RELEASE);
+	}
+
+	pthread_join(tid, NULL);
+
+	qsort(lat_ns, LAT_SAMPLES, sizeof(lat_ns[0]), cmp_u64);
+	printf("%-8s alloc latency p50 %lu ns p99 %lu ns p99.9 %lu ns "
+	       "max %lu ns, peak RSS %ld KB\n", slab_mode ? "slab" : "malloc",
+	       lat_ns[LAT_SAMPLES / 2], lat_ns[LAT_SAMPLES * 99 / 100],
+	       lat_ns[LAT_SAMPLES * 999 / 1000], lat_ns[LAT_SAMPLES - 1],
+	       peak_rss_kb());
+
+	if (slab_mode) {
+		u64 in_flight = atomic64_read(&slab.bytes_in_flight);
+		clib_slab_release(&slab);
+		printf("bytes in flight %lu\n", in_flight);
+		return in_flight == 0 ? 0 : -1;
+	}
+
+	return 0;
+}
+
+/* Run in a child process, so that the peak RSS is not shared. */
+static int run_child(bool slab_mode)
+{
+	int status;
+	pid_t pid = fork();
+	if (pid < 0)
+		return -1;
+	if (pid == 0)
+		exit(run(slab_mode) == 0 ? 0 : 1);
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+int main(void)
+{
+	clib_mem_init();
+	clib_slab_init(&slab, "test_slab");
+
+	if (run_child(false) || run_child(true))
+		return -1;
+
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../user/config.h"
+#include "../user/types.h"
+#include "../user/clib.h"
+#include "../user/mem.h"
+#include "../user/log.h"
+#include "../user/profile/stack_str_cache.h"
+
+#define CORPUS_MAX	4096
+#define ITERATIONS	50
+#define SAMPLES_NUM	2000
+
+struct stack {
+	pid_t pid;
+	int depth;
+	u64 ips[PERF_MAX_STACK_DEPTH];
+};
+
+static struct stack corpus[CORPUS_MAX];
+static int corpus_len;
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * Load the corpus, one stack per line: "<pid> <addr>;<addr>;...". Without
+ * a file, generate stacks of a few processes sharing their outer frames.
+ */
+static int load_corpus(const char *path)
+{
+	char line[4096];
+	int i, j;
+
+	if (path == NULL) {
+		srand(1);
+		for (i = 0; i < 512; i++) {
+			struct stack *s = &corpus[i];
+			s->pid = 1000 + i % 8;
+			s->depth = 8 + rand() % 48;
+			for (j = 0; j < s->depth; j++)
+				s->ips[j] = j < s->depth / 2 ?
+				    0x400000 + j * 0x40 + rand() % 4096 :
+				    0x7f0000000000 + j * 0x1000;
+		}
+		corpus_len = i;
+		return 0;
+	}
+
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+
+	while (corpus_len < CORPUS_MAX && fgets(line, sizeof(line), fp)) {
+		struct stack *s = &corpus[corpus_len];
+		char *p = line, *end;
+		s->pid = strtol(p, &end, 10);
+		for (j = 0, p = end; j < PERF_MAX_STACK_DEPTH; j++, p = end) {
+			while (*p == ' ' || *p == ';')
+				p++;
+			s->ips[j] = strtoull(p, &end, 16);
+			if (end == p)
+				break;
+		}
+		s->depth = j;
+		if (s->depth > 0)
+			corpus_len++;
+	}
+	fclose(fp);
+
+	return corpus_len > 0 ? 0 : -1;
+}
+
+/* Stands for symbolizing and folding the stack. */
+static void fold_stack(struct stack *s, char *buf, int size)
+{
+	int i, len = 0;
+	buf[0] = '\0';
+	for (i = s->depth - 1; i >= 0 && len < size; i--)
+		len += snprintf(buf + len, size - len, "%sfunc_%lx",
+				len ? ";" : "", s->ips[i]);
+}
+
+/* Pick hot stacks far more often than cold ones. */
+static struct stack *sample_stack(void)
+{
+	int r = rand() % corpus_len;
+	return &corpus[(r * r / corpus_len) % corpus_len];
+}
+
+/*
+ * Without 'check', a hit costs only the key and the lookup, as in the
+ * profiler; with 'check', the cached strings are compared to the stacks.
+ */
+static int replay(stack_str_cache_t * c, double *elapsed_ms, bool use_cache,
+		  bool check)
+{
+	char buf[PERF_MAX_STACK_DEPTH * 32];
+	stack_str_cache_key_t k;
+	int i, n;
+
+	double start = now_ms();
+	for (i = 0; i < ITERATIONS; i++) {
+		for (n = 0; n < SAMPLES_NUM; n++) {
+			struct stack *s = sample_stack();
+			if (!use_cache) {
+				fold_stack(s, buf, sizeof(buf));
+				continue;
+			}
+
+			stack_str_cache_key(&k, s->ips, PERF_MAX_STACK_DEPTH,
+					    s->pid, 1, 1, 0);
+			const char *str = stack_str_cache_lookup(c, &k);
+			if (str == NULL) {
+				fold_stack(s, buf, sizeof(buf));
+				str = stack_str_cache_add(c, &k, buf);
+				if (str == NULL)
+					return -1;
+				continue;
+			}
+
+			if (!check)
+				continue;
+			fold_stack(s, buf, sizeof(buf));
+			if (strcmp(str, buf)) {
+				printf("stack of pid %d mismatch\n", s->pid);
+				return -1;
+			}
+		}
+		/* The end of a profiler iteration. */
+		stack_str_cache_trim(c);
+	}
+	*elapsed_ms = now_ms() - start;
+
+	return 0;
+}
+
+static int test_generation(stack_str_cache_t * c)
+{
+	stack_str_cache_key_t k1, k2;
+	struct stack *s = &corpus[0];
+
+	/* The process was replaced or its symbols reloaded. */
+	stack_str_cache_key(&k1, s->ips, PERF_MAX_STACK_DEPTH, s->pid, 1, 1, 0);
+	stack_str_cache_key(&k2, s->ips, PERF_MAX_STACK_DEPTH, s->pid, 2, 1, 0);
+	if (!memcmp(&k1, &k2, sizeof(k1)))
+		return -1;
+	stack_str_cache_key(&k2, s->ips, PERF_MAX_STACK_DEPTH, s->pid, 1, 2, 0);
+	if (!memcmp(&k1, &k2, sizeof(k1)))
+		return -1;
+	stack_str_cache_key(&k2, s->ips, PERF_MAX_STACK_DEPTH, s->pid, 1, 1, 0);
+	if (memcmp(&k1, &k2, sizeof(k1)))
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Replay the corpus through the cache, the strings must match the stacks.
+ * Usage: test_stack_str_cache [corpus], without a corpus, a generated one
+ * is used; pass stacks dumped from a profiler to compare the timings.
+ */
+int main(int argc, char **argv)
+{
+	stack_str_cache_t c;
+	double cold_ms, cached_ms, ms;
+	int ret;
+
+	log_to_stdout = true;
+	clib_mem_init();
+
+	if (load_corpus(argc > 1 ? argv[1] : NULL)) {
+		printf("[FAIL] load corpus\n");
+		return -1;
+	}
+
+	stack_str_cache_init(&c, STRINGIFIER_STACK_CACHE_MEM_MAX);
+	ret = replay(&c, &cold_ms, false, false);
+	if (ret == 0)
+		ret = replay(&c, &cached_ms, true, false);
+	if (ret == 0)
+		ret = replay(&c, &ms, true, true);
+	if (ret == 0)
+		ret = test_generation(&c);
+	if (ret == 0 && c.stats.adds > corpus_len)
+		ret = -1;
+	printf("%d stacks, %d samples: no cache %.1fms, cached %.1fms, "
+	       "hit rate %.2f%% (%lu elems, %lu bytes)\n", corpus_len,
+	       ITERATIONS * SAMPLES_NUM, cold_ms, cached_ms,
+	       c.stats.lookups ? c.stats.hits * 100.0 / c.stats.lookups : 0,
+	       c.stats.elems, c.stats.bytes);
+	stack_str_cache_release(&c);
+
+	/* With a small cap, the cold stacks are evicted at each trim. */
+	if (ret == 0) {
+		stack_str_cache_init(&c, 16 * 1024);
+		ret = replay(&c, &ms, true, true);
+		if (ret == 0 && (c.stats.evictions == 0 ||
+				 c.stats.bytes > c.mem_max))
+			ret = -1;
+		printf("capped: hit rate %.2f%%, %lu evictions\n",
+		       c.stats.hits * 100.0 / c.stats.lookups,
+		       c.stats.evictions);
+		stack_str_cache_release(&c);
+	}
+
+	printf("[%s] %s\n", __func__, ret == 0 ? "success" : "failed");
+	return ret;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <bcc/libbpf.h>
+#include "../user/config.h"
+#include "../user/types.h"
+#include "../user/clib.h"
+#include "../user/log.h"
+#include "../user/tracer.h"
+#include "../user/load.h"
+#include "../user/table.h"
+
+#define KEYS_NUM	64
+#define MAP_NAME	"test_table_delete"
+
+/*
+ * Fill the map with KEYS_NUM keys, then delete them plus 'missing' keys
+ * which are not in the map. All the present keys must be deleted and
+ * reported, whether the map supports BPF_MAP_DELETE_BATCH or not.
+ */
+static int test_delete_keys(enum bpf_map_type type, const char *type_name,
+			    int missing)
+{
+	struct ebpf_map map = {.def = {.type = type,.key_size = sizeof(u32),
+				       .value_size = sizeof(u32),
+				       .max_entries = KEYS_NUM * 2}};
+	struct ebpf_object obj = {.maps = &map,.maps_cnt = 1 };
+	struct bpf_tracer t = {.obj = &obj };
+	struct bpf_table_reclaim_stats stats = { 0 };
+	u32 keys[KEYS_NUM * 2], key, next, ifindex = 1;
+	int i, n = 0, ret = 0;
+
+	snprintf(map.name, sizeof(map.name), "%s", MAP_NAME);
+	map.fd = bcc_create_map(type, MAP_NAME, sizeof(u32), sizeof(u32),
+				KEYS_NUM * 2, 0);
+	if (map.fd < 0) {
+		printf("%s: bcc_create_map() failed - %s, skip\n", type_name,
+		       strerror(errno));
+		return 0;
+	}
+
+	/* The value of a device map is an ifindex, use the loopback one. */
+	for (i = 0; i < KEYS_NUM; i++) {
+		key = i * 2;
+		if (bpf_update_elem(map.fd, &key, &ifindex, BPF_ANY)) {
+			printf("%s: bpf_update_elem() failed - %s\n",
+			       type_name, strerror(errno));
+			ret = -1;
+			goto out;
+		}
+		keys[n++] = key;
+		/* The odd keys do not exist. */
+		if (i < missing)
+			keys[n++] = key + 1;
+	}
+
+	u32 deleted = bpf_table_delete_keys(&t, MAP_NAME, keys, n, &stats);
+	if (deleted != KEYS_NUM ||
+	    bpf_get_first_key(map.fd, &next, sizeof(next)) == 0)
+		ret = -1;
+
+	printf("%s: %d keys (%d missing), deleted %u, %u syscalls, "
+	       "batched %d\n", type_name, n, n - KEYS_NUM, deleted,
+	       stats.syscalls, stats.batched);
+out:
+	close(map.fd);
+	return ret;
+}
+
+int main(void)
+{
+	int ret = 0;
+
+	log_to_stdout = true;
+
+	ret |= test_delete_keys(BPF_MAP_TYPE_HASH, "hash", 0);
+	ret |= test_delete_keys(BPF_MAP_TYPE_HASH, "hash", 8);
+	/* Device hash maps do not support BPF_MAP_DELETE_BATCH. */
+	ret |= test_delete_keys(BPF_MAP_TYPE_DEVMAP_HASH, "devmap_hash", 0);
+	ret |= test_delete_keys(BPF_MAP_TYPE_DEVMAP_HASH, "devmap_hash", 8);
+
+	printf("[%s] %s\n", __func__, ret == 0 ? "success" : "failed");
+	return ret;
+}
@@ -36,6 +36,8 @@
 #define MAP_PROTO_PORTS_BITMAPS_NAME	"__proto_ports_bitmap"
 #define MAP_ALLOW_REASM_PROTOS_NAME     "__allow_reasm_protos_map"
 #define MAP_PKTS_STATES_NAME		"__pkts_stats_map"
+#define MAP_SOCKET_RINGBUF_PREFIX	"__socket_ringbuf"	// "__socket_ringbuf_<index>"
+#define MAP_SSL_PIDS_NAME		"__ssl_pids_map"
 
 //Program jmp tables
 #define MAP_PROGS_JMP_KP_NAME		"__progs_jmp_kp_map"
@@ -160,6 +162,41 @@ enum cfg_feature_idx {
  */
 #define TRACE_RECLAIM_TIMEOUT_DEF	10
 
+/*
+ * BPF ring buffers (kernel >= 5.8) used instead of the per-CPU perf
+ * buffers to transfer socket data, see set_socket_ringbuf(). CPUs are split
+ * into at most SOCKET_RINGBUF_NUM_MAX groups, each sharing one ring.
+ */
+#define SOCKET_RINGBUF_NUM_MAX		4
+#define SOCKET_RINGBUF_SIZE_DEF		(1 << 22)	// 4MB per ring
+// Wake up the reader once this much data is pending in a ring.
+#define SOCKET_RINGBUF_WAKEUP_DEF	(1 << 16)
+
+/*
+ * Number of empty polls a dispatch worker performs before parking on the
+ * futex. Roughly tens of microseconds of spinning, short enough to not
+ * burn a CPU when idle, long enough to absorb back-to-back bursts.
+ *
+ * 工作线程在队列为空时进入休眠前的自旋次数。
+ */
+#define DISPATCH_SPIN_BUDGET_DEF	2000
+
+/*
+ * Flow-affine dispatch. Socket data is hashed by socket id into a flow
+ * bucket, and every bucket is owned by one dispatch queue so that the
+ * events of a flow are processed in order by the same worker.
+ *
+ * An idle worker steals buckets from the deepest queue once its depth
+ * reaches FLOW_STEAL_DEPTH_MIN; at most FLOW_STEAL_BUCKETS_MAX buckets
+ * are moved per attempt, found within FLOW_STEAL_SCAN_NUM buckets.
+ * A parked worker is woken up to steal each time a queue grows by
+ * another FLOW_STEAL_DEPTH_MIN events.
+ */
+#define FLOW_BUCKETS_NUM		4096	// Must be a power of 2
+#define FLOW_STEAL_DEPTH_MIN		256
+#define FLOW_STEAL_BUCKETS_MAX		16
+#define FLOW_STEAL_SCAN_NUM		512
+
 // The maximum default amount of data passed to the agent by eBPF programe.
 #define SOCKET_DATA_LIMIT_MAX_DEF	4096
 
@@ -167,10 +204,36 @@ enum cfg_feature_idx {
 
 // execute/exit events delayed processing time, unit: second
 #define PROC_EVENT_DELAY_HANDLE_DEF     60
+// Delay of the process events of the OpenSSL and unwind tracers, unit: second
+#define PROC_EVENT_HANDLE_DELAY		120
+// Buckets of the pending process events hash (by PID), power of 2
+#define PROC_EVENT_HASH_SIZE		1024
+// Number of expired process events handled per batch
+#define PROC_EVENT_DRAIN_BATCH		64
+// Buckets of the Go process offsets hash (by PID), power of 2
+#define GO_PROC_INFO_HASH_SIZE		1024
 
 // seconds
 #define GO_TRACING_TIMEOUT_DEFAULT      120
 
+// Number of Go executables whose uprobe resolution results are cached
+#define GO_BIN_CACHE_MAX		64
+// Log the Go uprobe resolution statistics every this many executions
+#define GO_BIN_CACHE_STATS_INTERVAL	64
+// Maximum length of a Go or GNU build ID string
+#define GO_BUILD_ID_LEN			128
+
+// Number of binaries whose OpenSSL/Python uprobe symbols are cached
+#define UPROBE_SYM_CACHE_MAX		64
+
+// Number of processes whose /proc/<pid>/maps snapshot is cached
+#define PROC_MAPS_CACHE_MAX		1024
+// Buckets of the snapshot (by PID) and path (by name) hash tables, power of 2
+#define PROC_MAPS_HASH_SIZE		1024
+#define PROC_MAPS_PATH_HASH_SIZE	4096
+// A snapshot younger than this is used without checking the process (ms)
+#define PROC_MAPS_RECHECK_MS		1000
+
 #define SK_TRACER_NAME			"socket-trace"
 #define CP_TRACER_NAME	                "continuous_profiler"
 
@@ -208,10 +271,30 @@ enum cfg_feature_idx {
 #define MAP_CUSTOM_STACK_A_NAME	"__custom_stack_map_a"
 #define MAP_CUSTOM_STACK_B_NAME	"__custom_stack_map_b"
 #define MAP_PROFILER_STATE_NAME	"__profiler_state_map"
+#define MAP_STACK_AGG_A_NAME	"__stack_agg_map_a"
+#define MAP_STACK_AGG_B_NAME	"__stack_agg_map_b"
 
 #define STRINGIFIER_STACK_STR_HASH_BUCKETS_NUM	8192
 #define STRINGIFIER_STACK_STR_HASH_MEM_SZ	(1ULL << 30)	// 1Gbytes
 
+// Snapshot index of the BPF symbol table, see MAX_SYMBOL_NUM
+#define STRINGIFIER_SYMBOL_ID_HASH_BUCKETS_NUM	1024
+#define STRINGIFIER_SYMBOL_ID_HASH_MEM_SZ	(1ULL << 24)	// 16Mbytes
+
+// Address -> interned frame cache, kept across profiler iterations
+#define STRINGIFIER_FRAME_HASH_BUCKETS_NUM	8192
+#define STRINGIFIER_FRAME_HASH_MEM_SZ		(1ULL << 28)	// 256Mbytes
+// Flush the frame cache once it holds more addresses than this
+#define STRINGIFIER_FRAME_CACHE_MAX		(1 << 20)
+// Chunk size of the per-iteration stringifier arenas
+#define STRINGIFIER_ARENA_CHUNK_SZ		(1 << 20)	// 1Mbytes
+
+// Folded stack strings by content, kept across profiler iterations
+#define STRINGIFIER_STACK_CACHE_BUCKETS_NUM	8192
+#define STRINGIFIER_STACK_CACHE_HASH_MEM_SZ	(1ULL << 28)	// 256Mbytes
+// Evict the least recently used strings beyond this size
+#define STRINGIFIER_STACK_CACHE_MEM_MAX		(1ULL << 26)	// 64Mbytes
+
 #define SYMBOLIZER_CACHES_HASH_BUCKETS_NUM	8192
 #define SYMBOLIZER_CACHES_HASH_MEM_SZ		(1ULL << 31)	// 2Gbytes
 
@@ -270,6 +353,13 @@ enum cfg_feature_idx {
  * is milliseconds.
  */
 #define KICK_KERN_PERIOD 40000000  // Set default interval to 40 milliseconds
+
+/*
+ * Only CPUs whose eBPF push buffer holds data are kicked each period. As a
+ * safety net against a missed pending flag, all online CPUs are kicked once
+ * every KICK_KERN_ALL_PERIODS periods (1 second by default).
+ */
+#define KICK_KERN_ALL_PERIODS 25
 /*
  * A special value should be assigned to indicate the case where no data has
  * been pushed after exceeding 100 milliseconds.
@@ -239,11 +239,13 @@ static void tracer_dump(struct bpf_tracer_param *param)
 		rx_q = &btp->rx_queues[j];
 		printf
 		    ("worker %d for queue, de %" PRIu64 " en %" PRIu64 " lost %"
-		     PRIu64 " alloc failed %" PRIu64 " burst %" PRIu64
-		     " queue size %u cap %u\n", j, rx_q->dequeue_nr,
-		     rx_q->enqueue_nr, rx_q->enqueue_lost,
-		     rx_q->heap_get_failed, rx_q->burst_count, rx_q->queue_size,
-		     rx_q->ring_capacity);
+		     PRIu64 " alloc failed %" PRIu64 " in flight %" PRIu64
+		     " bytes burst %" PRIu64 " wakeup %" PRIu64 " steal %" PRIu64
+		     " queue size %u cap %u\n", j,
+		     rx_q->dequeue_nr, rx_q->enqueue_nr, rx_q->enqueue_lost,
+		     rx_q->heap_get_failed, rx_q->bytes_in_flight,
+		     rx_q->burst_count, rx_q->wakeup_count, rx_q->steal_count,
+		     rx_q->queue_size, rx_q->ring_capacity);
 		heap_get_failed += rx_q->heap_get_failed;
 		dequeue_nr += rx_q->dequeue_nr;
 		enqueue_nr += rx_q->enqueue_nr;
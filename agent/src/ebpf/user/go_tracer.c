@@ -48,26 +48,17 @@
 #include "table.h"
 #include "symbol.h"
 #include "socket.h"
+#include "proc.h"
 #include "elf.h"
 
-/* *INDENT-OFF* */
-// For process execute/exit events.
-struct process_event {
-	struct list_head list;	// list add to proc_events_head
-	struct bpf_tracer *tracer;	// link to struct bpf_tracer
-	uint32_t type;		// EVENT_TYPE_PROC_EXEC or EVENT_TYPE_PROC_EXIT
-	char *path;		// Full path "/proc/<pid>/root/..."
-	int pid;		// Process ID
-	uint64_t stime;		// The start time of the process
-	uint32_t expire_time;	// Expiration Date, the number of seconds since the system started.
-};
-/* *INDENT-ON* */
-
 extern uint32_t k_version;
 static char build_info_magic[] = "\xff Go buildinf:";
-static struct list_head proc_info_head;	// For pid-offsets correspondence lists.
-static struct list_head proc_events_head;	// For process execute/exit events list.
-static pthread_mutex_t mutex_proc_events_lock;
+// For pid-offsets correspondence, hashed by PID.
+static struct list_head proc_info_hash[GO_PROC_INFO_HASH_SIZE];
+// The proc_info not written to the eBPF map yet.
+static struct list_head proc_info_pending_head;
+// Process execute events, the path is "/proc/<pid>/root/...".
+static proc_event_list_t proc_events;
 static bool golang_trace_enabled;
 
 /* *INDENT-OFF* */
@@ -466,10 +457,15 @@ exit:
 
 }
 
+static inline struct list_head *proc_info_bucket(int pid)
+{
+	return &proc_info_hash[pid & (GO_PROC_INFO_HASH_SIZE - 1)];
+}
+
 static struct proc_info *find_proc_info_by_pid(int pid)
 {
 	struct proc_info *p_info;
-	list_for_each_entry(p_info, &proc_info_head, list) {
+	list_for_each_entry(p_info, proc_info_bucket(pid), list) {
 		if (p_info->pid == pid)
 			return p_info;
 	}
@@ -486,9 +482,368 @@ static struct proc_info *alloc_proc_info_by_pid(void)
 		return NULL;
 	}
 
+	init_list_head(&info->pending);
 	return info;
 }
 
+/*
+ * Per-binary cache of the Go uprobe resolution results.
+ *
+ * Resolving the symbols, return addresses, struct member offsets and itab
+ * addresses of a Go executable means walking its symbol table and DWARF
+ * sections, which takes from tens of milliseconds up to seconds. Replicas
+ * of a service run the same binary, often from the filesystems of
+ * different containers, so the results are cached by the identity of the
+ * file (device, inode, size and mtime) and by its build ID, and reused by
+ * every process executing it. Uprobe entries are file offsets, so only
+ * the per-PID path needs to be filled in when applying a cached result.
+ */
+
+struct go_bin_uprobe {
+	bool resolved;
+	size_t entry;
+	uint64_t size;
+	size_t rets[FUNC_RET_MAX];
+	int rets_count;
+};
+
+struct go_bin_info {
+	struct list_head list;	// LRU list, the most recently used last
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	char build_id[GO_BUILD_ID_LEN];	// "" if the binary has none
+	bool golang_symbol;	// Resolved with the GoReSym fallback
+	int syms_count;
+	struct go_bin_uprobe uprobes[NELEMS(syms)];
+	__u16 offsets[OFFSET_IDX_MAX];
+	__u64 net_TCPConn_itab;
+	__u64 crypto_tls_Conn_itab;
+	__u64 credentials_syscallConn_itab;
+};
+
+#define GO_RESOLVE_HIST_NUM	16	// log2(us) buckets, the last one unbounded
+
+static struct list_head go_bin_cache_head;
+static pthread_mutex_t go_bin_cache_lock;
+static int go_bin_cache_count;
+static u64 go_bin_cache_hits;
+static u64 go_bin_cache_misses;
+static u64 go_bin_cache_evictions;
+static u64 go_resolve_hist[GO_RESOLVE_HIST_NUM];
+
+/*
+ * Read the build ID of an executable: the Go build ID note if present,
+ * otherwise the GNU build ID in hex.
+ */
+static void fetch_bin_build_id(const char *path, char *buf, int size)
+{
+	Elf_Data *data;
+	Elf *e = NULL;
+	int fd = -1;
+	char *desc;
+	u32 *hdr;
+	u32 namesz, descsz, i, off;
+
+	buf[0] = '\0';
+	if (openelf(path, &e, &fd) < 0)
+		return;
+
+	/* Note header: namesz, descsz, type, then name and desc 4-aligned. */
+	if ((data = get_sec_elf_data(e, ".note.go.buildid")) &&
+	    data->d_size > 12) {
+		hdr = data->d_buf;
+		namesz = hdr[0];
+		descsz = hdr[1];
+		off = 12 + ((namesz + 3) & ~3);
+		if (off + descsz <= data->d_size && descsz < size) {
+			memcpy(buf, (char *)data->d_buf + off, descsz);
+			buf[descsz] = '\0';
+		}
+	} else if ((data = get_sec_elf_data(e, ".note.gnu.build-id")) &&
+		   data->d_size > 12) {
+		hdr = data->d_buf;
+		namesz = hdr[0];
+		descsz = hdr[1];
+		off = 12 + ((namesz + 3) & ~3);
+		desc = (char *)data->d_buf + off;
+		if (off + descsz <= data->d_size && descsz * 2 + 4 < size) {
+			i = snprintf(buf, size, "gnu:");
+			for (off = 0; off < descsz; off++, i += 2)
+				snprintf(buf + i, size - i, "%02x",
+					 (unsigned char)desc[off]);
+		}
+	}
+
+	elf_end(e);
+	close(fd);
+}
+
+static void go_bin_info_resolve(const char *path, int pid,
+				struct version_info *go_ver,
+				struct go_bin_info *info)
+{
+	struct symbol_uprobe *probe_sym;
+	struct data_members *off;
+	struct go_bin_uprobe *u;
+	int i;
+
+	for (i = 0; i < NELEMS(syms); i++) {
+		probe_sym = resolve_and_gen_uprobe_symbol(path, &syms[i], 0, pid);
+		if (probe_sym == NULL)
+			continue;
+
+		u = &info->uprobes[i];
+		u->resolved = true;
+		u->entry = probe_sym->entry;
+		u->size = probe_sym->size;
+		u->rets_count = probe_sym->rets_count;
+		memcpy(u->rets, probe_sym->rets, sizeof(u->rets));
+		free_uprobe_symbol(probe_sym, NULL);
+		info->syms_count++;
+	}
+
+	if (info->syms_count == 0)
+		return;
+
+	// resolve all offsets in one pass over the DWARF information.
+	struct member_offset targets[NELEMS(offsets)];
+	for (i = 0; i < NELEMS(offsets); i++) {
+		targets[i].structure = offsets[i].structure;
+		targets[i].member = offsets[i].field_name;
+	}
+	struct_member_offsets_analyze(path, targets, NELEMS(offsets));
+	for (i = 0; i < NELEMS(offsets); i++) {
+		off = &offsets[i];
+		info->offsets[off->idx] = targets[i].offset == ETR_INVAL ?
+		    off->default_offset : targets[i].offset;
+	}
+
+	const char *tcp_conn_sym, *tls_conn_sym, *syscall_conn_sym;
+	if (GO_VERSION(go_ver->major, go_ver->minor, go_ver->revision) <
+	    GO_VERSION(1, 20, 0)) {
+		tcp_conn_sym = "go.itab.*net.TCPConn,net.Conn";
+		tls_conn_sym = "go.itab.*crypto/tls.Conn,net.Conn";
+		syscall_conn_sym =
+		    "go.itab.*google.golang.org/grpc/internal/credentials.syscallConn,net.Conn";
+	} else {
+		tcp_conn_sym = "go:itab.*net.TCPConn,net.Conn";
+		tls_conn_sym = "go:itab.*crypto/tls.Conn,net.Conn";
+		syscall_conn_sym =
+		    "go:itab.*google.golang.org/grpc/internal/credentials.syscallConn,net.Conn";
+	}
+
+	info->net_TCPConn_itab =
+	    get_symbol_addr_from_binary(pid, path, tcp_conn_sym);
+	if (info->net_TCPConn_itab == 0)
+		ebpf_warning
+		    ("'%s' does not exist. Since eBPF uprobe relies on it to retrieve "
+		     "connection information, if it is empty, eBPF will not retrieve any"
+		     " data. This situation may be due to the lack of symbol table in "
+		     "the golang executable (confirm by executing 'nm %s'). If it shows "
+		     "'no symbols', you can try setting the configuration option "
+		     "'golang-symbol' to see if it resolves the issue, if the issue "
+		     "persists, please attempt to resolve it using the Golang executable "
+		     "with symbol table included.\n", tcp_conn_sym, path);
+
+	info->crypto_tls_Conn_itab =
+	    get_symbol_addr_from_binary(pid, path, tls_conn_sym);
+
+	info->credentials_syscallConn_itab =
+	    get_symbol_addr_from_binary(pid, path, syscall_conn_sym);
+}
+
+static inline bool go_bin_stat_match(struct go_bin_info *info,
+				     struct stat *st, bool golang_symbol)
+{
+	return info->golang_symbol == golang_symbol &&
+	    info->dev == st->st_dev && info->ino == st->st_ino &&
+	    info->size == st->st_size &&
+	    info->mtime.tv_sec == st->st_mtim.tv_sec &&
+	    info->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static inline void go_bin_stat_set(struct go_bin_info *info, struct stat *st)
+{
+	info->dev = st->st_dev;
+	info->ino = st->st_ino;
+	info->size = st->st_size;
+	info->mtime = st->st_mtim;
+}
+
+/*
+ * Look the cache up, the file identity first and then the build ID.
+ * Called with go_bin_cache_lock held, the entry found becomes the most
+ * recently used one and is copied to 'info'.
+ */
+static bool go_bin_cache_find(struct stat *st, const char *build_id,
+			      bool golang_symbol, struct go_bin_info *info)
+{
+	struct go_bin_info *c;
+	list_for_each_entry(c, &go_bin_cache_head, list) {
+		if (build_id == NULL) {
+			if (!go_bin_stat_match(c, st, golang_symbol))
+				continue;
+		} else if (c->golang_symbol != golang_symbol ||
+			   build_id[0] == '\0' ||
+			   strcmp(c->build_id, build_id)) {
+			continue;
+		}
+
+		list_head_del(&c->list);
+		list_add_tail(&c->list, &go_bin_cache_head);
+		*info = *c;
+		return true;
+	}
+
+	return false;
+}
+
+static void go_bin_cache_add(struct go_bin_info *info)
+{
+	struct go_bin_info *c, *lru;
+	c = malloc(sizeof(*c));
+	if (c == NULL) {
+		ebpf_warning("malloc() size:sizeof(struct go_bin_info) error.\n");
+		return;
+	}
+
+	*c = *info;
+	pthread_mutex_lock(&go_bin_cache_lock);
+	list_add_tail(&c->list, &go_bin_cache_head);
+	if (++go_bin_cache_count > GO_BIN_CACHE_MAX) {
+		lru = list_first_entry(&go_bin_cache_head,
+					struct go_bin_info, list);
+		list_head_del(&lru->list);
+		free(lru);
+		go_bin_cache_count--;
+		go_bin_cache_evictions++;
+	}
+	pthread_mutex_unlock(&go_bin_cache_lock);
+}
+
+/*
+ * Get the resolution results of the executable 'path' of process 'pid',
+ * from the cache if possible. Returns true on a cache hit.
+ */
+static bool go_bin_info_get(const char *path, int pid,
+			    struct version_info *go_ver,
+			    struct go_bin_info *info)
+{
+	bool golang_symbol, found;
+	char build_id[GO_BUILD_ID_LEN];
+	struct stat st;
+
+	memset(info, 0, sizeof(*info));
+	if (stat(path, &st) != 0) {
+		go_bin_info_resolve(path, pid, go_ver, info);
+		return false;
+	}
+
+	golang_symbol =
+	    is_feature_matched(FEATURE_UPROBE_GOLANG_SYMBOL, pid, path);
+	pthread_mutex_lock(&go_bin_cache_lock);
+	found = go_bin_cache_find(&st, NULL, golang_symbol, info);
+	pthread_mutex_unlock(&go_bin_cache_lock);
+	if (found)
+		return true;
+
+	fetch_bin_build_id(path, build_id, sizeof(build_id));
+	pthread_mutex_lock(&go_bin_cache_lock);
+	found = go_bin_cache_find(&st, build_id, golang_symbol, info);
+	pthread_mutex_unlock(&go_bin_cache_lock);
+	if (found) {
+		/*
+		 * The same binary in another filesystem (e.g. a copy in each
+		 * container), cache this identity too rather than replacing
+		 * the one found, so that the copies do not evict each other.
+		 */
+		go_bin_stat_set(info, &st);
+		go_bin_cache_add(info);
+		return true;
+	}
+
+	go_bin_info_resolve(path, pid, go_ver, info);
+	go_bin_stat_set(info, &st);
+	snprintf(info->build_id, sizeof(info->build_id), "%s", build_id);
+	info->golang_symbol = golang_symbol;
+	go_bin_cache_add(info);
+	return false;
+}
+
+static void go_resolve_stats_update(bool hit, u64 elapsed_ns)
+{
+	u64 us = elapsed_ns / 1000, total;
+	int i = 0;
+
+	while (us > 1 && i < GO_RESOLVE_HIST_NUM - 1) {
+		us >>= 1;
+		i++;
+	}
+
+	pthread_mutex_lock(&go_bin_cache_lock);
+	go_resolve_hist[i]++;
+	if (hit)
+		go_bin_cache_hits++;
+	else
+		go_bin_cache_misses++;
+
+	total = go_bin_cache_hits + go_bin_cache_misses;
+	if (total % GO_BIN_CACHE_STATS_INTERVAL == 0) {
+		char hist[GO_RESOLVE_HIST_NUM * 32];
+		int len = 0;
+		for (i = 0; i < GO_RESOLVE_HIST_NUM; i++) {
+			if (go_resolve_hist[i] == 0)
+				continue;
+			len += snprintf(hist + len, sizeof(hist) - len,
+					" %s%luus:%lu",
+					i < GO_RESOLVE_HIST_NUM - 1 ? "<" : ">=",
+					i < GO_RESOLVE_HIST_NUM - 1 ?
+					2UL << i : 1UL << i, go_resolve_hist[i]);
+		}
+		ebpf_info("Go uprobe resolve: %lu execs, cache hits %lu "
+			  "misses %lu evictions %lu binaries %d, latency%s\n",
+			  total, go_bin_cache_hits, go_bin_cache_misses,
+			  go_bin_cache_evictions, go_bin_cache_count, hist);
+	}
+	pthread_mutex_unlock(&go_bin_cache_lock);
+}
+
+static struct symbol_uprobe *go_uprobe_symbol_gen(const char *path, int pid,
+						  struct symbol *sym,
+						  struct go_bin_uprobe *u,
+						  struct version_info *go_ver)
+{
+	struct symbol_uprobe *probe_sym;
+	probe_sym = calloc(1, sizeof(struct symbol_uprobe));
+	if (probe_sym == NULL) {
+		ebpf_warning("calloc() error.\n");
+		return NULL;
+	}
+
+	probe_sym->type = sym->type;
+	probe_sym->isret = sym->is_probe_ret;
+	probe_sym->pid = pid;
+	probe_sym->probe_func = strdup(sym->probe_func);
+	probe_sym->binary_path = strdup(path);
+	probe_sym->name = strdup(sym->symbol);
+	if (probe_sym->probe_func == NULL || probe_sym->binary_path == NULL ||
+	    probe_sym->name == NULL) {
+		ebpf_warning("strdup() error.\n");
+		free_uprobe_symbol(probe_sym, NULL);
+		return NULL;
+	}
+
+	probe_sym->entry = u->entry;
+	probe_sym->size = u->size;
+	probe_sym->rets_count = u->rets_count;
+	memcpy(probe_sym->rets, u->rets, sizeof(probe_sym->rets));
+	probe_sym->ver = *go_ver;
+
+	return probe_sym;
+}
+
 static int resolve_bin_file(const char *path, int pid,
 			    struct version_info *go_ver,
 			    struct tracer_probes_conf *conf, int *resolve_num)
@@ -496,26 +851,26 @@ static int resolve_bin_file(const char *path, int pid,
 	int ret = ETR_OK;
 	struct symbol *sym;
 	struct symbol_uprobe *probe_sym = NULL;
-	struct data_members *off;
-	char *binary_path = NULL;
+	struct go_bin_info info;
 	int syms_count = 0;
+	bool hit;
+	u64 start = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+
+	hit = go_bin_info_get(path, pid, go_ver, &info);
+	go_resolve_stats_update(hit, gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) -
+				start);
 
 	for (int i = 0; i < NELEMS(syms); i++) {
 		sym = &syms[i];
-		probe_sym = resolve_and_gen_uprobe_symbol(path, sym, 0, pid);
-		if (probe_sym == NULL) {
+		if (!info.uprobes[i].resolved)
 			continue;
-		}
 
-		if (!binary_path) {
-			binary_path = strdup(probe_sym->binary_path);
-			if (binary_path == NULL) {
-				goto failed;
-			}
+		probe_sym = go_uprobe_symbol_gen(path, pid, sym,
+						 &info.uprobes[i], go_ver);
+		if (probe_sym == NULL) {
+			continue;
 		}
 
-		probe_sym->ver = *go_ver;
-
 		if (probe_sym->isret) {
 			size_t addr;
 			int j;
@@ -545,12 +900,12 @@ static int resolve_bin_file(const char *path, int pid,
 			add_uprobe_symbol(pid, probe_sym, conf);
 
 		ebpf_info
-		    ("Uprobe [%s] pid:%d go%d.%d.%d entry:0x%lx size:%ld symname:%s probe_func:%s rets_count:%d\n",
+		    ("Uprobe [%s] pid:%d go%d.%d.%d entry:0x%lx size:%ld symname:%s probe_func:%s rets_count:%d%s\n",
 		     probe_sym->binary_path, probe_sym->pid,
 		     probe_sym->ver.major, probe_sym->ver.minor,
 		     probe_sym->ver.revision, probe_sym->entry, probe_sym->size,
 		     probe_sym->name, probe_sym->probe_func,
-		     probe_sym->rets_count);
+		     probe_sym->rets_count, hit ? " (cached)" : "");
 
 		if (probe_sym->isret)
 			free_uprobe_symbol(probe_sym, NULL);
@@ -569,85 +924,40 @@ static int resolve_bin_file(const char *path, int pid,
 		goto failed;
 	}
 
-	struct proc_info *p_info = NULL;
-	if (binary_path) {
-		bool is_new_info = false;
-		p_info = find_proc_info_by_pid(pid);
-		if (p_info == NULL) {
-			p_info = alloc_proc_info_by_pid();
-			if (p_info == NULL)
-				goto offset_failed;
-			is_new_info = true;
-		}
+	bool is_new_info = false;
+	struct proc_info *p_info = find_proc_info_by_pid(pid);
+	if (p_info == NULL) {
+		p_info = alloc_proc_info_by_pid();
+		if (p_info == NULL)
+			goto offset_failed;
+		is_new_info = true;
+	}
 
-		p_info->info.version = GO_VERSION(go_ver->major, go_ver->minor,
-						  go_ver->revision);
-		p_info->pid = pid;
+	p_info->info.version = GO_VERSION(go_ver->major, go_ver->minor,
+					  go_ver->revision);
+	p_info->pid = pid;
 
-		if (p_info->path != NULL) {
-			free(p_info->path);
-			p_info->path = NULL;
-		}
+	if (p_info->path != NULL) {
+		free(p_info->path);
+		p_info->path = NULL;
+	}
 
-		p_info->path = strdup(binary_path);
-		if (p_info->path == NULL) {
-			goto offset_failed;
-		}
-		// resolve all offsets.
-		for (int k = 0; k < NELEMS(offsets); k++) {
-			off = &offsets[k];
-			int offset = struct_member_offset_analyze(binary_path,
-								  off->
-								  structure,
-								  off->
-								  field_name);
-			if (offset == ETR_INVAL)
-				offset = off->default_offset;
-
-			p_info->info.offsets[off->idx] = offset;
-		}
+	p_info->path = strdup(path);
+	if (p_info->path == NULL) {
+		goto offset_failed;
+	}
 
-		const char *tcp_conn_sym, *tls_conn_sym, *syscall_conn_sym;
-		if (p_info->info.version < GO_VERSION(1, 20, 0)) {
-			tcp_conn_sym = "go.itab.*net.TCPConn,net.Conn";
-			tls_conn_sym = "go.itab.*crypto/tls.Conn,net.Conn";
-			syscall_conn_sym =
-			    "go.itab.*google.golang.org/grpc/internal/credentials.syscallConn,net.Conn";
-		} else {
-			tcp_conn_sym = "go:itab.*net.TCPConn,net.Conn";
-			tls_conn_sym = "go:itab.*crypto/tls.Conn,net.Conn";
-			syscall_conn_sym =
-			    "go:itab.*google.golang.org/grpc/internal/credentials.syscallConn,net.Conn";
-		}
+	memcpy(p_info->info.offsets, info.offsets, sizeof(info.offsets));
+	p_info->info.net_TCPConn_itab = info.net_TCPConn_itab;
+	p_info->info.crypto_tls_Conn_itab = info.crypto_tls_Conn_itab;
+	p_info->info.credentials_syscallConn_itab =
+	    info.credentials_syscallConn_itab;
+	p_info->has_updated = false;
+	if (list_empty(&p_info->pending))
+		list_add_tail(&p_info->pending, &proc_info_pending_head);
 
-		p_info->info.net_TCPConn_itab =
-		    get_symbol_addr_from_binary(pid, binary_path, tcp_conn_sym);
-		if (p_info->info.net_TCPConn_itab == 0)
-			ebpf_warning
-			    ("'%s' does not exist. Since eBPF uprobe relies on it to retrieve "
-			     "connection information, if it is empty, eBPF will not retrieve any"
-			     " data. This situation may be due to the lack of symbol table in "
-			     "the golang executable (confirm by executing 'nm %s'). If it shows "
-			     "'no symbols', you can try setting the configuration option "
-			     "'golang-symbol' to see if it resolves the issue, if the issue "
-			     "persists, please attempt to resolve it using the Golang executable "
-			     "with symbol table included.\n", tcp_conn_sym,
-			     binary_path);
-
-		p_info->info.crypto_tls_Conn_itab =
-		    get_symbol_addr_from_binary(pid, binary_path, tls_conn_sym);
-
-		p_info->info.credentials_syscallConn_itab =
-		    get_symbol_addr_from_binary(pid, binary_path, syscall_conn_sym);
-
-		p_info->has_updated = false;
-
-		if (is_new_info)
-			list_add_tail(&p_info->list, &proc_info_head);
-
-		free(binary_path);
-		binary_path = NULL;
-	}
+	if (is_new_info)
+		list_add_tail(&p_info->list, proc_info_bucket(pid));
 
 	*resolve_num = syms_count;
 	return ret;
@@ -658,19 +968,13 @@ failed:
 		free_uprobe_symbol(probe_sym, NULL);
 	}
 
-	if (binary_path) {
-		free(binary_path);
-	}
 	return ret;
 
 offset_failed:
 	*resolve_num = syms_count;
-	if (p_info != NULL) {
+	if (p_info != NULL && is_new_info) {
 		free(p_info);
 	}
-	if (binary_path) {
-		free(binary_path);
-	}
 
 	return ETR_INVAL;
 }
@@ -815,9 +1119,7 @@ static bool
 {
 	struct probe *p;
 	struct symbol_uprobe *sym;
-	list_for_each_entry(p, &tracer->probes_head, list) {
-		if (!(p->type == UPROBE && p->private_data != NULL))
-			continue;
+	list_for_each_entry(p, tracer_pid_probes(tracer, pid), pid_list) {
 		sym = p->private_data;
 		if (sym->pid == pid && sym->starttime == starttime)
 			return true;
@@ -832,9 +1134,7 @@ static bool __attribute__ ((unused)) pid_exist_in_probes_without_stime(struct bp
 {
 	struct probe *p;
 	struct symbol_uprobe *sym;
-	list_for_each_entry(p, &tracer->probes_head, list) {
-		if (!(p->type == UPROBE && p->private_data != NULL))
-			continue;
+	list_for_each_entry(p, tracer_pid_probes(tracer, pid), pid_list) {
 		sym = p->private_data;
 		if (sym->pid == pid)
 			return true;
@@ -843,17 +1143,6 @@ static bool __attribute__ ((unused)) pid_exist_in_probes_without_stime(struct bp
 	return false;
 }
 
-static struct proc_info *find_proc_info(int pid)
-{
-	struct proc_info *p_info = NULL;
-	list_for_each_entry(p_info, &proc_info_head, list) {
-		if (p_info->pid == pid)
-			return p_info;
-	}
-
-	return NULL;
-}
-
 static void free_proc_info(struct proc_info *p_info)
 {
 	// Free memory occupied by structure members.
@@ -871,20 +1160,18 @@ static void clear_probes_by_pid(struct bpf_tracer *tracer, int pid,
 				struct tracer_probes_conf *conf)
 {
 	bool info_print = false;
-	struct probe *probe;
-	struct list_head *p, *n;
+	struct probe *probe, *n;
 	struct symbol_uprobe *sym_uprobe;
 
-	struct proc_info *p_info = find_proc_info(pid);
+	struct proc_info *p_info = find_proc_info_by_pid(pid);
 	if (p_info) {
 		list_head_del(&p_info->list);
+		list_head_del(&p_info->pending);
 		free_proc_info(p_info);
 	}
 
-	list_for_each_safe(p, n, &tracer->probes_head) {
-		probe = container_of(p, struct probe, list);
-		if (!(probe->type == UPROBE && probe->private_data != NULL))
-			continue;
+	list_for_each_entry_safe(probe, n, tracer_pid_probes(tracer, pid),
+				 pid_list) {
 		sym_uprobe = probe->private_data;
 
 		if (sym_uprobe->type != GO_UPROBE)
@@ -909,14 +1196,12 @@ static void clear_probes_by_pid(struct bpf_tracer *tracer, int pid,
 
 void update_proc_info_to_map(struct bpf_tracer *tracer)
 {
-	struct proc_info *p_info;
+	struct proc_info *p_info, *n;
 	char buff[4096];
 	struct ebpf_proc_info *info;
 	int len, i;
 
-	list_for_each_entry(p_info, &proc_info_head, list) {
-		if (p_info->has_updated)
-			continue;
+	list_for_each_entry_safe(p_info, n, &proc_info_pending_head, pending) {
 		info = &p_info->info;
 		int pid = p_info->pid;
 		if (!bpf_table_set_value
@@ -933,6 +1218,7 @@ void update_proc_info_to_map(struct bpf_tracer *tracer)
 		}
 
 		p_info->has_updated = true;
+		list_del_init(&p_info->pending);
 		ebpf_info("Udpate map %s, key(pid):%d, value:%s",
 			  MAP_PROC_INFO_MAP_NAME, p_info->pid, buff);
 	}
@@ -964,26 +1250,9 @@ static void process_execute_handle(int pid, struct bpf_tracer *tracer)
 	pthread_mutex_unlock(&tracer->mutex_probes_lock);
 }
 
-// The caller needs 'mutex_proc_events_lock' for protection
-static inline void find_and_clear_event_from_list(int pid)
-{
-	struct process_event *pe;
-	struct list_head *p, *n;
-	list_for_each_safe(p, n, &proc_events_head) {
-		pe = container_of(p, struct process_event, list);
-		if (pe->pid == pid) {
-			list_head_del(&pe->list);
-			free(pe->path);
-			free(pe);
-		}
-	}
-}
-
 static void process_exit_handle(int pid, struct bpf_tracer *tracer)
 {
-	pthread_mutex_lock(&mutex_proc_events_lock);
-	find_and_clear_event_from_list(pid);
-	pthread_mutex_unlock(&mutex_proc_events_lock);
+	proc_event_list_cancel(&proc_events, pid);
 
 	// Protect the probes operation in multiple threads, similar to process_execute_handle()
 	pthread_mutex_lock(&tracer->mutex_probes_lock);
@@ -992,8 +1261,7 @@ static void process_exit_handle(int pid, struct bpf_tracer *tracer)
 	pthread_mutex_unlock(&tracer->mutex_probes_lock);
 }
 
-static void add_event_to_proc_header(struct bpf_tracer *tracer, int pid,
-				     uint32_t type)
+static void add_event_to_proc_header(struct bpf_tracer *tracer, int pid)
 {
 	char *path = get_elf_path_by_pid(pid);
 	if (path == NULL) {
@@ -1005,24 +1273,7 @@ static void add_event_to_proc_header(struct bpf_tracer *tracer, int pid,
 		return;
 	}
 
-	struct process_event *pe = calloc(1, sizeof(struct process_event));
-	if (pe == NULL) {
-		free(path);
-		ebpf_warning("Without memory.\n");
-		return;
-	}
-
-	pe->tracer = tracer;
-	pe->path = path;
-	pe->pid = pid;
-	pe->type = type;
-	pe->stime = get_process_starttime(pid);
-	pe->expire_time = get_sys_uptime() + PROC_EVENT_DELAY_HANDLE_DEF;
-
-	pthread_mutex_lock(&mutex_proc_events_lock);
-	find_and_clear_event_from_list(pid);
-	list_add_tail(&pe->list, &proc_events_head);
-	pthread_mutex_unlock(&mutex_proc_events_lock);
+	add_event_to_proc_list(&proc_events, tracer, pid, path);
 }
 
 /**
@@ -1035,13 +1286,13 @@ void go_process_exec(int pid)
 	if (tracer == NULL)
 		return;
 
-	if (tracer->probes_count > OPEN_FILES_MAX) {
-		ebpf_warning("Probes count too many. The maximum is %d\n",
+	if (tracer->links_count >= OPEN_FILES_MAX) {
+		ebpf_warning("Probe attachments too many. The maximum is %d\n",
 			     OPEN_FILES_MAX);
 		return;
 	}
 
-	add_event_to_proc_header(tracer, pid, EVENT_TYPE_PROC_EXEC);
+	add_event_to_proc_header(tracer, pid);
 }
 
 /**
@@ -1066,49 +1317,21 @@ void go_process_exit(int pid)
  */
 void go_process_events_handle(void)
 {
-	struct process_event *pe;
-	do {
-		// Multithreaded safe fetch 'struct process_event'
-		pthread_mutex_lock(&mutex_proc_events_lock);
-		if (!list_empty(&proc_events_head)) {
-			pe = list_first_entry(&proc_events_head,
-					      struct process_event, list);
-		} else {
-			pe = NULL;
-		}
-
-		if (pe == NULL) {
-			pthread_mutex_unlock(&mutex_proc_events_lock);
-			break;
-		}
+	struct process_create_event *pe, *n;
+	struct list_head expired;
 
-		if (get_sys_uptime() >= pe->expire_time) {
-			char *path = strdup(pe->path);
-			int pid = pe->pid;
-			struct bpf_tracer *tracer = pe->tracer;
-			uint32_t type = pe->type;
+	init_list_head(&expired);
+	while (proc_event_list_drain(&proc_events, &expired,
+				     PROC_EVENT_DRAIN_BATCH) > 0) {
+		list_for_each_entry_safe(pe, n, &expired, list) {
 			list_head_del(&pe->list);
-			free(pe->path);
-			free(pe);
-			pthread_mutex_unlock(&mutex_proc_events_lock);
 			// Confirm whether the process has changed?
-			if (pe->stime != get_process_starttime(pid)) {
-				free(path);
-				continue;
-			}
-
-			if (type == EVENT_TYPE_PROC_EXEC) {
-				if (access(path, F_OK) == 0) {
-					process_execute_handle(pid, tracer);
-				}
-			}
-			free(path);
-
-		} else {
-			pthread_mutex_unlock(&mutex_proc_events_lock);
-			break;
+			if (pe->stime == get_process_starttime(pe->pid) &&
+			    access(pe->path, F_OK) == 0)
+				process_execute_handle(pe->pid, pe->tracer);
+			process_event_free(pe);
 		}
-	} while (true);
+	}
 }
 
 void golang_trace_handle(int pid, enum match_pids_act act)
@@ -1122,9 +1345,13 @@ void golang_trace_handle(int pid, enum match_pids_act act)
 
 void golang_trace_init(void)
 {
-	init_list_head(&proc_events_head);
-	init_list_head(&proc_info_head);
-	pthread_mutex_init(&mutex_proc_events_lock, NULL);
+	int i;
+	for (i = 0; i < GO_PROC_INFO_HASH_SIZE; i++)
+		init_list_head(&proc_info_hash[i]);
+	init_list_head(&proc_info_pending_head);
+	init_list_head(&go_bin_cache_head);
+	proc_event_list_init(&proc_events, PROC_EVENT_DELAY_HANDLE_DEF);
+	pthread_mutex_init(&go_bin_cache_lock, NULL);
 }
 
 void set_uprobe_golang_enabled(bool enabled)
@@ -30,7 +30,8 @@ struct data_members {
 
 // Pid correspond to offsets.
 struct proc_info {
-	struct list_head list;
+	struct list_head list;		// PID hash chain
+	struct list_head pending;	// Waiting for the eBPF map update
 	int pid;
 	char *path;
 	unsigned long long starttime;	// The time the process started after system boot.
@@ -965,7 +965,11 @@ int ebpf_obj_load(struct ebpf_object *obj)
 		if (enabled_feats == 0 &&
 		    map->def.type != BPF_MAP_TYPE_PROG_ARRAY &&
 		    map->def.type != BPF_MAP_TYPE_PERF_EVENT_ARRAY) {
-			map->def.max_entries = 1;
+			/* A ring buffer cannot be smaller than one page. */
+			if (map->def.type == BPF_MAP_TYPE_RINGBUF)
+				map->def.max_entries = getpagesize();
+			else
+				map->def.max_entries = 1;
 		}
 
 		extended_map_preprocess(map);
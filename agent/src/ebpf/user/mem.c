@@ -18,6 +18,7 @@
 #include <malloc.h>
 #include <sys/mman.h>
 #include <unistd.h>		// sysconf()
+#include <pthread.h>
 #include "types.h"
 #include "clib.h"
 #include "mem.h"
@@ -40,7 +41,13 @@
 #define MAP_FIXED_NOREPLACE 0x100000
 #endif
 
-static clib_mem_main_t mem_main;
+static clib_mem_main_t mem_main = {
+	.arena_list = {&mem_main.arena_list, &mem_main.arena_list},
+};
+
+static __thread clib_mem_thread_stat_t *mem_thread_stat;
+static pthread_key_t mem_thread_stat_key;
+static pthread_once_t mem_thread_stat_once = PTHREAD_ONCE_INIT;
 
 static uword mem_get_fd_page_size(int fd)
 {
@@ -94,7 +101,7 @@ static inline void mem_del_list(uword address)
 	mem_list_unlock(&mem_main);
 }
 
-void show_mem_list(void)
+static void show_mem_debug_list(void)
 {
 	u64 alloc_sz = 0;
 	struct list_head *p, *n;
@@ -143,11 +150,127 @@ void show_mem_list(void)
 }
 #endif
 
+static_always_inline void arena_list_lock(clib_mem_main_t * m)
+{
+	while (__atomic_test_and_set(&m->arena_lock, __ATOMIC_ACQUIRE))
+		CLIB_PAUSE();
+}
+
+static_always_inline void arena_list_unlock(clib_mem_main_t * m)
+{
+	__atomic_clear(&m->arena_lock, __ATOMIC_RELEASE);
+}
+
+void show_mem_list(void)
+{
+	clib_mem_main_t *mm = &mem_main;
+	clib_mem_thread_stat_t *s;
+	clib_mem_arena_t *a;
+	u64 alloc_b, free_b;
+	int threads = 0;
+
+#ifdef DF_MEM_DEBUG
+	show_mem_debug_list();
+#endif
+
+	for (s = __atomic_load_n(&mm->thread_stats, __ATOMIC_ACQUIRE);
+	     s != NULL; s = s->next)
+		threads++;
+	get_mem_stat(&alloc_b, &free_b);
+	ebpf_info("== memory alloc %lu bytes free %lu bytes use %lu bytes, "
+		  "%d thread stats ==\n", alloc_b, free_b, alloc_b - free_b,
+		  threads);
+
+	arena_list_lock(mm);
+	list_for_each_entry(a, &mm->arena_list, list) {
+		ebpf_info("arena '%s' used %lu bytes reserved %lu bytes "
+			  "peak %lu bytes resets %lu\n", a->name,
+			  __atomic_load_n(&a->used_bytes, __ATOMIC_RELAXED),
+			  __atomic_load_n(&a->reserved_bytes, __ATOMIC_RELAXED),
+			  __atomic_load_n(&a->peak_bytes, __ATOMIC_RELAXED),
+			  __atomic_load_n(&a->reset_count, __ATOMIC_RELAXED));
+	}
+	arena_list_unlock(mm);
+}
+
+/* Hand the statistics of an exiting thread over to the next new thread. */
+static void mem_thread_stat_detach(void *arg)
+{
+	clib_mem_thread_stat_t *s = arg;
+	mem_thread_stat = NULL;
+	__atomic_store_n(&s->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void mem_thread_stat_key_create(void)
+{
+	if (pthread_key_create(&mem_thread_stat_key, mem_thread_stat_detach))
+		ebpf_warning("pthread_key_create() failed.\n");
+}
+
+static clib_mem_thread_stat_t *mem_thread_stat_attach(void)
+{
+	clib_mem_main_t *mm = &mem_main;
+	clib_mem_thread_stat_t *s;
+	u32 free_entry;
+
+	pthread_once(&mem_thread_stat_once, mem_thread_stat_key_create);
+
+	for (s = __atomic_load_n(&mm->thread_stats, __ATOMIC_ACQUIRE);
+	     s != NULL; s = s->next) {
+		free_entry = 0;
+		if (s->in_use == 0 &&
+		    __atomic_compare_exchange_n(&s->in_use, &free_entry, 1,
+						false, __ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED))
+			goto done;
+	}
+
+	/*
+	 * Not allocated by clib_mem_alloc_aligned(), that would
+	 * count itself before the entry exists.
+	 */
+	if (posix_memalign((void **)&s, CLIB_CACHE_LINE_BYTES, sizeof(*s)))
+		return NULL;
+	memset(s, 0, sizeof(*s));
+	s->in_use = 1;
+	s->next = __atomic_load_n(&mm->thread_stats, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&mm->thread_stats, &s->next, s,
+					    true, __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED))
+		CLIB_PAUSE();
+
+done:
+	pthread_setspecific(mem_thread_stat_key, s);
+	mem_thread_stat = s;
+	return s;
+}
+
+static_always_inline void mem_stat_add(bool is_alloc, u64 bytes)
+{
+	clib_mem_thread_stat_t *s = mem_thread_stat;
+	if (PREDICT_FALSE(s == NULL)) {
+		s = mem_thread_stat_attach();
+		if (s == NULL) {
+			atomic64_add(is_alloc ? &mem_main.clib_alloc_mem_bytes :
+				     &mem_main.clib_free_mem_bytes, bytes);
+			return;
+		}
+	}
+
+	/* Single writer, get_mem_stat() only needs an untorn value. */
+	if (is_alloc)
+		__atomic_store_n(&s->alloc_bytes, s->alloc_bytes + bytes,
+				 __ATOMIC_RELAXED);
+	else
+		__atomic_store_n(&s->free_bytes, s->free_bytes + bytes,
+				 __ATOMIC_RELAXED);
+}
+
 void clib_mem_free(void *p)
 {
 	void *start = p - sizeof(u64);
 	u64 mem_size = *(u64 *) start;
-	atomic64_add(&mem_main.clib_free_mem_bytes, mem_size);
+	mem_stat_add(false, mem_size);
 #ifdef DF_MEM_DEBUG
 	mem_del_list(pointer_to_uword(start));
 #endif
@@ -178,7 +301,7 @@ void *clib_mem_alloc_aligned(const char *name, uword size,
 		*alloc_sz = size - extra_len;
 
 	*(u64 *) ptr = size;
-	atomic64_add(&mem_main.clib_alloc_mem_bytes, size);
+	mem_stat_add(true, size);
 
 #ifdef DF_MEM_DEBUG
 	mem_add_list(name, pointer_to_uword(ptr), size);
@@ -212,8 +335,7 @@ void *clib_mem_realloc_aligned(const char *name, void *p, uword size,
 
 	*alloc_sz = size;
 	*(u64 *) ptr = size + extra_len;
-	atomic64_add(&mem_main.clib_alloc_mem_bytes,
-		     (size + extra_len - old_size));
+	mem_stat_add(true, size + extra_len - old_size);
 
 #ifdef DF_MEM_DEBUG
 	mem_del_list(pointer_to_uword(start));
@@ -263,11 +385,253 @@ uword clib_mem_vm_reserve(uword size, clib_mem_page_sz_t log2_page_sz)
 	return (uword) base + sys_page_sz;
 }
 
+void clib_slab_init(clib_slab_t * s, const char *name)
+{
+	memset(s, 0, sizeof(*s));
+	s->name = name;
+	atomic64_init(&s->bytes_in_flight);
+}
+
+static inline u32 slab_class_size(u32 idx)
+{
+	u32 log2_sz = CLIB_SLAB_MIN_LOG2 + idx / 2;
+	return (idx & 1) ? (3U << (log2_sz - 1)) : (1U << log2_sz);
+}
+
+static inline u32 slab_class_index(uword size)
+{
+	if (size <= (1ULL << CLIB_SLAB_MIN_LOG2))
+		return 0;
+
+	/* (1 << (log2_sz - 1)) < size <= (1 << log2_sz) */
+	uword log2_sz = max_log2(size);
+	if (log2_sz > CLIB_SLAB_MAX_LOG2)
+		return CLIB_SLAB_CLASS_NUM;
+
+	if (size <= (3ULL << (log2_sz - 2)))
+		return 2 * (log2_sz - 1 - CLIB_SLAB_MIN_LOG2) + 1;
+
+	return 2 * (log2_sz - CLIB_SLAB_MIN_LOG2);
+}
+
+void *clib_slab_alloc(clib_slab_t * s, uword size)
+{
+	clib_slab_block_t *b;
+	size += sizeof(*b);
+	u32 idx = slab_class_index(size);
+
+	if (idx < CLIB_SLAB_CLASS_NUM) {
+		if (s->free_list[idx] == NULL)
+			s->free_list[idx] =
+			    __atomic_exchange_n(&s->return_list[idx], NULL,
+						__ATOMIC_ACQUIRE);
+
+		b = s->free_list[idx];
+		if (b != NULL) {
+			s->free_list[idx] = b->next;
+			__atomic_fetch_sub(&s->cached[idx], 1, __ATOMIC_RELAXED);
+			goto done;
+		}
+
+		size = slab_class_size(idx);
+	}
+
+	b = clib_mem_alloc_aligned(s->name, size, 0, NULL);
+	if (b == NULL)
+		return NULL;
+
+	b->slab = s;
+	b->class_idx = idx;
+	b->size = size;
+
+done:
+	b->next = NULL;
+	atomic64_add(&s->bytes_in_flight, b->size);
+	return b + 1;
+}
+
+void clib_slab_free(void *p)
+{
+	clib_slab_block_t *b = (clib_slab_block_t *) p - 1;
+	clib_slab_t *s = b->slab;
+	u32 idx = b->class_idx;
+
+	atomic64_sub(&s->bytes_in_flight, b->size);
+	if (idx >= CLIB_SLAB_CLASS_NUM ||
+	    __atomic_load_n(&s->cached[idx], __ATOMIC_RELAXED) >=
+	    CLIB_SLAB_CACHE_BYTES / b->size) {
+		clib_mem_free(b);
+		return;
+	}
+
+	__atomic_fetch_add(&s->cached[idx], 1, __ATOMIC_RELAXED);
+	clib_slab_block_t **head = &s->return_list[idx];
+	b->next = __atomic_load_n(head, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(head, &b->next, b, true,
+					    __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED))
+		CLIB_PAUSE();
+}
+
+/*
+ * Free all the cached blocks, the blocks in flight are not tracked and
+ * must have been freed before.
+ */
+void clib_slab_release(clib_slab_t * s)
+{
+	clib_slab_block_t *b, *next;
+	u32 i;
+	for (i = 0; i < CLIB_SLAB_CLASS_NUM; i++) {
+		b = __atomic_exchange_n(&s->return_list[i], NULL,
+					__ATOMIC_ACQUIRE);
+		for (; b != NULL; b = next) {
+			next = b->next;
+			clib_mem_free(b);
+		}
+		for (b = s->free_list[i]; b != NULL; b = next) {
+			next = b->next;
+			clib_mem_free(b);
+		}
+		s->free_list[i] = NULL;
+		s->cached[i] = 0;
+	}
+}
+
+void clib_mem_arena_init(clib_mem_arena_t * a, const char *name,
+			 u32 chunk_size)
+{
+	clib_mem_main_t *mm = &mem_main;
+	memset(a, 0, sizeof(*a));
+	a->name = name;
+	a->chunk_size = round_pow2(chunk_size, CLIB_MEM_MIN_ALIGN);
+
+	arena_list_lock(mm);
+	list_add_tail(&a->list, &mm->arena_list);
+	arena_list_unlock(mm);
+}
+
+static clib_mem_arena_chunk_t *arena_chunk_alloc(clib_mem_arena_t * a,
+						 uword size)
+{
+	clib_mem_arena_chunk_t *c;
+	c = clib_mem_alloc_aligned(a->name, sizeof(*c) + size, 0, NULL);
+	if (c == NULL)
+		return NULL;
+
+	c->next = NULL;
+	c->size = size;
+	c->used = 0;
+	a->reserved_bytes += size;
+	return c;
+}
+
+void *clib_mem_arena_alloc(clib_mem_arena_t * a, uword size)
+{
+	clib_mem_arena_chunk_t *c, *big;
+	void *ptr;
+
+	size = round_pow2(size, CLIB_MEM_MIN_ALIGN);
+	if (size == 0 || size > (u32) ~ 0)
+		return NULL;
+
+	/* Larger than a chunk, put it in a chunk of its own. */
+	if (PREDICT_FALSE(size > a->chunk_size)) {
+		big = arena_chunk_alloc(a, size);
+		if (big == NULL)
+			return NULL;
+		big->used = size;
+		if (a->current) {
+			big->next = a->current->next;
+			a->current->next = big;
+		} else {
+			big->next = a->chunks;
+			a->chunks = big;
+		}
+		a->used_bytes += size;
+		return big->data;
+	}
+
+	for (c = a->current ? a->current : a->chunks; c != NULL; c = c->next) {
+		if (c->size - c->used >= size)
+			goto found;
+		a->current = c;
+	}
+
+	c = arena_chunk_alloc(a, a->chunk_size);
+	if (c == NULL)
+		return NULL;
+	if (a->current)
+		a->current->next = c;
+	else
+		a->chunks = c;
+
+found:
+	a->current = c;
+	ptr = c->data + c->used;
+	c->used += size;
+	a->used_bytes += size;
+	return ptr;
+}
+
+/*
+ * Take back all the memory of the arena. The regular chunks are kept for
+ * the next round, the oversized ones are freed.
+ */
+void clib_mem_arena_reset(clib_mem_arena_t * a)
+{
+	clib_mem_arena_chunk_t *c, *next, **prev = &a->chunks;
+
+	for (c = a->chunks; c != NULL; c = next) {
+		next = c->next;
+		if (c->size > a->chunk_size) {
+			*prev = next;
+			a->reserved_bytes -= c->size;
+			clib_mem_free(c);
+			continue;
+		}
+		c->used = 0;
+		prev = &c->next;
+	}
+
+	a->current = NULL;
+	a->peak_bytes = clib_max(a->peak_bytes, a->used_bytes);
+	a->used_bytes = 0;
+	a->reset_count++;
+}
+
+void clib_mem_arena_release(clib_mem_arena_t * a)
+{
+	clib_mem_main_t *mm = &mem_main;
+	clib_mem_arena_chunk_t *c, *next;
+
+	arena_list_lock(mm);
+	list_head_del(&a->list);
+	arena_list_unlock(mm);
+
+	for (c = a->chunks; c != NULL; c = next) {
+		next = c->next;
+		clib_mem_free(c);
+	}
+
+	a->chunks = a->current = NULL;
+	a->used_bytes = a->reserved_bytes = 0;
+}
+
 void get_mem_stat(u64 * alloc_b, u64 * free_b)
 {
 	clib_mem_main_t *mm = &mem_main;
-	*alloc_b = atomic64_read(&mm->clib_alloc_mem_bytes);
-	*free_b = atomic64_read(&mm->clib_free_mem_bytes);
+	clib_mem_thread_stat_t *s;
+	u64 alloc = atomic64_read(&mm->clib_alloc_mem_bytes);
+	u64 free = atomic64_read(&mm->clib_free_mem_bytes);
+
+	for (s = __atomic_load_n(&mm->thread_stats, __ATOMIC_ACQUIRE);
+	     s != NULL; s = s->next) {
+		alloc += __atomic_load_n(&s->alloc_bytes, __ATOMIC_RELAXED);
+		free += __atomic_load_n(&s->free_bytes, __ATOMIC_RELAXED);
+	}
+
+	*alloc_b = alloc;
+	*free_b = free;
 }
 
 void clib_mem_init(void)
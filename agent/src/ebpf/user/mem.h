@@ -46,6 +46,21 @@ typedef enum {
 	CLIB_MEM_PAGE_SZ_16G = 34,
 } clib_mem_page_sz_t;
 
+/*
+ * Allocation statistics of a thread.
+ *
+ * Every thread counts its allocations in its own cache line, only the
+ * owner thread writes it so no atomic read-modify-write is needed, and
+ * get_mem_stat() sums all of them. The entries are never freed, when a
+ * thread exits its entry is handed over to the next new thread.
+ */
+typedef struct clib_mem_thread_stat {
+	struct clib_mem_thread_stat *next;
+	volatile u32 in_use;
+	u64 alloc_bytes;
+	u64 free_bytes;
+} __attribute__ ((aligned(CLIB_CACHE_LINE_BYTES))) clib_mem_thread_stat_t;
+
 typedef struct {
 	/* log2 system page size */
 	clib_mem_page_sz_t log2_page_sz;
@@ -53,10 +68,20 @@ typedef struct {
 	/* log2 default hugepage size */
 	clib_mem_page_sz_t log2_default_hugepage_sz;
 
-	/* total memory bytes statistics*/
+	/*
+	 * total memory bytes statistics, only used by the threads
+	 * which failed to get a clib_mem_thread_stat_t.
+	 */
 	atomic64_t clib_alloc_mem_bytes;
 	atomic64_t clib_free_mem_bytes;
 
+	/* Per-thread statistics, see clib_mem_thread_stat_t. */
+	clib_mem_thread_stat_t *thread_stats;
+
+	/* All the registered arenas, protected by 'arena_lock'. */
+	volatile u32 arena_lock;
+	struct list_head arena_list;
+
 #ifdef DF_MEM_DEBUG
 	volatile uint32_t *list_lock;
 	/* Used for managing all allocated memory.*/
@@ -128,14 +153,92 @@ clib_mem_vm_free (void *addr, uword size)
 	munmap (addr, size);
 }
 
+/*
+ * Fixed size class slab allocator.
+ *
+ * Blocks are allocated by one producer thread and can be freed by any
+ * other threads. A freed block is pushed onto the lock-free return stack
+ * of its class, the producer takes a whole stack at once (atomic exchange,
+ * so there is no ABA problem) when its local free list is empty.
+ *
+ * Size classes go up by half powers of two, 4K, 6K, 8K, 12K ... 64K bytes,
+ * larger requests fall back to clib_mem_alloc_aligned().
+ */
+#define CLIB_SLAB_MIN_LOG2	12	// 4K bytes
+#define CLIB_SLAB_MAX_LOG2	16	// 64K bytes, below the mmap threshold
+#define CLIB_SLAB_CLASS_NUM	(2 * (CLIB_SLAB_MAX_LOG2 - CLIB_SLAB_MIN_LOG2) + 1)
+/* Max free bytes kept per class, the others are returned to the heap. */
+#define CLIB_SLAB_CACHE_BYTES	(1 << 18)
+
+typedef struct clib_slab_block {
+	struct clib_slab_block *next;
+	struct clib_slab *slab;
+	u32 class_idx;		// CLIB_SLAB_CLASS_NUM if not from a size class
+	u32 size;		// Total size of the block, including this header
+	u64 pad;		// Pad the header to 32 bytes
+} clib_slab_block_t;
+
+typedef struct clib_slab {
+	const char *name;
+	/* Only accessed by the producer. */
+	clib_slab_block_t *free_list[CLIB_SLAB_CLASS_NUM];
+	/* Blocks freed by the consumers. */
+	clib_slab_block_t *return_list[CLIB_SLAB_CLASS_NUM]
+	    __attribute__ ((aligned(CLIB_CACHE_LINE_BYTES)));
+	/* Number of free blocks in both lists. */
+	u32 cached[CLIB_SLAB_CLASS_NUM];
+	/* Bytes allocated and not freed yet. */
+	atomic64_t bytes_in_flight;
+} clib_slab_t;
+
+void clib_slab_init(clib_slab_t *s, const char *name);
+void *clib_slab_alloc(clib_slab_t *s, uword size);
+void clib_slab_free(void *p);
+void clib_slab_release(clib_slab_t *s);
+
+/*
+ * Named bump allocator arena.
+ *
+ * For the memory of a subsystem which lives until a known point (e.g. the
+ * strings built in one profiler iteration): allocating only moves a cursor
+ * inside a chunk, nothing is freed one by one, clib_mem_arena_reset() takes
+ * all the memory back at once and keeps the chunks for the next round.
+ *
+ * An arena has a single owner thread. The arenas are registered by name and
+ * their usage is reported by show_mem_list().
+ */
+typedef struct clib_mem_arena_chunk {
+	struct clib_mem_arena_chunk *next;
+	u32 size;		// Usable bytes in 'data'
+	u32 used;
+	u8 data[0] __attribute__ ((aligned(CLIB_MEM_MIN_ALIGN)));
+} clib_mem_arena_chunk_t;
+
+typedef struct clib_mem_arena {
+	struct list_head list;
+	const char *name;
+	u32 chunk_size;
+	clib_mem_arena_chunk_t *chunks;
+	/* The chunk being carved, the chunks before it are full. */
+	clib_mem_arena_chunk_t *current;
+	/* Statistics, only written by the owner. */
+	u64 used_bytes;		// Bytes handed out since the last reset
+	u64 reserved_bytes;	// Bytes held by the chunks
+	u64 peak_bytes;		// Max 'used_bytes' of a round
+	u64 reset_count;
+} clib_mem_arena_t;
+
+void clib_mem_arena_init(clib_mem_arena_t *a, const char *name, u32 chunk_size);
+void *clib_mem_arena_alloc(clib_mem_arena_t *a, uword size);
+void clib_mem_arena_reset(clib_mem_arena_t *a);
+void clib_mem_arena_release(clib_mem_arena_t *a);
+
 void clib_mem_init(void);
 uword clib_mem_vm_reserve(uword size, clib_mem_page_sz_t log2_page_sz);
 void *clib_mem_realloc_aligned(const char *name, void *p, uword size, u32 align, uword *alloc_sz);
 void *clib_mem_alloc_aligned(const char *name, uword size, u32 align, uword *alloc_sz);
 void clib_mem_free(void *p);
 void get_mem_stat(u64 *alloc_b, u64 *free_b);
-#ifdef DF_MEM_DEBUG
 void show_mem_list(void);
-#endif
 
 #endif /* _included_clib_mem_h */
@@ -33,11 +33,27 @@ static const int FOUND_TARGET = 12;
 static const int LEVEL_MAX = 3;
 
 struct target_data_s {
-	const char *structure;
-	const char *member;
-	unsigned long long int offset;
+	struct member_offset *targets;
+	int count;
+	int remaining;		// Number of targets not found yet
 };
 
+static bool structure_wanted(struct target_data_s *td, const char *structure)
+{
+	int i;
+	for (i = 0; i < td->count; i++) {
+		if (td->targets[i].offset == ETR_INVAL &&
+		    !strcmp(td->targets[i].structure, structure))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Collect the offsets of all the wanted members of a structure DIE,
+ * returns FOUND_TARGET once every target has been found.
+ */
 static int examine_die_data(Dwarf_Debug dbg, struct target_data_s *td,
 			    Dwarf_Die die, int in_level)
 {
@@ -45,8 +61,11 @@ static int examine_die_data(Dwarf_Debug dbg, struct target_data_s *td,
 	Dwarf_Die child = NULL;
 	Dwarf_Half tag = 0;
 	Dwarf_Attribute attr = NULL;
+	Dwarf_Unsigned offset;
+	struct member_offset *t;
 	char *name = NULL;
-	int rc = 0;
+	char *structure = NULL;
+	int rc = 0, i;
 
 	rc = dwarf_tag(die, &tag, &err);
 	if (rc != DW_DLV_OK) {
@@ -56,36 +75,50 @@ static int examine_die_data(Dwarf_Debug dbg, struct target_data_s *td,
 	if (tag != DW_TAG_structure_type)
 		return DW_DLV_OK;
 
-	rc = dwarf_die_text(die, DW_AT_name, &name, &err);
+	rc = dwarf_die_text(die, DW_AT_name, &structure, &err);
 	if (rc == DW_DLV_ERROR) {
 		return DW_DLV_ERROR;
 	}
 
-	if (!name || strcmp(name, td->structure))
+	if (!structure || !structure_wanted(td, structure))
 		return DW_DLV_OK;
 
 	rc = dwarf_child(die, &child, &err);
 	if (rc == DW_DLV_ERROR) {
 		return DW_DLV_ERROR;
 	}
+	if (rc == DW_DLV_NO_ENTRY) {
+		return DW_DLV_OK;
+	}
 
 	for (;;) {
+		name = NULL;
 		rc = dwarf_die_text(child, DW_AT_name, &name, &err);
 		if (rc == DW_DLV_ERROR) {
 			return DW_DLV_ERROR;
 		}
-		if (!strcmp(name, td->member)) {
+		for (i = 0; name && i < td->count; i++) {
+			t = &td->targets[i];
+			if (t->offset != ETR_INVAL || strcmp(name, t->member) ||
+			    strcmp(structure, t->structure))
+				continue;
+
 			rc = dwarf_attr(child, DW_AT_data_member_location,
 					&attr, &err);
 			if (rc == DW_DLV_ERROR) {
 				return DW_DLV_ERROR;
 			}
+			if (rc == DW_DLV_NO_ENTRY) {
+				break;
+			}
 
-			rc = dwarf_formudata(attr, &td->offset, &err);
+			rc = dwarf_formudata(attr, &offset, &err);
 			if (rc == DW_DLV_ERROR) {
 				return DW_DLV_ERROR;
 			}
-			return FOUND_TARGET;
+			t->offset = (int)offset;
+			if (--td->remaining == 0)
+				return FOUND_TARGET;
 		}
 
 		rc = dwarf_siblingof_b(dbg, child, true, &child, &err);
@@ -202,33 +235,91 @@ static int look_for_our_target(Dwarf_Debug dbg, struct target_data_s *td,
 	return DW_DLV_NO_ENTRY;
 }
 
-int struct_member_offset_analyze(const char *bin, const char *structure,
-				 const char *member)
+/*
+ * Fast path: look the structures up in the .debug_pubtypes index, so that
+ * only their DIEs are examined instead of walking all CUs. The index is
+ * optional (e.g. Go binaries don't have it), DW_DLV_NO_ENTRY is returned
+ * if it is absent.
+ */
+static int look_for_target_by_pubtypes(Dwarf_Debug dbg,
+				       struct target_data_s *td,
+				       Dwarf_Error *errp)
+{
+	Dwarf_Type *types = NULL;
+	Dwarf_Signed count = 0, i;
+	Dwarf_Off die_off, cu_off;
+	Dwarf_Die die;
+	char *name;
+	int res;
+
+	res = dwarf_get_pubtypes(dbg, &types, &count, errp);
+	if (res != DW_DLV_OK)
+		return DW_DLV_NO_ENTRY;
+
+	for (i = 0; i < count && td->remaining > 0; i++) {
+		res = dwarf_pubtype_name_offsets(types[i], &name, &die_off,
+						 &cu_off, errp);
+		if (res != DW_DLV_OK || !structure_wanted(td, name))
+			continue;
+
+		res = dwarf_offdie_b(dbg, die_off, true, &die, errp);
+		if (res != DW_DLV_OK)
+			continue;
+
+		res = examine_die_data(dbg, td, die, 0);
+		dwarf_dealloc(dbg, die, DW_DLA_DIE);
+		if (res == DW_DLV_ERROR)
+			break;
+	}
+
+	dwarf_pubtypes_dealloc(dbg, types, count);
+	return DW_DLV_OK;
+}
+
+int struct_member_offsets_analyze(const char *bin,
+				  struct member_offset *targets, int count)
 {
 	Dwarf_Error err = NULL;
 	Dwarf_Debug dbg = NULL;
 	int fd = 0;
-	int rc = 0;
+	int rc = 0, i;
 
 	struct target_data_s td = {
-		.structure = structure,
-		.member = member,
-		.offset = -1,
+		.targets = targets,
+		.count = count,
+		.remaining = count,
 	};
 
+	for (i = 0; i < count; i++)
+		targets[i].offset = ETR_INVAL;
+
 	fd = open(bin, O_RDONLY, 0);
 	if (fd < 0)
-		goto out;
+		return ETR_INVAL;
 
 	rc = dwarf_init_b(fd, DW_GROUPNUMBER_ANY, NULL, NULL, &dbg, &err);
-	if (rc != DW_DLV_OK)
-		goto out_file;
+	if (rc != DW_DLV_OK) {
+		close(fd);
+		return ETR_INVAL;
+	}
 
-	look_for_our_target(dbg, &td, &err);
+	look_for_target_by_pubtypes(dbg, &td, &err);
+	if (td.remaining > 0)
+		look_for_our_target(dbg, &td, &err);
 
 	dwarf_finish(dbg);
-out_file:
 	close(fd);
-out:
-	return (int)td.offset;
+	return count - td.remaining;
+}
+
+int struct_member_offset_analyze(const char *bin, const char *structure,
+				 const char *member)
+{
+	struct member_offset target = {
+		.structure = structure,
+		.member = member,
+	};
+
+	struct_member_offsets_analyze(bin, &target, 1);
+	return target.offset;
 }
@@ -17,8 +17,22 @@
 #ifndef DF_BPF_OFFSET_H
 #define DF_BPF_OFFSET_H
 
+struct member_offset {
+	const char *structure;
+	const char *member;
+	int offset;		/* ETR_INVAL 表示未找到 */
+};
+
 /* 返回值为偏移量, ETR_INVAL 表示执行过程中出错 */
 int struct_member_offset_analyze(const char *bin, const char *structure,
 				 const char *member);
 
+/*
+ * 一次遍历 DWARF 信息解析 targets 中所有 (structure, member) 的偏移量,
+ * 全部找到后提前结束遍历。
+ * 返回值为找到的数量, ETR_INVAL 表示执行过程中出错
+ */
+int struct_member_offsets_analyze(const char *bin,
+				  struct member_offset *targets, int count);
+
 #endif
@@ -85,4 +85,18 @@ reader_event_read_polling(struct epoll_event *events, int nfds)
 	}
 }
 
+/*
+ * Poll the rings owned by reader thread 'epoll_id'. Producers skip the
+ * wakeup while little data is pending, so the rings are also drained
+ * when the poll times out.
+ */
+static inline void ringbuf_reader_poll(struct bpf_perf_reader *r, int epoll_id)
+{
+	int ret = ring_buffer__poll(r->ringbufs[epoll_id], r->epoll_timeout);
+	if (ret == 0)
+		ring_buffer__consume(r->ringbufs[epoll_id]);
+	else if (ret < 0 && ret != -EINTR)
+		ebpf_warning("ring_buffer__poll() failed, with %d\n", ret);
+}
+
 #endif /* _BPF_PERF_READER_H_ */
@@ -15,6 +15,7 @@
  */
 
 #include <stdint.h>
+#include <stddef.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
@@ -56,9 +57,12 @@
 #include "bihash_8_8.h"
 #include "profile/stringifier.h"
 #include "profile/profile_common.h"
+#include "trace_utils.h"
 
 static u64 add_symcache_count;
 static u64 free_symcache_count;
+/* Source of 'symbolizer_proc_info.syms_gen', 0 is reserved for the kernel. */
+static u32 syms_cache_gen;
 
 // Process exec/exit event information
 struct proc_event_info {
@@ -542,6 +546,7 @@ static int config_symbolizer_proc_info(struct symbolizer_proc_info *p, int pid)
 	p->lock = 0;
 	pthread_mutex_init(&p->mutex, NULL);
 	p->syms_cache = 0;
+	p->syms_gen = AO_ADD_F(&syms_cache_gen, 1);
 	p->thread_names = NULL;
 	p->thread_names_lock = 0;
 	p->netns_id = get_netns_id_from_pid(pid);
@@ -671,6 +676,7 @@ static void *symbols_cache_update(symbol_caches_hash_t * h,
 
 	p->syms_cache =
 	    pointer_to_uword(bcc_symcache_new((int)kv->k.pid, &lazy_opt));
+	p->syms_gen = AO_ADD_F(&syms_cache_gen, 1);
 
 	if (p->syms_cache <= 0) {
 		p->syms_cache = 0;
@@ -693,6 +699,28 @@ exit:
 	return (void *)p->syms_cache;
 }
 
+/*
+ * The JIT symbols of a Java process are updated in place by the symbol
+ * collector, move the process to a new generation so that the frames
+ * and stacks memoized by the stringifier are resolved again.
+ */
+void symbolizer_proc_syms_changed(pid_t pid)
+{
+	symbol_caches_hash_t *h = &syms_cache_hash;
+	struct symbolizer_proc_info *p;
+	struct symbolizer_cache_kvp kv;
+	kv.k.pid = (u64) pid;
+	kv.v.proc_info_p = 0;
+	if (symbol_caches_hash_search(h, (symbol_caches_hash_kv *) & kv,
+				      (symbol_caches_hash_kv *) & kv) != 0)
+		return;
+
+	p = (struct symbolizer_proc_info *)kv.v.proc_info_p;
+	AO_INC(&p->use);
+	AO_SET(&p->syms_gen, AO_ADD_F(&syms_cache_gen, 1));
+	AO_DEC(&p->use);
+}
+
 static inline void java_expired_update(symbol_caches_hash_t * h,
 				       struct symbolizer_cache_kvp *kv,
 				       struct symbolizer_proc_info *p)
@@ -1054,15 +1082,111 @@ void process_event_free(struct process_create_event *event)
 	free(event);
 }
 
+void proc_event_list_init(proc_event_list_t * list, uint32_t delay)
+{
+	memset(list, 0, sizeof(*list));
+	pthread_mutex_init(&list->m, NULL);
+	list->delay = delay;
+}
+
+static inline bool proc_event_before(struct process_create_event *a,
+				     struct process_create_event *b)
+{
+	if (a->expire_time != b->expire_time)
+		return a->expire_time < b->expire_time;
+	return a->seq < b->seq;
+}
+
+static inline void proc_event_heap_set(proc_event_list_t * list, u32 idx,
+				       struct process_create_event *event)
+{
+	list->heap[idx] = event;
+	event->heap_idx = idx;
+}
+
+/* Called with list->m held, the heap functions below as well. */
+static void proc_event_heap_up(proc_event_list_t * list, u32 idx)
+{
+	struct process_create_event *event = list->heap[idx];
+	u32 parent;
+	while (idx > 0) {
+		parent = (idx - 1) / 2;
+		if (!proc_event_before(event, list->heap[parent]))
+			break;
+		proc_event_heap_set(list, idx, list->heap[parent]);
+		idx = parent;
+	}
+	proc_event_heap_set(list, idx, event);
+}
+
+static void proc_event_heap_down(proc_event_list_t * list, u32 idx)
+{
+	struct process_create_event *event = list->heap[idx];
+	u32 n = vec_len(list->heap), child;
+	while ((child = 2 * idx + 1) < n) {
+		if (child + 1 < n &&
+		    proc_event_before(list->heap[child + 1], list->heap[child]))
+			child++;
+		if (!proc_event_before(list->heap[child], event))
+			break;
+		proc_event_heap_set(list, idx, list->heap[child]);
+		idx = child;
+	}
+	proc_event_heap_set(list, idx, event);
+}
+
+static void proc_event_heap_del(proc_event_list_t * list,
+				struct process_create_event *event)
+{
+	u32 idx = event->heap_idx, last = vec_len(list->heap) - 1;
+	if (idx != last) {
+		proc_event_heap_set(list, idx, list->heap[last]);
+		vec_set_len(list->heap, last);
+		if (idx > 0 &&
+		    proc_event_before(list->heap[idx],
+				      list->heap[(idx - 1) / 2]))
+			proc_event_heap_up(list, idx);
+		else
+			proc_event_heap_down(list, idx);
+	} else {
+		vec_set_len(list->heap, last);
+	}
+}
+
+/* Called with list->m held. Unlinks the event from the hash and the heap. */
+static void proc_event_unlink(proc_event_list_t * list,
+			      struct process_create_event *event)
+{
+	struct process_create_event **pp;
+	pp = &list->hash[event->pid & (PROC_EVENT_HASH_SIZE - 1)];
+	while (*pp != event)
+		pp = &(*pp)->next;
+	*pp = event->next;
+	proc_event_heap_del(list, event);
+}
+
+/* Called with list->m held. */
+static struct process_create_event *proc_event_find(proc_event_list_t * list,
+						    int pid)
+{
+	struct process_create_event *event;
+	event = list->hash[pid & (PROC_EVENT_HASH_SIZE - 1)];
+	while (event != NULL && event->pid != pid)
+		event = event->next;
+	return event;
+}
+
 void add_event_to_proc_list(proc_event_list_t * list, struct bpf_tracer *tracer,
 			    int pid, char *path)
 {
-	static const uint32_t PROC_EVENT_HANDLE_DELAY = 120;
-	struct process_create_event *event = NULL;
+	struct process_create_event *event = NULL, *old;
+	struct process_create_event **head;
+	int ret = VEC_OK;
 
 	event = calloc(1, sizeof(struct process_create_event));
 	if (!event) {
 		ebpf_warning("no memory.\n");
+		free(path);
 		return;
 	}
 
@@ -1070,63 +1194,499 @@ void add_event_to_proc_list(proc_event_list_t * list, struct bpf_tracer *tracer,
 	event->pid = pid;
 	event->stime = get_process_starttime(pid);
 	event->path = path;
-	event->expire_time = get_sys_uptime() + PROC_EVENT_HANDLE_DELAY;
+	event->expire_time = get_sys_uptime() + list->delay;
+
+	pthread_mutex_lock(&list->m);
+	old = proc_event_find(list, pid);
+	if (old != NULL)
+		proc_event_unlink(list, old);
+
+	vec_add1(list->heap, event, ret);
+	if (ret != VEC_OK) {
+		pthread_mutex_unlock(&list->m);
+		ebpf_warning("no memory.\n");
+		process_event_free(event);
+		goto out;
+	}
+	event->seq = list->seq++;
+	proc_event_heap_up(list, vec_len(list->heap) - 1);
+	head = &list->hash[pid & (PROC_EVENT_HASH_SIZE - 1)];
+	event->next = *head;
+	*head = event;
+	pthread_mutex_unlock(&list->m);
 
+out:
+	if (old != NULL)
+		process_event_free(old);
+}
+
+void proc_event_list_cancel(proc_event_list_t * list, int pid)
+{
+	struct process_create_event *event;
 	pthread_mutex_lock(&list->m);
-	list_add_tail(&event->list, &list->head);
+	event = proc_event_find(list, pid);
+	if (event != NULL)
+		proc_event_unlink(list, event);
 	pthread_mutex_unlock(&list->m);
+
+	if (event != NULL)
+		process_event_free(event);
 }
 
-struct process_create_event *get_first_event(proc_event_list_t * list)
+int proc_event_list_drain(proc_event_list_t * list, struct list_head *expired,
+			  int max)
 {
-	struct process_create_event *event = NULL;
+	struct process_create_event *event;
+	u32 now = get_sys_uptime();
+	int count = 0;
+
 	pthread_mutex_lock(&list->m);
-	if (!list_empty(&list->head)) {
-		event = list_first_entry(&list->head,
-					 struct process_create_event, list);
+	while (count < max && vec_len(list->heap) > 0) {
+		event = list->heap[0];
+		if (now < event->expire_time)
+			break;
+		proc_event_unlink(list, event);
+		list_add_tail(&event->list, expired);
+		count++;
 	}
 	pthread_mutex_unlock(&list->m);
-	return event;
+
+	return count;
 }
 
-void remove_event(proc_event_list_t * list, struct process_create_event *event)
+u32 proc_event_list_count(proc_event_list_t * list)
 {
+	u32 count;
 	pthread_mutex_lock(&list->m);
-	list_head_del(&event->list);
+	count = vec_len(list->heap);
 	pthread_mutex_unlock(&list->m);
+	return count;
+}
+
+/*
+ * /proc/<pid>/maps snapshots, see proc.h.
+ */
+
+struct proc_maps_path {
+	struct proc_maps_path *next;	// Hash chain
+	u32 refcnt;
+	u32 hash;
+	char path[];
+};
+
+static struct proc_maps *proc_maps_hash[PROC_MAPS_HASH_SIZE];
+static struct list_head proc_maps_lru_head =
+    { &proc_maps_lru_head, &proc_maps_lru_head };
+static int proc_maps_count;
+static pthread_mutex_t proc_maps_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct proc_maps_path *proc_maps_paths[PROC_MAPS_PATH_HASH_SIZE];
+static pthread_mutex_t proc_maps_paths_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Statistics since the last get_proc_maps_stats(), under proc_maps_lock
+static u64 proc_maps_parse_count;
+static u64 proc_maps_hit_count;
+static u64 proc_maps_parse_ns;
+static u64 proc_maps_parse_max_ns;
+
+static inline u32 proc_maps_path_hash(const char *s, int len)
+{
+	u32 h = 2166136261u;
+	int i;
+	for (i = 0; i < len; i++)
+		h = (h ^ (u8) s[i]) * 16777619u;
+	return h;
+}
+
+static const char *proc_maps_path_intern(const char *s, int len)
+{
+	struct proc_maps_path *p, **head;
+	u32 h = proc_maps_path_hash(s, len);
+
+	pthread_mutex_lock(&proc_maps_paths_lock);
+	head = &proc_maps_paths[h & (PROC_MAPS_PATH_HASH_SIZE - 1)];
+	for (p = *head; p != NULL; p = p->next) {
+		if (p->hash == h && !strncmp(p->path, s, len) &&
+		    p->path[len] == '\0') {
+			p->refcnt++;
+			goto out;
+		}
+	}
+
+	p = clib_mem_alloc_aligned("proc_maps_path", sizeof(*p) + len + 1, 0,
+				   NULL);
+	if (p == NULL) {
+		pthread_mutex_unlock(&proc_maps_paths_lock);
+		return NULL;
+	}
+	p->refcnt = 1;
+	p->hash = h;
+	memcpy(p->path, s, len);
+	p->path[len] = '\0';
+	p->next = *head;
+	*head = p;
+out:
+	pthread_mutex_unlock(&proc_maps_paths_lock);
+	return p->path;
+}
+
+static void proc_maps_path_release(const char *path)
+{
+	struct proc_maps_path *p, **pp;
+	p = (struct proc_maps_path *)(path -
+				      offsetof(struct proc_maps_path, path));
+
+	pthread_mutex_lock(&proc_maps_paths_lock);
+	if (--p->refcnt == 0) {
+		pp = &proc_maps_paths[p->hash & (PROC_MAPS_PATH_HASH_SIZE - 1)];
+		while (*pp != p)
+			pp = &(*pp)->next;
+		*pp = p->next;
+		clib_mem_free(p);
+	}
+	pthread_mutex_unlock(&proc_maps_paths_lock);
+}
+
+static void proc_maps_regions_release(struct proc_maps_region *regions,
+				      int count)
+{
+	int i;
+	for (i = 0; i < count; i++) {
+		if (regions[i].path)
+			proc_maps_path_release(regions[i].path);
+	}
+}
+
+static int proc_maps_vm_pages(pid_t pid, u64 * vm_pages)
+{
+	char file[64], buff[128];
+	int fd, n;
+
+	snprintf(file, sizeof(file), "/proc/%d/statm", pid);
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	n = read(fd, buff, sizeof(buff) - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+
+	buff[n] = '\0';
+	*vm_pages = strtoull(buff, NULL, 10);
+	return 0;
+}
+
+/*
+ * Parse one line of /proc/<pid>/maps:
+ * "<start>-<end> <perms> <offset> <dev> <inode>    [path]"
+ */
+static int proc_maps_parse_line(char *line, struct proc_maps_region *r)
+{
+	char *p = line;
+	int len;
+
+	memset(r, 0, sizeof(*r));
+	r->start = strtoull(p, &p, 16);
+	if (*p != '-')
+		return -1;
+	r->end = strtoull(p + 1, &p, 16);
+	while (*p == ' ')
+		p++;
+	if (strnlen(p, 4) < 4)
+		return -1;
+	if (p[0] == 'r')
+		r->perms |= PROC_MAPS_PERM_READ;
+	if (p[1] == 'w')
+		r->perms |= PROC_MAPS_PERM_WRITE;
+	if (p[2] == 'x')
+		r->perms |= PROC_MAPS_PERM_EXEC;
+	if (p[3] == 's')
+		r->perms |= PROC_MAPS_PERM_SHARED;
+	r->offset = strtoull(p + 4, &p, 16);
+
+	/* Skip the device and the inode. */
+	while (*p == ' ')
+		p++;
+	while (*p != ' ' && *p != '\0')
+		p++;
+	strtoull(p, &p, 10);
+	while (isspace(*p))
+		p++;
+
+	len = strlen(p);
+	while (len > 0 && p[len - 1] == '\n')
+		len--;
+	if (len > 0) {
+		r->path = proc_maps_path_intern(p, len);
+		if (r->path == NULL)
+			return -1;
+	}
+
+	return 0;
+}
+
+static struct proc_maps *proc_maps_parse(pid_t pid, u64 stime, u64 vm_pages)
+{
+	char file[64], line[PATH_MAX + 128];
+	struct proc_maps_region *regions = NULL, r;
+	struct proc_maps *m = NULL;
+	int count, ret = VEC_OK;
+	FILE *fp;
+
+	snprintf(file, sizeof(file), "/proc/%d/maps", pid);
+	fp = fopen(file, "r");
+	if (fp == NULL)
+		return NULL;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (proc_maps_parse_line(line, &r))
+			continue;
+		vec_add1(regions, r, ret);
+		if (ret != VEC_OK) {
+			if (r.path)
+				proc_maps_path_release(r.path);
+			goto failed;
+		}
+	}
+
+	count = vec_len(regions);
+	m = clib_mem_alloc_aligned("proc_maps", sizeof(*m) +
+				   count * sizeof(struct proc_maps_region), 0,
+				   NULL);
+	if (m == NULL)
+		goto failed;
+
+	memset(m, 0, sizeof(*m));
+	m->pid = pid;
+	m->stime = stime;
+	m->vm_pages = vm_pages;
+	m->count = count;
+	if (count > 0)
+		memcpy(m->regions, regions, count * sizeof(*regions));
+	vec_free(regions);
+	fclose(fp);
+	return m;
+
+failed:
+	ebpf_warning("Parse %s failed, no memory.\n", file);
+	proc_maps_regions_release(regions, vec_len(regions));
+	vec_free(regions);
+	fclose(fp);
+	return NULL;
+}
+
+static void proc_maps_free(struct proc_maps *m)
+{
+	proc_maps_regions_release(m->regions, m->count);
+	clib_mem_free(m);
+}
+
+/* Called with proc_maps_lock held. */
+static void proc_maps_unref(struct proc_maps *m)
+{
+	if (--m->refcnt == 0)
+		proc_maps_free(m);
+}
+
+/* Called with proc_maps_lock held. */
+static struct proc_maps *proc_maps_lookup(pid_t pid)
+{
+	struct proc_maps *m;
+	m = proc_maps_hash[pid & (PROC_MAPS_HASH_SIZE - 1)];
+	while (m != NULL && m->pid != pid)
+		m = m->next;
+	return m;
+}
+
+/* Called with proc_maps_lock held. */
+static void proc_maps_unlink(struct proc_maps *m)
+{
+	struct proc_maps **pp = &proc_maps_hash[m->pid &
+						 (PROC_MAPS_HASH_SIZE - 1)];
+	while (*pp != m)
+		pp = &(*pp)->next;
+	*pp = m->next;
+	list_head_del(&m->list);
+	proc_maps_count--;
+	m->cached = false;
+	proc_maps_unref(m);
+}
+
+/* Called with proc_maps_lock held. */
+static void proc_maps_link(struct proc_maps *m)
+{
+	struct proc_maps **head = &proc_maps_hash[m->pid &
+						   (PROC_MAPS_HASH_SIZE - 1)];
+	struct proc_maps *lru;
+
+	m->next = *head;
+	*head = m;
+	list_add_tail(&m->list, &proc_maps_lru_head);
+	m->cached = true;
+	m->refcnt++;
+	if (++proc_maps_count > PROC_MAPS_CACHE_MAX) {
+		lru = list_first_entry(&proc_maps_lru_head, struct proc_maps,
+				       list);
+		proc_maps_unlink(lru);
+	}
+}
+
+/* Called with proc_maps_lock held. */
+static struct proc_maps *proc_maps_hit(struct proc_maps *m)
+{
+	list_head_del(&m->list);
+	list_add_tail(&m->list, &proc_maps_lru_head);
+	m->refcnt++;
+	proc_maps_hit_count++;
+	return m;
+}
+
+struct proc_maps *proc_maps_get(pid_t pid)
+{
+	struct proc_maps *m;
+	u64 stime, vm_pages, start_ns, cost_ns;
+	u64 now_ms = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) / NS_IN_MSEC;
+
+	pthread_mutex_lock(&proc_maps_lock);
+	m = proc_maps_lookup(pid);
+	if (m != NULL && now_ms - m->checked_ms < PROC_MAPS_RECHECK_MS) {
+		m = proc_maps_hit(m);
+		pthread_mutex_unlock(&proc_maps_lock);
+		return m;
+	}
+	pthread_mutex_unlock(&proc_maps_lock);
+
+	stime = get_process_starttime(pid);
+	if (stime == 0 || proc_maps_vm_pages(pid, &vm_pages))
+		return NULL;
+
+	pthread_mutex_lock(&proc_maps_lock);
+	m = proc_maps_lookup(pid);
+	if (m != NULL && m->stime == stime && m->vm_pages == vm_pages) {
+		m->checked_ms = now_ms;
+		m = proc_maps_hit(m);
+		pthread_mutex_unlock(&proc_maps_lock);
+		return m;
+	}
+	pthread_mutex_unlock(&proc_maps_lock);
+
+	start_ns = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+	m = proc_maps_parse(pid, stime, vm_pages);
+	if (m == NULL)
+		return NULL;
+	cost_ns = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) - start_ns;
+	m->checked_ms = now_ms;
+	m->refcnt = 1;
+
+	pthread_mutex_lock(&proc_maps_lock);
+	struct proc_maps *old = proc_maps_lookup(pid);
+	if (old != NULL)
+		proc_maps_unlink(old);
+	proc_maps_link(m);
+	proc_maps_parse_count++;
+	proc_maps_parse_ns += cost_ns;
+	if (cost_ns > proc_maps_parse_max_ns)
+		proc_maps_parse_max_ns = cost_ns;
+	pthread_mutex_unlock(&proc_maps_lock);
+
+	return m;
+}
+
+void proc_maps_put(struct proc_maps *m)
+{
+	pthread_mutex_lock(&proc_maps_lock);
+	proc_maps_unref(m);
+	pthread_mutex_unlock(&proc_maps_lock);
+}
+
+struct proc_maps_region *proc_maps_find(struct proc_maps *m, u64 addr)
+{
+	int lo = 0, hi = (int)m->count - 1, mid;
+	while (lo <= hi) {
+		mid = lo + (hi - lo) / 2;
+		if (addr < m->regions[mid].start)
+			hi = mid - 1;
+		else if (addr >= m->regions[mid].end)
+			lo = mid + 1;
+		else
+			return &m->regions[mid];
+	}
+
+	return NULL;
+}
+
+void proc_maps_invalidate(pid_t pid)
+{
+	struct proc_maps *m;
+	pthread_mutex_lock(&proc_maps_lock);
+	m = proc_maps_lookup(pid);
+	if (m != NULL)
+		proc_maps_unlink(m);
+	pthread_mutex_unlock(&proc_maps_lock);
+}
+
+void get_proc_maps_stats(struct proc_maps_stats *stats)
+{
+	pthread_mutex_lock(&proc_maps_lock);
+	stats->parse_count = proc_maps_parse_count;
+	stats->hit_count = proc_maps_hit_count;
+	stats->parse_max_us = proc_maps_parse_max_ns / NS_IN_USEC;
+	stats->parse_avg_us = proc_maps_parse_count ?
+	    proc_maps_parse_ns / proc_maps_parse_count / NS_IN_USEC : 0;
+	proc_maps_parse_count = 0;
+	proc_maps_hit_count = 0;
+	proc_maps_parse_ns = 0;
+	proc_maps_parse_max_ns = 0;
+	pthread_mutex_unlock(&proc_maps_lock);
+}
+
+static void *proc_maps_provider_get(uint32_t pid,
+				    const proc_maps_region_t ** regions,
+				    uint32_t * count)
+{
+	struct proc_maps *m = proc_maps_get(pid);
+	if (m != NULL) {
+		*regions = (const proc_maps_region_t *)m->regions;
+		*count = m->count;
+	}
+
+	return m;
+}
+
+static void proc_maps_provider_put(void *handle)
+{
+	proc_maps_put(handle);
+}
+
+void proc_maps_cache_init(void)
+{
+	set_proc_maps_provider(proc_maps_provider_get, proc_maps_provider_put);
 }
 
 // https://github.com/iovisor/bcc/blob/15fccdb9a4dbdc3d41e669a7ad5be73d2ac44b00/src/cc/bcc_proc.c#L419
 static int which_so_in_process(const char *libname, int pid, char *libpath)
 {
-	int ret, found = 0;
-	char endline[4096], *mapname = NULL, *newline;
-	char mappings_file[128];
+	int i, found = 0;
+	const char *mapname, *last = NULL;
+	struct proc_maps *m;
 	const size_t search_len = strlen(libname) + strlen("/lib.");
 	char search1[search_len + 1];
 	char search2[search_len + 1];
 
-	snprintf(mappings_file, sizeof(mappings_file), "/proc/%ld/maps",
-		 (long)pid);
-	FILE *fp = fopen(mappings_file, "r");
-	if (!fp)
+	m = proc_maps_get(pid);
+	if (m == NULL)
 		return found;
 
 	snprintf(search1, search_len + 1, "/lib%s.", libname);
 	snprintf(search2, search_len + 1, "/lib%s-", libname);
 
-	do {
-		ret = fscanf(fp, "%*x-%*x %*s %*x %*s %*d");
-		if (!fgets(endline, sizeof(endline), fp))
-			break;
-
-		mapname = endline;
-		newline = strchr(endline, '\n');
-		if (newline)
-			newline[0] = '\0';
-
-		while (isspace(mapname[0]))
-			mapname++;
+	for (i = 0; i < m->count; i++) {
+		/* Interned, the regions of one file share the path. */
+		mapname = m->regions[i].path;
+		if (mapname == NULL || mapname == last)
+			continue;
+		last = mapname;
 
 		if (strstr(mapname, ".so") &&
 		    (strstr(mapname, search1) || strstr(mapname, search2))) {
@@ -1134,9 +1694,9 @@ static int which_so_in_process(const char *libname, int pid, char *libpath)
 			memcpy(libpath, mapname, strlen(mapname) + 1);
 			break;
 		}
-	} while (ret != EOF);
+	}
 
-	fclose(fp);
+	proc_maps_put(m);
 	return found;
 }
 
@@ -1179,63 +1739,335 @@ static struct bcc_symbol_option bcc_elf_foreach_sym_option = {
 	.use_symbol_type = bcc_use_symbol_type,
 };
 
-struct bcc_elf_foreach_sym_payload {
+/*
+ * Uprobe symbols of a binary are resolved in one pass over its ELF symbol
+ * tables: the requested names and prefixes are kept in a small hash table
+ * and each ELF symbol is hashed once per distinct target length, instead
+ * of being strstr()ed against every target in a pass per target. The ELF
+ * type and load segments are read once as well.
+ *
+ * The results are cached by the identity of the binary (device, inode,
+ * size and mtime), so that attaching the same libssl.so or python to many
+ * processes does not read the binary again.
+ */
+
+#define ELF_SYM_HASH_SIZE	64	// Power of 2, at least twice the targets
+#define ELF_LOAD_SEGMENTS_MAX	16
+
+struct elf_sym_target {
+	const char *str;	// Symbol name (suffix match) or prefix
+	int len;
+	bool is_prefix;
+	bool found;
 	uint64_t addr;
 	uint64_t size;
-	const char *name;
-	const char *prefix;
-	const char *symbol_name;
+	char *symbol_name;	// The matched ELF symbol
+};
+
+struct elf_sym_key {
+	int len;
+	bool is_prefix;
+};
+
+struct elf_sym_lookup {
+	struct elf_sym_target *targets;
+	int count;
+	int remaining;
+	struct elf_sym_key keys[ELF_SYM_HASH_SIZE / 2];	// Distinct lengths
+	int keys_count;
+	int hash[ELF_SYM_HASH_SIZE];	// Target index + 1, 0 if empty
+};
+
+struct elf_load_segment {
+	uint64_t v_addr;
+	uint64_t mem_sz;
+	uint64_t file_offset;
+};
+
+struct elf_load_segments {
+	struct elf_load_segment segs[ELF_LOAD_SEGMENTS_MAX];
+	int count;
+};
+
+struct uprobe_sym_result {
+	uint64_t entry;		// File offset, 0 if not found
+	uint64_t size;
+	char *name;
 };
 
-static int bcc_elf_foreach_sym_callback(const char *name, uint64_t addr,
-					uint64_t size, void *payload)
+struct uprobe_sym_cache {
+	struct list_head list;	// LRU list, the most recently used last
+	struct symbol *symbols;	// The symbols[] array resolved
+	size_t n_symbols;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	struct uprobe_sym_result res[];
+};
+
+static struct list_head uprobe_sym_cache_head =
+    { &uprobe_sym_cache_head, &uprobe_sym_cache_head };
+static pthread_mutex_t uprobe_sym_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static int uprobe_sym_cache_count;
+
+static inline u32 elf_sym_hash(const char *s, int len, bool is_prefix)
+{
+	u32 h = 2166136261u ^ is_prefix;
+	int i;
+	for (i = 0; i < len; i++)
+		h = (h ^ (u8) s[i]) * 16777619u;
+	return h;
+}
+
+static struct elf_sym_target *elf_sym_lookup_find(struct elf_sym_lookup *l,
+						  const char *s, int len,
+						  bool is_prefix, bool add)
 {
-	struct bcc_elf_foreach_sym_payload *p = payload;
-	char *pos;
-	if (p->name && (pos = strstr(name, p->name))) {
-		if (pos[strlen(p->name)] == '\0') {
-			p->addr = addr;
-			p->size = size;
-			p->symbol_name = strdup(name);
+	struct elf_sym_target *t;
+	u32 i = elf_sym_hash(s, len, is_prefix) & (ELF_SYM_HASH_SIZE - 1);
+	for (; l->hash[i]; i = (i + 1) & (ELF_SYM_HASH_SIZE - 1)) {
+		t = &l->targets[l->hash[i] - 1];
+		if (t->len == len && t->is_prefix == is_prefix &&
+		    !memcmp(t->str, s, len))
+			return t;
+	}
+
+	if (!add)
+		return NULL;
+
+	t = &l->targets[l->count++];
+	t->str = s;
+	t->len = len;
+	t->is_prefix = is_prefix;
+	l->hash[i] = l->count;
+	l->remaining++;
+
+	for (i = 0; i < l->keys_count; i++) {
+		if (l->keys[i].len == len && l->keys[i].is_prefix == is_prefix)
+			return t;
+	}
+	l->keys[l->keys_count].len = len;
+	l->keys[l->keys_count++].is_prefix = is_prefix;
+	return t;
+}
+
+static int elf_sym_lookup_callback(const char *name, uint64_t addr,
+				   uint64_t size, void *payload)
+{
+	struct elf_sym_lookup *l = payload;
+	struct elf_sym_target *t;
+	struct elf_sym_key *k;
+	int i, len = strlen(name);
+	const char *s;
+
+	for (i = 0; i < l->keys_count; i++) {
+		k = &l->keys[i];
+		if (k->len > len)
+			continue;
+
+		s = k->is_prefix ? name : name + len - k->len;
+		t = elf_sym_lookup_find(l, s, k->len, k->is_prefix, false);
+		if (t == NULL || t->found)
+			continue;
+
+		// The first occurrence of a name must end the symbol.
+		if (!t->is_prefix && strstr(name, t->str) != s)
+			continue;
+
+		t->found = true;
+		t->addr = addr;
+		t->size = size;
+		t->symbol_name = strdup(name);
+		if (--l->remaining == 0)
 			return -1;
+	}
+
+	return 0;
+}
+
+static int collect_load_segment(uint64_t v_addr, uint64_t mem_sz,
+				uint64_t file_offset, void *payload)
+{
+	struct elf_load_segments *l = payload;
+	if (l->count >= ELF_LOAD_SEGMENTS_MAX)
+		return -1;
+
+	l->segs[l->count].v_addr = v_addr;
+	l->segs[l->count].mem_sz = mem_sz;
+	l->segs[l->count++].file_offset = file_offset;
+	return 0;
+}
+
+static struct uprobe_sym_cache *uprobe_sym_resolve(const char *path,
+						   struct symbol symbols[],
+						   size_t n_symbols,
+						   struct stat *st)
+{
+	struct elf_sym_target targets[n_symbols], *t;
+	struct elf_sym_target *map[n_symbols];
+	struct elf_load_segments segs = { 0 };
+	struct elf_sym_lookup l = { .targets = targets };
+	struct uprobe_sym_cache *c;
+	struct load_addr_t addr;
+	const char *s;
+	bool is_exec;
+	int idx, i;
+
+	if (n_symbols > ELF_SYM_HASH_SIZE / 2) {
+		ebpf_warning("Too many uprobe symbols %lu, max %d.\n",
+			     n_symbols, ELF_SYM_HASH_SIZE / 2);
+		return NULL;
+	}
+
+	memset(targets, 0, sizeof(targets));
+	for (idx = 0; idx < n_symbols; idx++) {
+		s = symbols[idx].symbol ? : symbols[idx].symbol_prefix;
+		map[idx] = s ? elf_sym_lookup_find(&l, s, strlen(s),
+						   !symbols[idx].symbol,
+						   true) : NULL;
+	}
+
+	c = calloc(1, sizeof(*c) + n_symbols * sizeof(c->res[0]));
+	if (c == NULL) {
+		ebpf_warning("calloc() error.\n");
+		return NULL;
+	}
+	c->symbols = symbols;
+	c->n_symbols = n_symbols;
+	c->dev = st->st_dev;
+	c->ino = st->st_ino;
+	c->size = st->st_size;
+	c->mtime = st->st_mtim;
+
+	if (bcc_elf_foreach_sym(path, elf_sym_lookup_callback,
+				&bcc_elf_foreach_sym_option, &l)) {
+		free(c);
+		c = NULL;
+		goto out;
+	}
+
+	/*
+	 * For executable binary files (ET_EXEC), convert the virtual
+	 * address to a physical address.
+	 * For shared library binary files (ET_DYN), no conversion is needed.
+	 * ref: https://refspecs.linuxbase.org/elf/gabi4+/ch5.pheader.html
+	 */
+	is_exec = l.remaining < l.count && bcc_elf_get_type(path) == ET_EXEC;
+	if (is_exec)
+		bcc_elf_foreach_load_section(path, &collect_load_segment,
+					     &segs);
+
+	for (idx = 0; idx < n_symbols; idx++) {
+		t = map[idx];
+		// It has been confirmed earlier that the incoming binary file
+		// must be libssl.so and should not be hit here
+		if (t == NULL || !t->found || !t->addr || !t->size)
+			continue;
+
+		addr.target_addr = t->addr;
+		addr.binary_addr = t->addr;
+		if (is_exec) {
+			addr.binary_addr = 0x0;
+			for (i = 0; i < segs.count; i++) {
+				if (find_load(segs.segs[i].v_addr,
+					      segs.segs[i].mem_sz,
+					      segs.segs[i].file_offset, &addr))
+					break;
+			}
 		}
-	} else if (p->prefix && (pos = strstr(name, p->prefix))) {
-		if (name == pos) {
-			p->addr = addr;
-			p->size = size;
-			p->symbol_name = strdup(name);
-			return -1;
+
+		c->res[idx].name = t->symbol_name ? strdup(t->symbol_name) : NULL;
+		if (c->res[idx].name == NULL)
+			continue;
+		c->res[idx].entry = addr.binary_addr;
+		c->res[idx].size = t->size;
+	}
+
+out:
+	for (i = 0; i < l.count; i++)
+		free(targets[i].symbol_name);
+
+	return c;
+}
+
+static void uprobe_sym_cache_free(struct uprobe_sym_cache *c)
+{
+	int idx;
+	for (idx = 0; idx < c->n_symbols; idx++)
+		free(c->res[idx].name);
+	free(c);
+}
+
+/* Called with uprobe_sym_cache_lock held. */
+static struct uprobe_sym_cache *uprobe_sym_cache_find(struct symbol symbols[],
+						      struct stat *st)
+{
+	struct uprobe_sym_cache *c;
+	list_for_each_entry(c, &uprobe_sym_cache_head, list) {
+		if (c->symbols == symbols && c->dev == st->st_dev &&
+		    c->ino == st->st_ino && c->size == st->st_size &&
+		    c->mtime.tv_sec == st->st_mtim.tv_sec &&
+		    c->mtime.tv_nsec == st->st_mtim.tv_nsec) {
+			list_head_del(&c->list);
+			list_add_tail(&c->list, &uprobe_sym_cache_head);
+			return c;
 		}
 	}
-	return 0;
+
+	return NULL;
+}
+
+/* Called with uprobe_sym_cache_lock held. */
+static void uprobe_sym_cache_add(struct uprobe_sym_cache *c)
+{
+	struct uprobe_sym_cache *lru;
+	list_add_tail(&c->list, &uprobe_sym_cache_head);
+	if (++uprobe_sym_cache_count > UPROBE_SYM_CACHE_MAX) {
+		lru = list_first_entry(&uprobe_sym_cache_head,
+				       struct uprobe_sym_cache, list);
+		list_head_del(&lru->list);
+		uprobe_sym_cache_free(lru);
+		uprobe_sym_cache_count--;
+	}
 }
 
 int add_probe_sym_to_tracer_probes(int pid, const char *path,
 				   struct tracer_probes_conf *conf,
 				   struct symbol symbols[], size_t n_symbols)
 {
-	int ret, idx, count;
-	ret = idx = count = 0;
+	int idx, count = 0;
 	struct symbol_uprobe *probe_sym = NULL;
+	struct uprobe_sym_cache *c, *new;
+	struct uprobe_sym_result *res;
 	struct symbol *cur = NULL;
-	struct bcc_elf_foreach_sym_payload payload;
+	struct stat st;
 
-	for (idx = 0; idx < n_symbols; ++idx) {
-		memset(&payload, 0, sizeof(payload));
-		cur = &symbols[idx];
+	if (stat(path, &st) != 0)
+		return 0;
 
-		// Use memory on the stack, no need to allocate on the heap
-		payload.name = cur->symbol;
-		payload.prefix = cur->symbol_prefix;
-		ret = bcc_elf_foreach_sym(path, bcc_elf_foreach_sym_callback,
-					  &bcc_elf_foreach_sym_option,
-					  &payload);
-		if (ret)
-			break;
+	pthread_mutex_lock(&uprobe_sym_cache_lock);
+	c = uprobe_sym_cache_find(symbols, &st);
+	if (c == NULL) {
+		pthread_mutex_unlock(&uprobe_sym_cache_lock);
+		new = uprobe_sym_resolve(path, symbols, n_symbols, &st);
+		if (new == NULL)
+			return 0;
+
+		pthread_mutex_lock(&uprobe_sym_cache_lock);
+		// Resolved by another thread in the meantime ?
+		c = uprobe_sym_cache_find(symbols, &st);
+		if (c == NULL) {
+			uprobe_sym_cache_add(new);
+			c = new;
+		} else
+			uprobe_sym_cache_free(new);
+	}
 
-		// It has been confirmed earlier that the incoming binary file
-		// must be libssl.so and should not be hit here
-		if (!payload.addr || !payload.size)
+	for (idx = 0; idx < n_symbols; ++idx) {
+		cur = &symbols[idx];
+		res = &c->res[idx];
+		if (!res->entry)
 			continue;
 
 		// This memory will be maintained in conf, no need to release
@@ -1244,57 +2076,33 @@ int add_probe_sym_to_tracer_probes(int pid, const char *path,
 			continue;
 
 		// Data comes from symbolic information
-		probe_sym->entry = payload.addr;
-		probe_sym->size = payload.size;
+		probe_sym->entry = res->entry;
+		probe_sym->size = res->size;
+		probe_sym->name = strdup(res->name);
 
 		// Data comes from global variables
 		probe_sym->type = cur->type;
 		probe_sym->isret = cur->is_probe_ret;
 		probe_sym->probe_func = strdup(cur->probe_func);
-		probe_sym->name = payload.symbol_name;
 
 		// Data comes from function input parameters
 		probe_sym->binary_path = strdup(path);
 		probe_sym->pid = pid;
 
-		/*
-		 * For executable binary files (ET_EXEC), convert the virtual
-		 * address to a physical address.
-		 * For shared library binary files (ET_DYN), no conversion is needed.
-		 * ref: https://refspecs.linuxbase.org/elf/gabi4+/ch5.pheader.html
-		 */
-		if (bcc_elf_get_type(probe_sym->binary_path) == ET_EXEC) {
-			struct load_addr_t addr = {
-				.target_addr = probe_sym->entry,
-				.binary_addr = 0x0,
-			};
-
-			if (bcc_elf_foreach_load_section
-			    (probe_sym->binary_path, &find_load, &addr) < 0) {
-				goto invalid;
-			}
-			if (!addr.binary_addr) {
-				goto invalid;
-			}
-			probe_sym->entry = addr.binary_addr;
-		}
-
 		if (probe_sym->probe_func && probe_sym->name &&
 		    probe_sym->binary_path) {
 			add_uprobe_symbol(pid, probe_sym, conf);
 		} else {
-			goto invalid;
+			free((void *)probe_sym->probe_func);
+			free((void *)probe_sym->name);
+			free((void *)probe_sym->binary_path);
+			free(probe_sym);
+			continue;
 		}
 
 		count++;
-		continue;
-
-	      invalid:
-		free((void *)probe_sym->probe_func);
-		free((void *)probe_sym->name);
-		free((void *)probe_sym->binary_path);
-		free(probe_sym);
 	}
+	pthread_mutex_unlock(&uprobe_sym_cache_lock);
 
 	return count;
 }
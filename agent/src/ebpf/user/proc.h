@@ -18,6 +18,7 @@
 #define _USER_PROC_H_
 #include <stdint.h>
 #include "types.h"
+#include "config.h"
 #include "clib.h"
 #include "mem.h"
 #include "vec.h"
@@ -105,6 +106,13 @@ struct symbolizer_proc_info {
 	pthread_mutex_t mutex;
 	/* Recording symbol resolution cache. */
 	volatile uword syms_cache;
+	/*
+	 * Generation of 'syms_cache', unique across processes and changed
+	 * whenever the cache is rebuilt (e.g. Java symbol file refresh)
+	 * or the JIT symbols of a Java process are updated.
+	 * Frames memoized by the stringifier are only valid for it.
+	 */
+	u32 syms_gen;
 };
 
 static inline void thread_names_lock(struct symbolizer_proc_info *p)
@@ -188,6 +196,7 @@ u64 get_pid_stime(pid_t pid);
 void set_java_syms_fetch_delay(int delay_secs);
 u64 get_java_syms_fetch_delay(void);
 void free_proc_cache(struct symbolizer_proc_info *p);
+void symbolizer_proc_syms_changed(pid_t pid);
 void symbolizer_kernel_lock(void);
 void symbolizer_kernel_unlock(void);
 #endif
@@ -221,24 +230,66 @@ bool kernel_version_check(void);
 bool process_probing_check(int pid);
 
 struct process_create_event {
-	struct list_head list;
+	struct list_head list;	// Drained events, see proc_event_list_drain()
+	struct process_create_event *next;	// PID hash chain
 	int pid;
 	uint64_t stime; // Process start time
 	uint32_t expire_time;
+	uint32_t heap_idx;	// Index in the timer heap
+	uint64_t seq;		// Arrival order, FIFO among equal 'expire_time'
 	char *path;
 	struct bpf_tracer *tracer;
 };
 
+/*
+ * Pending process exec events of a tracer, handled after a delay.
+ *
+ * The events are indexed by PID, so that a newer event of a process
+ * replaces the pending one and an exit cancels it in O(1), and kept in
+ * a min-heap ordered by 'expire_time', so that the expired events are
+ * popped without scanning the ones still waiting.
+ */
 typedef struct {
-	struct list_head head;
 	pthread_mutex_t m;
+	uint32_t delay;		// Seconds from the event to its handling
+	uint64_t seq;
+	struct process_create_event **heap;	// vec
+	struct process_create_event *hash[PROC_EVENT_HASH_SIZE];
 } proc_event_list_t;
 
+#define PROC_EVENT_LIST_INITIALIZER(d) \
+	{ .m = PTHREAD_MUTEX_INITIALIZER, .delay = (d) }
+
+void proc_event_list_init(proc_event_list_t * list, uint32_t delay);
+
+/**
+ * @brief Queue an exec event of a process, replacing its pending event.
+ *
+ * @param path Owned by the event from now on, may be NULL.
+ */
 void add_event_to_proc_list(proc_event_list_t * list, struct bpf_tracer *tracer,
 			    int pid, char *path);
 void process_event_free(struct process_create_event *event);
-void remove_event(proc_event_list_t * list, struct process_create_event *event);
-struct process_create_event *get_first_event(proc_event_list_t * list);
+
+/**
+ * @brief Drop the pending event of a process, called on process exit.
+ */
+void proc_event_list_cancel(proc_event_list_t * list, int pid);
+
+/**
+ * @brief Move the expired events, at most 'max', to the 'expired' list in
+ *        expiration order. The caller handles them without holding the
+ *        list lock and frees them with process_event_free().
+ *
+ * @return The number of events moved.
+ */
+int proc_event_list_drain(proc_event_list_t * list, struct list_head *expired,
+			  int max);
+
+/**
+ * @brief Number of pending events.
+ */
+u32 proc_event_list_count(proc_event_list_t * list);
 
 bool check_so_path_by_pid_and_name(int pid, const char *so_name);
 char *get_so_path_by_pid_and_name(int pid, const char *so_name);
@@ -246,4 +297,82 @@ int add_probe_sym_to_tracer_probes(int pid, const char *path,
 				   struct tracer_probes_conf *conf,
 				   struct symbol symbols[], size_t n_symbols);
 
+/*
+ * Snapshot of /proc/<pid>/maps shared by all the tracers.
+ *
+ * The maps file of a process is parsed once per (pid, start time) into an
+ * array of regions sorted by address, with the mapped file paths interned
+ * so that the same library mapped by many processes is stored once. The
+ * snapshot is dropped on process exec/exit events, and rebuilt when the
+ * size of the address space (/proc/<pid>/statm) changes, which happens on
+ * most mmap()/munmap() calls such as dlopen().
+ *
+ * The trace-utils crate reads the snapshots through the provider
+ * registered by proc_maps_cache_init().
+ */
+
+#define PROC_MAPS_PERM_READ	(1 << 0)
+#define PROC_MAPS_PERM_WRITE	(1 << 1)
+#define PROC_MAPS_PERM_EXEC	(1 << 2)
+#define PROC_MAPS_PERM_SHARED	(1 << 3)
+
+/* The layout is shared with 'ProcMapsRegion' in trace-utils. */
+struct proc_maps_region {
+	u64 start;
+	u64 end;
+	u64 offset;		// File offset of 'start'
+	u32 perms;		// PROC_MAPS_PERM_*
+	u32 reserved;
+	const char *path;	// Interned, NULL for anonymous mappings
+};
+
+struct proc_maps {
+	struct list_head list;	// LRU list, the most recently used last
+	struct proc_maps *next;	// Hash chain
+	pid_t pid;
+	u64 stime;		// Process start time (milliseconds)
+	u64 vm_pages;		// Size of the address space (pages)
+	u64 checked_ms;		// Last time 'stime' and 'vm_pages' were checked
+	u32 refcnt;		// References held by the cache and the users
+	bool cached;		// Still in the cache (not invalidated)
+	u32 count;
+	struct proc_maps_region regions[];
+};
+
+struct proc_maps_stats {
+	u64 parse_count;	// Number of maps files parsed
+	u64 hit_count;		// Number of lookups served by a snapshot
+	u64 parse_max_us;	// The longest parse (microseconds)
+	u64 parse_avg_us;	// The average parse (microseconds)
+};
+
+/**
+ * @brief Get the maps snapshot of a process, parsing /proc/<pid>/maps if
+ *        there is no valid snapshot.
+ *
+ * @param pid Process ID
+ * @return The snapshot, released with proc_maps_put(); NULL if the maps
+ *         file can not be read.
+ */
+struct proc_maps *proc_maps_get(pid_t pid);
+void proc_maps_put(struct proc_maps *m);
+
+/**
+ * @brief Find the region containing 'addr' (binary search).
+ *
+ * @return The region, or NULL if 'addr' is not mapped.
+ */
+struct proc_maps_region *proc_maps_find(struct proc_maps *m, u64 addr);
+
+/**
+ * @brief Drop the snapshot of a process, called on exec/exit events.
+ */
+void proc_maps_invalidate(pid_t pid);
+
+/**
+ * @brief Read the statistics since the last call and reset them.
+ */
+void get_proc_maps_stats(struct proc_maps_stats *stats);
+void proc_maps_cache_init(void);
+
 #endif /* _USER_PROC_H_ */
@@ -28,6 +28,7 @@
 #include "collect_symbol_files.h"
 #include "config.h"
 #include "jvm_symbol_collect.h"
+#include "jit_symbol_table.h"
 #include "../perf_profiler.h"
 #include "../../elf.h"
 #include "../../load.h"
@@ -70,20 +71,15 @@ void collect_java_symbols(int pid, int *ret_val, bool error_occurred)
 		goto error;
 	u64 end_time = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
 
-	if (target_symbol_file_access(pid) != 0) {
-		goto error;
-	}
-
-	i64 new_file_sz = get_local_symbol_file_sz(pid);
-	if (new_file_sz == 0) {
+	u32 syms_count = java_jit_symbols_count(pid);
+	if (syms_count == 0) {
 		goto error;
 	}
 
 	if (is_new_collector) {
-		ebpf_info("Refreshing JAVA symbol file: "
-			  DF_AGENT_LOCAL_PATH_FMT
-			  ".map, PID %d, size %ld, cost %lu us", pid, pid,
-			  new_file_sz, (end_time - start_time) / 1000ULL);
+		ebpf_info("Collecting JAVA JIT symbols: PID %d, count %u,"
+			  " cost %lu us", pid, syms_count,
+			  (end_time - start_time) / 1000ULL);
 		*ret_val = JAVA_SYMS_NEW_COLLECTOR;
 	} else {
 		*ret_val = JAVA_SYMS_NEED_UPDATE;
@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "../../config.h"
+#include "../../types.h"
+#include "../../utils.h"
+#include "../../log.h"
+#include "../../mem.h"
+#include "../../vec.h"
+#include "config.h"
+#include "jit_symbol_table.h"
+
+/* Tables of all Java processes being collected, looked up by PID. */
+static jit_symbol_table_t **jit_tables;
+static pthread_rwlock_t jit_tables_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static char *jit_symbol_name_dup(const char *name, int len)
+{
+	char *dst = clib_mem_alloc_aligned("java_jit_sym", len + 1, 0, NULL);
+	if (dst == NULL)
+		return NULL;
+	memcpy(dst, name, len);
+	dst[len] = '\0';
+	return dst;
+}
+
+/* Index of the first symbol whose start address is not below 'addr'. */
+static u32 jit_symbol_lower_bound(jit_symbol_table_t * t, u64 addr)
+{
+	u32 lo = 0, hi = vec_len(t->syms), mid;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (t->syms[mid].start < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static int jit_symbol_cmp(const void *a, const void *b)
+{
+	const struct jit_symbol *x = a, *y = b;
+	if (x->start != y->start)
+		return x->start < y->start ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+jit_symbol_table_t *jit_symbol_table_create(pid_t pid)
+{
+	jit_symbol_table_t *t;
+	int i, ret = VEC_OK;
+
+	t = clib_mem_alloc_aligned("jit_symbol_table", sizeof(*t), 0, NULL);
+	if (t == NULL)
+		return NULL;
+	memset(t, 0, sizeof(*t));
+	t->pid = pid;
+	pthread_rwlock_init(&t->lock, NULL);
+
+	pthread_rwlock_wrlock(&jit_tables_lock);
+	for (i = 0; i < vec_len(jit_tables); i++) {
+		/* The table of an exited process with the same PID. */
+		if (jit_tables[i]->pid == pid) {
+			jit_tables[i] = t;
+			pthread_rwlock_unlock(&jit_tables_lock);
+			return t;
+		}
+	}
+	vec_add1(jit_tables, t, ret);
+	pthread_rwlock_unlock(&jit_tables_lock);
+
+	if (ret != VEC_OK) {
+		ebpf_warning(JAVA_LOG_TAG "JIT symbol table add failed.\n");
+		pthread_rwlock_destroy(&t->lock);
+		clib_mem_free(t);
+		return NULL;
+	}
+
+	return t;
+}
+
+void jit_symbol_table_destroy(jit_symbol_table_t * t)
+{
+	struct jit_symbol *sym;
+	int i;
+
+	if (t == NULL)
+		return;
+
+	pthread_rwlock_wrlock(&jit_tables_lock);
+	for (i = 0; i < vec_len(jit_tables); i++) {
+		if (jit_tables[i] == t) {
+			vec_delete(jit_tables, 1, i);
+			break;
+		}
+	}
+	pthread_rwlock_unlock(&jit_tables_lock);
+
+	vec_foreach(sym, t->syms) {
+		if (sym->name)
+			clib_mem_free(sym->name);
+	}
+	vec_free(t->syms);
+	vec_free(t->unloads);
+	pthread_rwlock_destroy(&t->lock);
+	clib_mem_free(t);
+}
+
+int jit_symbol_table_add(jit_symbol_table_t * t, u64 start, u32 size,
+			 const char *name, int name_len)
+{
+	struct jit_symbol sym = {
+		.start = start,
+		.size = size,
+	};
+	u32 first, last, len, i;
+	int ret = VEC_OK;
+
+	sym.name = jit_symbol_name_dup(name, name_len);
+	if (sym.name == NULL)
+		return -1;
+
+	pthread_rwlock_wrlock(&t->lock);
+	sym.seq = t->seq++;
+	if (!t->sorted) {
+		vec_add1(t->syms, sym, ret);
+		goto out;
+	}
+
+	/* Drop the symbols overlapping [start, start + size). */
+	len = vec_len(t->syms);
+	first = last = jit_symbol_lower_bound(t, start);
+	if (first > 0 && t->syms[first - 1].start +
+	    t->syms[first - 1].size > start)
+		first--;
+	while (last < len && t->syms[last].start < start + size)
+		last++;
+	for (i = first; i < last; i++)
+		clib_mem_free(t->syms[i].name);
+
+	if (last > first) {
+		t->syms[first] = sym;
+		vec_delete(t->syms, last - first - 1, first + 1);
+		goto out;
+	}
+
+	vec_add1(t->syms, sym, ret);
+	if (ret == VEC_OK && first < len) {
+		memmove(&t->syms[first + 1], &t->syms[first],
+			(len - first) * sizeof(sym));
+		t->syms[first] = sym;
+	}
+
+out:
+	pthread_rwlock_unlock(&t->lock);
+	if (ret != VEC_OK) {
+		clib_mem_free(sym.name);
+		return -1;
+	}
+
+	return 0;
+}
+
+void jit_symbol_table_remove(jit_symbol_table_t * t, u64 start)
+{
+	struct jit_unload unload;
+	int ret = VEC_OK;
+	u32 i;
+
+	pthread_rwlock_wrlock(&t->lock);
+	if (!t->sorted) {
+		unload.addr = start;
+		unload.seq = t->seq++;
+		vec_add1(t->unloads, unload, ret);
+		if (ret != VEC_OK)
+			ebpf_warning(JAVA_LOG_TAG "JIT unload add failed.\n");
+	} else {
+		i = jit_symbol_lower_bound(t, start);
+		if (i < vec_len(t->syms) && t->syms[i].start == start) {
+			clib_mem_free(t->syms[i].name);
+			vec_delete(t->syms, 1, i);
+		}
+	}
+	pthread_rwlock_unlock(&t->lock);
+}
+
+void jit_symbol_table_sort(jit_symbol_table_t * t)
+{
+	struct jit_unload *unload;
+	struct jit_symbol *sym, *prev;
+	u32 i, n = 0;
+
+	pthread_rwlock_wrlock(&t->lock);
+	if (t->sorted)
+		goto out;
+
+	if (vec_len(t->syms) > 0)
+		qsort(t->syms, vec_len(t->syms), sizeof(t->syms[0]),
+		      jit_symbol_cmp);
+
+	/* An unload only removes the symbols loaded before it. */
+	vec_foreach(unload, t->unloads) {
+		for (i = jit_symbol_lower_bound(t, unload->addr);
+		     i < vec_len(t->syms) && t->syms[i].start == unload->addr;
+		     i++) {
+			sym = &t->syms[i];
+			if (sym->name && sym->seq < unload->seq) {
+				clib_mem_free(sym->name);
+				sym->name = NULL;
+			}
+		}
+	}
+
+	/* Compact, keeping the most recent of overlapping symbols. */
+	for (i = 0; i < vec_len(t->syms); i++) {
+		sym = &t->syms[i];
+		if (sym->name == NULL)
+			continue;
+		if (n > 0) {
+			prev = &t->syms[n - 1];
+			if (prev->start + prev->size > sym->start) {
+				if (prev->seq > sym->seq) {
+					clib_mem_free(sym->name);
+					continue;
+				}
+				clib_mem_free(prev->name);
+				n--;
+			}
+		}
+		t->syms[n++] = *sym;
+	}
+
+	if (t->syms)
+		vec_set_len(t->syms, n);
+	vec_free(t->unloads);
+	t->sorted = true;
+
+out:
+	pthread_rwlock_unlock(&t->lock);
+}
+
+int jit_symbol_table_export(jit_symbol_table_t * t, const char *path)
+{
+	char temp_path[MAX_PATH_LENGTH];
+	struct jit_symbol *sym;
+	int count = 0;
+	FILE *fp;
+
+	snprintf(temp_path, sizeof(temp_path), "%s.temp", path);
+	fp = fopen(temp_path, "w");
+	if (fp == NULL) {
+		ebpf_warning(JAVA_LOG_TAG
+			     "Error creating temporary file %s, with '%s(%d)'\n",
+			     temp_path, strerror(errno), errno);
+		return -1;
+	}
+
+	pthread_rwlock_rdlock(&t->lock);
+	vec_foreach(sym, t->syms) {
+		if (sym->name == NULL)
+			continue;
+		fprintf(fp, "%lx %x %s\n", sym->start, sym->size, sym->name);
+		count++;
+	}
+	pthread_rwlock_unlock(&t->lock);
+	fclose(fp);
+
+	if (rename(temp_path, path) != 0) {
+		ebpf_warning(JAVA_LOG_TAG
+			     "Error renaming temporary file '%s(%d)'\n",
+			     strerror(errno), errno);
+		return -1;
+	}
+
+	return count;
+}
+
+static jit_symbol_table_t *jit_symbol_table_find(pid_t pid)
+{
+	int i;
+	for (i = 0; i < vec_len(jit_tables); i++) {
+		if (jit_tables[i]->pid == pid)
+			return jit_tables[i];
+	}
+
+	return NULL;
+}
+
+int java_jit_symbol_lookup(pid_t pid, u64 addr, char *buf, int size)
+{
+	jit_symbol_table_t *t;
+	struct jit_symbol *sym;
+	int ret = -1;
+	u32 i;
+
+	pthread_rwlock_rdlock(&jit_tables_lock);
+	t = jit_symbol_table_find(pid);
+	if (t == NULL)
+		goto out;
+
+	pthread_rwlock_rdlock(&t->lock);
+	if (t->sorted) {
+		/* The last symbol starting at or below 'addr'. */
+		i = jit_symbol_lower_bound(t, addr + 1);
+		if (i > 0) {
+			sym = &t->syms[i - 1];
+			if (addr < sym->start + sym->size) {
+				snprintf(buf, size, "%s", sym->name);
+				ret = 0;
+			}
+		}
+	}
+	pthread_rwlock_unlock(&t->lock);
+
+out:
+	pthread_rwlock_unlock(&jit_tables_lock);
+	return ret;
+}
+
+u32 java_jit_symbols_count(pid_t pid)
+{
+	jit_symbol_table_t *t;
+	u32 count = 0;
+
+	pthread_rwlock_rdlock(&jit_tables_lock);
+	t = jit_symbol_table_find(pid);
+	if (t) {
+		pthread_rwlock_rdlock(&t->lock);
+		count = vec_len(t->syms);
+		pthread_rwlock_unlock(&t->lock);
+	}
+	pthread_rwlock_unlock(&jit_tables_lock);
+
+	return count;
+}
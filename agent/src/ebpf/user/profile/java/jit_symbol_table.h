@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DF_JAVA_JIT_SYMBOL_TABLE_H
+#define DF_JAVA_JIT_SYMBOL_TABLE_H
+
+#include <pthread.h>
+
+/*
+ * In-memory interval map of the JIT compiled code of a Java process.
+ *
+ * The symbol collector applies the load/unload events sent by the JVMTI
+ * agent to the table as they arrive, and the stringifier resolves Java
+ * frames by looking the table up directly, so no perf-<pid>.map file has
+ * to be written and re-parsed on every refresh.
+ */
+
+struct jit_symbol {
+	u64 start;		/**< Start address of the compiled code */
+	u32 size;		/**< Size of the compiled code */
+	u32 seq;		/**< Arrival order, the later entry wins on overlap */
+	char *name;		/**< Symbol name, e.g. "LFoo;::bar" */
+};
+
+struct jit_unload {
+	u64 addr;
+	u32 seq;
+};
+
+typedef struct jit_symbol_table {
+	pid_t pid;		/**< Java process ID */
+	pthread_rwlock_t lock;	/**< Writer: symbol collector, readers: stringifier */
+	/*
+	 * Symbols vector. During the replay of the already compiled methods
+	 * new symbols are only appended and unloads are deferred in 'unloads';
+	 * jit_symbol_table_sort() orders it once, afterwards every update
+	 * keeps the vector sorted by start address.
+	 */
+	struct jit_symbol *syms;
+	struct jit_unload *unloads;
+	bool sorted;
+	u32 seq;
+} jit_symbol_table_t;
+
+/**
+ * @brief Create the JIT symbol table of a Java process and register it
+ *        for lookups, replacing a stale table of the same PID.
+ *
+ * @param pid The Java process ID.
+ * @return The table, or NULL on memory allocation failure.
+ */
+jit_symbol_table_t *jit_symbol_table_create(pid_t pid);
+
+/**
+ * @brief Unregister and free a JIT symbol table.
+ */
+void jit_symbol_table_destroy(jit_symbol_table_t * t);
+
+/**
+ * @brief Add the compiled code [start, start + size) named 'name'.
+ *
+ * Symbols overlapping the new range are dropped, the JVM reuses the
+ * code cache of unloaded methods.
+ *
+ * @return 0 on success, -1 on memory allocation failure.
+ */
+int jit_symbol_table_add(jit_symbol_table_t * t, u64 start, u32 size,
+			 const char *name, int name_len);
+
+/**
+ * @brief Remove the compiled code starting at 'start'.
+ */
+void jit_symbol_table_remove(jit_symbol_table_t * t, u64 start);
+
+/**
+ * @brief Sort the symbols appended during replay and apply the deferred
+ *        unloads. Called once, when the replay has completed.
+ */
+void jit_symbol_table_sort(jit_symbol_table_t * t);
+
+/**
+ * @brief Write the table in perf-map format ("<addr> <size> <name>").
+ *
+ * The file is written to '<path>.temp' and renamed over 'path'.
+ *
+ * @return The number of symbols written, or -1 on failure.
+ */
+int jit_symbol_table_export(jit_symbol_table_t * t, const char *path);
+
+/**
+ * @brief Resolve an address of a Java process to its JIT symbol.
+ *
+ * @param pid The Java process ID.
+ * @param addr The address to resolve.
+ * @param buf Buffer receiving the symbol name.
+ * @param size Size of 'buf'.
+ * @return 0 if found, otherwise -1.
+ */
+int java_jit_symbol_lookup(pid_t pid, u64 addr, char *buf, int size);
+
+/**
+ * @brief Number of JIT symbols known for a Java process.
+ */
+u32 java_jit_symbols_count(pid_t pid);
+
+#endif /* DF_JAVA_JIT_SYMBOL_TABLE_H */
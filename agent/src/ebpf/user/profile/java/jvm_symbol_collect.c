@@ -31,7 +31,12 @@
 #include "../../mem.h"
 #include "../../vec.h"
 #include "config.h"
+#include "jit_symbol_table.h"
 #include "jvm_symbol_collect.h"
+#if !defined(JAVA_AGENT_ATTACH_TOOL) && !defined(AARCH64_MUSL)
+#include "../../tracer.h"
+#include "../../proc.h"
+#endif
 
 #define SYM_COLLECT_MAX_EVENTS 4
 
@@ -39,11 +44,10 @@
 symbol_collect_thread_pool_t *g_collect_pool;
 
 /*
- * Use a dynamic array to store the addresses of 'COMPILED_METHOD_UNLOAD'
- * sent by the Java JVM. This is a per-thread variable, with each thread
- * handling the data sent by the corresponding JVM.
+ * Java symbols are kept in memory (see jit_symbol_table.h), the
+ * perf-<pid>.map file is only written when exporting is enabled.
  */
-static __thread java_unload_addr_str_t *unload_addrs;
+static volatile bool java_perf_map_export;
 extern int jattach(int pid, int argc, char **argv, int print_output);
 static int create_symbol_collect_task(pid_t pid, options_t * opts,
 				      bool is_same_mntns);
@@ -406,115 +410,108 @@ static inline int receive_msg(receiver_args_t * args, int sock_fd, char *buf,
 	return recv_bytes;	// Return total bytes received
 }
 
-static bool is_unload_address(const char *sym_str)
+void set_java_perf_map_export(bool enabled)
 {
-	java_unload_addr_str_t *jaddr;
-	vec_foreach(jaddr, unload_addrs) {
-		if (jaddr->is_verified)
-			continue;
-		if (substring_starts_with(sym_str, jaddr->addr)) {
-			jaddr->is_verified = true;
-			return true;
-		}
-	}
+	java_perf_map_export = enabled;
+}
 
-	return false;
+/*
+ * The table can be looked up (it is sorted) and has just changed: the
+ * frames the stringifier memoized for the process may resolve to other
+ * symbols now. Only mark it, see jit_symbols_flush().
+ */
+static inline void jit_symbols_changed(receiver_args_t * args)
+{
+	if (args->jit_table->sorted)
+		args->jit_syms_dirty = true;
 }
 
-static int delete_method_unload_symbol(receiver_args_t * args)
+/*
+ * Move the process to a new symbol generation once per profiler
+ * iteration at most, however many methods a JVM still compiling has
+ * loaded or unloaded meanwhile: each generation invalidates the frames
+ * and stacks the stringifier memoized for the process. The attach tool
+ * has no symbolizer.
+ */
+static inline void jit_symbols_flush(receiver_args_t * args)
 {
-	const char *path = args->opts->perf_map_path;
-	size_t delete_count = 0;
-	FILE *fp_in = fopen(path, "r");
-	if (!fp_in) {
-		ebpf_warning(JAVA_LOG_TAG
-			     "Error opening input file %s, with '%s(%d)'\n",
-			     path, strerror(errno), errno);
-		return -1;
-	}
+#if !defined(JAVA_AGENT_ATTACH_TOOL) && !defined(AARCH64_MUSL)
+	if (!args->jit_syms_dirty)
+		return;
 
-	char temp_path[MAX_PATH_LENGTH];
-	snprintf(temp_path, sizeof(temp_path), "%s.temp", path);
-	FILE *fp_out = fopen(temp_path, "w");
-	if (!fp_out) {
-		ebpf_warning(JAVA_LOG_TAG
-			     "Error creating temporary file %s, with '%s(%d)'\n",
-			     temp_path, strerror(errno), errno);
-		fclose(fp_in);
-		return -1;
-	}
+	u64 now = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+	if (now - args->jit_syms_flush_time <
+	    PROFILER_READER_EPOLL_TIMEOUT * NS_IN_MSEC)
+		return;
+
+	args->jit_syms_flush_time = now;
+	args->jit_syms_dirty = false;
+	symbolizer_proc_syms_changed(args->pid);
+#endif
+}
 
-	char buffer[STRING_BUFFER_SIZE];
-	while (fgets(buffer, sizeof(buffer), fp_in)) {
-		if (!is_unload_address(buffer))
-			fputs(buffer, fp_out);
-		else
-			delete_count++;
+/*
+ * Sort the symbols received during replay once it has completed, from
+ * then on the table is updated in place and can be looked up.
+ */
+static inline void jit_symbol_table_replay_check(receiver_args_t * args)
+{
+	if (args->replay_done && !args->jit_table->sorted) {
+		jit_symbol_table_sort(args->jit_table);
+		jit_symbols_changed(args);
 	}
+}
 
-	fclose(fp_in);
-	fclose(fp_out);
+/*
+ * Write the perf-<pid>.map file when a refresh is requested and
+ * exporting is enabled.
+ */
+static int export_java_perf_map_file(receiver_args_t * args)
+{
+	if (!(args->task->need_refresh && java_perf_map_export))
+		return 0;
 
-	if (remove(path) != 0) {
-		ebpf_warning(JAVA_LOG_TAG
-			     "Error deleting original file %s, with '%s(%d)'\n",
-			     path, strerror(errno), errno);
-		return -1;
-	}
-	if (rename(temp_path, path) != 0) {
-		ebpf_warning(JAVA_LOG_TAG
-			     "Error renaming temporary file '%s(%d)'\n",
-			     strerror(errno), errno);
+	jit_symbol_table_replay_check(args);
+	int count = jit_symbol_table_export(args->jit_table,
+					    args->opts->perf_map_path);
+	if (count < 0)
 		return -1;
-	}
 
-	return delete_count;
+	ebpf_debug(JAVA_LOG_TAG "Export perf map file %s, pid %d count %d\n",
+		   args->opts->perf_map_path, args->pid, count);
+	return 0;
 }
 
-static int update_java_perf_map_file(receiver_args_t * args, char *addr_str)
+/* Apply a "<addr> <size> <name>\n" symbol line to the table. */
+static int jit_symbol_load(receiver_args_t * args, char *line)
 {
-	if (addr_str != NULL) {
-		int ret = VEC_OK;
-		java_unload_addr_str_t java_addr;
-		memset(&java_addr, 0, sizeof(java_addr));
-		snprintf(java_addr.addr, sizeof(java_addr.addr), "%s",
-			 addr_str);
-		vec_add1(unload_addrs, java_addr, ret);
-		if (ret != VEC_OK) {
-			ebpf_warning(" Java unload_addrs add failed.\n");
-		}
-	}
-
-	int unload_count = vec_len(unload_addrs);
-	if (args->map_fp != NULL &&
-	    ((args->task->need_refresh && unload_count > 0)
-	     || unload_count >= UPDATE_SYMS_FILE_UNLOAD_HIGH_THRESH)) {
-		fclose(args->map_fp);
-		int count;
-		if ((count = delete_method_unload_symbol(args)) < 0) {
-			vec_free(unload_addrs);
-			return -1;
-		}
-		vec_free(unload_addrs);
-		args->map_fp = fopen(args->opts->perf_map_path, "a");
-		if (!args->map_fp) {
-			ebpf_warning(JAVA_LOG_TAG
-				     "fopen() %s failed with '%s(%d)'\n",
-				     args->opts->perf_map_path, strerror(errno),
-				     errno);
-			return -1;
-		}
-		ebpf_debug
-		    ("=== file update args->task->need_refresh %d pid %d unload_count %d\n",
-		     args->task->need_refresh, args->task->pid, unload_count);
-	}
-
+	char *p, *name;
+	u64 start;
+	u32 size;
+	int len;
+
+	start = strtoull(line, &p, 16);
+	if (p == line || *p != ' ')
+		goto invalid;
+	name = p + 1;
+	size = strtoul(name, &p, 16);
+	if (p == name || *p != ' ')
+		goto invalid;
+	name = p + 1;
+	len = strlen(name);
+	if (len > 0 && name[len - 1] == '\n')
+		len--;
+
+	return jit_symbol_table_add(args->jit_table, start, size, name, len);
+
+invalid:
+	ebpf_debug(JAVA_LOG_TAG "Invalid symbol '%s', pid %d\n", line,
+		   args->pid);
 	return 0;
 }
 
 static int symbol_msg_process(receiver_args_t * args, int sock_fd)
 {
-	FILE *fp = args->map_fp;
 	struct symbol_metadata meta;
 	int n = receive_msg(args, sock_fd, (char *)&meta, sizeof(meta), false);
 	if (n != sizeof(meta))
@@ -529,28 +526,26 @@ static int symbol_msg_process(receiver_args_t * args, int sock_fd)
 		return -1;
 	rcv_buf[meta.len] = '\0';
 
+	jit_symbol_table_replay_check(args);
+
 	/*
-	 * If the replay is complete and the event type is
-	 * JVMTI_EVENT_COMPILED_METHOD_UNLOAD, the map file
-	 * needs to be updated.
+	 * JVMTI_EVENT_COMPILED_METHOD_UNLOAD carries only the code address,
+	 * the other events a perf map line.
 	 */
-	if (args->replay_done && meta.type == METHOD_UNLOAD) {
-		if (update_java_perf_map_file(args, rcv_buf))
-			return -1;
-	} else {
-		int written_count = fwrite(rcv_buf, sizeof(char), n, fp);
-		if (written_count != n) {
-			ebpf_warning(JAVA_LOG_TAG "%s(%d)\n", strerror(errno),
-				     errno);
-			return -1;
-		}
-		/*
-		 * Ensure data is written to the file promptly,
-		 * avoiding prolonged residence in the buffer.
-		 */
-		fflush(fp);
+	if (meta.type == METHOD_UNLOAD) {
+		jit_symbol_table_remove(args->jit_table,
+					strtoull(rcv_buf, NULL, 16));
+		jit_symbols_changed(args);
+		return 0;
 	}
 
+	if (jit_symbol_load(args, rcv_buf)) {
+		ebpf_warning(JAVA_LOG_TAG "Add JIT symbol failed, pid %d\n",
+			     args->pid);
+		return -1;
+	}
+
+	jit_symbols_changed(args);
 	return 0;
 }
 
@@ -614,9 +609,7 @@ static int destroy_task(symbol_collect_task_t * task,
 			symbol_collect_thread_pool_t * pool)
 {
 	receiver_args_t *args = (receiver_args_t *) & task->args;
-	if (args->map_fp) {
-		fclose(args->map_fp);
-	}
+	jit_symbol_table_destroy(args->jit_table);
 
 	if (args->log_fp) {
 		fclose(args->log_fp);
@@ -677,20 +670,12 @@ static void *ipc_receiver_main(void *arguments)
 {
 	receiver_args_t *args = (receiver_args_t *) arguments;
 
-	/*
-	 * If the file already exists, opening it in "w" mode will clear its contents
-	 * (truncate it to zero length). If the file does not exist, opening it in "w"
-	 * mode will create a new file.
-	 */
-	FILE *map_fp = fopen(args->opts->perf_map_path, "w");
-	if (!map_fp) {
-		// byte stream in socket needs to be consumed to avoid client stuck
-		// even if file open fails
-		ebpf_warning(JAVA_LOG_TAG "fopen() %s failed with '%s(%d)'\n",
-			     args->opts->perf_map_path, strerror(errno), errno);
+	args->jit_table = jit_symbol_table_create(args->pid);
+	if (args->jit_table == NULL) {
+		ebpf_warning(JAVA_LOG_TAG "JIT symbol table create failed,"
+			     " pid %d\n", args->pid);
 		goto cleanup;
 	}
-	args->map_fp = map_fp;
 
 	FILE *log_fp = fopen(args->opts->perf_log_path, "w");
 	if (!log_fp) {
@@ -744,7 +729,10 @@ static void *ipc_receiver_main(void *arguments)
 			}
 		}
 
-		refresh_symbol_file_and_notify(args, update_java_perf_map_file(args, NULL));
+		jit_symbol_table_replay_check(args);
+		jit_symbols_flush(args);
+		refresh_symbol_file_and_notify(args,
+					       export_java_perf_map_file(args));
 	}
 
 cleanup:
@@ -1134,6 +1122,14 @@ int update_java_symbol_file(pid_t pid, bool * is_new_collector)
 			     " is invalid and needs to be recreated.\n", pid);
 		return -1;
 	}
+	/*
+	 * Symbols are looked up in memory, the file only needs refreshing
+	 * when it is exported.
+	 */
+	*is_new_collector = false;
+	if (!java_perf_map_export)
+		return 0;
+
 	// Notify to refresh the file
 	task->need_refresh = true;
 	// Refresh the file again; needs to wait for completion.
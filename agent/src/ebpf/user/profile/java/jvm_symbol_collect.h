@@ -20,20 +20,9 @@
 #include "config.h"
 
 #define UNIX_PATH_MAX 108
-#define JAVA_ADDR_STR_SIZE 13
 
 #define DF_JAVA_ATTACH_CMD "/usr/bin/deepflow-jattach"
 
-/*
- * The address range of the 64-bit user space is from 0x0000000000000000
- * to 0x00007fffffffffff, which effectively uses only 48 bits. We use 13
- * bytes to represent the address string, with the last byte used as '\0'.
- */
-typedef struct {
-	char addr[JAVA_ADDR_STR_SIZE];
-	bool is_verified;
-} java_unload_addr_str_t;
-
 typedef uint64_t(*agent_test_t) (void);
 
 typedef struct options {
@@ -54,10 +43,12 @@ typedef struct receiver_args {
 	int map_client;		/**< For Java symbol data transmission */
 	int log_client;		/**< For JVM log data transmission */
 	int epoll_fd;		/**< epoll listening socket */
-	FILE *map_fp;		/**< File for saving Java symbol information */
+	struct jit_symbol_table *jit_table; /**< In-memory Java JIT symbols */
 	FILE *log_fp;		/**< File for saving JVM log information */
 	volatile int attach_ret; /**< To store the return value of jattach */
 	volatile bool replay_done; /**< Indicates whether Java symbol replay is complete */
+	bool jit_syms_dirty;	/**< JIT symbols changed since the last symbol generation bump */
+	u64 jit_syms_flush_time; /**< Time of the last symbol generation bump (ns) */
 	symbol_collect_task_t *task; /**< Address of the associated task */
 } receiver_args_t;
 
@@ -117,6 +108,16 @@ typedef struct {
  */
 int update_java_symbol_file(pid_t pid, bool *is_new_collector);
 
+/**
+ * @brief Enables or disables exporting the perf-<pid>.map file.
+ *
+ * Java symbols are always resolved from the in-memory JIT symbol table,
+ * the file is only for external consumers. Disabled by default.
+ *
+ * @param enabled Whether to write the file on every symbol refresh.
+ */
+void set_java_perf_map_export(bool enabled);
+
 /**
  * @brief Cleans up a single file in the target namespace.
  * 
@@ -65,6 +65,8 @@ struct profiler_context *g_ctx_array[PROFILER_CTX_NUM];
 static struct profiler_context oncpu_ctx;
 
 static bool g_enable_oncpu = true;
+// Count the on-CPU samples in kernel, see set_profiler_sample_aggregation()
+static bool g_sample_aggregation;
 
 /* Used for handling updates to JAVA symbol files */
 static pthread_t java_syms_update_thread;
@@ -327,6 +329,17 @@ static int create_profiler(struct bpf_tracer *tracer)
 	if ((ret = maps_config(tracer, MAP_STACK_B_NAME, cap)))
 		return ret;
 
+	/*
+	 * An element stands for one distinct sample key of an iteration,
+	 * there can't be more of them than stack map entries.
+	 */
+	int agg_cap = g_sample_aggregation ? cap : 1;
+	if ((ret = maps_config(tracer, MAP_STACK_AGG_A_NAME, agg_cap)))
+		return ret;
+
+	if ((ret = maps_config(tracer, MAP_STACK_AGG_B_NAME, agg_cap)))
+		return ret;
+
 	if (get_dwarf_enabled() && (major > 5 || (major == 5 && minor >= 2))) {
 		if ((ret = maps_config(tracer, MAP_CUSTOM_STACK_A_NAME, cap))) {
 			return ret;
@@ -371,6 +384,12 @@ static int create_profiler(struct bpf_tracer *tracer)
 		ebpf_info(LOG_CP_TAG "=== oncpu profiler enabled ===\n");
 		tracer->enable_sample = true;
 		set_bpf_run_enabled(tracer, &oncpu_ctx, 0);
+		if (oncpu_ctx.sample_aggregation &&
+		    !profiler_state_set(tracer, &oncpu_ctx, SAMPLE_AGG_IDX, 1)) {
+			ebpf_warning(LOG_CP_TAG "Enable sample aggregation "
+				     "failed, output every sample.\n");
+			oncpu_ctx.sample_aggregation = false;
+		}
 
 		/*
 		 * create reader for read eBPF-profiler data.
@@ -535,49 +554,55 @@ void output_profiler_status(struct bpf_tracer *t, void *context)
 	get_mem_stat(&alloc_b, &free_b);
 
 	u64 sample_drop_cnt = 0;
-	if (!bpf_table_get_value
-	    (t, ctx->state_map_name, SAMPLE_CNT_DROP,
-	     (void *)&sample_drop_cnt)) {
+	if (!profiler_state_get(t, ctx, SAMPLE_CNT_DROP, &sample_drop_cnt)) {
 		ebpf_warning("Get map '%s' sample_drop_cnt failed.\n",
 			     ctx->state_map_name);
 	}
 
 	u64 output_err_cnt = 0;
-	if (!bpf_table_get_value
-	    (t, ctx->state_map_name, ERROR_IDX, (void *)&output_err_cnt)) {
+	if (!profiler_state_get(t, ctx, ERROR_IDX, &output_err_cnt)) {
 		ebpf_warning("Get map '%s' output_err_cnt failed.\n",
 			     ctx->state_map_name);
 	}
 
 	u64 output_count = 0;
-	if (!bpf_table_get_value
-	    (t, ctx->state_map_name, OUTPUT_CNT_IDX, (void *)&output_count)) {
+	if (!profiler_state_get(t, ctx, OUTPUT_CNT_IDX, &output_count)) {
 		ebpf_warning("Get map '%s' output_cnt failed.\n",
 			     ctx->state_map_name);
 	}
 
 	u64 iter_max_cnt = 0;
-	if (!bpf_table_get_value
-	    (t, ctx->state_map_name, SAMPLE_ITER_CNT_MAX,
-	     (void *)&iter_max_cnt)) {
+	if (!profiler_state_get(t, ctx, SAMPLE_ITER_CNT_MAX, &iter_max_cnt)) {
 		ebpf_warning("Get map '%s' iter_max_cnt failed.\n",
 			     ctx->state_map_name);
 	}
 
 	u64 is_rt_kern = 0;
-	if (!bpf_table_get_value
-	    (t, ctx->state_map_name, RT_KERN, (void *)&is_rt_kern)) {
+	if (!profiler_state_get(t, ctx, RT_KERN, &is_rt_kern)) {
 		ebpf_warning("Get map '%s' is_rt_kern failed.\n",
 			     ctx->state_map_name);
 	}
 
 	u64 is_enabled = 0;
-	if (!bpf_table_get_value
-	    (t, ctx->state_map_name, ENABLE_IDX, (void *)&is_enabled)) {
+	if (!profiler_state_get(t, ctx, ENABLE_IDX, &is_enabled)) {
 		ebpf_warning("Get map '%s' is_enabled failed.\n",
 			     ctx->state_map_name);
 	}
 
+	/* Not all the profilers have the slot, missing means 0. */
+	u64 agg_sample_cnt = 0;
+	profiler_state_get(t, ctx, SAMPLE_AGG_CNT_IDX, &agg_sample_cnt);
+
+	/*
+	 * Each sample reaches user space either as a perf buffer event or
+	 * folded into an element of the aggregation maps.
+	 */
+	u64 samples = output_count + agg_sample_cnt;
+	u64 records = output_count + ctx->agg_entry_count;
+
+	struct stack_str_cache_stats cache_stats;
+	get_stack_str_cache_stats(&ctx->stack_str_hash, &cache_stats);
+
 	ebpf_info("\n\n----------------------------\n"
 		  "Profiler Name: %s\nstate_map_name: %s\n"
 		  "enabled: %lu\nrecv envent:\t%lu\n"
@@ -594,6 +619,12 @@ void output_profiler_status(struct bpf_tracer *t, void *context)
 		  " - output_err_cnt:\t%lu\n"
 		  " - iter_max_cnt:\t%lu\n"
 		  " - is_rt_kern:\t%lu\n"
+		  " - agg_sample_cnt:\t%lu\n"
+		  "sample_aggregation:\t%d samples %lu records %lu "
+		  "(reduction %.2lfx) agg_entries %lu drain_syscalls %lu\n"
+		  "consumer_cpu:\t%lu ms (%.2lf us/sample)\n"
+		  "stack_str_cache:\tlookups %lu hits %lu (%.2lf%%) "
+		  "elems %lu bytes %lu evictions %lu\n"
 		  "----------------------------\n\n",
 		  ctx->name, ctx->state_map_name, is_enabled,
 		  atomic64_read(&t->recv), ctx->process_count,
@@ -605,7 +636,17 @@ void output_profiler_status(struct bpf_tracer *t, void *context)
 		  ((double)atomic64_read(&t->recv) /
 		   (double)ctx->transfer_count), alloc_b, free_b,
 		  alloc_b - free_b, output_count, sample_drop_cnt,
-		  output_err_cnt, iter_max_cnt, is_rt_kern);
+		  output_err_cnt, iter_max_cnt, is_rt_kern, agg_sample_cnt,
+		  ctx->sample_aggregation, samples, records,
+		  records ? (double)samples / (double)records : 0.0,
+		  ctx->agg_entry_count, ctx->agg_drain_syscalls,
+		  ctx->consumer_cpu_ns / NS_IN_MSEC,
+		  samples ? (double)ctx->consumer_cpu_ns / NS_IN_USEC /
+		  (double)samples : 0.0, cache_stats.lookups,
+		  cache_stats.hits,
+		  cache_stats.lookups ? (double)cache_stats.hits * 100 /
+		  (double)cache_stats.lookups : 0.0, cache_stats.elems,
+		  cache_stats.bytes, cache_stats.evictions);
 }
 
 void print_cp_tracer_status(void)
@@ -757,6 +798,11 @@ int start_continuous_profiler(int freq, int java_syms_update_delay,
 			      NANOSEC_PER_SEC / freq,
 			      cb_ctx[PROFILER_CTX_ONCPU_IDX]);
 	g_ctx_array[PROFILER_CTX_ONCPU_IDX] = &oncpu_ctx;
+	oncpu_ctx.sample_aggregation = g_sample_aggregation;
+	snprintf(oncpu_ctx.stack_agg_map_a, sizeof(oncpu_ctx.stack_agg_map_a),
+		 "%s", MAP_STACK_AGG_A_NAME);
+	snprintf(oncpu_ctx.stack_agg_map_b, sizeof(oncpu_ctx.stack_agg_map_b),
+		 "%s", MAP_STACK_AGG_B_NAME);
 
 	if ((java_syms_update_delay < JAVA_SYMS_UPDATE_DELAY_MIN)
 	    || (java_syms_update_delay > JAVA_SYMS_UPDATE_DELAY_MAX))
@@ -881,9 +927,7 @@ void release_flame_graph_hash(void)
 		fclose(folded_file);
 
 	get_mem_stat(&alloc_b, &free_b);
-#ifdef DF_MEM_DEBUG
 	show_mem_list();
-#endif
 	ebpf_info(LOG_CP_TAG
 		  "after alloc_b:\t%lu bytes free_b:\t%lu bytes use:\t%lu"
 		  " bytes\n", alloc_b, free_b, alloc_b - free_b);
@@ -977,6 +1021,18 @@ bool oncpu_profiler_enabled(void)
 	return g_enable_oncpu;
 }
 
+/*
+ * Count the on-CPU samples by key in kernel and drain the counts once per
+ * iteration, instead of outputting each sample through the perf buffer.
+ * Must be called before start_continuous_profiler(), disabled by default.
+ */
+void set_profiler_sample_aggregation(bool enabled)
+{
+	g_sample_aggregation = enabled;
+	ebpf_info(LOG_CP_TAG "Set sample aggregation %s.\n",
+		  enabled ? "enable" : "disable");
+}
+
 void profiler_match_pid_handle(int feat, int pid, enum match_pids_act act)
 {
 	if (feat == FEATURE_PROFILE_ONCPU || feat == FEATURE_PROFILE_OFFCPU
@@ -1057,6 +1113,10 @@ bool oncpu_profiler_enabled(void)
 	return false;
 }
 
+void set_profiler_sample_aggregation(bool enabled)
+{
+}
+
 void print_cp_tracer_status(void)
 {
 }
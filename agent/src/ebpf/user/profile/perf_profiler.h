@@ -208,6 +208,7 @@ int check_profiler_running_pid(int pid);
 int check_profiler_is_running(void);
 int write_profiler_running_pid(void);
 bool oncpu_profiler_enabled(void);
+void set_profiler_sample_aggregation(bool enabled);
 void print_cp_tracer_status(void);
 void output_profiler_status(struct bpf_tracer *t, void *context);
 void profiler_match_pid_handle(int feat, int pid, enum match_pids_act act);
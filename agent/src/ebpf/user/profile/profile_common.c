@@ -140,14 +140,118 @@ int profiler_context_init(struct profiler_context *ctx,
 	return 0;
 }
 
+/*
+ * The state map is either the control and counters elements of
+ * profiler_state_t (see perf_profiler.h) or, for the profilers which have
+ * not been converted yet, an array of u64 indexed by the slot.
+ */
+static inline bool state_map_is_struct(struct bpf_tracer *t,
+				       struct profiler_context *ctx)
+{
+	struct ebpf_map *map =
+	    ebpf_obj__get_map_by_name(t->obj, ctx->state_map_name);
+	return map != NULL && map->def.value_size == sizeof(profiler_state_t);
+}
+
+static inline bool state_slot_is_ctrl(int idx)
+{
+	return idx == TRANSFER_CNT_IDX || idx == ENABLE_IDX ||
+	    idx == MINBLOCK_TIME_IDX || idx == RT_KERN ||
+	    idx == SAMPLE_AGG_IDX || idx == SAMPLE_CNT_A_BASE_IDX ||
+	    idx == SAMPLE_CNT_B_BASE_IDX;
+}
+
+/* Serializes the read-modify-write of the control element. */
+static pthread_mutex_t state_ctrl_lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool profiler_state_get(struct bpf_tracer *t, struct profiler_context *ctx,
+			int idx, u64 * val)
+{
+	profiler_state_t state;
+	if (!state_map_is_struct(t, ctx))
+		return bpf_table_get_value(t, ctx->state_map_name, idx, val);
+
+	if (!bpf_table_get_value(t, ctx->state_map_name,
+				 state_slot_is_ctrl(idx) ? PROFILER_STATE_CTRL :
+				 PROFILER_STATE_CNT, &state))
+		return false;
+
+	*val = state.vals[idx];
+	return true;
+}
+
+/*
+ * Only the slots of the control element can be set, the counters element
+ * is written by BPF alone.
+ */
+bool profiler_state_set(struct bpf_tracer *t, struct profiler_context *ctx,
+			int idx, u64 val)
+{
+	profiler_state_t state;
+	bool ret;
+	if (!state_map_is_struct(t, ctx))
+		return bpf_table_set_value(t, ctx->state_map_name, idx, &val);
+
+	if (!state_slot_is_ctrl(idx)) {
+		errno = EINVAL;
+		return false;
+	}
+
+	pthread_mutex_lock(&state_ctrl_lock);
+	ret = bpf_table_get_value(t, ctx->state_map_name,
+				  PROFILER_STATE_CTRL, &state);
+	if (ret) {
+		state.vals[idx] = val;
+		ret = bpf_table_set_value(t, ctx->state_map_name,
+					  PROFILER_STATE_CTRL, &state);
+	}
+	pthread_mutex_unlock(&state_ctrl_lock);
+
+	return ret;
+}
+
+/*
+ * Make the buffer selected by 'transfer_count' active. Its sample count is
+ * recorded as the base with the same update, so that the count of this
+ * iteration is the sample count minus the base, without resetting it.
+ */
+bool profiler_state_transfer(struct bpf_tracer *t, struct profiler_context *ctx,
+			     u64 transfer_count)
+{
+	profiler_state_t state, cnt;
+	bool ret;
+	if (!state_map_is_struct(t, ctx))
+		return bpf_table_set_value(t, ctx->state_map_name,
+					   TRANSFER_CNT_IDX, &transfer_count);
+
+	pthread_mutex_lock(&state_ctrl_lock);
+	ret = bpf_table_get_value(t, ctx->state_map_name,
+				  PROFILER_STATE_CTRL, &state) &&
+	    bpf_table_get_value(t, ctx->state_map_name,
+				PROFILER_STATE_CNT, &cnt);
+	if (ret) {
+		if (transfer_count & 0x1ULL)
+			state.vals[SAMPLE_CNT_B_BASE_IDX] =
+			    cnt.vals[SAMPLE_CNT_B_IDX];
+		else
+			state.vals[SAMPLE_CNT_A_BASE_IDX] =
+			    cnt.vals[SAMPLE_CNT_A_IDX];
+		state.vals[TRANSFER_CNT_IDX] = transfer_count;
+		ret = bpf_table_set_value(t, ctx->state_map_name,
+					  PROFILER_STATE_CTRL, &state);
+	}
+	pthread_mutex_unlock(&state_ctrl_lock);
+
+	return ret;
+}
+
 void set_bpf_run_enabled(struct bpf_tracer *t, struct profiler_context *ctx,
 			 u64 enable_flag)
 {
 	if (ctx->profiler_stop == 1)
 		return;
 
-	if (bpf_table_set_value(t, ctx->state_map_name,
-				ENABLE_IDX, &enable_flag) == false) {
+	if (profiler_state_set(t, ctx, ENABLE_IDX, enable_flag) == false) {
 		ebpf_warning("%sprofiler state map update error."
 			     "(%s enable_flag %lu) - %s\n",
 			     ctx->tag, ctx->state_map_name, enable_flag,
@@ -166,8 +270,7 @@ void set_bpf_rt_kern(struct bpf_tracer *t, struct profiler_context *ctx)
 	if (ctx->profiler_stop == 1)
 		return;
 	u64 rt_flag = 1;
-	if (bpf_table_set_value(t, ctx->state_map_name,
-				RT_KERN, &rt_flag) == false) {
+	if (profiler_state_set(t, ctx, RT_KERN, rt_flag) == false) {
 		ebpf_warning("%sprofiler state map update error."
 			     "(%s rt_flag %lu) - %s\n",
 			     ctx->tag, ctx->state_map_name, rt_flag,
@@ -300,51 +403,36 @@ int java_libs_and_tools_install(void)
 static u32 delete_all_stackmap_elems(struct bpf_tracer *tracer,
 				     const char *stack_map_name)
 {
-	struct ebpf_map *map =
-	    ebpf_obj__get_map_by_name(tracer->obj, stack_map_name);
-	if (map == NULL) {
-		ebpf_warning("[%s] map(name:%s) is NULL.\n", __func__,
-			     stack_map_name);
-		return 0;
-	}
-	int map_fd = map->fd;
-
-	u32 key = 0, next_key;
-	u32 reclaim_count = 0;
-	u32 find_count = 0;
-	struct list_head clear_elem_head;
-	init_list_head(&clear_elem_head);
-
-	while (bpf_get_next_key(map_fd, &key, &next_key) == 0) {
-		find_count++;
-		insert_list(&next_key, sizeof(next_key), &clear_elem_head);
-		key = next_key;
-	}
-
-	if (find_count == 0)
+	struct bpf_table_reclaim_stats stats = {};
+	if (bpf_table_reclaim(tracer, stack_map_name, (u32) ~0, NULL, NULL,
+			      &stats))
 		return 0;
 
-	reclaim_count = __reclaim_map(map_fd, &clear_elem_head);
+	ebpf_debug("[%s] table %s find_count %u reclaim_count :%u"
+		   " (syscalls %u, batched %d, cost %lu us)\n",
+		   __func__, stack_map_name, stats.walked, stats.deleted,
+		   stats.syscalls, stats.batched, stats.wall_ns / 1000);
 
-	ebpf_debug("[%s] table %s find_count %u reclaim_count :%u\n",
-		   __func__, stack_map_name, find_count, reclaim_count);
-
-	return reclaim_count;
+	return stats.deleted;
 }
 
 #define CLEAN_STACK_MAP(stack_map)						           \
 do {											   \
 	int *sid;									   \
+	u32 clear_count = vec_len(stack_map->clear_ids);				   \
+	struct bpf_table_reclaim_stats stats = {};					   \
+	u32 deleted = 0;								   \
+	if (clear_count > 0)								   \
+		deleted = bpf_table_delete_keys(t, stack_map->name,			   \
+						stack_map->clear_ids,			   \
+						clear_count, &stats);			   \
+	/*										   \
+	 * It may be due to the disorder in the perf buffer transmission,		   \
+	 * leading to the repetitive deletion of the same stack ID.			   \
+	 */										   \
+	ctx->stackmap_clear_failed_count += clear_count - deleted;			   \
 	vec_foreach(sid, stack_map->clear_ids) {					   \
-		int id = *sid;								   \
-		if (!bpf_table_delete_key(t, stack_map->name, (u64) id)) {		   \
-			/*								   \
-			 * It may be due to the disorder in the perf buffer transmission,  \
-			 * leading to the repetitive deletion of the same stack ID.	   \
-			 */								   \
-			ctx->stackmap_clear_failed_count++;				   \
-		}									   \
-		clear_bitmap(stack_map->ids.bitmap, id);				   \
+		clear_bitmap(stack_map->ids.bitmap, *sid);				   \
 	}										   \
 	vec_free(stack_map->clear_ids);							   \
 	stack_map->ids.count = 0;							   \
@@ -647,6 +735,29 @@ static void set_memprof_msg_kvp(struct profiler_context *ctx,
 	kvp->msg_ptr = pointer_to_uword(msg_value);
 }
 
+/*
+ * The value a stack trace key adds to the count of its message (except
+ * for the memory profiler). Keys drained from the in-kernel aggregation
+ * maps stand for 'on_cpu.count' samples.
+ */
+static inline u64 stack_trace_count(struct profiler_context *ctx,
+				    struct stack_trace_key_t *v)
+{
+	u64 samples = 1;
+	if (ctx->type == PROFILER_TYPE_ONCPU && v->on_cpu.count > 0)
+		samples = v->on_cpu.count;
+
+	if (ctx->use_delta_time) {
+		// If sampling is used
+		if (ctx->sample_period > 0)
+			return samples * (ctx->sample_period / 1000);
+		// Using microseconds for storage.
+		return v->off_cpu.duration_ns / 1000;
+	}
+
+	return samples;
+}
+
 static void set_stack_trace_msg(struct profiler_context *ctx,
 				stack_trace_msg_t * msg,
 				struct stack_trace_key_t *v,
@@ -723,16 +834,8 @@ static void set_stack_trace_msg(struct profiler_context *ctx,
 	msg->time_stamp = gettime(CLOCK_REALTIME, TIME_TYPE_NAN);
 	if (ctx->type == PROFILER_TYPE_MEMORY) {
 		msg->count = v->memory.size;
-	} else if (ctx->use_delta_time) {
-		// If sampling is used
-		if (ctx->sample_period > 0) {
-			msg->count = ctx->sample_period / 1000;
-		} else {
-			// Using microseconds for storage.
-			msg->count = v->off_cpu.duration_ns / 1000;
-		}
 	} else {
-		msg->count = 1;
+		msg->count = stack_trace_count(ctx, v);
 	}
 	msg->data_ptr = pointer_to_uword(&msg->data[0]);
 
@@ -771,19 +874,8 @@ static inline void update_matched_process_in_total(struct profiler_context *ctx,
 	    (msg_hash, (stack_trace_msg_hash_kv *) & kv,
 	     (stack_trace_msg_hash_kv *) & kv) == 0) {
 		__sync_fetch_and_add(&msg_hash->hit_hash_count, 1);
-		if (ctx->use_delta_time) {
-			if (ctx->sample_period > 0) {
-				((stack_trace_msg_t *) kv.msg_ptr)->count +=
-				    (ctx->sample_period / 1000);
-			} else {
-				// Using microseconds for storage.
-				((stack_trace_msg_t *) kv.msg_ptr)->count +=
-				    (v->off_cpu.duration_ns / 1000);
-			}
-
-		} else {
-			((stack_trace_msg_t *) kv.msg_ptr)->count++;
-		}
+		((stack_trace_msg_t *) kv.msg_ptr)->count +=
+		    stack_trace_count(ctx, v);
 		return;
 	}
 
@@ -890,8 +982,14 @@ static void aggregate_stack_traces(struct profiler_context *ctx,
 			add_stack_id_to_bitmap(ctx, v->intpstack, custom_stack_map);
 		}
 
-		/* Total iteration count for this iteration. */
-		(*count)++;
+		/*
+		 * Total iteration count for this iteration, in samples
+		 * to be compared with the BPF sample count.
+		 */
+		if (ctx->type == PROFILER_TYPE_ONCPU && v->on_cpu.count > 0)
+			(*count) += v->on_cpu.count;
+		else
+			(*count)++;
 
 		/* Total iteration count for all iterations. */
 		ctx->process_count++;
@@ -1001,19 +1099,9 @@ static void aggregate_stack_traces(struct profiler_context *ctx,
 			if (ctx->type == PROFILER_TYPE_MEMORY) {
 				((stack_trace_msg_t *) kv.msg_ptr)->count +=
 				    v->memory.size;
-			} else if (ctx->use_delta_time) {
-				if (ctx->sample_period > 0) {
-					((stack_trace_msg_t *) kv.
-					 msg_ptr)->count +=
-					   (ctx->sample_period / 1000);
-				} else {
-					// Using microseconds for storage.
-					((stack_trace_msg_t *) kv.
-					 msg_ptr)->count +=
-					   (v->off_cpu.duration_ns / 1000);
-				}
 			} else {
-				((stack_trace_msg_t *) kv.msg_ptr)->count++;
+				((stack_trace_msg_t *) kv.msg_ptr)->count +=
+				    stack_trace_count(ctx, v);
 			}
 			if (__info_p)
 				AO_DEC(&__info_p->use);
@@ -1066,7 +1154,6 @@ static void aggregate_stack_traces(struct profiler_context *ctx,
 			int len = sizeof(stack_trace_msg_t) + str_len;
 			stack_trace_msg_t *msg = alloc_stack_trace_msg(len);
 			if (msg == NULL) {
-				clib_mem_free(trace_str);
 				if (__info_p)
 					AO_DEC(&__info_p->use);
 				if (class_name) {
@@ -1110,8 +1197,8 @@ static void aggregate_stack_traces(struct profiler_context *ctx,
 				}
 			}
 
+			/* 'trace_str' is in the stringifier arena, not freed here. */
 			msg->data_len = strlen((char *)msg->data);
-			clib_mem_free(trace_str);
 			kv.msg_ptr = pointer_to_uword(msg);
 
 			if (stack_trace_msg_hash_add_del(msg_hash,
@@ -1136,6 +1223,58 @@ static void aggregate_stack_traces(struct profiler_context *ctx,
 	vec_free(ctx->raw_stack_data);
 }
 
+static bool drain_stack_agg_elem(void *key, void *value, void *arg)
+{
+	struct profiler_context *ctx = arg;
+	struct stack_trace_agg_key_t *k = key;
+	struct stack_trace_agg_value_t *val = value;
+	struct stack_trace_key_t v;
+
+	memset(&v, 0, sizeof(v));
+	v.pid = k->pid;
+	v.tgid = k->tgid;
+	v.cpu = k->cpu;
+	memcpy(v.comm, k->comm, sizeof(v.comm));
+	v.kernstack = k->kernstack;
+	v.userstack = k->userstack;
+	v.intpstack = k->intpstack;
+	v.flags = k->flags;
+	v.timestamp = val->timestamp;
+	v.on_cpu.count = val->count;
+
+	int ret = VEC_OK;
+	vec_add1(ctx->raw_stack_data, v, ret);
+	if (ret != VEC_OK)
+		ebpf_warning("vec add failed\n");
+
+	ctx->agg_entry_count++;
+	ctx->agg_sample_count += val->count;
+
+	/*
+	 * Always delete, the stack IDs of the element are no longer
+	 * valid once the stack map has been cleaned up.
+	 */
+	return true;
+}
+
+/*
+ * Move the samples counted in the aggregation map of this iteration to
+ * 'raw_stack_data', as if they had been read from the perf buffer.
+ */
+static void drain_stack_agg_map(struct profiler_context *ctx,
+				struct bpf_tracer *t, const char *name)
+{
+	struct bpf_table_reclaim_stats stats = {};
+	if (bpf_table_reclaim(t, name, (u32) ~0, drain_stack_agg_elem, ctx,
+			      &stats))
+		return;
+
+	ctx->agg_drain_syscalls += stats.syscalls;
+	ebpf_debug("%s%s table %s drained %u (syscalls %u, batched %d,"
+		   " cost %lu us)\n", ctx->tag, __func__, name, stats.deleted,
+		   stats.syscalls, stats.batched, stats.wall_ns / 1000);
+}
+
 void process_bpf_stacktraces(struct profiler_context *ctx, struct bpf_tracer *t)
 {
 	struct bpf_perf_reader *r;
@@ -1145,14 +1284,22 @@ void process_bpf_stacktraces(struct profiler_context *ctx, struct bpf_tracer *t)
 	stack_map_t *custom_stack_map = using_map_set_a ? &ctx->custom_stack_map_a : &ctx->custom_stack_map_b;
 	const u64 sample_count_idx =
 	    using_map_set_a ? SAMPLE_CNT_A_IDX : SAMPLE_CNT_B_IDX;
+	const u64 sample_base_idx =
+	    using_map_set_a ? SAMPLE_CNT_A_BASE_IDX : SAMPLE_CNT_B_BASE_IDX;
+	bool state_is_struct = state_map_is_struct(t, ctx);
+	const char *agg_map_name =
+	    using_map_set_a ? ctx->stack_agg_map_a : ctx->stack_agg_map_b;
+	/* With aggregation, samples may be waiting in the map only. */
+	int agg_drains = ctx->sample_aggregation ? 2 : 0;
 
 	struct epoll_event events[r->readers_count];
 	int nfds = reader_epoll_wait(r, events, 0);
 
+	/* The CPU time spent consuming the data, the wait excluded. */
+	u64 cpu_start = gettime(CLOCK_THREAD_CPUTIME_ID, TIME_TYPE_NAN);
+
 	ctx->transfer_count++;
-	if (bpf_table_set_value(t, ctx->state_map_name,
-				TRANSFER_CNT_IDX,
-				&ctx->transfer_count) == false) {
+	if (profiler_state_transfer(t, ctx, ctx->transfer_count) == false) {
 		ebpf_warning("%sprofiler state map update error."
 			     "(%s transfer_count %lu) - %s\n",
 			     ctx->tag, ctx->state_map_name, ctx->transfer_count,
@@ -1166,6 +1313,15 @@ void process_bpf_stacktraces(struct profiler_context *ctx, struct bpf_tracer *t)
 	/* eBPF map record count for this iteration. */
 	u64 sample_cnt_val = 0;
 
+	/*
+	 * The sample count of the buffer when it became active, set by
+	 * profiler_state_transfer() in the previous iteration.
+	 */
+	u64 sample_cnt_base = 0;
+	if (state_is_struct &&
+	    !profiler_state_get(t, ctx, sample_base_idx, &sample_cnt_base))
+		sample_cnt_base = 0;
+
 	/*
 	 * Why use g_stack_str_hash?
 	 *
@@ -1209,7 +1365,7 @@ void process_bpf_stacktraces(struct profiler_context *ctx, struct bpf_tracer *t)
 		}
 	}
 
-	if (nfds > 0) {
+	if (nfds > 0 || agg_drains > 0) {
 
 	      check_again:
 		if (unlikely(ctx->profiler_stop == 1))
@@ -1219,7 +1375,13 @@ void process_bpf_stacktraces(struct profiler_context *ctx, struct bpf_tracer *t)
 		 * If there is data, the reader's callback
 		 * function will be called.
 		 */
-		reader_event_read(events, nfds);
+		if (nfds > 0)
+			reader_event_read(events, nfds);
+
+		if (agg_drains > 0) {
+			drain_stack_agg_map(ctx, t, agg_map_name);
+			agg_drains--;
+		}
 
 		/*
 		 * After the reader completes data reading, the work of
@@ -1238,12 +1400,11 @@ void process_bpf_stacktraces(struct profiler_context *ctx, struct bpf_tracer *t)
 		 * corresponding stackmap records in the next iteration, leading
 		 * to incomplete processing.
 		 */
-		if (bpf_table_get_value(t, ctx->state_map_name,
-					sample_count_idx,
-					(void *)&sample_cnt_val)) {
-			if (sample_cnt_val > count) {
+		if (profiler_state_get(t, ctx, sample_count_idx,
+				       &sample_cnt_val)) {
+			if (sample_cnt_val - sample_cnt_base > count) {
 				nfds = reader_epoll_short_wait(r, events, 0);
-				if (nfds > 0)
+				if (nfds > 0 || agg_drains > 0)
 					goto check_again;
 			}
 		}
@@ -1253,10 +1414,12 @@ release_iter:
 
 	cleanup_stackmap(ctx, t, stack_map, custom_stack_map, using_map_set_a);
 
-	/* Now that we've consumed the data, reset the sample count in BPF. */
-	sample_cnt_val = 0;
-	bpf_table_set_value(t, ctx->state_map_name,
-			    sample_count_idx, &sample_cnt_val);
+	/*
+	 * Now that we've consumed the data, reset the sample count in BPF.
+	 * The counts in the counters element are cumulative instead.
+	 */
+	if (!state_is_struct)
+		profiler_state_set(t, ctx, sample_count_idx, 0);
 
 	//print_profiler_status(ctx, t, count);
 
@@ -1265,6 +1428,9 @@ release_iter:
 
 	/* Push messages and free stack_trace_msg_hash */
 	push_and_release_stack_trace_msg(ctx, &ctx->msg_hash, false);
+
+	ctx->consumer_cpu_ns +=
+	    gettime(CLOCK_THREAD_CPUTIME_ID, TIME_TYPE_NAN) - cpu_start;
 }
 
 bool profiler_is_running(void)
@@ -47,6 +47,14 @@ struct profiler_context {
 	stack_map_t custom_stack_map_a;
 	stack_map_t custom_stack_map_b;
 
+	/*
+	 * If set, BPF counts the samples in the aggregation maps (one per
+	 * buffer) instead of outputting each one to the perf buffer.
+	 */
+	bool sample_aggregation;
+	char stack_agg_map_a[MAP_NAME_SZ];
+	char stack_agg_map_b[MAP_NAME_SZ];
+
 	// Read raw data from the eBPF perfbuf and temporarily store it.
 	struct stack_trace_key_t *raw_stack_data;
 
@@ -121,6 +129,13 @@ struct profiler_context {
 	u64 stack_trace_err;
 	// Quantity statistics of data pushed.
 	u64 push_count;
+	// Samples and elements drained from the aggregation maps.
+	u64 agg_sample_count;
+	u64 agg_entry_count;
+	// bpf() syscalls issued to drain the aggregation maps.
+	u64 agg_drain_syscalls;
+	// Reader thread CPU time spent in process_bpf_stacktraces() (ns).
+	u64 consumer_cpu_ns;
 
 	/*
 	 * Record the time of the last data push
@@ -153,4 +168,10 @@ void push_and_release_stack_trace_msg(struct profiler_context *ctx,
 // Check if the profiler is currently running.
 bool profiler_is_running(void);
 void set_bpf_rt_kern(struct bpf_tracer *t, struct profiler_context *ctx);
+bool profiler_state_get(struct bpf_tracer *t, struct profiler_context *ctx,
+			int idx, u64 * val);
+bool profiler_state_set(struct bpf_tracer *t, struct profiler_context *ctx,
+			int idx, u64 val);
+bool profiler_state_transfer(struct bpf_tracer *t, struct profiler_context *ctx,
+			     u64 transfer_count);
 #endif /*DF_USER_PROFILE_COMMON_H */
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "../config.h"
+#include "../types.h"
+#include "../log.h"
+#include "../mem.h"
+#include "stack_str_cache.h"
+
+struct stack_str_entry {
+	struct list_head list;	// LRU list
+	stack_str_cache_key_t key;
+	u32 size;		// allocated size
+	char str[0];
+};
+
+void stack_str_cache_init(stack_str_cache_t * c, u64 mem_max)
+{
+	memset(c, 0, sizeof(*c));
+	init_list_head(&c->lru);
+	c->mem_max = mem_max;
+}
+
+static inline void stack_str_entry_free(stack_str_cache_t * c,
+					struct stack_str_entry *e)
+{
+	list_head_del(&e->list);
+	c->stats.bytes -= e->size;
+	c->stats.elems--;
+	clib_mem_free(e);
+}
+
+void stack_str_cache_release(stack_str_cache_t * c)
+{
+	struct stack_str_entry *e, *n;
+	list_for_each_entry_safe(e, n, &c->lru, list) {
+		stack_str_entry_free(c, e);
+	}
+
+	if (c->hash.buckets != NULL)
+		clib_bihash_free_16_8(&c->hash);
+}
+
+/*
+ * Two independent 64-bit lanes of xxhash rounds. With 128 bits, a
+ * collision between two stacks is not a practical concern, the key is
+ * not compared against the addresses.
+ */
+void stack_str_cache_key(stack_str_cache_key_t * k, const u64 * ips, int n,
+			 pid_t pid, u64 stime, u32 gen, u32 flags)
+{
+	u64 seed = ((u64) pid << 32) ^ ((u64) gen << 8) ^ flags;
+	u64 a = seed + PRIME64_1 + PRIME64_2;
+	u64 b = (stime ^ seed) + PRIME64_5;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		a ^= XXH_rotl64(ips[i] * PRIME64_2, 31) * PRIME64_1;
+		a = XXH_rotl64(a, 27) * PRIME64_1 + PRIME64_4;
+		b += ips[i] * PRIME64_3;
+		b = XXH_rotl64(b, 31) * PRIME64_2 ^ a;
+	}
+
+	k->hash[0] = xxhash(a ^ n);
+	k->hash[1] = xxhash(b ^ stime);
+}
+
+const char *stack_str_cache_lookup(stack_str_cache_t * c,
+				   stack_str_cache_key_t * k)
+{
+	c->stats.lookups++;
+	if (c->hash.buckets == NULL)
+		return NULL;
+
+	clib_bihash_kv_16_8_t kv;
+	kv.key[0] = k->hash[0];
+	kv.key[1] = k->hash[1];
+	kv.value = 0;
+	if (clib_bihash_search_16_8(&c->hash, &kv, &kv) != 0)
+		return NULL;
+
+	struct stack_str_entry *e = (struct stack_str_entry *)kv.value;
+	list_head_del(&e->list);
+	list_add_tail(&e->list, &c->lru);
+	c->stats.hits++;
+
+	return e->str;
+}
+
+const char *stack_str_cache_add(stack_str_cache_t * c,
+				stack_str_cache_key_t * k, const char *str)
+{
+	if (c->hash.buckets == NULL &&
+	    clib_bihash_init_16_8(&c->hash, "stack_str_cache",
+				  STRINGIFIER_STACK_CACHE_BUCKETS_NUM,
+				  STRINGIFIER_STACK_CACHE_HASH_MEM_SZ))
+		return NULL;
+
+	int len = strlen(str);
+	u32 size = sizeof(struct stack_str_entry) + len + 1;
+	struct stack_str_entry *e =
+	    clib_mem_alloc_aligned("stack_str_cache", size, 0, NULL);
+	if (e == NULL)
+		return NULL;
+
+	e->key = *k;
+	e->size = size;
+	memcpy(e->str, str, len + 1);
+
+	clib_bihash_kv_16_8_t kv;
+	kv.key[0] = k->hash[0];
+	kv.key[1] = k->hash[1];
+	kv.value = pointer_to_uword(e);
+	/* Do not overwrite, a string may already be in use for the key. */
+	if (clib_bihash_add_del_16_8(&c->hash, &kv, 2 /* is_add */ )) {
+		clib_mem_free(e);
+		return NULL;
+	}
+
+	list_add_tail(&e->list, &c->lru);
+	c->stats.adds++;
+	c->stats.elems++;
+	c->stats.bytes += size;
+
+	return e->str;
+}
+
+u32 stack_str_cache_trim(stack_str_cache_t * c)
+{
+	struct stack_str_entry *e;
+	clib_bihash_kv_16_8_t kv;
+	u32 count = 0;
+
+	while (c->stats.bytes > c->mem_max && !list_empty(&c->lru)) {
+		e = list_first_entry(&c->lru, struct stack_str_entry, list);
+		kv.key[0] = e->key.hash[0];
+		kv.key[1] = e->key.hash[1];
+		clib_bihash_add_del_16_8(&c->hash, &kv, 0 /* delete */ );
+		stack_str_entry_free(c, e);
+		count++;
+	}
+
+	c->stats.evictions += count;
+	return count;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2024 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DF_USER_STACK_STR_CACHE_H
+#define DF_USER_STACK_STR_CACHE_H
+
+#include <sys/types.h>
+#include "../types.h"
+#include "../list.h"
+#include "../bihash_16_8.h"
+
+/*
+ * Content addressed cache of folded stack trace strings.
+ *
+ * BPF stack IDs are only valid for one profiler iteration, but the address
+ * vectors of hot stacks repeat in every iteration. The strings are kept
+ * across iterations, keyed by a 128-bit hash of the addresses and of the
+ * generation of the process address space (pid, start time and symbol
+ * cache generation), so an unchanged stack costs one hash lookup instead
+ * of being symbolized and folded again. Once the strings take more memory
+ * than the cap, the least recently used ones are evicted.
+ */
+
+typedef struct {
+	u64 hash[2];
+} stack_str_cache_key_t;
+
+struct stack_str_cache_stats {
+	u64 lookups;
+	u64 hits;
+	u64 adds;
+	u64 evictions;
+	u64 elems;
+	u64 bytes;		/**< Memory taken by the cached strings */
+};
+
+typedef struct stack_str_cache {
+	clib_bihash_16_8_t hash;	/**< key -> struct stack_str_entry */
+	struct list_head lru;	/**< Least recently used first */
+	u64 mem_max;
+	struct stack_str_cache_stats stats;
+} stack_str_cache_t;
+
+/**
+ * @brief Initialize an empty cache, the hash is created on first add.
+ *
+ * @param mem_max Memory cap (in bytes) of the cached strings.
+ */
+void stack_str_cache_init(stack_str_cache_t * c, u64 mem_max);
+
+/**
+ * @brief Free all the cached strings and the hash.
+ */
+void stack_str_cache_release(stack_str_cache_t * c);
+
+/**
+ * @brief Compute the key of a stack.
+ *
+ * @param ips Stack addresses, 'n' entries.
+ * @param pid Process ID, 0 for kernel stacks.
+ * @param stime Process start time.
+ * @param gen Generation of the process symbol cache.
+ * @param flags Options changing the string built from the addresses.
+ */
+void stack_str_cache_key(stack_str_cache_key_t * k, const u64 * ips, int n,
+			 pid_t pid, u64 stime, u32 gen, u32 flags);
+
+/**
+ * @brief Look a stack up, a hit makes it the most recently used.
+ *
+ * @return The cached string or NULL. The string stays valid until the
+ *         next stack_str_cache_trim() or stack_str_cache_release().
+ */
+const char *stack_str_cache_lookup(stack_str_cache_t * c,
+				   stack_str_cache_key_t * k);
+
+/**
+ * @brief Add a copy of 'str' for the stack.
+ *
+ * Nothing is evicted here, the cache may exceed its cap until the next
+ * stack_str_cache_trim().
+ *
+ * @return The cached copy, or NULL on failure.
+ */
+const char *stack_str_cache_add(stack_str_cache_t * c,
+				stack_str_cache_key_t * k, const char *str);
+
+/**
+ * @brief Evict the least recently used strings until the cap is met.
+ *
+ * Call it when none of the strings returned so far is in use anymore,
+ * e.g. at the end of a profiler iteration.
+ *
+ * @return The number of strings evicted.
+ */
+u32 stack_str_cache_trim(stack_str_cache_t * c);
+
+#endif /* DF_USER_STACK_STR_CACHE_H */
@@ -38,6 +38,9 @@
  * destructive read approach (it reads a stack trace from the table and then clears it).
  * Due to the reuse of stack trace identifiers and destructive reads, the Stringifier
  * caches the result of its stringification. In each iteration of a continuous perf profiler.
+ *
+ * Across iterations, the strings are also cached by the content of the stacks
+ * (see stack_str_cache.h), so hot stacks are not symbolized again.
  */
 
 #ifndef AARCH64_MUSL
@@ -57,6 +60,8 @@
 #include "../bihash_8_8.h"
 #include "../bihash_16_8.h"
 #include "java/collect_symbol_files.h"
+#include "java/config.h"
+#include "java/jit_symbol_table.h"
 #include "stringifier.h"
 #include <bcc/bcc_syms.h>
 #include "../proc.h"
@@ -101,17 +106,308 @@ int init_stack_str_hash(stack_str_hash_t * h, const char *name)
 		return ETR_NOMEM;
 
 	struct stack_str_hash_ext_data *ext = h->private;
+	memset(ext, 0, sizeof(*ext));
 	ext->stack_str_kvps = NULL;
 	ext->clear_hash = false;
+	ext->symbol_snapshot = NULL;
+	ext->frame_strs = NULL;
+	/*
+	 * The folded stack trace strings and the stack strings only live
+	 * for one iteration, they are reset in clean_stack_strs().
+	 */
+	clib_mem_arena_init(&ext->folded_arena, "folded_str",
+			    STRINGIFIER_ARENA_CHUNK_SZ);
+	clib_mem_arena_init(&ext->stack_arena, "stack_str",
+			    STRINGIFIER_ARENA_CHUNK_SZ);
+	stack_str_cache_init(&ext->stack_cache,
+			     STRINGIFIER_STACK_CACHE_MEM_MAX);
 
 	return stack_str_hash_init(h, (char *)name, nbuckets, hash_memory_size);
 }
 
+/*
+ * The custom stack of interpreters (e.g. Python) stores a symbol id for
+ * each frame, the symbols are kept in the BPF LRU map '__symbol_table'
+ * (symbol -> symbol id). The table is copied once per iteration and
+ * indexed by symbol id, instead of walking the map for every stack.
+ */
+struct symbol_table_snapshot {
+	bool loaded;
+	/* Reloaded once in this iteration for a symbol added after loading. */
+	bool reloaded;
+	int n_symbols;
+	symbol_t symbols[MAX_SYMBOL_NUM];
+	u32 symbol_ids[MAX_SYMBOL_NUM];
+	/* symbol id -> index of symbols[] */
+	clib_bihash_8_8_t index;
+};
+
+static void release_symbol_snapshot(struct symbol_table_snapshot *s)
+{
+	clib_bihash_free_8_8(&s->index);
+	clib_mem_free(s);
+}
+
+static void reset_symbol_snapshot(struct symbol_table_snapshot *s)
+{
+	clib_bihash_kv_8_8_t kv;
+
+	if (!s->loaded)
+		return;
+
+	for (int i = 0; i < s->n_symbols; i++) {
+		kv.key = (u64) s->symbol_ids[i];
+		kv.value = 0;
+		clib_bihash_add_del_8_8(&s->index, &kv, 0 /* delete */ );
+	}
+
+	s->n_symbols = 0;
+	s->loaded = false;
+}
+
+static void reset_symbol_snapshot_iter(struct symbol_table_snapshot *s)
+{
+	reset_symbol_snapshot(s);
+	s->reloaded = false;
+}
+
+static int load_symbol_table_batch(int map_fd, struct symbol_table_snapshot *s)
+{
+	u32 in_batch = 0, out_batch = 0, count;
+	bool first = true;
+	int ret;
+
+	do {
+		count = MAX_SYMBOL_NUM - s->n_symbols;
+		if (count == 0)
+			break;
+
+		ret = bpf_lookup_batch(map_fd, first ? NULL : &in_batch,
+				       &out_batch, &s->symbols[s->n_symbols],
+				       &s->symbol_ids[s->n_symbols], &count);
+		if (ret != 0 && errno != ENOENT)
+			return ret;
+
+		s->n_symbols += count;
+		in_batch = out_batch;
+		first = false;
+	} while (ret == 0);
+
+	return 0;
+}
+
+static void load_symbol_table_iter(int map_fd, struct symbol_table_snapshot *s)
+{
+	symbol_t key = {};
+
+	while (s->n_symbols < MAX_SYMBOL_NUM &&
+	       bpf_get_next_key(map_fd, &key, &s->symbols[s->n_symbols]) == 0) {
+		key = s->symbols[s->n_symbols];
+		if (bpf_lookup_elem(map_fd, &key,
+				    &s->symbol_ids[s->n_symbols]) == 0)
+			s->n_symbols++;
+	}
+}
+
+static struct symbol_table_snapshot *get_symbol_snapshot(struct bpf_tracer *t,
+							 stack_str_hash_t * h)
+{
+	struct stack_str_hash_ext_data *ext = h->private;
+	struct symbol_table_snapshot *s = ext->symbol_snapshot;
+
+	if (s == NULL) {
+		s = clib_mem_alloc_aligned("symbol_snapshot", sizeof(*s), 0,
+					   NULL);
+		if (s == NULL)
+			return NULL;
+		memset(s, 0, sizeof(*s));
+		if (clib_bihash_init_8_8(&s->index, "symbol_snapshot",
+					 STRINGIFIER_SYMBOL_ID_HASH_BUCKETS_NUM,
+					 STRINGIFIER_SYMBOL_ID_HASH_MEM_SZ)) {
+			clib_mem_free(s);
+			return NULL;
+		}
+		ext->symbol_snapshot = s;
+	}
+
+	if (s->loaded)
+		return s;
+
+	struct ebpf_map *map =
+	    ebpf_obj__get_map_by_name(t->obj, MAP_SYMBOL_TABLE_NAME);
+	if (map == NULL) {
+		ebpf_warning("bpf table %s not found", MAP_SYMBOL_TABLE_NAME);
+		return NULL;
+	}
+
+	/* Batch lookup requires Linux 5.6+, fall back to iteration. */
+	if (load_symbol_table_batch(map->fd, s) != 0) {
+		s->n_symbols = 0;
+		load_symbol_table_iter(map->fd, s);
+	}
+
+	clib_bihash_kv_8_8_t kv;
+	for (int i = 0; i < s->n_symbols; i++) {
+		kv.key = (u64) s->symbol_ids[i];
+		kv.value = (u64) i;
+		clib_bihash_add_del_8_8(&s->index, &kv, 1 /* is_add */ );
+	}
+
+	s->loaded = true;
+	return s;
+}
+
+static symbol_t *lookup_symbol_snapshot(struct bpf_tracer *t,
+					stack_str_hash_t * h, u32 symbol_id)
+{
+	struct symbol_table_snapshot *s = get_symbol_snapshot(t, h);
+	if (s == NULL)
+		return NULL;
+
+	clib_bihash_kv_8_8_t kv;
+	kv.key = (u64) symbol_id;
+	kv.value = 0;
+	if (clib_bihash_search_8_8(&s->index, &kv, &kv) == 0)
+		return &s->symbols[kv.value];
+
+	/*
+	 * The symbol may be added after the snapshot was taken, reload
+	 * at most once per iteration. Otherwise, it has been expelled
+	 * from LRU.
+	 */
+	if (s->reloaded)
+		return NULL;
+
+	reset_symbol_snapshot(s);
+	s->reloaded = true;
+	s = get_symbol_snapshot(t, h);
+	if (s == NULL)
+		return NULL;
+
+	if (clib_bihash_search_8_8(&s->index, &kv, &kv) == 0)
+		return &s->symbols[kv.value];
+
+	return NULL;
+}
+
+static int init_frame_cache(struct stack_str_hash_ext_data *ext)
+{
+	if (clib_bihash_init_16_8(&ext->frame_hash, "stringifier_frame",
+				  STRINGIFIER_FRAME_HASH_BUCKETS_NUM,
+				  STRINGIFIER_FRAME_HASH_MEM_SZ))
+		return ETR_NOMEM;
+
+	if (clib_bihash_init_8_8(&ext->frame_str_index, "stringifier_frame_str",
+				 STRINGIFIER_FRAME_HASH_BUCKETS_NUM,
+				 STRINGIFIER_FRAME_HASH_MEM_SZ)) {
+		clib_bihash_free_16_8(&ext->frame_hash);
+		return ETR_NOMEM;
+	}
+
+	return ETR_OK;
+}
+
+static void release_frame_cache(struct stack_str_hash_ext_data *ext)
+{
+	char **s;
+	vec_foreach(s, ext->frame_strs) {
+		clib_mem_free(*s);
+	}
+	vec_free(ext->frame_strs);
+	ext->frame_strs = NULL;
+
+	if (ext->frame_hash.buckets != NULL)
+		clib_bihash_free_16_8(&ext->frame_hash);
+	if (ext->frame_str_index.buckets != NULL)
+		clib_bihash_free_8_8(&ext->frame_str_index);
+}
+
+/*
+ * Frames are keyed by the generation of the process symbol cache, so
+ * the entries of an exec'd/exited process or of a refreshed Java symbol
+ * file are never hit again. They are dropped along with everything else
+ * once the cache grows beyond STRINGIFIER_FRAME_CACHE_MAX.
+ */
+static inline void frame_cache_key(clib_bihash_kv_16_8_t * kv, pid_t pid,
+				   u32 gen, u64 address)
+{
+	kv->key[0] = address;
+	kv->key[1] = ((u64) pid << 32) | gen;
+	kv->value = 0;
+}
+
+static char *frame_cache_lookup(struct stack_str_hash_ext_data *ext,
+				pid_t pid, u32 gen, u64 address)
+{
+	if (ext->frame_hash.buckets == NULL)
+		return NULL;
+
+	clib_bihash_kv_16_8_t kv;
+	frame_cache_key(&kv, pid, gen, address);
+	if (clib_bihash_search_16_8(&ext->frame_hash, &kv, &kv) == 0)
+		return ext->frame_strs[kv.value];
+
+	return NULL;
+}
+
+/*
+ * Intern the frame string 'str' and memoize it for the address. On
+ * success the ownership of 'str' is taken over and the interned string
+ * is returned, otherwise NULL is returned and 'str' is left untouched.
+ */
+static char *frame_cache_add(struct stack_str_hash_ext_data *ext,
+			     pid_t pid, u32 gen, u64 address, char *str)
+{
+	int ret = VEC_OK;
+	if (ext->frame_hash.buckets == NULL && init_frame_cache(ext) != ETR_OK)
+		return NULL;
+
+	u64 id;
+	clib_bihash_kv_8_8_t skv;
+	skv.key = (u64) djb2_32bit(str);
+	skv.value = 0;
+	if (clib_bihash_search_8_8(&ext->frame_str_index, &skv, &skv) == 0 &&
+	    strcmp(ext->frame_strs[skv.value], str) == 0) {
+		id = skv.value;
+	} else {
+		id = vec_len(ext->frame_strs);
+		vec_add1(ext->frame_strs, str, ret);
+		if (ret != VEC_OK)
+			return NULL;
+		/* On hash collision, the string is kept but not indexed. */
+		skv.key = (u64) djb2_32bit(str);
+		skv.value = id;
+		clib_bihash_add_del_8_8(&ext->frame_str_index, &skv,
+					2 /* is_add = 2, Add but do not overwrite */ );
+	}
+
+	/*
+	 * If memoizing fails, the interned string is still valid until
+	 * the cache is flushed, so it can be returned anyway.
+	 */
+	clib_bihash_kv_16_8_t kv;
+	frame_cache_key(&kv, pid, gen, address);
+	kv.value = id;
+	if (clib_bihash_add_del_16_8(&ext->frame_hash, &kv, 1 /* is_add */ ) == 0)
+		ext->frame_hash.hash_elems_count++;
+
+	if (ext->frame_strs[id] != str)
+		clib_mem_free(str);
+
+	return ext->frame_strs[id];
+}
+
 void release_stack_str_hash(stack_str_hash_t * h)
 {
 	if (h->private) {
 		struct stack_str_hash_ext_data *ext = h->private;
 		vec_free(ext->stack_str_kvps);
+		if (ext->symbol_snapshot)
+			release_symbol_snapshot(ext->symbol_snapshot);
+		release_frame_cache(ext);
+		stack_str_cache_release(&ext->stack_cache);
+		clib_mem_arena_release(&ext->folded_arena);
+		clib_mem_arena_release(&ext->stack_arena);
 		clib_mem_free(ext);
 	}
 
@@ -129,9 +425,7 @@ void clean_stack_strs(stack_str_hash_t * h)
 	stack_str_hash_kv *v;
 	struct stack_str_hash_ext_data *ext = h->private;
 	vec_foreach(v, ext->stack_str_kvps) {
-		if (v->value != 0)
-			clib_mem_free((void *)v->value);
-
+		/* The strings are in the arena, released by the reset below. */
 		if (stack_str_hash_add_del(h, v, 0 /* delete */ )) {
 			ebpf_warning("stack_str_hash_add_del() failed.\n");
 			ext->clear_hash = true;
@@ -142,6 +436,24 @@ void clean_stack_strs(stack_str_hash_t * h)
 
 	vec_free(ext->stack_str_kvps);
 
+	if (ext->symbol_snapshot)
+		reset_symbol_snapshot_iter(ext->symbol_snapshot);
+
+	clib_mem_arena_reset(&ext->folded_arena);
+	clib_mem_arena_reset(&ext->stack_arena);
+
+	/* No string of the stack cache is referenced anymore. */
+	u32 evicted = stack_str_cache_trim(&ext->stack_cache);
+	if (evicted > 0)
+		ebpf_debug("stringifier stack cache evict %u elems.\n",
+			   evicted);
+
+	if (ext->frame_hash.hash_elems_count > STRINGIFIER_FRAME_CACHE_MAX) {
+		ebpf_debug("stringifier frame cache flush %lu elems.\n",
+			   ext->frame_hash.hash_elems_count);
+		release_frame_cache(ext);
+	}
+
 	h->hit_hash_count = 0;
 	h->hash_elems_count = 0;
 
@@ -152,6 +464,18 @@ void clean_stack_strs(stack_str_hash_t * h)
 	ebpf_debug("clean_stack_strs hashmap clear %lu elems.\n", elems_count);
 }
 
+void get_stack_str_cache_stats(stack_str_hash_t * h,
+			       struct stack_str_cache_stats *stats)
+{
+	struct stack_str_hash_ext_data *ext = h->private;
+	if (ext == NULL) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	*stats = ext->stack_cache.stats;
+}
+
 static inline char *create_symbol_str(int len, char *src, const char *tag)
 {
 	char *dst = clib_mem_alloc_aligned("symbol_str", len + 1, 0, NULL);
@@ -321,6 +645,25 @@ static inline int symcache_resolve(pid_t pid, void *resolver, u64 address,
 			if (p->is_exit
 			    || ((u64) resolver != (u64) p->syms_cache))
 				return (-1);
+			/*
+			 * JIT compiled Java methods are resolved from the
+			 * in-memory table kept by the symbol collector.
+			 */
+			if (p->is_java) {
+				char jit_sym[STRING_BUFFER_SIZE];
+				if (java_jit_symbol_lookup(pid, address, jit_sym,
+							   sizeof(jit_sym)) == 0) {
+					*sym_ptr = rewrite_java_symbol(jit_sym);
+					if (*sym_ptr == NULL)
+						*sym_ptr =
+						    create_symbol_str(strlen
+								      (jit_sym),
+								      jit_sym,
+								      u_sym_prefix);
+					if (*sym_ptr != NULL)
+						return 0;
+				}
+			}
 			pthread_mutex_lock(&p->mutex);
 			ret = bcc_symcache_resolve(resolver, address, sym);
 			if (ret == 0) {
@@ -368,7 +711,8 @@ static inline int symcache_resolve(pid_t pid, void *resolver, u64 address,
 }
 
 static char *resolve_addr(struct bpf_tracer *t, pid_t pid, bool is_start_idx,
-			  u64 address, bool is_create, void *info_p)
+			  u64 address, bool is_create, void *info_p,
+			  bool *resolved)
 {
 	ASSERT(pid >= 0);
 
@@ -383,6 +727,8 @@ static char *resolve_addr(struct bpf_tracer *t, pid_t pid, bool is_start_idx,
 
 	int ret = symcache_resolve(pid, resolver, address, &sym, info_p, &ptr);
 	if (ret == 0 && ptr) {
+		if (resolved)
+			*resolved = true;
 		char *p = ptr;
 		/*
 		 * If the parsed string contains a semicolon (';'), replace
@@ -421,7 +767,47 @@ finish:
 	return ptr;
 }
 
-static char *resolve_custom_symbol_addr(symbol_t *symbols, u32 *symbol_ids, int n_symbols, bool is_start_idx, u64 address)
+/*
+ * Hot stacks repeat the same addresses in every iteration, so the
+ * successfully symbolized frames are memoized and interned, a hit needs
+ * neither the process symbolizer lock nor any allocation. '*owned' tells
+ * whether the returned string must be freed by the caller.
+ */
+static char *resolve_frame(struct bpf_tracer *t, stack_str_hash_t * h,
+			   pid_t pid, bool is_start_idx, u64 address,
+			   bool is_create, void *info_p, bool *owned)
+{
+	struct stack_str_hash_ext_data *ext = h->private;
+	struct symbolizer_proc_info *p = info_p;
+	bool cacheable = (pid == 0 || (p != NULL && !AO_GET(&p->is_exit)));
+	u32 gen = (pid == 0 || p == NULL) ? 0 : AO_GET(&p->syms_gen);
+	bool resolved = false;
+	char *str;
+
+	*owned = false;
+	if (cacheable) {
+		str = frame_cache_lookup(ext, pid, gen, address);
+		if (str)
+			return str;
+	}
+
+	str = resolve_addr(t, pid, is_start_idx, address, is_create, info_p,
+			   &resolved);
+	if (str == NULL)
+		return NULL;
+
+	if (cacheable && resolved) {
+		char *interned = frame_cache_add(ext, pid, gen, address, str);
+		if (interned)
+			return interned;
+	}
+
+	*owned = true;
+	return str;
+}
+
+static char *resolve_custom_symbol_addr(struct bpf_tracer *t, stack_str_hash_t * h,
+					bool is_start_idx, u64 address)
 {
 	int len = 0;
 	char *ptr = NULL;
@@ -429,15 +815,14 @@ static char *resolve_custom_symbol_addr(symbol_t *symbols, u32 *symbol_ids, int
 	memset(format_str, 0, sizeof(format_str));
 
 	u32 symbol_id = address & 0xFFFFFFFF;
-	for (int i = 0; i < n_symbols; i++) {
-		if (symbol_ids[i] == symbol_id) {
-			if (strlen(symbols[i].class_name) > 0) {
-				snprintf(format_str, sizeof(format_str), "%s::%s", symbols[i].class_name, symbols[i].method_name);
-			} else {
-				snprintf(format_str, sizeof(format_str), "%s", symbols[i].method_name);
-			}
-			goto finish;
+	symbol_t *sym = lookup_symbol_snapshot(t, h, symbol_id);
+	if (sym) {
+		if (strlen(sym->class_name) > 0) {
+			snprintf(format_str, sizeof(format_str), "%s::%s", sym->class_name, sym->method_name);
+		} else {
+			snprintf(format_str, sizeof(format_str), "%s", sym->method_name);
 		}
+		goto finish;
 	}
 
 	/*
@@ -494,27 +879,6 @@ static char *build_stack_trace_string(struct bpf_tracer *t,
 	u64 ips[PERF_MAX_STACK_DEPTH];
 	memset(ips, 0, sizeof(ips));
 
-	symbol_t symbols[MAX_SYMBOL_NUM];
-	memset(symbols, 0, sizeof(symbols));
-	u32 symbol_ids[MAX_SYMBOL_NUM];
-	memset(symbol_ids, 0, sizeof(symbol_ids));
-	int n_symbols = 0;
-
-	if (use_symbol_table) {
-		struct ebpf_map *map = ebpf_obj__get_map_by_name(t->obj, MAP_SYMBOL_TABLE_NAME);
-		if (map == NULL) {
-			ebpf_warning("bpf table %s not found", MAP_SYMBOL_TABLE_NAME);
-			return NULL;
-		}
-		symbol_t key = {};
-		while (bpf_get_next_key(map->fd, &key, &symbols[n_symbols]) == 0) {
-			int ret = bpf_lookup_elem(map->fd, &key, &symbol_ids[n_symbols]);
-			key = symbols[n_symbols];
-			if (ret == 0) {
-				n_symbols++;
-			}
-		}
-	}
 
 	int ret;
 	if ((ret = get_stack_ips(t, stack_map_name, stack_id, ips, ts))) {
@@ -523,14 +887,39 @@ static char *build_stack_trace_string(struct bpf_tracer *t,
 		return NULL;
 	}
 
+	/*
+	 * The string of a stack depends only on its addresses while the
+	 * address space and the symbols of the process are unchanged. The
+	 * interpreter symbol ids are not stable, they are not cached.
+	 */
+	struct stack_str_hash_ext_data *ext = h->private;
+	struct symbolizer_proc_info *p = info_p;
+	bool cacheable = !use_symbol_table &&
+	    (pid == 0 || (p != NULL && !AO_GET(&p->is_exit)));
+	stack_str_cache_key_t cache_key;
+	if (cacheable) {
+		stack_str_cache_key(&cache_key, ips, PERF_MAX_STACK_DEPTH, pid,
+				    pid == 0 ? 0 : p->stime,
+				    pid == 0 ? 0 : AO_GET(&p->syms_gen),
+				    ignore_libs);
+		const char *cached =
+		    stack_str_cache_lookup(&ext->stack_cache, &cache_key);
+		if (cached)
+			return (char *)cached;
+	}
+
 	char *str = NULL;
-	ret = VEC_OK;
-	uword *symbol_array = NULL;
-	vec_validate_init_empty(symbol_array, PERF_MAX_STACK_DEPTH, 0, ret);
-	if (ret != VEC_OK)
-		return NULL;
+	/*
+	 * Frames are either interned in the frame cache or, when '*_owned'
+	 * is set, allocated for this stack only.
+	 */
+	char *frames[PERF_MAX_STACK_DEPTH];
+	bool frames_owned[PERF_MAX_STACK_DEPTH];
+	memset(frames, 0, sizeof(frames));
+	memset(frames_owned, 0, sizeof(frames_owned));
 
 	int start_idx = -1, folded_size = 0;
+	bool owned;
 	for (i = PERF_MAX_STACK_DEPTH - 1; i >= 0; i--) {
 		if (ips[i] == 0 || ips[i] == sentinel_addr)
 			continue;
@@ -539,19 +928,23 @@ static char *build_stack_trace_string(struct bpf_tracer *t,
 			start_idx = i;
 
 		if (use_symbol_table) {
-			str = resolve_custom_symbol_addr(symbols, symbol_ids, n_symbols, (i == start_idx), ips[i]);
+			str = resolve_custom_symbol_addr(t, h, (i == start_idx), ips[i]);
+			owned = true;
 		} else {
-			str = resolve_addr(t, pid, (i == start_idx), ips[i], new_cache, info_p);
+			str = resolve_frame(t, h, pid, (i == start_idx), ips[i],
+					    new_cache, info_p, &owned);
 		}
 		if (str) {
 			// ignore frames in library for memory profiling
 			if (ignore_libs && strlen(str) >= strlen(lib_sym_prefix)
 			    && strncmp(str, lib_sym_prefix,
 				       strlen(lib_sym_prefix)) == 0) {
-				clib_mem_free(str);
+				if (owned)
+					clib_mem_free(str);
 				continue;
 			}
-			symbol_array[i] = pointer_to_uword(str);
+			frames[i] = str;
+			frames_owned[i] = owned;
 			folded_size += strlen(str);
 		}
 	}
@@ -560,36 +953,40 @@ static char *build_stack_trace_string(struct bpf_tracer *t,
 	folded_size += PERF_MAX_STACK_DEPTH;
 
 	char *fold_stack_trace_str =
-	    clib_mem_alloc_aligned("folded_str", folded_size, 0, NULL);
+	    clib_mem_arena_alloc(&ext->folded_arena, folded_size);
 	if (fold_stack_trace_str == NULL)
-		goto failed;
+		goto finish;
 
 	int len = 0;
 	for (i = PERF_MAX_STACK_DEPTH - 1; i >= 0; i--) {
-		if (symbol_array[i]) {
+		if (frames[i]) {
 			len += snprintf(fold_stack_trace_str + len,
 					folded_size - len,
-					"%s;", (char *)symbol_array[i]);
-			clib_mem_free((void *)symbol_array[i]);
+					"%s;", frames[i]);
 		}
 	}
 
 	/* Remove the semicolon at the end of the string. */
 	if (len - 1 >= 0) {
 		fold_stack_trace_str[len - 1] = '\0';
+	} else {
+		fold_stack_trace_str[0] = '\0';
 	}
-	vec_free(symbol_array);
-	return fold_stack_trace_str;
 
-failed:
+finish:
 	for (i = PERF_MAX_STACK_DEPTH - 1; i >= 0; i--) {
-		if (symbol_array[i])
-			clib_mem_free((void *)symbol_array[i]);
+		if (frames_owned[i]) {
+			clib_mem_free(frames[i]);
+			/* Not symbolized, it may be next time. */
+			cacheable = false;
+		}
 	}
 
-	vec_free(symbol_array);
+	if (cacheable && fold_stack_trace_str)
+		stack_str_cache_add(&ext->stack_cache, &cache_key,
+				    fold_stack_trace_str);
 
-	return NULL;
+	return fold_stack_trace_str;
 }
 
 static char *folded_stack_trace_string(struct bpf_tracer *t,
@@ -631,8 +1028,8 @@ static char *folded_stack_trace_string(struct bpf_tracer *t,
 	/* memoized stack trace string. Because the stack-ids
 	   are not stable across profiler iterations. */
 	if (stack_str_hash_add_del(h, &kv, 1 /* is_add */ )) {
+		/* The string stays in the arena until the iteration ends. */
 		ebpf_warning("stack_str_hash_add_del() failed.\n");
-		clib_mem_free((void *)str);
 		str = NULL;
 	} else {
 		/*
@@ -651,10 +1048,11 @@ static char *folded_stack_trace_string(struct bpf_tracer *t,
 	return str;
 }
 
-static inline char *alloc_stack_trace_str(int len)
+static inline char *alloc_stack_trace_str(stack_str_hash_t * h, int len)
 {
+	struct stack_str_hash_ext_data *ext = h->private;
 	void *trace_str;
-	trace_str = clib_mem_alloc_aligned("stack_str", len, 0, NULL);
+	trace_str = clib_mem_arena_alloc(&ext->stack_arena, len);
 	if (trace_str == NULL) {
 		ebpf_warning("stack trace str alloc memory failed.\n");
 	}
@@ -696,7 +1094,7 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 	if (!new_cache) {
 		/* add string "[p/t] " */
 		len += (TASK_COMM_LEN * 2) + 10;
-		trace_str = alloc_stack_trace_str(len);
+		trace_str = alloc_stack_trace_str(h, len);
 		if (trace_str == NULL) {
 			ebpf_warning("No available memory space.\n");
 			return NULL;
@@ -750,7 +1148,7 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 	if (v->flags & STACK_TRACE_FLAGS_URETPROBE && v->uprobe_addr != 0) {
 		uprobe_str =
 		    resolve_addr(t, v->tgid, false, v->uprobe_addr, new_cache,
-				 info_p);
+				 info_p, NULL);
 		if (uprobe_str == NULL) {
 			return NULL;
 		}
@@ -767,7 +1165,7 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 		}
 	}
 
-	trace_str = alloc_stack_trace_str(len);
+	trace_str = alloc_stack_trace_str(h, len);
 	if (trace_str == NULL) {
 		ebpf_warning("No available memory space.\n");
 		goto error;
@@ -810,7 +1208,7 @@ char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 		 */
 
 		len += strlen(lost_tag);
-		trace_str = alloc_stack_trace_str(len);
+		trace_str = alloc_stack_trace_str(h, len);
 		if (trace_str == NULL) {
 			ebpf_warning("No available memory space.\n");
 			goto error;
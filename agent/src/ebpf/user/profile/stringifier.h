@@ -18,6 +18,8 @@
 #define DF_USER_STRINGIFIER_H
 
 #include "../bihash_8_8.h"
+#include "../bihash_16_8.h"
+#include "stack_str_cache.h"
 
 #define stack_str_hash_t	clib_bihash_8_8_t
 #define stack_str_hash_init	clib_bihash_init_8_8
@@ -35,6 +37,31 @@ struct stack_str_hash_ext_data {
 	 */
 	stack_str_hash_kv *stack_str_kvps;
 	bool clear_hash;
+	/*
+	 * Snapshot of the BPF symbol table, taken on first use in each
+	 * iteration and shared by all the stacks symbolized in it.
+	 */
+	struct symbol_table_snapshot *symbol_snapshot;
+	/*
+	 * Frame cache, kept across iterations:
+	 * (address, pid, symbol cache generation) -> interned frame id.
+	 * 'frame_strs' holds the interned frame strings indexed by id,
+	 * 'frame_str_index' maps the string hash to id for interning.
+	 */
+	clib_bihash_16_8_t frame_hash;
+	clib_bihash_8_8_t frame_str_index;
+	char **frame_strs;
+	/*
+	 * Folded stack trace strings by content, kept across iterations,
+	 * so that a stack ID seen again only costs reading its addresses.
+	 */
+	stack_str_cache_t stack_cache;
+	/*
+	 * Arenas of the folded stack trace strings and of the complete
+	 * stack strings, reset (not freed) at the end of each iteration.
+	 */
+	clib_mem_arena_t folded_arena;
+	clib_mem_arena_t stack_arena;
 };
 
 #ifndef AARCH64_MUSL
@@ -42,6 +69,8 @@ struct stack_str_hash_ext_data {
 u64 get_stack_table_data_miss_count(void);
 int init_stack_str_hash(stack_str_hash_t *h, const char *name);
 void clean_stack_strs(stack_str_hash_t *h);
+void get_stack_str_cache_stats(stack_str_hash_t *h,
+			       struct stack_str_cache_stats *stats);
 void release_stack_str_hash(stack_str_hash_t *h);
 char *resolve_and_gen_stack_trace_str(struct bpf_tracer *t,
 				      struct stack_trace_key_t *v,
@@ -19,6 +19,8 @@
 #include <arpa/inet.h>
 #include <sched.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <arpa/inet.h>
 #include <bcc/perf_reader.h>
 #include <linux/version.h>
@@ -46,6 +48,7 @@
 #include "socket_trace_bpf_5_2_plus.c"
 #include "socket_trace_bpf_kylin.c"
 #include "socket_trace_bpf_kfunc.c"
+#include "socket_trace_bpf_kfunc_ringbuf.c"
 #include "socket_trace_bpf_rt.c"
 #include "socket_trace_bpf_kprobe.c"
 
@@ -115,6 +118,22 @@ static uint32_t go_tracing_timeout = GO_TRACING_TIMEOUT_DEFAULT;
 static uint32_t io_event_collect_mode = 1;
 static uint64_t io_event_minimal_duration = 1000000;
 
+/*
+ * Number of empty polls a dispatch worker performs on its queue before
+ * parking on the futex. Set by set_dispatch_spin_budget()
+ */
+static volatile uint32_t dispatch_spin_budget = DISPATCH_SPIN_BUDGET_DEF;
+
+/*
+ * BPF ring buffer configuration, set by set_socket_ringbuf(). With
+ * 'socket_ringbuf_num' 0 the per-CPU perf buffers are used.
+ */
+static int socket_ringbuf_num;
+static uint32_t socket_ringbuf_pages;
+static uint32_t socket_ringbuf_wakeup_bytes = SOCKET_RINGBUF_WAKEUP_DEF;
+// Whether the loaded eBPF binary outputs through the ring buffers.
+static bool socket_use_ringbuf;
+
 /*
  * The maximum threshold for socket map reclamation, with map
  * reclamation occurring if this value is exceeded.
@@ -857,12 +876,14 @@ static void process_event(struct process_event_t *e)
 	if (e->meta.event_type == EVENT_TYPE_PROC_EXEC) {
 		if (e->maybe_thread && !is_user_process(e->pid))
 			return;
+		proc_maps_invalidate(e->pid);
 		update_proc_info_cache(e->pid, PROC_EXEC);
 		unwind_process_exec(e->pid);
 		extended_process_exec(e->pid);
 	} else if (e->meta.event_type == EVENT_TYPE_PROC_EXIT) {
 		/* Cache for updating process information used in
 		 * symbol resolution. */
+		proc_maps_invalidate(e->pid);
 		update_proc_info_cache(e->pid, PROC_EXIT);
 		unwind_process_exit(e->pid);
 		extended_process_exit(e->pid);
@@ -874,6 +895,335 @@ static inline int dispatch_queue_index(uint64_t val, int count)
 	return xxhash(val) % count;
 }
 
+static inline long futex(volatile u32 *uaddr, int op, u32 val,
+			 const struct timespec *timeout)
+{
+	return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+/*
+ * Wake up the worker of queue 'q' if it has parked itself.
+ *
+ * The futex wake is only issued when the worker has parked itself, so
+ * a busy or spinning worker costs the producer nothing but a fence.
+ * Pairs with the fence in queue_park(): either the producer sees
+ * 'parked' set, or the worker sees the newly enqueued data.
+ */
+static inline void queue_notify(struct queue *q)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!q->parked)
+		return;
+
+	__atomic_add_fetch(&q->wake_seq, 1, __ATOMIC_SEQ_CST);
+	futex(&q->wake_seq, FUTEX_WAKE_PRIVATE, 1, NULL);
+	atomic64_inc(&q->wakeup_count);
+}
+
+/*
+ * Called after 'nr' events have been enqueued on 'q': each time its
+ * depth grows past another FLOW_STEAL_DEPTH_MIN events, wake up one
+ * parked worker so that it takes flows over from 'q'.
+ */
+static inline void queue_notify_idle(struct queue *q, int nr)
+{
+	struct bpf_tracer *t = q->t;
+	unsigned int depth;
+	int i;
+
+	if (t->dispatch_workers_nr < 2)
+		return;
+
+	depth = ring_count(q->r);
+	if (depth < FLOW_STEAL_DEPTH_MIN ||
+	    (depth - nr) / FLOW_STEAL_DEPTH_MIN == depth / FLOW_STEAL_DEPTH_MIN)
+		return;
+
+	for (i = 0; i < t->dispatch_workers_nr; i++) {
+		if (&t->queues[i] != q && t->queues[i].parked) {
+			queue_notify(&t->queues[i]);
+			break;
+		}
+	}
+}
+
+/*
+ * Park the worker of queue 'q' until a producer calls queue_notify(),
+ * either for data enqueued on 'q' or for flows to take over.
+ */
+static void queue_park(struct queue *q)
+{
+	u32 seq = __atomic_load_n(&q->wake_seq, __ATOMIC_ACQUIRE);
+	__atomic_store_n(&q->parked, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	/*
+	 * Recheck after announcing 'parked': data enqueued before the
+	 * producer could observe it would otherwise never be signalled.
+	 * If wake_seq changes after it was sampled, FUTEX_WAIT returns
+	 * immediately with EAGAIN.
+	 */
+	if (ring_empty(q->r))
+		futex(&q->wake_seq, FUTEX_WAIT_PRIVATE, seq, NULL);
+
+	__atomic_store_n(&q->parked, 0, __ATOMIC_RELAXED);
+}
+
+/*
+ * Flow buckets for flow-affine dispatch (see FLOW_BUCKETS_NUM).
+ *
+ * 'state' packs the owner queue (high 8 bits, MAX_CPU_NR queues), the
+ * number of the bucket's events that are queued on or being processed
+ * by a previous owner ('draining', middle 28 bits) and by the current
+ * owner ('inflight', low 28 bits). A producer adds one event and reads
+ * the owner with a single fetch-add.
+ *
+ * An idle worker takes a bucket over by a CAS that moves 'inflight' to
+ * 'draining': the events already dispatched stay with the old owner,
+ * the next ones go to the new owner, which holds them back until the
+ * old owner has drained the bucket (socket_data_hold()). So a hot
+ * flow can move between two batches and its events stay in order.
+ */
+#define FLOW_OWNER_SHIFT	56
+#define FLOW_DRAINING_SHIFT	28
+#define FLOW_COUNT_MASK		((1ULL << FLOW_DRAINING_SHIFT) - 1)
+#define FLOW_STATE(owner, draining, inflight) \
+	(((u64)(owner) << FLOW_OWNER_SHIFT) | \
+	 ((u64)(draining) << FLOW_DRAINING_SHIFT) | (inflight))
+#define FLOW_OWNER(state)	((int)((state) >> FLOW_OWNER_SHIFT))
+#define FLOW_DRAINING(state)	(((state) >> FLOW_DRAINING_SHIFT) & FLOW_COUNT_MASK)
+#define FLOW_INFLIGHT(state)	((state) & FLOW_COUNT_MASK)
+
+struct flow_bucket {
+	volatile u64 state;
+	volatile u32 hits;	// events dispatched, halved on every steal scan
+} __attribute__ ((aligned(16)));
+
+static struct flow_bucket flow_buckets[FLOW_BUCKETS_NUM];
+static __thread u32 flow_steal_cursor;
+
+static void flow_buckets_init(int queues_nr)
+{
+	int i;
+	for (i = 0; i < FLOW_BUCKETS_NUM; i++) {
+		flow_buckets[i].state = FLOW_STATE(i % queues_nr, 0, 0);
+		flow_buckets[i].hits = 0;
+	}
+}
+
+/*
+ * Pick the queue for an event of socket 'socket_id' and account it as
+ * in flight on its flow bucket. Data without a socket (e.g. DPDK) gets
+ * FLOW_BUCKET_NONE and stays on the reader's queue 'def_q'.
+ */
+static inline int flow_dispatch(uint64_t socket_id, int def_q,
+				uint32_t * bucket)
+{
+	struct flow_bucket *b;
+	u64 state;
+
+	if (socket_id == 0) {
+		*bucket = FLOW_BUCKET_NONE;
+		return def_q;
+	}
+
+	*bucket = dispatch_queue_index(socket_id, FLOW_BUCKETS_NUM);
+	b = &flow_buckets[*bucket];
+	state = __atomic_fetch_add(&b->state, 1, __ATOMIC_ACQ_REL);
+	b->hits++;		// racy, only a hint for stealing
+
+	return FLOW_OWNER(state);
+}
+
+/*
+ * Is the event still waiting for the previous owner of its bucket to
+ * process the bucket's earlier events ?
+ */
+static inline bool flow_bucket_draining(struct mem_block_head *block_head)
+{
+	u64 state = __atomic_load_n(&flow_buckets[block_head->flow_bucket].state,
+				    __ATOMIC_ACQUIRE);
+	return FLOW_DRAINING(state) != 0 &&
+	    FLOW_OWNER(state) == block_head->flow_owner;
+}
+
+/*
+ * Called by the worker of queue 'q' before processing a dispatched
+ * event: if the event's bucket was taken over from another queue which
+ * has not drained it yet, or earlier events of the bucket are already
+ * held, hold the event back on 'q->held' and return true. The held
+ * events are processed in order by socket_data_process_held().
+ *
+ * A worker never waits on another queue: once buckets have moved in
+ * both directions between two queues, each worker could be waiting
+ * for an event queued behind the one the other is waiting on.
+ */
+bool socket_data_hold(struct queue *q, struct mem_block_head *block_head)
+{
+	struct flow_held *h = &q->flow_held[block_head->flow_bucket];
+	void *data = block_head + 1;
+	int ret;
+
+	if (h->nr == 0 && !flow_bucket_draining(block_head))
+		return false;
+
+	vec_add1(q->held, data, ret);
+	if (ret != 0) {
+		atomic64_inc(&q->heap_get_failed);
+		socket_data_release(block_head);
+		return true;
+	}
+
+	h->nr++;
+	return true;
+}
+
+/*
+ * Process the held events of queue 'q' whose buckets have been drained
+ * by their previous owner, in their order. Once an event is kept, the
+ * later events of the same bucket are kept as well in this pass.
+ */
+void socket_data_process_held(struct queue *q)
+{
+	struct mem_block_head *block_head;
+	struct flow_held *h;
+	u32 i, n = 0, len = vec_len(q->held);
+
+	q->held_pass++;
+	for (i = 0; i < len; i++) {
+		block_head = (struct mem_block_head *)q->held[i] - 1;
+		h = &q->flow_held[block_head->flow_bucket];
+		if (h->pass == q->held_pass ||
+		    flow_bucket_draining(block_head)) {
+			h->pass = q->held_pass;
+			q->held[n++] = q->held[i];
+			continue;
+		}
+
+		h->nr--;
+		process_socket_data(q->t, q->held[i]);
+	}
+
+	vec_set_len(q->held, n);
+}
+
+/*
+ * Drop the flow bucket and memory block references of a dispatched
+ * event, once it has been processed (or could not be enqueued).
+ */
+void socket_data_release(struct mem_block_head *block_head)
+{
+	struct mem_block_ref *ref = block_head->free_ptr;
+	struct flow_bucket *b;
+	u64 state, dec;
+
+	if (block_head->flow_bucket != FLOW_BUCKET_NONE) {
+		b = &flow_buckets[block_head->flow_bucket];
+		state = __atomic_load_n(&b->state, __ATOMIC_RELAXED);
+		do {
+			/* The bucket was taken over since it was dispatched. */
+			dec = FLOW_OWNER(state) == block_head->flow_owner ?
+			    1 : (1ULL << FLOW_DRAINING_SHIFT);
+		} while (!__atomic_compare_exchange_n(&b->state, &state,
+						      state - dec, false,
+						      __ATOMIC_RELEASE,
+						      __ATOMIC_RELAXED));
+	}
+
+	if (__atomic_sub_fetch(&ref->refcnt, 1, __ATOMIC_ACQ_REL) == 0)
+		clib_slab_free(ref);
+}
+
+/*
+ * Called by the worker of queue 'q' when its ring runs empty: take over
+ * the flow buckets with traffic since the last scan from the deepest
+ * queue, including the ones with events still queued there (see
+ * struct flow_bucket). A bucket whose previous takeover has not
+ * drained yet is left alone.
+ */
+static void flow_steal(struct queue *q)
+{
+	struct bpf_tracer *t = q->t;
+	int i, self = q - t->queues, victim = -1, stolen = 0;
+	unsigned int depth, max_depth = FLOW_STEAL_DEPTH_MIN - 1;
+	struct flow_bucket *b;
+	u64 state;
+	u32 hits;
+
+	for (i = 0; i < t->dispatch_workers_nr; i++) {
+		if (i == self)
+			continue;
+		depth = ring_count(t->queues[i].r);
+		if (depth > max_depth) {
+			max_depth = depth;
+			victim = i;
+		}
+	}
+
+	if (victim < 0)
+		return;
+
+	for (i = 0; i < FLOW_STEAL_SCAN_NUM && stolen < FLOW_STEAL_BUCKETS_MAX;
+	     i++) {
+		b = &flow_buckets[flow_steal_cursor++ & (FLOW_BUCKETS_NUM - 1)];
+		hits = b->hits;
+		if (hits == 0)
+			continue;
+		b->hits = hits >> 1;
+
+		state = __atomic_load_n(&b->state, __ATOMIC_ACQUIRE);
+		while (FLOW_OWNER(state) == victim &&
+		       FLOW_DRAINING(state) == 0) {
+			if (__atomic_compare_exchange_n(&b->state, &state,
+							FLOW_STATE(self,
+								   FLOW_INFLIGHT
+								   (state), 0),
+							false,
+							__ATOMIC_ACQ_REL,
+							__ATOMIC_RELAXED)) {
+				stolen++;
+				break;
+			}
+		}
+	}
+
+	if (stolen > 0)
+		atomic64_add(&q->steal_count, stolen);
+}
+
+/*
+ * Enqueue 'n' dispatched events on queue 'q_id', the events which do not
+ * fit are released.
+ */
+static void enqueue_socket_data(struct bpf_tracer *tracer, int q_id,
+				void **datas, int n)
+{
+	struct queue *dq = &tracer->queues[q_id];
+	struct socket_bpf_data *submit_data;
+	int j, nr;
+
+	nr = ring_mp_enqueue_burst(dq->r, datas, n, NULL);
+	if (nr > 0) {
+		/*
+		 * 通知工作线程进行dequeue，并进行数据处理。
+		 */
+		queue_notify(dq);
+		queue_notify_idle(dq, nr);
+		atomic64_add(&dq->enqueue_nr, nr);
+	}
+
+	if (nr < n) {
+		atomic64_add(&dq->enqueue_lost, n - nr);
+		for (j = nr; j < n; j++) {
+			submit_data = datas[j];
+			if (submit_data->source == DATA_SOURCE_DPDK)
+				atomic64_inc(&tracer->dropped_pkts);
+			socket_data_release((struct mem_block_head *)
+					    submit_data - 1);
+		}
+	}
+}
+
 // Some event types of data are handled by the user using a separate callback interface,
 // which completes the dispatch logic after reading the data from the Perf-Reader.
 static int register_events_handle(struct reader_forward_info *fwd_info,
@@ -902,33 +1252,40 @@ static int register_events_handle(struct reader_forward_info *fwd_info,
 	uint64_t q_idx;
 	struct queue *q;
 	int nr;
+	struct mem_block_ref *ref;
 	struct mem_block_head *block_head;
 
 	q_idx = fwd_info->queue_id;
 	q = &tracer->queues[q_idx];
-	block_head = malloc(sizeof(struct mem_block_head) + size);
-	if (block_head == NULL) {
+	ref = clib_slab_alloc(&q->slab, sizeof(*ref) +
+			      sizeof(struct mem_block_head) + size);
+	if (ref == NULL) {
 		ebpf_warning("block_head alloc memory failed\n");
+		atomic64_inc(&q->heap_get_failed);
 		return ETR_NOMEM;
 	}
 
+	/*
+	 * Fill in the head before enqueueing, the worker may consume
+	 * (and free) it immediately.
+	 */
+	ref->refcnt = 1;
+	block_head = (struct mem_block_head *)(ref + 1);
+	block_head->free_ptr = ref;
+	block_head->flow_bucket = FLOW_BUCKET_NONE;
+	block_head->fn = fn;
+
 	void *data = block_head + 1;
 	memcpy(data, meta, size);
-	nr = ring_sp_enqueue_burst(q->r, (void **)&data, 1, NULL);
+	nr = ring_mp_enqueue_burst(q->r, (void **)&data, 1, NULL);
 	if (nr < 1) {
 		atomic64_add(&q->enqueue_lost, 1);
-		free(block_head);
+		clib_slab_free(ref);
 		ebpf_warning("Add ring(q:%d) failed\n", q_idx);
 		return ETR_NOROOM;
 	}
 
-	block_head->free_ptr = block_head;
-	block_head->is_last = 1;
-	block_head->fn = fn;
-
-	pthread_mutex_lock(&q->mutex);
-	pthread_cond_signal(&q->cond);
-	pthread_mutex_unlock(&q->mutex);
+	queue_notify(q);
 
 	atomic64_add(&q->enqueue_nr, nr);
 
@@ -1104,7 +1461,6 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 
 	uint64_t q_idx;
 	struct queue *q;
-	int nr;
 	struct mem_block_head *block_head;	// 申请内存块的指针
 
 	struct __socket_data_buffer *buf = (struct __socket_data_buffer *)raw;
@@ -1147,7 +1503,10 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 			return;
 	}
 
-	/* Determine which queue to distribute to based on the first socket_data. */
+	/*
+	 * The memory block is allocated from the reader's own queue, its
+	 * events are then dispatched to the queues owning their flows.
+	 */
 	q_idx = fwd_info->queue_id;
 	q = &tracer->queues[q_idx];
 
@@ -1159,16 +1518,18 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 	}
 
 	struct socket_bpf_data *burst_data[MAX_EVENTS_BURST];
+	int burst_q[MAX_EVENTS_BURST];
+	uint32_t bucket;
+	int n;
 
 	/*
 	 * ----------- -> memory block ptr (free_ptr)
-	 *         |                /\
-	 *         |                *
+	 *  refcnt |                /\
 	 * --------------------|    *
 	 *      mem_block_head |    *
-	 *      >is_last-------|    *   is_last 判断是否是内存块中最后一个socket data,
-	 *      >*free_ptr     | ****   如果是释放整个内存。
-	 *      ---------------|----> burst enqueue
+	 *      >flow_bucket   |    *   refcnt 为内存块中尚未处理完的socket data数,
+	 *      >*free_ptr     | ****   减为0时释放整个内存。
+	 *      ---------------|----> enqueue to the flow's queue
 	 *                     |
 	 *      socket_data    |
 	 *                     |
@@ -1187,23 +1548,25 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 	alloc_len += sizeof(*submit_data) * buf->events_num;	// 计算长度包含要提交的数据的头
 	alloc_len += sizeof(struct mem_block_head) * buf->events_num;	// 包含内存块head
 	alloc_len += sizeof(sd->extra_data) * buf->events_num;	// 可能包含额外数据
+	alloc_len += sizeof(struct mem_block_ref);	// 内存块引用计数
 	alloc_len = CACHE_LINE_ROUNDUP(alloc_len);	// 保持cache line对齐
 
-	void *socket_data_buff = malloc(alloc_len);
+	void *socket_data_buff = clib_slab_alloc(&q->slab, alloc_len);
 	if (socket_data_buff == NULL) {
-		ebpf_warning("malloc() error.\n");
+		ebpf_warning("clib_slab_alloc() error.\n");
 		atomic64_inc(&q->heap_get_failed);
 		return;
 	}
 
-	data_buf_ptr = socket_data_buff;
+	struct mem_block_ref *ref = socket_data_buff;
+	ref->refcnt = buf->events_num;
+	data_buf_ptr = ref + 1;
 
 	for (i = 0; i < buf->events_num; i++) {
 		sd = (struct __socket_data *)&buf->data[start];
 		len = sd->data_len;
 		block_head = (struct mem_block_head *)data_buf_ptr;
-		block_head->is_last = 0;
-		block_head->free_ptr = socket_data_buff;
+		block_head->free_ptr = ref;
 		block_head->fn = NULL;
 
 		data_buf_ptr = block_head + 1;
@@ -1288,35 +1651,32 @@ static void reader_raw_cb(void *cookie, void *raw, int raw_size)
 		data_buf_ptr += sizeof(*submit_data) + submit_data->cap_len;
 	}
 
-	nr = ring_sp_enqueue_burst
-	    (q->r, (void **)burst_data, buf->events_num, NULL);
-
-	if (nr < buf->events_num) {
-		int lost = buf->events_num - nr;
-		atomic64_add(&q->enqueue_lost, lost);
-		if (lost == buf->events_num) {
-			free(socket_data_buff);
-			return;
-		}
-		int i;
-		for (i = nr; i < buf->events_num; i++) {
-			if (burst_data[i]->source == DATA_SOURCE_DPDK)
-				atomic64_inc(&tracer->dropped_pkts);
-		}
-	}
-
-	submit_data = burst_data[nr - 1];
-	block_head = (struct mem_block_head *)submit_data - 1;
-	block_head->is_last = 1;
-
 	/*
-	 * 通知工作线程进行dequeue，并进行数据处理。
+	 * Dispatch each event right before it is enqueued: an event counted
+	 * in flight on its bucket is on its queue (or about to be), so that
+	 * a worker taking the bucket over does not hold its events back
+	 * while this reader is busy. Consecutive events for the same queue
+	 * are enqueued as one burst. Once an event is enqueued the worker
+	 * may process and release it, only the events not yet enqueued are
+	 * touched afterwards.
 	 */
-	pthread_mutex_lock(&q->mutex);
-	pthread_cond_signal(&q->cond);
-	pthread_mutex_unlock(&q->mutex);
+	for (i = 0, n = 0; i < buf->events_num; i++) {
+		submit_data = burst_data[i];
+		block_head = (struct mem_block_head *)submit_data - 1;
+		burst_q[i] = flow_dispatch(submit_data->socket_id, q_idx,
+					   &bucket);
+		block_head->flow_bucket = bucket;
+		block_head->flow_owner = burst_q[i];
+		if (n > 0 && burst_q[i] != burst_q[i - 1]) {
+			enqueue_socket_data(tracer, burst_q[i - 1],
+					    (void **)&burst_data[i - n], n);
+			n = 0;
+		}
+		n++;
+	}
 
-	atomic64_add(&q->enqueue_nr, nr);
+	enqueue_socket_data(tracer, burst_q[i - 1],
+			    (void **)&burst_data[i - n], n);
 }
 
 static void reader_lost_cb(void *cookie, uint64_t lost)
@@ -1326,98 +1686,75 @@ static void reader_lost_cb(void *cookie, uint64_t lost)
 	atomic64_add(&tracer->lost, lost);
 }
 
-static void reclaim_trace_map(struct bpf_tracer *tracer, uint32_t timeout)
+struct reclaim_timeout_ctx {
+	uint32_t uptime;
+	uint32_t timeout;
+};
+
+static bool trace_map_timeout(void *key, void *value, void *ctx)
 {
-	struct ebpf_map *map =
-	    ebpf_obj__get_map_by_name(tracer->obj, MAP_TRACE_NAME);
-	if (map == NULL) {
-		ebpf_warning("[%s] map(name:%s) is NULL.\n", __func__,
-			     MAP_TRACE_NAME);
-		return;
-	}
-	int map_fd = map->fd;
+	struct trace_info_t *info = value;
+	struct reclaim_timeout_ctx *c = ctx;
+	return c->uptime - info->update_time > c->timeout;
+}
+
+static bool socket_map_timeout(void *key, void *value, void *ctx)
+{
+	struct socket_info_s *info = value;
+	struct reclaim_timeout_ctx *c = ctx;
+	return c->uptime - info->update_time > c->timeout;
+}
 
-	struct trace_key_t trace_key = {}, next_trace_key;
-	uint32_t reclaim_count = 0;
-	struct trace_info_t value;
-	uint32_t uptime = get_sys_uptime();
-	uint32_t curr_trace_count = 0, limit;
+static void reclaim_trace_map(struct bpf_tracer *tracer, uint32_t timeout)
+{
+	struct bpf_table_reclaim_stats stats = {};
+	struct reclaim_timeout_ctx ctx = {
+		.uptime = get_sys_uptime(),
+		.timeout = timeout,
+	};
+	uint32_t curr_trace_count, limit;
 	limit = conf_max_trace_entries * RECLAIM_TRACE_MAP_SCALE;
-	struct list_head clear_elem_head;
-	init_list_head(&clear_elem_head);
-
-	while (bpf_get_next_key(map_fd, &trace_key, &next_trace_key) == 0) {
-		if (bpf_lookup_elem(map_fd, &next_trace_key, &value) == 0) {
-			curr_trace_count++;
-			if (uptime - value.update_time > timeout &&
-			    reclaim_count < limit) {
-				if (insert_list(&next_trace_key,
-						sizeof(next_trace_key),
-						&clear_elem_head)) {
-					reclaim_count++;
-				}
-			}
-		}
 
-		trace_key = next_trace_key;
-	}
+	if (bpf_table_reclaim(tracer, MAP_TRACE_NAME, limit,
+			      trace_map_timeout, &ctx, &stats))
+		return;
 
-	reclaim_count = __reclaim_map(map_fd, &clear_elem_head);
 	// The trace statistics map needs to be updated to reflect the count.   
-	curr_trace_count -= reclaim_count;
+	curr_trace_count = stats.walked - stats.deleted;
 	if (!bpf_stats_map_update(tracer, -1, curr_trace_count, -1, -1, -1, -1)) {
 		ebpf_warning("Update trace statistics failed.\n");
 	}
 
-	ebpf_info("[%s] curr_trace_count %u trace map reclaim_count :%u\n",
-		  __func__, curr_trace_count, reclaim_count);
+	ebpf_info("[%s] curr_trace_count %u trace map reclaim_count :%u"
+		  " (syscalls %u, batched %d, cost %lu us)\n",
+		  __func__, curr_trace_count, stats.deleted, stats.syscalls,
+		  stats.batched, stats.wall_ns / 1000);
 }
 
 static void reclaim_socket_map(struct bpf_tracer *tracer, uint32_t timeout)
 {
-	struct ebpf_map *map =
-	    ebpf_obj__get_map_by_name(tracer->obj, MAP_SOCKET_INFO_NAME);
-	if (map == NULL) {
-		ebpf_warning("[%s] map(name:%s) is NULL.\n", __func__,
-			     MAP_SOCKET_INFO_NAME);
+	struct bpf_table_reclaim_stats stats = {};
+	struct reclaim_timeout_ctx ctx = {
+		.uptime = get_sys_uptime(),
+		.timeout = timeout,
+	};
+	uint32_t curr_socket_count;
+
+	if (bpf_table_reclaim(tracer, MAP_SOCKET_INFO_NAME,
+			      conf_socket_map_max_reclaim,
+			      socket_map_timeout, &ctx, &stats))
 		return;
-	}
-	int map_fd = map->fd;
-
-	uint64_t conn_key, next_conn_key;
-	uint32_t sockets_reclaim_count = 0;
-	struct socket_info_s value;
-	conn_key = 0;
-	uint32_t uptime = get_sys_uptime();
-	uint32_t curr_socket_count = 0;
-	struct list_head clear_elem_head;
-	init_list_head(&clear_elem_head);
-
-	while (bpf_get_next_key(map_fd, &conn_key, &next_conn_key) == 0) {
-		if (bpf_lookup_elem(map_fd, &next_conn_key, &value) == 0) {
-			curr_socket_count++;
-			if ((uptime - value.update_time > timeout) &&
-			    (sockets_reclaim_count <
-			     conf_socket_map_max_reclaim)) {
-				if (insert_list(&next_conn_key,
-						sizeof(next_conn_key),
-						&clear_elem_head)) {
-					sockets_reclaim_count++;
-				}
-			}
-		}
-		conn_key = next_conn_key;
-	}
 
-	sockets_reclaim_count = __reclaim_map(map_fd, &clear_elem_head);
-	curr_socket_count -= sockets_reclaim_count;
+	curr_socket_count = stats.walked - stats.deleted;
 	if (!bpf_stats_map_update
 	    (tracer, curr_socket_count, -1, -1, -1, -1, -1)) {
 		ebpf_warning("Update trace statistics failed.\n");
 	}
 
-	ebpf_info("[%s] curr_socket_count %u sockets_reclaim_count :%u\n",
-		  __func__, curr_socket_count, sockets_reclaim_count);
+	ebpf_info("[%s] curr_socket_count %u sockets_reclaim_count :%u"
+		  " (syscalls %u, batched %d, cost %lu us)\n",
+		  __func__, curr_socket_count, stats.deleted, stats.syscalls,
+		  stats.batched, stats.wall_ns / 1000);
 }
 
 static int check_map_exceeded(void)
@@ -2104,6 +2441,82 @@ int set_io_event_minimal_duration(uint64_t duration)
 	return 0;
 }
 
+/*
+ * For each CPU, report whether its eBPF push buffer holds data that is
+ * waiting for a periodic push ('pending' holds 'cpus' entries).
+ *
+ * Returns 0 on success (all false if the socket tracer is not running),
+ * non-zero if the state could not be read.
+ */
+int socket_tracer_buffered_cpus(bool *pending, int cpus)
+{
+	static int nr_cpus;
+	int cpu;
+
+	memset(pending, 0, sizeof(bool) * cpus);
+	struct bpf_tracer *tracer = find_bpf_tracer(SK_TRACER_NAME);
+	if (tracer == NULL)
+		return 0;
+
+	if (nr_cpus <= 0)
+		nr_cpus = get_num_possible_cpus();
+	if (nr_cpus <= 0)
+		return ETR_INVAL;
+
+	struct tracer_ctx_s values[nr_cpus];
+	if (!bpf_table_get_value(tracer, MAP_TRACER_CTX_NAME, 0, values))
+		return ETR_NOTEXIST;
+
+	for (cpu = 0; cpu < nr_cpus && cpu < cpus; cpu++)
+		pending[cpu] = values[cpu].buffered_timestamp > 0;
+
+	return 0;
+}
+
+/*
+ * Set the number of empty polls a dispatch worker performs before it
+ * parks and waits for a producer wakeup. 0 parks immediately.
+ */
+int set_dispatch_spin_budget(uint32_t budget)
+{
+	dispatch_spin_budget = budget;
+	ebpf_info("Set dispatch spin budget %u\n", budget);
+	return 0;
+}
+
+/*
+ * Transfer socket data through BPF ring buffers instead of per-CPU perf
+ * buffers (needs Linux 5.8+ and the kfunc eBPF binary, otherwise perf
+ * buffers are used). Must be called before running_socket_tracer().
+ *
+ * @rings_num Number of rings, CPUs are split into as many groups.
+ *            0 disables ring buffers.
+ * @ring_pages Memory pages per ring, rounded down to a power of 2.
+ * @wakeup_bytes Wake up the reader once this much data is pending,
+ *               0 uses the default value.
+ */
+int set_socket_ringbuf(int rings_num, uint32_t ring_pages,
+		       uint32_t wakeup_bytes)
+{
+	if (rings_num < 0 || rings_num > SOCKET_RINGBUF_NUM_MAX) {
+		ebpf_warning("Invalid rings_num %d, range [0, %d]\n",
+			     rings_num, SOCKET_RINGBUF_NUM_MAX);
+		return ETR_INVAL;
+	}
+
+	if (ring_pages == 0)
+		ring_pages = SOCKET_RINGBUF_SIZE_DEF / getpagesize();
+
+	socket_ringbuf_num = rings_num;
+	socket_ringbuf_pages = 1 << min_log2(ring_pages);
+	socket_ringbuf_wakeup_bytes = wakeup_bytes ? wakeup_bytes :
+	    SOCKET_RINGBUF_WAKEUP_DEF;
+	ebpf_info("Set socket ring buffers num %d pages %u wakeup %u\n",
+		  socket_ringbuf_num, socket_ringbuf_pages,
+		  socket_ringbuf_wakeup_bytes);
+	return 0;
+}
+
 /*
  * Using an eBPF program specifically designed to send data, the goal is to solve the
  * problem of instructions exceeding the maximum limit.
@@ -2159,18 +2572,44 @@ static void process_data(void *queue)
 	struct queue *q = (struct queue *)queue;
 	struct ring *r = q->r;
 	void *rx_burst[MAX_EVENTS_BURST];
+	u32 spins = 0;
 	for (;;) {
+		if (vec_len(q->held) > 0)
+			socket_data_process_held(q);
+
 		nr = ring_sc_dequeue_burst(r, rx_burst, MAX_EVENTS_BURST, NULL);
 		if (nr == 0) {
+			/*
+			 * 队列刚变为空时，尝试从负载最重的队列迁移空闲的流。
+			 */
+			if (spins == 0)
+				flow_steal(q);
+
+			/*
+			 * 队列为空时先自旋，数据很快到达时无需陷入内核。
+			 */
+			if (spins++ < dispatch_spin_budget) {
+				CLIB_PAUSE();
+				continue;
+			}
+
+			/*
+			 * 有暂存的事件时不休眠，其他队列处理完流桶后不会唤醒本线程。
+			 */
+			if (vec_len(q->held) > 0) {
+				sched_yield();
+				continue;
+			}
+
 			/*
 			 * 等着生产者唤醒
 			 */
-			pthread_mutex_lock(&q->mutex);
-			pthread_cond_wait(&q->cond, &q->mutex);
-			pthread_mutex_unlock(&q->mutex);
+			queue_park(q);
+			spins = 0;
 		} else {
+			spins = 0;
 			atomic64_add(&q->dequeue_nr, nr);
-			prefetch_and_process_data(q->t, nr, rx_burst);
+			prefetch_and_process_data(q, nr, rx_burst);
 			if (nr == MAX_EVENTS_BURST)
 				atomic64_inc(&q->burst_count);
 		}
@@ -2218,6 +2657,10 @@ static void perf_buffer_read(void *arg)
 #ifndef PERFORMANCE_TEST
 		for (i = 0; i < tracer->perf_readers_count; i++) {
 			perf_reader = &tracer->readers[i];
+			if (perf_reader->is_ringbuf) {
+				ringbuf_reader_poll(perf_reader, epoll_id);
+				continue;
+			}
 			struct epoll_event events[perf_reader->readers_count];
 			int nfds =
 			    reader_epoll_wait(perf_reader, events, epoll_id);
@@ -2244,15 +2687,13 @@ static void perf_buffer_read(void *arg)
 		prep_data->cap_data =
 		    (char *)((void **)&prep_data->cap_data + 1);
 		prep_data->len = data_len;
-		if (!ring_sp_enqueue_burst(q->r, (void **)&prep_data, 1, NULL)) {
-			printf("%s, ring_sp_enqueue failed.\n", __func__);
-			ebpf_info("%s, ring_sp_enqueue failed.\n", __func__);
+		if (!ring_mp_enqueue_burst(q->r, (void **)&prep_data, 1, NULL)) {
+			printf("%s, ring_mp_enqueue failed.\n", __func__);
+			ebpf_info("%s, ring_mp_enqueue failed.\n", __func__);
 			free(prep_data);
 			atomic64_inc(&q->enqueue_lost);
 		} else {
-			pthread_mutex_lock(&q->mutex);
-			pthread_cond_signal(&q->cond);
-			pthread_mutex_unlock(&q->mutex);
+			queue_notify(q);
 			atomic64_inc(&q->enqueue_nr);
 		}
 #endif
@@ -2287,12 +2728,14 @@ static int dispatch_workers_setup(struct bpf_tracer *tracer,
 	else
 		queue_size = 1 << min_log2((unsigned int)queue_size);
 
+	flow_buckets_init(tracer->dispatch_workers_nr);
+
 	for (i = 0; i < tracer->dispatch_workers_nr; i++) {
 		struct ring *r = NULL;
 		char name[NAME_LEN];
 		snprintf(name, sizeof(name), "%s-ring-%d", tracer->name, i);
 		r = ring_create(name, queue_size,
-				SOCKET_ID_ANY, RING_F_SP_ENQ | RING_F_SC_DEQ);
+				SOCKET_ID_ANY, RING_F_SC_DEQ);
 		if (r == NULL) {
 			ebpf_info("<%s> ring_create fail. err:%s\n", __func__,
 				  strerror(errno));
@@ -2309,9 +2752,26 @@ static int dispatch_workers_setup(struct bpf_tracer *tracer,
 		atomic64_init(&tracer->queues[i].dequeue_nr);
 		atomic64_init(&tracer->queues[i].burst_count);
 		atomic64_init(&tracer->queues[i].heap_get_failed);
+		clib_slab_init(&tracer->queues[i].slab, "socket_data");
+
+		tracer->queues[i].wake_seq = 0;
+		tracer->queues[i].parked = 0;
+		atomic64_init(&tracer->queues[i].wakeup_count);
+		atomic64_init(&tracer->queues[i].steal_count);
+
+		tracer->queues[i].held = NULL;
+		tracer->queues[i].held_pass = 0;
+		tracer->queues[i].flow_held =
+		    clib_mem_alloc_aligned("flow_held",
+					   FLOW_BUCKETS_NUM *
+					   sizeof(struct flow_held), 0, NULL);
+		if (tracer->queues[i].flow_held == NULL) {
+			ebpf_warning("<%s> flow_held alloc failed.\n", __func__);
+			return -ENOMEM;
+		}
+		memset(tracer->queues[i].flow_held, 0,
+		       FLOW_BUCKETS_NUM * sizeof(struct flow_held));
 
-		pthread_mutex_init(&tracer->queues[i].mutex, NULL);
-		pthread_cond_init(&tracer->queues[i].cond, NULL);
 		ret =
 		    pthread_create(&tracer->dispatch_workers[i], NULL,
 				   (void *)&process_data,
@@ -2354,6 +2814,7 @@ static int select_bpf_binary(char load_name[NAME_LEN], void **bin_buffer,
 	int buffer_sz;
 	char sys_type_str[16];
 	memset(sys_type_str, 0, sizeof(sys_type_str));
+	socket_use_ringbuf = false;
 	if (fetch_system_type(sys_type_str, sizeof(sys_type_str) - 1) != ETR_OK) {
 		ebpf_warning("Fetch system type faild.\n");
 	}
@@ -2372,9 +2833,21 @@ static int select_bpf_binary(char load_name[NAME_LEN], void **bin_buffer,
 		   && get_kfunc_params_num(TEST_KFUNC_NAME) ==
 		   TEST_KFUNC_PARAMS_NUM) {
 		g_k_type = K_TYPE_KFUNC;
-		snprintf(load_name, NAME_LEN, "socket-trace-bpf-linux-kfunc");
-		bpf_bin_buffer = (void *)socket_trace_kfunc_ebpf_data;
-		buffer_sz = sizeof(socket_trace_kfunc_ebpf_data);
+		// BPF ring buffer is supported since Linux 5.8
+		if (socket_ringbuf_num > 0 &&
+		    (major > 5 || (major == 5 && minor >= 8))) {
+			socket_use_ringbuf = true;
+			snprintf(load_name, NAME_LEN,
+				 "socket-trace-bpf-linux-kfunc-ringbuf");
+			bpf_bin_buffer =
+			    (void *)socket_trace_kfunc_ringbuf_ebpf_data;
+			buffer_sz = sizeof(socket_trace_kfunc_ringbuf_ebpf_data);
+		} else {
+			snprintf(load_name, NAME_LEN,
+				 "socket-trace-bpf-linux-kfunc");
+			bpf_bin_buffer = (void *)socket_trace_kfunc_ebpf_data;
+			buffer_sz = sizeof(socket_trace_kfunc_ebpf_data);
+		}
 	} else if (strcmp(sys_type_str, "ky10") == 0) {
 		g_k_type = K_TYPE_KYLIN;
 		snprintf(load_name, NAME_LEN, "socket-trace-bpf-linux-kylin");
@@ -2398,6 +2871,10 @@ static int select_bpf_binary(char load_name[NAME_LEN], void **bin_buffer,
 		buffer_sz = sizeof(socket_trace_common_ebpf_data);
 	}
 
+	if (socket_ringbuf_num > 0 && !socket_use_ringbuf)
+		ebpf_info("BPF ring buffer is not supported by '%s', use perf "
+			  "buffers.\n", load_name);
+
 	*bin_buffer = bpf_bin_buffer;
 	*bin_buf_size = buffer_sz;
 	return 0;
@@ -2540,6 +3017,24 @@ int running_socket_tracer(tracer_callback_t handle,
 
 	conf_max_trace_entries = max_trace_entries;
 
+	/*
+	 * Size the ring buffers, the unused ones shrink to one page. The
+	 * configuration is ignored if the perf buffer binary gets loaded.
+	 */
+	if (socket_ringbuf_num > 0) {
+		int i, page_sz = getpagesize();
+		char ring_name[NAME_LEN];
+		for (i = 0; i < SOCKET_RINGBUF_NUM_MAX; i++) {
+			snprintf(ring_name, sizeof(ring_name), "%s_%d",
+				 MAP_SOCKET_RINGBUF_PREFIX, i);
+			if ((ret = maps_config(tracer, ring_name,
+					       i < socket_ringbuf_num ?
+					       socket_ringbuf_pages *
+					       page_sz : page_sz)))
+				return ret;
+		}
+	}
+
 	bool has_attempted = false;
 retry_load:
 	if (tracer_bpf_load(tracer)) {
@@ -2558,12 +3053,25 @@ retry_load:
 	 * create reader for read perf buffer data. 
 	 */
 	struct bpf_perf_reader *reader;
-	reader = create_perf_buffer_reader(tracer,
-					   MAP_PERF_SOCKET_DATA_NAME,
-					   reader_raw_cb,
-					   reader_lost_cb,
-					   perf_pages_cnt,
-					   thread_nr, PERF_READER_TIMEOUT_DEF);
+	if (socket_use_ringbuf) {
+		ebpf_info("Socket data uses %d BPF ring buffers (%u pages).\n",
+			  socket_ringbuf_num, socket_ringbuf_pages);
+		reader = create_ringbuf_reader(tracer,
+					       MAP_SOCKET_RINGBUF_PREFIX,
+					       socket_ringbuf_num,
+					       reader_raw_cb,
+					       socket_ringbuf_pages,
+					       thread_nr,
+					       PERF_READER_TIMEOUT_DEF);
+	} else {
+		reader = create_perf_buffer_reader(tracer,
+						   MAP_PERF_SOCKET_DATA_NAME,
+						   reader_raw_cb,
+						   reader_lost_cb,
+						   perf_pages_cnt,
+						   thread_nr,
+						   PERF_READER_TIMEOUT_DEF);
+	}
 	if (reader == NULL)
 		return -EINVAL;
 
@@ -2604,6 +3112,11 @@ retry_load:
 		t_conf[cpu].io_event_minimal_duration =
 		    io_event_minimal_duration;
 		t_conf[cpu].disable_tracing = g_disable_syscall_tracing;
+		// Contiguous CPU groups share a ring buffer.
+		if (socket_use_ringbuf && cpu < sys_cpus_count)
+			t_conf[cpu].ringbuf_idx =
+			    cpu * socket_ringbuf_num / sys_cpus_count;
+		t_conf[cpu].ringbuf_wakeup_bytes = socket_ringbuf_wakeup_bytes;
 		if (!g_disable_syscall_tracing)
 			t_conf[cpu].go_tracing_timeout = go_tracing_timeout;
 	}
@@ -2766,6 +3279,7 @@ static bool bpf_stats_map_collect(struct bpf_tracer *tracer,
 	stats_total->period_event_max_delay = value.period_event_max_delay;
 	stats_total->period_event_total_time = value.period_event_total_time;
 	stats_total->period_event_count = value.period_event_count;
+	stats_total->ringbuf_lost_count = value.ringbuf_lost_count;
 	return true;
 }
 
@@ -2963,6 +3477,12 @@ struct socket_trace_stats socket_tracer_stats(void)
 		if (!bpf_stats_map_update(t, -1, -1, 0, 0, 0, 0)) {
 			ebpf_warning("Update trace statistics failed.\n");
 		}
+
+		// Records the kernel dropped because a ring buffer was full.
+		static u64 prev_ringbuf_lost;
+		stats.kern_lost +=
+		    stats_total.ringbuf_lost_count - prev_ringbuf_lost;
+		prev_ringbuf_lost = stats_total.ringbuf_lost_count;
 	}
 
 	int i;
@@ -2982,6 +3502,14 @@ struct socket_trace_stats socket_tracer_stats(void)
 		atomic64_init(&t->queues[i].enqueue_nr);
 		atomic64_init(&t->queues[i].dequeue_nr);
 		atomic64_init(&t->queues[i].heap_get_failed);
+		stats.worker_wakeup_count +=
+		    atomic64_read(&t->queues[i].wakeup_count);
+		atomic64_init(&t->queues[i].wakeup_count);
+		stats.flow_steal_count +=
+		    atomic64_read(&t->queues[i].steal_count);
+		atomic64_init(&t->queues[i].steal_count);
+		stats.queue_depth_max = clib_max(stats.queue_depth_max,
+					    (u64) ring_count(t->queues[i].r));
 	}
 
 	stats.is_adapt_success = t->adapt_success;
@@ -2995,6 +3523,16 @@ struct socket_trace_stats socket_tracer_stats(void)
 	clear_proc_exec_event_count();
 	clear_proc_exit_event_count();
 
+	struct proc_maps_stats maps_stats;
+	get_proc_maps_stats(&maps_stats);
+	stats.proc_maps_parse_count = maps_stats.parse_count;
+	stats.proc_maps_hit_count = maps_stats.hit_count;
+	stats.proc_maps_parse_max_us = maps_stats.parse_max_us;
+	stats.proc_maps_parse_avg_us = maps_stats.parse_avg_us;
+
+	get_kick_kern_stats(&stats.kick_count, &stats.kick_cpu_us,
+			    &stats.kick_sweep_max_us);
+
 	return stats;
 }
 
@@ -193,6 +193,35 @@ struct socket_trace_stats {
 	uint64_t dropped_packets;
 	uint64_t kern_missed_packets;
 	uint64_t invalid_packets;
+
+	/*
+	 * Number of futex wakeups issued to parked dispatch workers.
+	 */
+	uint64_t worker_wakeup_count;
+
+	/*
+	 * Flow-affine dispatch: the deepest dispatch queue at collection
+	 * time, and the number of flow buckets moved to idle workers.
+	 */
+	uint64_t queue_depth_max;
+	uint64_t flow_steal_count;
+
+	/*
+	 * /proc/<pid>/maps snapshots: files parsed, lookups served by a
+	 * snapshot, and the parse latency (microseconds).
+	 */
+	uint64_t proc_maps_parse_count;
+	uint64_t proc_maps_hit_count;
+	uint64_t proc_maps_parse_max_us;
+	uint64_t proc_maps_parse_avg_us;
+
+	/*
+	 * Kick thread: CPUs kicked to push buffered data, its CPU time and
+	 * the longest sweep over the CPUs (microseconds).
+	 */
+	uint64_t kick_count;
+	uint64_t kick_cpu_us;
+	uint64_t kick_sweep_max_us;
 };
 
 struct bpf_offset_param_array {
@@ -330,15 +359,43 @@ do {						\
 } while (0)
 /* *INDENT-ON* */
 
+bool socket_data_hold(struct queue *q, struct mem_block_head *block_head);
+void socket_data_release(struct mem_block_head *block_head);
+void socket_data_process_held(struct queue *q);
+
+/*
+ * Process one dispatched event and release it.
+ */
+static inline void process_socket_data(struct bpf_tracer *t, void *data)
+{
+	struct socket_bpf_data *sd = data;
+	struct mem_block_head *block_head = (struct mem_block_head *)sd - 1;
+	tracer_callback_t callback = (tracer_callback_t) t->process_fn;
+
+	if (block_head->fn != NULL) {
+		block_head->fn(sd);
+	} else {
+		int64_t boot_time = get_sysboot_time_ns();
+		if (t->datadump)
+			t->datadump((void *)sd, boot_time);
+		/*
+		 * Modify socket data time to real time,
+		 * time precision is in nanosecond.
+		 */
+		sd->timestamp = sd->timestamp + boot_time;
+		callback(NULL, sd);
+	}
+
+	socket_data_release(block_head);
+}
+
 static inline void
-prefetch_and_process_data(struct bpf_tracer *t, int nb_rx, void **datas_burst)
+prefetch_and_process_data(struct queue *q, int nb_rx, void **datas_burst)
 {
 /* Configure how many socket_data ahead to prefetch, when reading socket_data */
 #define PREFETCH_OFFSET   3
 	int32_t j;
-	struct socket_bpf_data *sd;
 	struct mem_block_head *block_head;
-	tracer_callback_t callback = (tracer_callback_t) t->process_fn;
 
 	/* Prefetch first packets */
 	for (j = 0; j < PREFETCH_OFFSET && j < nb_rx; j++)
@@ -352,24 +409,11 @@ prefetch_and_process_data(struct bpf_tracer *t, int nb_rx, void **datas_burst)
 		if (j + PREFETCH_OFFSET < nb_rx)
 			PREFETCH(datas_burst[j + PREFETCH_OFFSET],
 				 2 * CACHE_LINE_BYTES, READ);
-		sd = (struct socket_bpf_data *)datas_burst[j];
-		block_head = (struct mem_block_head *)sd - 1;
-		if (block_head->fn != NULL) {
-			block_head->fn(sd);
-		} else {
-			int64_t boot_time = get_sysboot_time_ns();
-			if (t->datadump)
-				t->datadump((void *)sd, boot_time);
-			/*
-			 * Modify socket data time to real time,
-			 * time precision is in nanosecond.
-			 */
-			sd->timestamp = sd->timestamp + boot_time;
-			callback(NULL, sd);
-		}
-
-		if (block_head->is_last == 1)
-			free(block_head->free_ptr);
+		block_head = (struct mem_block_head *)datas_burst[j] - 1;
+		if (block_head->flow_bucket != FLOW_BUCKET_NONE &&
+		    socket_data_hold(q, block_head))
+			continue;
+		process_socket_data(q->t, datas_burst[j]);
 	}
 }
 
@@ -377,6 +421,10 @@ int set_data_limit_max(int limit_size);
 int set_go_tracing_timeout(int timeout);
 int set_io_event_collect_mode(uint32_t mode);
 int set_io_event_minimal_duration(uint64_t duration);
+int set_dispatch_spin_budget(uint32_t budget);
+int set_socket_ringbuf(int rings_num, uint32_t ring_pages,
+		       uint32_t wakeup_bytes);
+int socket_tracer_buffered_cpus(bool *pending, int cpus);
 struct socket_trace_stats socket_tracer_stats(void);
 int running_socket_tracer(tracer_callback_t handle,
 			  int thread_nr,
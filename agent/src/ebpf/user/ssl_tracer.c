@@ -85,14 +85,11 @@ out:
 
 static void clear_ssl_probes_by_pid(struct bpf_tracer *tracer, int pid)
 {
-	struct probe *probe;
-	struct list_head *p, *n;
+	struct probe *probe, *n;
 	struct symbol_uprobe *sym_uprobe;
 
-	list_for_each_safe(p, n, &tracer->probes_head) {
-		probe = container_of(p, struct probe, list);
-		if (!(probe->type == UPROBE && probe->private_data != NULL))
-			continue;
+	list_for_each_entry_safe(probe, n, tracer_pid_probes(tracer, pid),
+				 pid_list) {
 		sym_uprobe = probe->private_data;
 
 		if (sym_uprobe->type != OPENSSL_UPROBE)
@@ -165,8 +162,8 @@ void ssl_process_exec(int pid)
 	if (tracer == NULL)
 		return;
 
-	if (tracer->probes_count > OPEN_FILES_MAX) {
-		ebpf_warning("Probes count too many. The maximum is %d\n",
+	if (tracer->links_count >= OPEN_FILES_MAX) {
+		ebpf_warning("Probe attachments too many. The maximum is %d\n",
 			     OPEN_FILES_MAX);
 		return;
 	}
@@ -184,6 +181,8 @@ void ssl_process_exit(int pid)
 	if (!kernel_version_check())
 		return;
 
+	proc_event_list_cancel(&proc_events, pid);
+
 	tracer = find_bpf_tracer(SK_TRACER_NAME);
 	if (tracer == NULL)
 		return;
@@ -195,34 +194,35 @@ void ssl_process_exit(int pid)
 
 void ssl_events_handle(void)
 {
-	struct process_create_event *event = NULL;
+	struct process_create_event *event, *n;
 	struct bpf_tracer *tracer = NULL;
+	struct list_head expired;
 	int count = 0;
-	do {
-		event = get_first_event(&proc_events);
-		if (!event)
-			break;
-
-		if (get_sys_uptime() < event->expire_time)
-			break;
-
-		if (event->stime != get_process_starttime(event->pid))
-			goto next;
-
-		tracer = event->tracer;
-		if (tracer) {
-			pthread_mutex_lock(&tracer->mutex_probes_lock);
-			openssl_parse_and_register(event->pid, tracer->tps);
-			tracer_uprobes_update(tracer);
-			tracer_hooks_process(tracer, HOOK_ATTACH, &count);
-			pthread_mutex_unlock(&tracer->mutex_probes_lock);
-		}
 
-	next:
-		remove_event(&proc_events, event);
-		process_event_free(event);
-
-	} while (true);
+	init_list_head(&expired);
+	while (proc_event_list_drain(&proc_events, &expired,
+				     PROC_EVENT_DRAIN_BATCH) > 0) {
+		list_for_each_entry_safe(event, n, &expired, list) {
+			list_head_del(&event->list);
+			if (event->stime != get_process_starttime(event->pid))
+				goto next;
+
+			tracer = event->tracer;
+			if (tracer) {
+				pthread_mutex_lock(&tracer->mutex_probes_lock);
+				openssl_parse_and_register(event->pid,
+							   tracer->tps);
+				tracer_uprobes_update(tracer);
+				tracer_hooks_process(tracer, HOOK_ATTACH,
+						     &count);
+				pthread_mutex_unlock
+				    (&tracer->mutex_probes_lock);
+			}
+
+		next:
+			process_event_free(event);
+		}
+	}
 }
 
 void openssl_trace_handle(int pid, enum match_pids_act act)
@@ -236,8 +236,7 @@ void openssl_trace_handle(int pid, enum match_pids_act act)
 
 void openssl_trace_init(void)
 {
-	init_list_head(&proc_events.head);
-	pthread_mutex_init(&proc_events.m, NULL);
+	proc_event_list_init(&proc_events, PROC_EVENT_HANDLE_DELAY);
 }
 
 void set_uprobe_openssl_enabled(bool enabled)
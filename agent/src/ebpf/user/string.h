@@ -50,7 +50,7 @@ always_inline void memset_s_inline(void *s, rsize_t smax, int c, rsize_t n)
 	u8 bad;
 
 	bad = (s == 0) + (n > smax);
-	ASSERT(bad != 0);
+	ASSERT(bad == 0);
 	memset(s, c, n);
 }
 
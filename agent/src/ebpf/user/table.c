@@ -26,6 +26,7 @@
 #include "load.h"
 #include "table.h"
 #include "log.h"
+#include "utils.h"
 
 bool bpf_table_get(struct bpf_tracer *tracer,
 			 const char *tb_name, void *key, void *val)
@@ -154,3 +155,218 @@ int bpf_table_get_fd(struct bpf_tracer *tracer, const char *tb_name)
 
 	return map->fd;
 }
+
+/*
+ * Delete the given keys, BPF_MAP_DELETE_BATCH (Linux 5.6+) is used if the
+ * table supports it, otherwise fall back to deleting them one by one.
+ * Keys that no longer exist are skipped. Returns the number of deleted
+ * elements.
+ */
+static uint32_t __delete_keys(int map_fd, uint32_t key_size, void *keys,
+			      uint32_t count,
+			      struct bpf_table_reclaim_stats *stats)
+{
+	uint32_t off = 0, n, deleted = 0;
+	bool batch = true;
+
+	while (off < count) {
+		if (batch) {
+			n = count - off;
+			stats->syscalls++;
+			int ret = bpf_delete_batch(map_fd, keys + off * key_size,
+						   &n);
+			/*
+			 * 'n' is copied back even if the kernel rejects the
+			 * call, it is the number of deleted keys only on
+			 * success or ENOENT.
+			 */
+			if (ret == 0) {
+				deleted += n;
+				break;
+			}
+			if (errno == ENOENT) {
+				/* Skip the key which has been deleted. */
+				deleted += n;
+				off += n + 1;
+				continue;
+			}
+			/*
+			 * Not supported, e.g. stack trace map or old kernel,
+			 * delete the same keys one by one.
+			 */
+			batch = false;
+			continue;
+		}
+
+		stats->syscalls++;
+		if (!bpf_delete_elem(map_fd, keys + off * key_size))
+			deleted++;
+		off++;
+	}
+
+	stats->batched |= batch;
+	return deleted;
+}
+
+uint32_t bpf_table_delete_keys(struct bpf_tracer *tracer, const char *tb_name,
+			       void *keys, uint32_t count,
+			       struct bpf_table_reclaim_stats *stats)
+{
+	struct ebpf_map *map = ebpf_obj__get_map_by_name(tracer->obj, tb_name);
+	if (map == NULL) {
+		ebpf_warning("[%s] map name \"%s\" map is NULL.\n", __func__,
+			     tb_name);
+		return 0;
+	}
+
+	uint64_t start = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+	uint32_t deleted = __delete_keys(map->fd, map->def.key_size, keys,
+					 count, stats);
+	stats->deleted += deleted;
+	stats->wall_ns += gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) - start;
+
+	return deleted;
+}
+
+/*
+ * Walk the table with BPF_MAP_LOOKUP_BATCH in chunks of BPF_TABLE_BATCH_NUM
+ * elements, and delete the selected ones of each chunk at once.
+ * Return 0 on success, or -1 if batch lookup is not supported.
+ */
+static int reclaim_batch(int map_fd, struct bpf_load_map_def *def,
+			 uint32_t max_reclaim, bpf_table_reclaim_cb_t cb,
+			 void *ctx, struct bpf_table_reclaim_stats *stats)
+{
+	/*
+	 * The batch token of hash tables is a bucket index (u32), the token
+	 * of array tables is a key.
+	 */
+	uint32_t token_size = def->key_size > 8 ? def->key_size : 8;
+	void *buf = malloc(2 * token_size +
+			   BPF_TABLE_BATCH_NUM * (2 * def->key_size +
+						  def->value_size));
+	if (buf == NULL) {
+		ebpf_warning("malloc() failed.\n");
+		return -1;
+	}
+
+	void *in_batch = buf;
+	void *out_batch = buf + token_size;
+	void *keys = out_batch + token_size;
+	void *del_keys = keys + BPF_TABLE_BATCH_NUM * def->key_size;
+	void *values = del_keys + BPF_TABLE_BATCH_NUM * def->key_size;
+	bool first = true;
+	uint32_t i, count, del_count;
+	int ret;
+
+	do {
+		count = BPF_TABLE_BATCH_NUM;
+		stats->syscalls++;
+		ret = bpf_lookup_batch(map_fd, first ? NULL : in_batch,
+				       out_batch, keys, values, &count);
+		if (ret != 0 && errno != ENOENT) {
+			if (first) {
+				free(buf);
+				return -1;
+			}
+			ebpf_warning("bpf_lookup_batch() failed, errno %d\n",
+				     errno);
+			break;
+		}
+
+		del_count = 0;
+		for (i = 0; i < count; i++) {
+			void *key = keys + i * def->key_size;
+			stats->walked++;
+			if (stats->deleted + del_count >= max_reclaim)
+				continue;
+			if (cb && !cb(key, values + i * def->value_size, ctx))
+				continue;
+			memcpy(del_keys + del_count * def->key_size, key,
+			       def->key_size);
+			del_count++;
+		}
+
+		if (del_count > 0)
+			stats->deleted += __delete_keys(map_fd, def->key_size,
+							del_keys, del_count,
+							stats);
+
+		memcpy(in_batch, out_batch, token_size);
+		first = false;
+	} while (ret == 0);
+
+	stats->batched = true;
+	free(buf);
+	return 0;
+}
+
+/*
+ * Fallback for kernels without BPF_MAP_LOOKUP_BATCH (before Linux 5.6) and
+ * tables which do not support it (e.g. BPF_MAP_TYPE_STACK_TRACE).
+ */
+static void reclaim_iter(int map_fd, struct bpf_load_map_def *def,
+			 uint32_t max_reclaim, bpf_table_reclaim_cb_t cb,
+			 void *ctx, struct bpf_table_reclaim_stats *stats)
+{
+	void *buf = calloc(2 * def->key_size + def->value_size, 1);
+	if (buf == NULL) {
+		ebpf_warning("calloc() failed.\n");
+		return;
+	}
+
+	void *key = buf, *next_key = buf + def->key_size;
+	void *value = next_key + def->key_size;
+	struct list_head clear_elem_head;
+	init_list_head(&clear_elem_head);
+	uint32_t reclaim_count = 0;
+
+	while (bpf_get_next_key(map_fd, key, next_key) == 0) {
+		stats->syscalls++;
+		stats->walked++;
+		if (reclaim_count < max_reclaim) {
+			if (cb) {
+				stats->syscalls++;
+				if (bpf_lookup_elem(map_fd, next_key, value) == 0
+				    && cb(next_key, value, ctx)
+				    && insert_list(next_key, def->key_size,
+						   &clear_elem_head))
+					reclaim_count++;
+			} else if (insert_list(next_key, def->key_size,
+					       &clear_elem_head)) {
+				reclaim_count++;
+			}
+		}
+		memcpy(key, next_key, def->key_size);
+	}
+	/* The last bpf_get_next_key() */
+	stats->syscalls++;
+
+	stats->syscalls += reclaim_count;
+	stats->deleted += __reclaim_map(map_fd, &clear_elem_head);
+	free(buf);
+}
+
+/*
+ * Walk the whole table and delete (at most 'max_reclaim') elements which
+ * are selected by 'cb'. The elements visited/deleted, the syscalls issued
+ * and the elapsed time are accumulated into 'stats'.
+ */
+int bpf_table_reclaim(struct bpf_tracer *tracer, const char *tb_name,
+		      uint32_t max_reclaim, bpf_table_reclaim_cb_t cb,
+		      void *ctx, struct bpf_table_reclaim_stats *stats)
+{
+	struct ebpf_map *map = ebpf_obj__get_map_by_name(tracer->obj, tb_name);
+	if (map == NULL) {
+		ebpf_warning("[%s] map name \"%s\" map is NULL.\n", __func__,
+			     tb_name);
+		return -1;
+	}
+
+	uint64_t start = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+	if (reclaim_batch(map->fd, &map->def, max_reclaim, cb, ctx, stats))
+		reclaim_iter(map->fd, &map->def, max_reclaim, cb, ctx, stats);
+	stats->wall_ns += gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) - start;
+
+	return 0;
+}
@@ -36,4 +36,30 @@ void insert_prog_to_map(struct bpf_tracer *tracer, const char *map_name,
 					const char *prog_name, int key);
 
 int bpf_table_get_fd(struct bpf_tracer *tracer, const char *tb_name);
+
+/*
+ * Number of elements fetched/deleted per BPF_MAP_*_BATCH syscall.
+ */
+#define BPF_TABLE_BATCH_NUM 256
+
+struct bpf_table_reclaim_stats {
+	uint32_t walked;	// Number of elements visited
+	uint32_t deleted;	// Number of elements deleted
+	uint32_t syscalls;	// Number of bpf() syscalls issued
+	uint64_t wall_ns;	// Elapsed wall time (in nanoseconds)
+	bool batched;		// Was BPF_MAP_*_BATCH used ?
+};
+
+/*
+ * Return true if the element (key, value) should be reclaimed. If no
+ * callback is given to bpf_table_reclaim(), all elements are reclaimed.
+ */
+typedef bool (*bpf_table_reclaim_cb_t)(void *key, void *value, void *ctx);
+
+int bpf_table_reclaim(struct bpf_tracer *tracer, const char *tb_name,
+		      uint32_t max_reclaim, bpf_table_reclaim_cb_t cb,
+		      void *ctx, struct bpf_table_reclaim_stats *stats);
+uint32_t bpf_table_delete_keys(struct bpf_tracer *tracer, const char *tb_name,
+			       void *keys, uint32_t count,
+			       struct bpf_table_reclaim_stats *stats);
 #endif /* DF_BPF_TABLE_H */
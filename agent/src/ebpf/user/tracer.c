@@ -20,9 +20,9 @@
 #include <signal.h>
 #include <sys/utsname.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
 #include <linux/version.h>
 #include <sys/epoll.h>
-#include <sys/timerfd.h>
 #include <bcc/bcc_proc.h>
 #include <bcc/bcc_elf.h>
 #include <bcc/libbpf.h>
@@ -40,6 +40,7 @@
 #include "elf.h"
 #include "load.h"
 #include "mem.h"
+#include "proc.h"
 #include "socket.h"
 #include "unwind_tracer.h"
 #include "extended/extended.h"
@@ -125,6 +126,9 @@ pthread_mutex_t match_pids_lock;
 pids_match_hash_t pids_match_hash;
 
 static int tracepoint_attach(struct tracepoint *tp);
+static int ringbuf_reader_setup(struct bpf_perf_reader *perf_reader,
+				const char *map_prefix, int rings_num,
+				int thread_nr);
 static int perf_reader_setup(struct bpf_perf_reader *perf_readerm,
 			     int thread_nr);
 static void perf_reader_release(struct bpf_perf_reader *perf_reader);
@@ -391,6 +395,9 @@ struct bpf_tracer *setup_bpf_tracer(const char *name,
 	}
 
 	init_list_head(&bt->probes_head);
+	init_list_head(&bt->probes_attach_head);
+	for (i = 0; i < PROBES_PID_INDEX_SIZE; i++)
+		init_list_head(&bt->probes_pid_index[i]);
 	init_list_head(&bt->maps_conf_head);
 
 	pthread_mutex_init(&bt->mutex_probes_lock, NULL);
@@ -518,6 +525,45 @@ failed:
 	return NULL;
 }
 
+struct bpf_perf_reader *create_ringbuf_reader(struct bpf_tracer *t,
+					      const char *map_prefix,
+					      int rings_num,
+					      perf_reader_raw_cb raw_cb,
+					      unsigned int pages_cnt,
+					      int thread_nr,
+					      int epoll_timeout)
+{
+	if (t == NULL || map_prefix == NULL || raw_cb == NULL ||
+	    rings_num <= 0 || thread_nr <= 0) {
+		ebpf_error("create_ringbuf_reader() Invalid parameter."
+			   "t %p map_prefix %s raw_cb %p rings_num %d "
+			   "thread_nr %d\n", t, map_prefix, raw_cb, rings_num,
+			   thread_nr);
+		return NULL;
+	}
+
+	struct bpf_perf_reader *reader = alloc_reader(t);
+	if (reader == NULL)
+		return NULL;
+
+	snprintf(reader->name, sizeof(reader->name), "%s", map_prefix);
+	reader->raw_cb = raw_cb;
+	reader->is_ringbuf = true;
+	reader->tracer = t;
+	reader->perf_pages_cnt = pages_cnt;
+	reader->epoll_timeout = epoll_timeout;
+
+	if (ringbuf_reader_setup(reader, map_prefix, rings_num, thread_nr))
+		goto failed;
+
+	return reader;
+
+failed:
+	perf_reader_release(reader);
+	free_reader(reader);
+	return NULL;
+}
+
 void free_perf_buffer_reader(struct bpf_perf_reader *reader)
 {
 	perf_reader_release(reader);
@@ -528,7 +574,19 @@ static int map_resize_set(struct ebpf_object *obj, struct map_config *m_conf)
 {
 	struct ebpf_map *map = ebpf_obj__get_map_by_name(obj, m_conf->map_name);
 	if (!map) {
-		ebpf_info("failed to find \"%s\" map.\n", m_conf->map_name);
+		/*
+		 * The socket ring buffer maps only exist in the ring buffer
+		 * variant, they are sized even if the perf buffer binary is
+		 * loaded instead.
+		 */
+		if (!strncmp(m_conf->map_name, MAP_SOCKET_RINGBUF_PREFIX,
+			     strlen(MAP_SOCKET_RINGBUF_PREFIX))) {
+			ebpf_info("failed to find \"%s\" map, skip it.\n",
+				  m_conf->map_name);
+			return ETR_OK;
+		}
+
+		ebpf_warning("failed to find \"%s\" map.\n", m_conf->map_name);
 		return ETR_NOTEXIST;
 	}
 
@@ -700,10 +758,16 @@ static struct kfunc *get_kfunc_from_tracer(struct bpf_tracer *tracer,
 void add_probe_to_tracer(struct probe *pb)
 {
 	struct bpf_tracer *tracer = pb->tracer;
-	if (pb->type == UPROBE && pb->private_data != NULL)
-		((struct symbol_uprobe *)pb->private_data)->in_probe = true;
+	struct symbol_uprobe *usym = pb->private_data;
+	if (pb->type == UPROBE && usym != NULL) {
+		usym->in_probe = true;
+		list_add_tail(&pb->pid_list,
+			      tracer_pid_probes(tracer, usym->pid));
+	} else
+		init_list_head(&pb->pid_list);
 
 	list_add_tail(&pb->list, &tracer->probes_head);
+	list_add_tail(&pb->attach_list, &tracer->probes_attach_head);
 	tracer->probes_count++;
 }
 
@@ -716,6 +780,8 @@ void free_probe_from_tracer(struct probe *pb)
 	}
 
 	list_head_del(&pb->list);
+	list_head_del(&pb->pid_list);
+	list_head_del(&pb->attach_list);
 	tracer->probes_count--;
 	free(pb);
 }
@@ -872,6 +938,208 @@ static struct ebpf_link *exec_attach_kprobe(struct ebpf_prog *prog, char *name,
 	return link;
 }
 
+static int exec_detach_uprobe(struct ebpf_link *link, const char *bin_path,
+			      size_t addr, bool isret);
+
+/*
+ * OpenSSL uprobes are attached once per (binary file, address, program)
+ * for all processes (pid -1) rather than once per process, the processes
+ * of hundreds of pods usually map the same libssl.so inode. The eBPF
+ * programs only handle the processes found in a PID allowlist map, which
+ * holds the processes having at least one of these uprobes installed.
+ */
+#define SHARED_UPROBE_HASH_SIZE	256
+
+struct shared_uprobe {
+	struct list_head list;	// Hash chain
+	dev_t dev;
+	ino_t ino;
+	size_t entry;
+	bool isret;
+	struct ebpf_prog *prog;
+	char *binary_path;	// The path attached with, used for detaching
+	struct ebpf_link *link;
+	int refcnt;		// Number of probes sharing the uprobe
+};
+
+struct shared_uprobe_pid {
+	struct list_head list;	// Hash chain
+	struct bpf_tracer *tracer;
+	const char *map_name;
+	int pid;
+	int refcnt;		// Number of shared uprobes of the process
+};
+
+static struct list_head shared_uprobes[SHARED_UPROBE_HASH_SIZE];
+static struct list_head shared_uprobe_pids[SHARED_UPROBE_HASH_SIZE];
+static pthread_mutex_t shared_uprobes_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool shared_uprobes_inited;
+
+/* The PID allowlist map of a uprobe, NULL if it is attached per process. */
+static const char *shared_uprobe_pids_map(struct symbol_uprobe *usym)
+{
+	if (usym->type == OPENSSL_UPROBE)
+		return MAP_SSL_PIDS_NAME;
+
+	return NULL;
+}
+
+static inline u32 shared_uprobe_hash(dev_t dev, ino_t ino, size_t entry)
+{
+	u64 h = ((u64) dev * 31 + ino) * 31 + entry;
+	return (h ^ (h >> 17)) & (SHARED_UPROBE_HASH_SIZE - 1);
+}
+
+/* Called with shared_uprobes_lock held. */
+static bool shared_uprobe_pid_get(struct bpf_tracer *tracer,
+				  const char *map_name, int pid)
+{
+	struct list_head *head;
+	struct shared_uprobe_pid *sp;
+	u8 allow = 1;
+	int i;
+
+	if (!shared_uprobes_inited) {
+		for (i = 0; i < SHARED_UPROBE_HASH_SIZE; i++) {
+			init_list_head(&shared_uprobes[i]);
+			init_list_head(&shared_uprobe_pids[i]);
+		}
+		shared_uprobes_inited = true;
+	}
+
+	head = &shared_uprobe_pids[pid & (SHARED_UPROBE_HASH_SIZE - 1)];
+	list_for_each_entry(sp, head, list) {
+		if (sp->pid == pid && sp->tracer == tracer &&
+		    sp->map_name == map_name) {
+			sp->refcnt++;
+			return true;
+		}
+	}
+
+	sp = calloc(1, sizeof(*sp));
+	if (sp == NULL) {
+		ebpf_warning("calloc() error.\n");
+		return false;
+	}
+
+	if (!bpf_table_set_value(tracer, map_name, pid, &allow)) {
+		free(sp);
+		return false;
+	}
+
+	sp->tracer = tracer;
+	sp->map_name = map_name;
+	sp->pid = pid;
+	sp->refcnt = 1;
+	list_add_tail(&sp->list, head);
+	return true;
+}
+
+/* Called with shared_uprobes_lock held. */
+static void shared_uprobe_pid_put(struct bpf_tracer *tracer,
+				  const char *map_name, int pid)
+{
+	struct list_head *head;
+	struct shared_uprobe_pid *sp;
+
+	head = &shared_uprobe_pids[pid & (SHARED_UPROBE_HASH_SIZE - 1)];
+	list_for_each_entry(sp, head, list) {
+		if (sp->pid == pid && sp->tracer == tracer &&
+		    sp->map_name == map_name) {
+			if (--sp->refcnt == 0) {
+				bpf_table_delete_key(tracer, map_name, pid);
+				list_head_del(&sp->list);
+				free(sp);
+			}
+			return;
+		}
+	}
+}
+
+static int shared_uprobe_attach(struct probe *p, struct symbol_uprobe *usym,
+				bool isret, const char *map_name)
+{
+	struct shared_uprobe *su;
+	struct list_head *head;
+	struct stat st;
+
+	if (stat(usym->binary_path, &st) != 0)
+		return ETR_INVAL;
+
+	pthread_mutex_lock(&shared_uprobes_lock);
+	if (!shared_uprobe_pid_get(p->tracer, map_name, usym->pid)) {
+		pthread_mutex_unlock(&shared_uprobes_lock);
+		return ETR_INVAL;
+	}
+
+	head = &shared_uprobes[shared_uprobe_hash(st.st_dev, st.st_ino,
+						  usym->entry)];
+	list_for_each_entry(su, head, list) {
+		if (su->ino == st.st_ino && su->dev == st.st_dev &&
+		    su->entry == usym->entry && su->isret == isret &&
+		    su->prog == p->prog)
+			goto found;
+	}
+
+	su = calloc(1, sizeof(*su));
+	if (su == NULL || (su->binary_path = strdup(usym->binary_path)) == NULL)
+		goto failed;
+
+	su->link = exec_attach_uprobe(p->prog, usym->binary_path, usym->entry,
+				      isret, -1);
+	if (su->link == NULL)
+		goto failed;
+	AO_INC(&p->tracer->links_count);
+
+	su->dev = st.st_dev;
+	su->ino = st.st_ino;
+	su->entry = usym->entry;
+	su->isret = isret;
+	su->prog = p->prog;
+	list_add_tail(&su->list, head);
+
+found:
+	su->refcnt++;
+	p->shared = su;
+	p->link = su->link;
+	p->installed = true;
+	pthread_mutex_unlock(&shared_uprobes_lock);
+	return ETR_OK;
+
+failed:
+	if (su) {
+		free(su->binary_path);
+		free(su);
+	}
+	shared_uprobe_pid_put(p->tracer, map_name, usym->pid);
+	pthread_mutex_unlock(&shared_uprobes_lock);
+	return ETR_INVAL;
+}
+
+static int shared_uprobe_detach(struct probe *p, struct symbol_uprobe *usym)
+{
+	struct shared_uprobe *su = p->shared;
+	int ret = 0;
+
+	pthread_mutex_lock(&shared_uprobes_lock);
+	if (--su->refcnt == 0) {
+		ret = exec_detach_uprobe(su->link, su->binary_path, su->entry,
+					 su->isret);
+		AO_DEC(&p->tracer->links_count);
+		list_head_del(&su->list);
+		free(su->binary_path);
+		free(su);
+	}
+	shared_uprobe_pid_put(p->tracer, shared_uprobe_pids_map(usym),
+			      usym->pid);
+	pthread_mutex_unlock(&shared_uprobes_lock);
+
+	p->shared = NULL;
+	p->link = NULL;
+	p->installed = false;
+	return ret;
+}
+
 int probe_attach(struct probe *p)
 {
 	if (p->link || p->installed) {
@@ -898,6 +1166,10 @@ int probe_attach(struct probe *p)
 		if (usym->type == GO_UPROBE && usym->isret)
 			ret = false;
 
+		const char *pids_map = shared_uprobe_pids_map(usym);
+		if (pids_map)
+			return shared_uprobe_attach(p, usym, ret, pids_map);
+
 		link = exec_attach_uprobe(p->prog, usym->binary_path,
 					  usym->entry, ret, usym->pid);
 	}
@@ -906,6 +1178,7 @@ int probe_attach(struct probe *p)
 	if (link == NULL)
 		return ETR_INVAL;
 
+	AO_INC(&p->tracer->links_count);
 	p->installed = true;
 	return ETR_OK;
 }
@@ -954,6 +1227,9 @@ int probe_detach(struct probe *p)
 			p->link = NULL;
 	} else {		/* UPROBE */
 		struct symbol_uprobe *usym = p->private_data;
+		if (p->shared)
+			return shared_uprobe_detach(p, usym);
+
 		bool isret = usym->isret;
 		if (usym->type == GO_UPROBE && usym->isret)
 			isret = false;
@@ -964,8 +1240,10 @@ int probe_detach(struct probe *p)
 			p->link = NULL;
 	}
 
-	if (ret == 0)
+	if (ret == 0) {
+		AO_DEC(&p->tracer->links_count);
 		p->installed = false;
+	}
 
 	return ret;
 }
@@ -1073,18 +1351,30 @@ int tracer_hooks_process(struct bpf_tracer *tracer, enum tracer_hook_type type,
 	int error, count = 0;
 	struct list_head *c, *n;
 
-	list_for_each_safe(c, n, &tracer->probes_head) {
-		p = container_of(c, struct probe, list);
+	/*
+	 * Only the probes not attached yet are visited when attaching, the
+	 * probes detached are queued for the next attach.
+	 */
+	list_for_each_safe(c, n, type == HOOK_ATTACH ?
+			   &tracer->probes_attach_head : &tracer->probes_head) {
+		if (type == HOOK_ATTACH)
+			p = container_of(c, struct probe, attach_list);
+		else
+			p = container_of(c, struct probe, list);
 		if (!p)
 			return ETR_INVAL;
 
-		if (tracer->probes_count > OPEN_FILES_MAX) {
+		if (type == HOOK_ATTACH &&
+		    tracer->links_count >= OPEN_FILES_MAX) {
 			ebpf_warning
-			    ("Probes count too many. The maximum is %d\n",
+			    ("Probe attachments too many. The maximum is %d\n",
 			     OPEN_FILES_MAX);
 			break;
 		}
 
+		if (type == HOOK_ATTACH)
+			list_del_init(&p->attach_list);
+
 		error = probe_handle(p);
 		if (type == HOOK_ATTACH && error == ETR_EXIST)
 			continue;
@@ -1105,6 +1395,9 @@ int tracer_hooks_process(struct bpf_tracer *tracer, enum tracer_hook_type type,
 			continue;
 		}
 
+		if (type == HOOK_DETACH)
+			list_add_tail(&p->attach_list,
+				      &tracer->probes_attach_head);
 		count++;
 	}
 
@@ -1343,6 +1636,15 @@ int tracer_hooks_detach(struct bpf_tracer *tracer)
 static void perf_reader_release(struct bpf_perf_reader *perf_reader)
 {
 	int i;
+	if (perf_reader->is_ringbuf) {
+		for (i = 0; i < perf_reader->epoll_fds_count; i++) {
+			if (perf_reader->ringbufs[i])
+				ring_buffer__free(perf_reader->ringbufs[i]);
+		}
+		ebpf_info("bpf_perf_reader %s release.\n", perf_reader->name);
+		return;
+	}
+
 	for (i = 0; i < perf_reader->readers_count; i++) {
 		perf_reader_free(perf_reader->readers[i]);
 	}
@@ -1435,6 +1737,83 @@ static int perf_reader_setup(struct bpf_perf_reader *perf_reader, int thread_nr)
 	return ETR_OK;
 }
 
+struct ringbuf_forward_info {
+	struct reader_forward_info fwd;
+	perf_reader_raw_cb raw_cb;
+};
+
+static int ringbuf_sample_cb(void *ctx, void *data, size_t size)
+{
+	struct ringbuf_forward_info *info = ctx;
+	info->raw_cb(&info->fwd, data, (int)size);
+	return 0;
+}
+
+/*
+ * Ring 'i' (map "<map_prefix>_<i>") is read by reader thread
+ * 'i % thread_nr', each thread polls one libbpf ring_buffer holding
+ * all of its rings.
+ */
+static int ringbuf_reader_setup(struct bpf_perf_reader *perf_reader,
+				const char *map_prefix, int rings_num,
+				int thread_nr)
+{
+	char map_name[NAME_LEN];
+	struct ebpf_map *map;
+	int i, tid, ret;
+
+	if (thread_nr > rings_num)
+		thread_nr = rings_num;
+	perf_reader->epoll_fds_count = thread_nr;
+
+	for (i = 0; i < rings_num; i++) {
+		snprintf(map_name, sizeof(map_name), "%s_%d", map_prefix, i);
+		map = ebpf_obj__get_map_by_name(perf_reader->tracer->obj,
+						map_name);
+		if (map == NULL) {
+			ebpf_error("Ring buffer map %s not found.\n", map_name);
+			return ETR_NOTEXIST;
+		}
+
+		struct ringbuf_forward_info *info =
+		    malloc(sizeof(struct ringbuf_forward_info));
+		if (info == NULL) {
+			ebpf_error("ringbuf_forward_info malloc() failed.\n");
+			return ETR_NOMEM;
+		}
+
+		tid = i % thread_nr;
+		info->fwd.queue_id = tid;
+		info->fwd.cpu_id = -1;
+		info->fwd.tracer = perf_reader->tracer;
+		info->raw_cb = perf_reader->raw_cb;
+
+		if (perf_reader->ringbufs[tid] == NULL) {
+			perf_reader->ringbufs[tid] =
+			    ring_buffer__new(map->fd, ringbuf_sample_cb,
+					     info, NULL);
+			ret = perf_reader->ringbufs[tid] ? 0 : -1;
+		} else {
+			ret = ring_buffer__add(perf_reader->ringbufs[tid],
+					       map->fd, ringbuf_sample_cb,
+					       info);
+		}
+
+		if (ret) {
+			ebpf_error("Add ring buffer %s failed.\n", map_name);
+			free(info);
+			return ETR_NORESOURCE;
+		}
+
+		ebpf_debug("Ring buffer %s -> reader thread %d\n", map_name,
+			   tid);
+		perf_reader->reader_fds[perf_reader->readers_count++] =
+		    map->fd;
+	}
+
+	return ETR_OK;
+}
+
 static void extra_waiting_process(int type)
 {
 	struct extra_waiting_op *ewo;
@@ -1588,126 +1967,108 @@ static int boot_time_update(void)
 	return ETR_OK;
 }
 
-/* 
- * Thread function to periodically trigger a kernel-related action.
- *
- * The kernel uses bundled bursts to send data to the user.  
- * The following method triggers a timeout check on all CPUs  
- * to push data residing in the eBPF buffer.
+/*
+ * Kick thread statistics, read and reset by get_kick_kern_stats().
  */
-static void *kick_kern_push_data(void *arg)
-{
-	int cpu_id = (int)((uintptr_t) arg);	// Extract CPU ID from the argument
-	char thread_name[NAME_LEN];
+static atomic64_t kick_kern_count;
+static atomic64_t kick_kern_cpu_ns;
+static atomic64_t kick_kern_sweep_max_ns;
 
-	// Set a descriptive thread name
-	snprintf(thread_name, sizeof(thread_name), "kick-kern-%d", cpu_id);
-	prctl(PR_SET_NAME, thread_name);
-
-	int tfd = -1, epfd = -1;
-	// Set CPU affinity for the thread
+/*
+ * Trigger a timeout check on 'cpu', pushing the data residing in its eBPF
+ * buffer: the calling thread migrates to the CPU and enters the kernel.
+ */
+static inline int kick_kern_cpu(int cpu)
+{
 	cpu_set_t cpuset;
 	CPU_ZERO(&cpuset);
-	CPU_SET(cpu_id, &cpuset);
-
-	if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) !=
-	    0) {
-		ebpf_warning("pthread_setaffinity_np() failed: %s(%d)\n",
-			     strerror(errno), errno);
-		goto error;
-	}
-	// Create a timerfd for periodic notifications
-	tfd = timerfd_create(CLOCK_MONOTONIC, 0);
-	if (tfd == -1) {
-		ebpf_warning("timerfd_create failed: %s(%d)\n", strerror(errno),
-			     errno);
-		goto error;
-	}
-
-	struct itimerspec timer_spec = {
-		.it_interval = {.tv_sec = 0,.tv_nsec = KICK_KERN_PERIOD},
-		.it_value = {.tv_sec = 0,.tv_nsec = KICK_KERN_PERIOD}
-	};
+	CPU_SET(cpu, &cpuset);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset))
+		return ETR_INVAL;
 
-	if (timerfd_settime(tfd, 0, &timer_spec, NULL) == -1) {
-		ebpf_warning("timerfd_settime failed: %s(%d)\n",
-			     strerror(errno), errno);
-		goto error;
-	}
-	// Create epoll instance and add timerfd
-	epfd = epoll_create1(0);
-	if (epfd == -1) {
-		ebpf_warning("epoll_create1 failed: %s(%d)\n", strerror(errno),
-			     errno);
-		goto error;
-	}
+	syscall(__NR_getppid);	// Trigger a kernel-related action (sample action)
+	return ETR_OK;
+}
 
-	struct epoll_event ev = {
-		.events = EPOLLIN,
-		.data.fd = tfd
-	};
+/*
+ * The kernel uses bundled bursts to send data to the user. A single
+ * unpinned thread periodically visits the CPUs that have data buffered in
+ * the eBPF push buffer and kicks them. Idle CPUs are left alone, so an idle
+ * host only pays for one wakeup and one map lookup per period.
+ */
+static void *kick_kern_main(__unused void *arg)
+{
+	prctl(PR_SET_NAME, "kick-kern");
+	bool pending[sys_cpus_count];
+	uint64_t periods = 0, start_ns, cpu_ns, sweep_ns, max_ns;
+	cpu_set_t allowed;
+	bool kick_all;
+	int i, kicks, ret;
 
-	if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) == -1) {
-		ebpf_warning("epoll_ctl failed: %s(%d)\n", strerror(errno),
-			     errno);
-		goto error;
+	ret = pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed);
+	if (ret) {
+		ebpf_warning("pthread_getaffinity_np() failed: %s(%d)\n",
+			     strerror(ret), ret);
+		pthread_exit(NULL);
 	}
 
-	struct epoll_event events[1];
-	ssize_t ret;
-
 	for (;;) {
-		int nfds = epoll_wait(epfd, events, 1, -1);
-		if (nfds > 0 && events[0].data.fd == tfd) {
-			uint64_t expirations;
-			while (1) {
-				ret =
-				    read(tfd, &expirations,
-					 sizeof(expirations));
-				if (ret == -1) {
-					if (errno == EINTR || errno == EAGAIN
-					    || errno == EWOULDBLOCK) {
-						continue;
-					} else {
-						ebpf_warning
-						    ("read from timerfd failed: %s(%d)\n",
-						     strerror(errno), errno);
-						goto error;
-					}
-				}
-				break;
-			}
+		usleep(KICK_KERN_PERIOD / 1000);
+
+		start_ns = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+		cpu_ns = gettime(CLOCK_THREAD_CPUTIME_ID, TIME_TYPE_NAN);
+		kick_all = (++periods % KICK_KERN_ALL_PERIODS == 0);
+		if (!kick_all &&
+		    socket_tracer_buffered_cpus(pending, sys_cpus_count))
+			kick_all = true;
+
+		kicks = 0;
+		for (i = 0; i < sys_cpus_count; i++) {
+			if (!cpu_online[i] || !CPU_ISSET(i, &allowed) ||
+			    !(kick_all || pending[i]))
+				continue;
+			if (kick_kern_cpu(i) == ETR_OK)
+				kicks++;
+			else
+				ebpf_debug("Kick cpu %d failed: %s(%d)\n", i,
+					   strerror(errno), errno);
+		}
 
-			if (ret != sizeof(expirations)) {
-				ebpf_warning("Kick kernel timer read error.\n");
-				goto error;
-			}
+		// Do not stay on the last kicked CPU.
+		if (kicks > 0)
+			pthread_setaffinity_np(pthread_self(), sizeof(allowed),
+					       &allowed);
 
-			syscall(__NR_getppid);	// Trigger a kernel-related action (sample action)
-		}
+		sweep_ns = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) - start_ns;
+		cpu_ns = gettime(CLOCK_THREAD_CPUTIME_ID, TIME_TYPE_NAN) - cpu_ns;
+		atomic64_add(&kick_kern_count, kicks);
+		atomic64_add(&kick_kern_cpu_ns, cpu_ns);
+		max_ns = atomic64_read(&kick_kern_sweep_max_ns);
+		if (sweep_ns > max_ns)
+			atomic64_set(&kick_kern_sweep_max_ns, sweep_ns);
 	}
 
-error:
-	if (tfd > 0)
-		close(tfd);
-	if (epfd > 0)
-		close(epfd);
 	pthread_exit(NULL);
 }
 
+void get_kick_kern_stats(uint64_t * kicks, uint64_t * cpu_us,
+			 uint64_t * sweep_max_us)
+{
+	*kicks = atomic64_read(&kick_kern_count);
+	*cpu_us = atomic64_read(&kick_kern_cpu_ns) / NS_IN_USEC;
+	*sweep_max_us = atomic64_read(&kick_kern_sweep_max_ns) / NS_IN_USEC;
+	atomic64_sub(&kick_kern_count, *kicks);
+	atomic64_sub(&kick_kern_cpu_ns, *cpu_us * NS_IN_USEC);
+	atomic64_set(&kick_kern_sweep_max_ns, 0);
+}
+
 static void period_process_main(__unused void *arg)
 {
 	prctl(PR_SET_NAME, "period-process");
-	pthread_t threads[sys_cpus_count];
-	int i;
-	for (i = 0; i < sys_cpus_count; i++) {
-		if (cpu_online[i])
-			if (pthread_create
-			    (&threads[i], NULL, kick_kern_push_data,
-			     (void *)(uintptr_t) i) != 0) {
-				ebpf_warning("pthread_create failed");
-			}
-	}
+	pthread_t kick_thread;
+
+	if (pthread_create(&kick_thread, NULL, kick_kern_main, NULL) != 0)
+		ebpf_warning("pthread_create kick_kern_main failed");
 
 	// Only this unique identifier can be adapted to the kernel
 	adapt_kern_uid =
@@ -1807,6 +2168,12 @@ static int tracer_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
 			    atomic64_read(&t->queues[j].dequeue_nr);
 			rx_q->heap_get_failed =
 			    atomic64_read(&t->queues[j].heap_get_failed);
+			rx_q->bytes_in_flight =
+			    atomic64_read(&t->queues[j].slab.bytes_in_flight);
+			rx_q->wakeup_count =
+			    atomic64_read(&t->queues[j].wakeup_count);
+			rx_q->steal_count =
+			    atomic64_read(&t->queues[j].steal_count);
 			rx_q->queue_size = ring_count(t->queues[j].r);
 			rx_q->ring_capacity = t->queues[j].r->capacity;
 		}
@@ -2218,6 +2585,9 @@ int bpf_tracer_init(const char *log_file, bool is_stdout)
 
 	init_thread_ids();
 
+	/* Share the /proc/<pid>/maps snapshots with the trace-utils crate. */
+	proc_maps_cache_init();
+
 	if (!check_netns_enabled())
 		ebpf_warning("If the system has not enabled the 'CONFIG_NET_NS'"
 			     " option, the 'netns_id' for continuously profiling"
@@ -74,6 +74,9 @@
 
 #define PROBE_NAME_SZ   128
 
+// Buckets of the index of uprobes by PID, power of 2
+#define PROBES_PID_INDEX_SIZE	1024
+
 #define MAX_CPU_NR      256
 
 // RHEL 7 & CentOS 7 systems that run on kernel 3.10.
@@ -272,9 +275,21 @@ enum {
 	SOCKOPT_PRINT_MATCH_PIDS = 800,
 };
 
+/*
+ * A burst of socket data is copied into one memory block, whose events may
+ * be dispatched to different queues. The block starts with a reference
+ * count of its queued events, the worker dropping the last one frees it.
+ */
+struct mem_block_ref {
+	volatile uint32_t refcnt;
+} __attribute__ ((aligned(16)));
+
+#define FLOW_BUCKET_NONE ((uint32_t)-1)
+
 struct mem_block_head {
-	uint8_t is_last;
-	void *free_ptr;
+	uint32_t flow_bucket;	// FLOW_BUCKET_NONE if not dispatched by flow
+	uint16_t flow_owner;	// queue the event was dispatched to
+	void *free_ptr;		// points to struct mem_block_ref
 	void (*fn) (void *);
 } __attribute__ ((packed));
 
@@ -303,6 +318,9 @@ struct probe {
 	void *private_data;	// Store uprobe information
 	bool installed;
 	struct bpf_tracer *tracer;
+	struct list_head pid_list;	// Uprobes of the same PID bucket
+	struct list_head attach_list;	// Probes waiting to be attached
+	struct shared_uprobe *shared;	// Uprobe attached for all processes
 };
 
 struct tracepoint {
@@ -319,6 +337,14 @@ struct kfunc {
 	int prog_fd;
 };
 
+/*
+ * 流桶在工作线程held中暂存的事件。
+ */
+struct flow_held {
+	u32 nr;			// held中该流桶的事件数
+	u32 pass;		// 该流桶的事件在第pass轮遍历held时被保留
+};
+
 struct queue {
 	struct bpf_tracer *t;
 	struct ring *r;
@@ -327,10 +353,23 @@ struct queue {
 	int nr;			// datas_burst中data数量
 
 	/*
-	 * 用于唤醒工作线程从队列上获取数据进行处理。
+	 * 用于唤醒工作线程从队列上获取数据进行处理（eventcount方式）。
+	 * 工作线程队列为空时先自旋一段时间，仍无数据才在wake_seq上
+	 * futex等待并设置parked；生产者只有在parked时才进行futex唤醒。
 	 */
-	pthread_mutex_t mutex;
-	pthread_cond_t cond;
+	volatile u32 wake_seq;
+	volatile u32 parked;
+	atomic64_t wakeup_count;	// 生产者futex唤醒工作线程的次数
+	atomic64_t steal_count;		// 工作线程空闲时从其他队列迁移来的流桶数
+
+	/*
+	 * 流桶从其他队列迁移而来、旧队列尚未处理完该流桶之前的事件时，
+	 * 新事件按序暂存于held稍后处理，工作线程从不等待其他队列
+	 * （见socket_data_hold()）。只由本队列的工作线程访问。
+	 */
+	void **held;			// vec，暂存的事件
+	struct flow_held *flow_held;	// 每个流桶一项，共FLOW_BUCKETS_NUM项
+	u32 held_pass;			// 遍历held的轮数
 
 	/*
 	 * 各种统计
@@ -340,6 +379,12 @@ struct queue {
 	atomic64_t burst_count;
 	atomic64_t dequeue_nr;
 	atomic64_t heap_get_failed;	// 从heap上获取内存失败的次数统计
+
+	/*
+	 * 存放socket data的内存块由reader线程从slab上申请，工作线程
+	 * 处理完成后无锁归还。
+	 */
+	clib_slab_t slab;
 };
 
 /*
@@ -353,13 +398,31 @@ struct map_config {
 
 struct ebpf_object;
 struct perf_reader;
+struct ring_buffer;
 struct bpf_tracer;
 typedef int (*tracer_op_fun_t) (struct bpf_tracer *);
 
+/*
+ * BPF ring buffer API of the libbpf bundled with bcc.
+ */
+typedef int (*ring_buffer_sample_fn) (void *ctx, void *data, size_t size);
+extern struct ring_buffer *ring_buffer__new(int map_fd,
+					    ring_buffer_sample_fn sample_cb,
+					    void *ctx, const void *opts);
+extern int ring_buffer__add(struct ring_buffer *rb, int map_fd,
+			    ring_buffer_sample_fn sample_cb, void *ctx);
+extern int ring_buffer__poll(struct ring_buffer *rb, int timeout_ms);
+extern int ring_buffer__consume(struct ring_buffer *rb);
+extern void ring_buffer__free(struct ring_buffer *rb);
+
 /*
  * This is used to read data from the perf buffer, and each MAP
  * (type: PF_MAP_TYPE_PERF_EVENT_ARRAY) corresponds to it. A tracer
  * may contain multiple readers.
+ *
+ * A reader created by create_ringbuf_reader() reads a set of shared BPF
+ * ring buffer maps (type: BPF_MAP_TYPE_RINGBUF) instead, 'readers_count'
+ * is then the number of rings.
  */
 struct bpf_perf_reader {
 	char name[NAME_LEN];	// perf ring-buffer map
@@ -375,6 +438,9 @@ struct bpf_perf_reader {
 	int epoll_fds[MAX_CPU_NR];
 	int epoll_fds_count;
 	struct bpf_tracer *tracer;
+
+	bool is_ringbuf;	// Reads BPF ring buffers, not perf buffers.
+	struct ring_buffer *ringbufs[MAX_CPU_NR];	// One ring set per reader thread.
 };
 
 struct bpf_tracer {
@@ -396,6 +462,13 @@ struct bpf_tracer {
 	struct tracer_probes_conf *tps;	// probe, tracepoint, uprobes config
 	struct list_head probes_head;
 	int probes_count;	// probe count.
+	/*
+	 * Kernel attachments of the probes, a uprobe shared by the processes
+	 * mapping the same file counts once. Bounded by OPEN_FILES_MAX.
+	 */
+	volatile int links_count;
+	struct list_head probes_attach_head;	// Probes not attached yet
+	struct list_head probes_pid_index[PROBES_PID_INDEX_SIZE];	// Uprobes by PID
 	struct tracepoint tracepoints[PROBES_NUM_MAX];
 	int tracepoints_count;
 	struct kfunc kfuncs[PROBES_NUM_MAX];
@@ -509,6 +582,9 @@ struct rx_queue_info {
 	uint64_t burst_count;
 	uint64_t dequeue_nr;
 	uint64_t heap_get_failed;
+	uint64_t bytes_in_flight;
+	uint64_t wakeup_count;
+	uint64_t steal_count;
 	int queue_size;
 	int ring_capacity;
 } __attribute__ ((aligned(8)));
@@ -634,6 +710,8 @@ struct bpf_tracer *find_bpf_tracer(const char *name);
 int register_period_event_op(const char *name,
 			     period_event_fun_t f, uint32_t period_time);
 int set_period_event_invalid(const char *name);
+void get_kick_kern_stats(uint64_t * kicks, uint64_t * cpu_us,
+			 uint64_t * sweep_max_us);
 
 /**
  * probe_detach - eBPF probe detach
@@ -657,6 +735,18 @@ int tracer_hooks_process(struct bpf_tracer *tracer,
 int tracer_uprobes_update(struct bpf_tracer *tracer);
 int probe_attach(struct probe *p);
 
+/*
+ * Uprobes of a process are found through the PID index of the tracer:
+ *
+ * list_for_each_entry_safe(p, n, tracer_pid_probes(tracer, pid), pid_list)
+ *         if (((struct symbol_uprobe *)p->private_data)->pid == pid) ...
+ */
+static inline struct list_head *tracer_pid_probes(struct bpf_tracer *tracer,
+						  int pid)
+{
+	return &tracer->probes_pid_index[pid & (PROBES_PID_INDEX_SIZE - 1)];
+}
+
 /**
  * @brief Create a perf buffer reader.
  *
@@ -677,6 +767,25 @@ struct bpf_perf_reader *create_perf_buffer_reader(struct bpf_tracer *t,
 						  unsigned int pages_cnt,
 						  int thread_nr,
 						  int epoll_timeout);
+/**
+ * @brief Create a reader for shared BPF ring buffers.
+ *
+ * @param t tracer
+ * @param map_prefix ring buffer maps are named "<map_prefix>_<index>"
+ * @param rings_num number of ring buffer maps
+ * @param raw_cb reader raw data callback, same as for perf buffers
+ * @param pages_cnt pages per ring, only recorded for statistics
+ * @param thread_nr The number of threads required for the reader's work
+ * @param epoll_timeout ring poll timeout
+ * @return perf_reader address on success, NULL on error
+ */
+struct bpf_perf_reader *create_ringbuf_reader(struct bpf_tracer *t,
+					      const char *map_prefix,
+					      int rings_num,
+					      perf_reader_raw_cb raw_cb,
+					      unsigned int pages_cnt,
+					      int thread_nr,
+					      int epoll_timeout);
 void free_perf_buffer_reader(struct bpf_perf_reader *reader);
 int release_bpf_tracer(const char *name);
 void free_all_readers(struct bpf_tracer *t);
@@ -46,8 +46,7 @@ extern int major, minor;
 
 bool dwarf_available(void) { return major > 5 || (major == 5 && minor >= 2); }
 
-static proc_event_list_t proc_events = { .head = { .prev = &proc_events.head, .next = &proc_events.head, },
-                                         .m = PTHREAD_MUTEX_INITIALIZER };
+static proc_event_list_t proc_events = PROC_EVENT_LIST_INITIALIZER(PROC_EVENT_HANDLE_DELAY);
 
 static pthread_mutex_t g_unwind_table_lock = PTHREAD_MUTEX_INITIALIZER;
 static unwind_table_t *g_unwind_table = NULL;
@@ -313,38 +312,33 @@ void unwind_events_handle(void) {
         return;
     }
 
-    struct process_create_event *event = NULL;
+    struct process_create_event *event, *n;
     struct bpf_tracer *tracer = NULL;
+    struct list_head expired;
     int count = 0;
+    init_list_head(&expired);
     pthread_mutex_lock(&g_unwind_table_lock);
     pthread_mutex_lock(&g_python_unwind_table_lock);
-    do {
-        event = get_first_event(&proc_events);
-        if (!event)
-            break;
-
-        if (get_sys_uptime() < event->expire_time) {
-            break;
-        }
-
-        tracer = event->tracer;
-        if (tracer && is_python_process(event->pid)) {
-            python_unwind_table_load(g_python_unwind_table, event->pid);
-            pthread_mutex_lock(&tracer->mutex_probes_lock);
-            python_parse_and_register(event->pid, tracer->tps);
-            tracer_uprobes_update(tracer);
-            tracer_hooks_process(tracer, HOOK_ATTACH, &count);
-            pthread_mutex_unlock(&tracer->mutex_probes_lock);
-        }
-
-        if (g_unwind_table && requires_dwarf_unwind_table(event->pid)) {
-            unwind_table_load(g_unwind_table, event->pid);
+    while (proc_event_list_drain(&proc_events, &expired, PROC_EVENT_DRAIN_BATCH) > 0) {
+        list_for_each_entry_safe(event, n, &expired, list) {
+            list_head_del(&event->list);
+            tracer = event->tracer;
+            if (tracer && is_python_process(event->pid)) {
+                python_unwind_table_load(g_python_unwind_table, event->pid);
+                pthread_mutex_lock(&tracer->mutex_probes_lock);
+                python_parse_and_register(event->pid, tracer->tps);
+                tracer_uprobes_update(tracer);
+                tracer_hooks_process(tracer, HOOK_ATTACH, &count);
+                pthread_mutex_unlock(&tracer->mutex_probes_lock);
+            }
+
+            if (g_unwind_table && requires_dwarf_unwind_table(event->pid)) {
+                unwind_table_load(g_unwind_table, event->pid);
+            }
+
+            process_event_free(event);
         }
-
-        remove_event(&proc_events, event);
-	process_event_free(event);
-
-    } while (true);
+    }
     pthread_mutex_unlock(&g_python_unwind_table_lock);
     pthread_mutex_unlock(&g_unwind_table_lock);
 }
@@ -360,17 +354,7 @@ void unwind_process_exit(int pid) {
         return;
     }
 
-    struct list_head *p, *n;
-    struct process_create_event *e = NULL;
-    pthread_mutex_lock(&proc_events.m);
-    list_for_each_safe(p, n, &proc_events.head) {
-        e = container_of(p, struct process_create_event, list);
-        if (e->pid == pid) {
-            list_head_del(&e->list);
-            process_event_free(e);
-        }
-    }
-    pthread_mutex_unlock(&proc_events.m);
+    proc_event_list_cancel(&proc_events, pid);
 
     pthread_mutex_lock(&g_unwind_table_lock);
     if (g_unwind_table) {
@@ -385,22 +369,31 @@ void unwind_process_exit(int pid) {
     pthread_mutex_unlock(&g_python_unwind_table_lock);
 }
 
-// Ensure exclusive access to *unwind_table before calling this function
-static int load_running_processes(struct bpf_tracer *tracer, unwind_table_t *unwind_table) {
+static int pid_cmp(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Collect the running processes requiring DWARF unwind tables, sorted by PID
+// Called without holding g_unwind_table_lock
+static int collect_dwarf_processes(uint32_t **pids_out) {
     struct dirent *entry = NULL;
     DIR *fddir = NULL;
+    uint32_t *pids = NULL, *p;
+    int count = 0, size = 0;
     int pid = 0;
 
+    *pids_out = NULL;
     // TODO: fix version check
     if (!kernel_version_check()) {
         ebpf_warning("Dwarf unwind requires kernel version 5.x\n");
-        return ETR_OK;
+        return 0;
     }
 
     fddir = opendir("/proc/");
     if (!fddir) {
-        ebpf_warning("Failed to open %s.\n");
-        return ETR_PROC_FAIL;
+        ebpf_warning("Failed to open %s.\n", "/proc/");
+        return -1;
     }
 
     while ((entry = readdir(fddir))) {
@@ -409,16 +402,42 @@ static int load_running_processes(struct bpf_tracer *tracer, unwind_table_t *unw
         pid = atoi(entry->d_name);
         if (!process_probing_check(pid))
             continue;
-        if (requires_dwarf_unwind_table(pid)) {
-            unwind_table_load(unwind_table, pid);
+        if (!requires_dwarf_unwind_table(pid))
+            continue;
+        if (count == size) {
+            size = size ? size * 2 : 64;
+            p = realloc(pids, size * sizeof(*pids));
+            if (p == NULL) {
+                ebpf_warning("Failed to allocate memory for DWARF processes.\n");
+                free(pids);
+                closedir(fddir);
+                return -1;
+            }
+            pids = p;
         }
+        pids[count++] = pid;
     }
 
     closedir(fddir);
-    return ETR_OK;
+    if (count > 0) {
+        qsort(pids, count, sizeof(*pids), pid_cmp);
+    }
+    *pids_out = pids;
+    return count;
 }
 
+// Reload after the DWARF regex or the profiler feature matching changed
+//
+// Only the difference is applied: the processes no longer matched are unloaded
+// and the newly matched ones are loaded, the others keep their shard lists and
+// shared shards. g_unwind_table_lock is taken for one process at a time so that
+// unwind_events_handle() is not blocked during the whole reload.
 void unwind_process_reload() {
+    static pthread_mutex_t reload_lock = PTHREAD_MUTEX_INITIALIZER;
+    uint32_t *pids = NULL, *loaded = NULL;
+    size_t i, loaded_count = 0;
+    int j, count, loads = 0, unloads = 0;
+
     if (!dwarf_available() || !get_dwarf_enabled()) {
         return;
     }
@@ -428,12 +447,52 @@ void unwind_process_reload() {
         return;
     }
 
+    pthread_mutex_lock(&reload_lock);
+    count = collect_dwarf_processes(&pids);
+    if (count < 0) {
+        goto out;
+    }
+
     pthread_mutex_lock(&g_unwind_table_lock);
     if (g_unwind_table) {
-        // Unload everything for the moment
-        // Maybe preserve some data on regex changes
-        unwind_table_unload_all(g_unwind_table);
-        load_running_processes(tracer, g_unwind_table);
+        loaded_count = unwind_table_loaded_pids(g_unwind_table, NULL, 0);
+        if (loaded_count > 0) {
+            loaded = malloc(loaded_count * sizeof(*loaded));
+            if (loaded) {
+                loaded_count = clib_min(loaded_count, unwind_table_loaded_pids(g_unwind_table, loaded, loaded_count));
+            } else {
+                loaded_count = 0;
+            }
+        }
     }
     pthread_mutex_unlock(&g_unwind_table_lock);
+
+    for (i = 0; i < loaded_count; i++) {
+        if (count > 0 && bsearch(&loaded[i], pids, count, sizeof(*pids), pid_cmp)) {
+            continue;
+        }
+        pthread_mutex_lock(&g_unwind_table_lock);
+        if (g_unwind_table) {
+            unwind_table_unload(g_unwind_table, loaded[i]);
+            unloads++;
+        }
+        pthread_mutex_unlock(&g_unwind_table_lock);
+    }
+
+    for (j = 0; j < count; j++) {
+        pthread_mutex_lock(&g_unwind_table_lock);
+        if (g_unwind_table && !unwind_table_is_loaded(g_unwind_table, pids[j])) {
+            unwind_table_load(g_unwind_table, pids[j]);
+            loads++;
+        }
+        pthread_mutex_unlock(&g_unwind_table_lock);
+    }
+
+    ebpf_info(LOG_CP_TAG "DWARF unwind tables reloaded, %d processes matched, %d loaded, %d unloaded.\n", count,
+              loads, unloads);
+
+out:
+    pthread_mutex_unlock(&reload_lock);
+    free(loaded);
+    free(pids);
 }
@@ -279,6 +279,56 @@ impl OwnedCountable for SyncEbpfCounter {
                 CounterType::Counted,
                 CounterValue::Unsigned(ebpf_counter.invalid_packets as u64),
             ),
+            (
+                "worker_wakeup_count",
+                CounterType::Counted,
+                CounterValue::Unsigned(ebpf_counter.worker_wakeup_count),
+            ),
+            (
+                "queue_depth_max",
+                CounterType::Gauged,
+                CounterValue::Unsigned(ebpf_counter.queue_depth_max),
+            ),
+            (
+                "flow_steal_count",
+                CounterType::Counted,
+                CounterValue::Unsigned(ebpf_counter.flow_steal_count),
+            ),
+            (
+                "proc_maps_parse_count",
+                CounterType::Counted,
+                CounterValue::Unsigned(ebpf_counter.proc_maps_parse_count),
+            ),
+            (
+                "proc_maps_hit_count",
+                CounterType::Counted,
+                CounterValue::Unsigned(ebpf_counter.proc_maps_hit_count),
+            ),
+            (
+                "proc_maps_parse_max_us",
+                CounterType::Gauged,
+                CounterValue::Unsigned(ebpf_counter.proc_maps_parse_max_us),
+            ),
+            (
+                "proc_maps_parse_avg_us",
+                CounterType::Gauged,
+                CounterValue::Unsigned(ebpf_counter.proc_maps_parse_avg_us),
+            ),
+            (
+                "kick_count",
+                CounterType::Counted,
+                CounterValue::Unsigned(ebpf_counter.kick_count),
+            ),
+            (
+                "kick_cpu_us",
+                CounterType::Counted,
+                CounterValue::Unsigned(ebpf_counter.kick_cpu_us),
+            ),
+            (
+                "kick_sweep_max_us",
+                CounterType::Gauged,
+                CounterValue::Unsigned(ebpf_counter.kick_sweep_max_us),
+            ),
         ]
     }
     // EbpfCollector不会重复创建，这里都是false
@@ -920,6 +970,21 @@ impl EbpfCollector {
 
         ebpf::set_bpf_map_prealloc(!config.ebpf.socket.tunning.map_prealloc_disabled);
 
+        ebpf::set_dispatch_spin_budget(config.ebpf.tunning.dispatch_spin_budget);
+
+        // 0 ring buffers keeps the per-CPU perf buffers
+        if ebpf::set_socket_ringbuf(
+            config.ebpf.tunning.socket_ring_buffers as c_int,
+            config.ebpf.tunning.socket_ring_buffer_pages,
+            config.ebpf.tunning.socket_ring_buffer_wakeup_bytes,
+        ) != 0
+        {
+            warn!(
+                "ebpf set_socket_ringbuf error: {}",
+                config.ebpf.tunning.socket_ring_buffers
+            );
+        }
+
         // set ebpf dpdk enabled
         #[cfg(feature = "extended_observability")]
         ebpf::set_dpdk_trace_enabled(config.dpdk_enabled);
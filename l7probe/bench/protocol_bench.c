@@ -0,0 +1,808 @@
+/*******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2025. All rights reserved.
+ * gala-gopher licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: zhaoguolin
+ * Create: 2025-01-20
+ * Description: micro-benchmark of protocol parsers and matchers
+ *
+ * Every corpus is a sequence of raw data segments (one segment per bpf event) in
+ * both directions. For each iteration, segments are split by
+ * proto_find_frame_boundary()/proto_parse_frame() the same way data_stream does,
+ * then the resulting frames are fed to proto_match_frames(). Each stage is timed
+ * and its heap allocations are counted separately. One JSON object is printed per
+ * (protocol, corpus, stage) so results of different commits can be diffed.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "protocol/expose/protocol_parser.h"
+#include "data_stream.h"
+#include "crpc/crpc_internal.h"
+
+#define BENCH_ITERATIONS_DEFAULT    1000
+#define BENCH_MSG_PAIRS             64
+#define BENCH_SEG_MAX               512
+#define BENCH_SEG_DATA_MAX          (64 * 1024)
+#define NSEC_PER_SEC                1000000000ULL
+
+/* Allocation accounting, glibc allows malloc family to be interposed by the executable. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long long g_alloc_count;
+
+void *malloc(size_t size)
+{
+    g_alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    g_alloc_count++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    g_alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+enum bench_stage_e {
+    BENCH_STAGE_BOUNDARY = 0,
+    BENCH_STAGE_PARSE,
+    BENCH_STAGE_MATCH,
+
+    BENCH_STAGE_MAX
+};
+
+static const char *g_stage_names[BENCH_STAGE_MAX] = {"find_frame_boundary", "parse_frame", "match_frames"};
+
+struct bench_stat_s {
+    unsigned long long ns;
+    unsigned long long bytes;
+    unsigned long long frames;
+    unsigned long long allocs;
+};
+
+struct bench_seg_s {
+    enum message_type_t msg_type;
+    size_t len;
+    char *data;
+};
+
+struct bench_corpus_s {
+    const char *proto_name;
+    const char *name;
+    enum proto_type_t proto;
+    size_t seg_num;
+    struct bench_seg_s segs[BENCH_SEG_MAX];
+
+    /* Scratch buffer used while building a segment */
+    size_t cur_len;
+    char cur[BENCH_SEG_DATA_MAX];
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * NSEC_PER_SEC + (unsigned long long)ts.tv_nsec;
+}
+
+/* Corpus building helpers, all multi-byte integers are big-endian unless noted. */
+static void put_bytes(struct bench_corpus_s *corpus, const void *buf, size_t len)
+{
+    if (corpus->cur_len + len > BENCH_SEG_DATA_MAX) {
+        fprintf(stderr, "corpus %s/%s: segment too large\n", corpus->proto_name, corpus->name);
+        exit(EXIT_FAILURE);
+    }
+    (void)memcpy(corpus->cur + corpus->cur_len, buf, len);
+    corpus->cur_len += len;
+}
+
+static void put_str(struct bench_corpus_s *corpus, const char *str)
+{
+    put_bytes(corpus, str, strlen(str));
+}
+
+static void put_cstr(struct bench_corpus_s *corpus, const char *str)
+{
+    put_bytes(corpus, str, strlen(str) + 1);
+}
+
+static void put_u8(struct bench_corpus_s *corpus, u8 val)
+{
+    put_bytes(corpus, &val, sizeof(val));
+}
+
+static void put_be16(struct bench_corpus_s *corpus, u16 val)
+{
+    u8 buf[2] = {(u8)(val >> 8), (u8)val};
+    put_bytes(corpus, buf, sizeof(buf));
+}
+
+static void put_be32(struct bench_corpus_s *corpus, u32 val)
+{
+    u8 buf[4] = {(u8)(val >> 24), (u8)(val >> 16), (u8)(val >> 8), (u8)val};
+    put_bytes(corpus, buf, sizeof(buf));
+}
+
+static void put_be64(struct bench_corpus_s *corpus, u64 val)
+{
+    put_be32(corpus, (u32)(val >> 32));
+    put_be32(corpus, (u32)val);
+}
+
+static void patch_be32(struct bench_corpus_s *corpus, size_t off, u32 val)
+{
+    corpus->cur[off] = (char)(val >> 24);
+    corpus->cur[off + 1] = (char)(val >> 16);
+    corpus->cur[off + 2] = (char)(val >> 8);
+    corpus->cur[off + 3] = (char)val;
+}
+
+static void commit_seg(struct bench_corpus_s *corpus, enum message_type_t msg_type)
+{
+    struct bench_seg_s *seg;
+
+    if (corpus->cur_len == 0) {
+        return;
+    }
+    if (corpus->seg_num >= BENCH_SEG_MAX) {
+        fprintf(stderr, "corpus %s/%s: too many segments\n", corpus->proto_name, corpus->name);
+        exit(EXIT_FAILURE);
+    }
+    seg = &corpus->segs[corpus->seg_num++];
+    seg->msg_type = msg_type;
+    seg->len = corpus->cur_len;
+    seg->data = __libc_malloc(corpus->cur_len);
+    if (seg->data == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    (void)memcpy(seg->data, corpus->cur, corpus->cur_len);
+    corpus->cur_len = 0;
+}
+
+/* HTTP/1.1: one request/response per segment on a keep-alive connection */
+static void build_http_keepalive(struct bench_corpus_s *corpus)
+{
+    char line[256];
+
+    for (int i = 0; i < BENCH_MSG_PAIRS; i++) {
+        (void)snprintf(line, sizeof(line), "GET /api/v1/items/%d HTTP/1.1\r\n", i);
+        put_str(corpus, line);
+        put_str(corpus, "Host: shop.example.com\r\nUser-Agent: bench/1.0\r\nAccept: application/json\r\n"
+                        "Connection: keep-alive\r\n\r\n");
+        commit_seg(corpus, MESSAGE_REQUEST);
+
+        put_str(corpus, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 40\r\n"
+                        "Connection: keep-alive\r\n\r\n");
+        (void)snprintf(line, sizeof(line), "{\"id\":%5d,\"name\":\"item\",\"stock\":12345}", i);
+        put_bytes(corpus, line, 40);
+        commit_seg(corpus, MESSAGE_RESPONSE);
+    }
+}
+
+/* HTTP/1.1: POST requests answered with chunked bodies */
+static void build_http_chunked(struct bench_corpus_s *corpus)
+{
+    static const char body[] = "{\"user\":\"bench\",\"action\":\"checkout\"}";
+    char line[256];
+
+    for (int i = 0; i < BENCH_MSG_PAIRS; i++) {
+        (void)snprintf(line, sizeof(line), "POST /api/v1/orders HTTP/1.1\r\nHost: shop.example.com\r\n"
+                       "Content-Type: application/json\r\nContent-Length: %zu\r\n\r\n", strlen(body));
+        put_str(corpus, line);
+        put_str(corpus, body);
+        commit_seg(corpus, MESSAGE_REQUEST);
+
+        put_str(corpus, "HTTP/1.1 201 Created\r\nContent-Type: application/json\r\n"
+                        "Transfer-Encoding: chunked\r\n\r\n");
+        for (int j = 0; j < 4; j++) {
+            put_str(corpus, "10\r\n0123456789abcdef\r\n");
+        }
+        put_str(corpus, "0\r\n\r\n");
+        commit_seg(corpus, MESSAGE_RESPONSE);
+    }
+}
+
+/* Redis: pipelines of 16 SET/GET commands per segment */
+static void build_redis_pipeline(struct bench_corpus_s *corpus)
+{
+    char cmd[128];
+    const int depth = 16;
+
+    for (int i = 0; i < BENCH_MSG_PAIRS; i += depth) {
+        for (int j = i; j < i + depth; j++) {
+            if (j % 2 == 0) {
+                (void)snprintf(cmd, sizeof(cmd), "*3\r\n$3\r\nSET\r\n$8\r\nkey:%04d\r\n$8\r\nval:%04d\r\n", j, j);
+            } else {
+                (void)snprintf(cmd, sizeof(cmd), "*2\r\n$3\r\nGET\r\n$8\r\nkey:%04d\r\n", j - 1);
+            }
+            put_str(corpus, cmd);
+        }
+        commit_seg(corpus, MESSAGE_REQUEST);
+
+        for (int j = i; j < i + depth; j++) {
+            if (j % 2 == 0) {
+                put_str(corpus, "+OK\r\n");
+            } else {
+                (void)snprintf(cmd, sizeof(cmd), "$8\r\nval:%04d\r\n", j - 1);
+                put_str(corpus, cmd);
+            }
+        }
+        commit_seg(corpus, MESSAGE_RESPONSE);
+    }
+}
+
+/* PGSQL regular message: tag + int32 length(self included) + payload */
+static size_t pgsql_begin_msg(struct bench_corpus_s *corpus, char tag)
+{
+    size_t off;
+
+    put_u8(corpus, (u8)tag);
+    off = corpus->cur_len;
+    put_be32(corpus, 0);
+    return off;
+}
+
+static void pgsql_end_msg(struct bench_corpus_s *corpus, size_t off)
+{
+    patch_be32(corpus, off, (u32)(corpus->cur_len - off));
+}
+
+/* PGSQL extended query: Parse/Bind/Describe/Execute/Sync per round trip */
+static void build_pgsql_extended(struct bench_corpus_s *corpus)
+{
+    char val[16];
+    size_t off;
+
+    for (int i = 0; i < BENCH_MSG_PAIRS; i++) {
+        off = pgsql_begin_msg(corpus, 'P');
+        put_cstr(corpus, "");
+        put_cstr(corpus, "SELECT name, stock FROM items WHERE id = $1");
+        put_be16(corpus, 1);
+        put_be32(corpus, 23);   // int4
+        pgsql_end_msg(corpus, off);
+
+        (void)snprintf(val, sizeof(val), "%d", i);
+        off = pgsql_begin_msg(corpus, 'B');
+        put_cstr(corpus, "");
+        put_cstr(corpus, "");
+        put_be16(corpus, 0);
+        put_be16(corpus, 1);
+        put_be32(corpus, (u32)strlen(val));
+        put_str(corpus, val);
+        put_be16(corpus, 0);
+        pgsql_end_msg(corpus, off);
+
+        off = pgsql_begin_msg(corpus, 'D');
+        put_u8(corpus, 'P');
+        put_cstr(corpus, "");
+        pgsql_end_msg(corpus, off);
+
+        off = pgsql_begin_msg(corpus, 'E');
+        put_cstr(corpus, "");
+        put_be32(corpus, 0);
+        pgsql_end_msg(corpus, off);
+
+        off = pgsql_begin_msg(corpus, 'S');
+        pgsql_end_msg(corpus, off);
+        commit_seg(corpus, MESSAGE_REQUEST);
+
+        off = pgsql_begin_msg(corpus, '1');
+        pgsql_end_msg(corpus, off);
+        off = pgsql_begin_msg(corpus, '2');
+        pgsql_end_msg(corpus, off);
+
+        off = pgsql_begin_msg(corpus, 'T');
+        put_be16(corpus, 2);
+        put_cstr(corpus, "name");
+        put_be32(corpus, 16384);
+        put_be16(corpus, 2);
+        put_be32(corpus, 25);   // text
+        put_be16(corpus, 0xFFFF);
+        put_be32(corpus, 0xFFFFFFFF);
+        put_be16(corpus, 0);
+        put_cstr(corpus, "stock");
+        put_be32(corpus, 16384);
+        put_be16(corpus, 3);
+        put_be32(corpus, 23);   // int4
+        put_be16(corpus, 4);
+        put_be32(corpus, 0xFFFFFFFF);
+        put_be16(corpus, 0);
+        pgsql_end_msg(corpus, off);
+
+        off = pgsql_begin_msg(corpus, 'D');
+        put_be16(corpus, 2);
+        put_be32(corpus, 6);
+        put_str(corpus, "widget");
+        put_be32(corpus, 3);
+        put_str(corpus, "120");
+        pgsql_end_msg(corpus, off);
+
+        off = pgsql_begin_msg(corpus, 'C');
+        put_cstr(corpus, "SELECT 1");
+        pgsql_end_msg(corpus, off);
+
+        off = pgsql_begin_msg(corpus, 'Z');
+        put_u8(corpus, 'I');
+        pgsql_end_msg(corpus, off);
+        commit_seg(corpus, MESSAGE_RESPONSE);
+    }
+}
+
+/* MySQL packet: int<3> payload_length(little-endian) + int<1> sequence_id + payload */
+static void mysql_put_packet(struct bench_corpus_s *corpus, u8 seq, const char *payload, size_t len)
+{
+    put_u8(corpus, (u8)len);
+    put_u8(corpus, (u8)(len >> 8));
+    put_u8(corpus, (u8)(len >> 16));
+    put_u8(corpus, seq);
+    put_bytes(corpus, payload, len);
+}
+
+/* MySQL prepared statements: COM_STMT_PREPARE followed by COM_STMT_EXECUTE */
+static void build_mysql_stmt(struct bench_corpus_s *corpus)
+{
+    static const char prepare[] = "\x16" "UPDATE items SET stock = stock - 1 WHERE id = ?";
+    static const char prepare_ok[] = "\x00\x01\x00\x00\x00\x00\x00\x01\x00\x00\x00\x00";
+    static const char param_def[] = "\x03" "def" "\x00\x00\x00\x01?\x00\x0c\x3f\x00\x00\x00\x00\x00\x08\x80\x00\x00\x00\x00";
+    static const char eof[] = "\xfe\x00\x00\x02\x00";
+    static const char exec_ok[] = "\x00\x01\x00\x02\x00\x00\x00";
+    char execute[32];
+
+    for (int i = 0; i < BENCH_MSG_PAIRS / 2; i++) {
+        mysql_put_packet(corpus, 0, prepare, sizeof(prepare) - 1);
+        commit_seg(corpus, MESSAGE_REQUEST);
+
+        mysql_put_packet(corpus, 1, prepare_ok, sizeof(prepare_ok) - 1);
+        mysql_put_packet(corpus, 2, param_def, sizeof(param_def) - 1);
+        mysql_put_packet(corpus, 3, eof, sizeof(eof) - 1);
+        commit_seg(corpus, MESSAGE_RESPONSE);
+
+        // COM_STMT_EXECUTE: stmt_id, flags, iteration_count, null_bitmap, new_params_bound, type, value
+        (void)memcpy(execute, "\x17\x01\x00\x00\x00\x00\x01\x00\x00\x00\x00\x01\x03\x00", 14);
+        execute[14] = (char)i;
+        execute[15] = execute[16] = execute[17] = 0;
+        mysql_put_packet(corpus, 0, execute, 18);
+        commit_seg(corpus, MESSAGE_REQUEST);
+
+        mysql_put_packet(corpus, 1, exec_ok, sizeof(exec_ok) - 1);
+        commit_seg(corpus, MESSAGE_RESPONSE);
+    }
+}
+
+/* Kafka request header v1: int32 size, int16 api_key, int16 api_version, int32 correlation_id, string client_id */
+static size_t kafka_begin_req(struct bench_corpus_s *corpus, u16 api_key, u16 api_version, u32 correlation_id)
+{
+    size_t off = corpus->cur_len;
+
+    put_be32(corpus, 0);
+    put_be16(corpus, api_key);
+    put_be16(corpus, api_version);
+    put_be32(corpus, correlation_id);
+    put_be16(corpus, 5);
+    put_str(corpus, "bench");
+    return off;
+}
+
+static size_t kafka_begin_resp(struct bench_corpus_s *corpus, u32 correlation_id)
+{
+    size_t off = corpus->cur_len;
+
+    put_be32(corpus, 0);
+    put_be32(corpus, correlation_id);
+    return off;
+}
+
+static void kafka_end_msg(struct bench_corpus_s *corpus, size_t off)
+{
+    patch_be32(corpus, off, (u32)(corpus->cur_len - off - sizeof(u32)));
+}
+
+/* Kafka produce v3 and fetch v4 with a single topic partition */
+static void build_kafka_produce_fetch(struct bench_corpus_s *corpus)
+{
+    size_t off;
+
+    for (int i = 0; i < BENCH_MSG_PAIRS; i++) {
+        if (i % 2 == 0) {
+            off = kafka_begin_req(corpus, 0, 3, (u32)i);
+            put_be16(corpus, 0xFFFF);   // null transactional_id
+            put_be16(corpus, 1);        // acks
+            put_be32(corpus, 30000);    // timeout_ms
+            put_be32(corpus, 1);
+            put_be16(corpus, 6);
+            put_str(corpus, "orders");
+            put_be32(corpus, 1);
+            put_be32(corpus, 0);        // partition
+            put_be32(corpus, 16);       // record set size
+            put_str(corpus, "0123456789abcdef");
+        } else {
+            off = kafka_begin_req(corpus, 1, 4, (u32)i);
+            put_be32(corpus, 0xFFFFFFFF); // replica_id
+            put_be32(corpus, 500);      // max_wait_ms
+            put_be32(corpus, 1);        // min_bytes
+            put_be32(corpus, 1048576);  // max_bytes
+            put_u8(corpus, 0);          // isolation_level
+            put_be32(corpus, 1);
+            put_be16(corpus, 6);
+            put_str(corpus, "orders");
+            put_be32(corpus, 1);
+            put_be32(corpus, 0);        // partition
+            put_be64(corpus, (u64)i);   // fetch_offset
+            put_be32(corpus, 1048576);  // partition_max_bytes
+        }
+        kafka_end_msg(corpus, off);
+        commit_seg(corpus, MESSAGE_REQUEST);
+
+        off = kafka_begin_resp(corpus, (u32)i);
+        put_be32(corpus, 1);
+        put_be16(corpus, 6);
+        put_str(corpus, "orders");
+        put_be32(corpus, 1);
+        put_be32(corpus, 0);            // partition
+        put_be16(corpus, 0);            // error_code
+        put_be64(corpus, (u64)i);       // offset or high_watermark
+        put_be64(corpus, (u64)-1);
+        kafka_end_msg(corpus, off);
+        commit_seg(corpus, MESSAGE_RESPONSE);
+    }
+}
+
+/* AMQP 0-9-1 frame: u8 type, u16 channel, u32 size, payload, 0xCE */
+static size_t amqp_begin_frame(struct bench_corpus_s *corpus, u8 type)
+{
+    size_t off;
+
+    put_u8(corpus, type);
+    put_be16(corpus, 1);
+    off = corpus->cur_len;
+    put_be32(corpus, 0);
+    return off;
+}
+
+static void amqp_end_frame(struct bench_corpus_s *corpus, size_t off)
+{
+    patch_be32(corpus, off, (u32)(corpus->cur_len - off - sizeof(u32)));
+    put_u8(corpus, 0xCE);
+}
+
+/* AMQP publisher confirms: basic.publish + content header + body, answered by basic.ack */
+static void build_amqp_publish_confirm(struct bench_corpus_s *corpus)
+{
+    static const char body[] = "{\"order\":42,\"state\":\"paid\"}";
+    size_t off;
+
+    off = amqp_begin_frame(corpus, 1);
+    put_be16(corpus, 85);               // confirm.select
+    put_be16(corpus, 10);
+    put_u8(corpus, 0);
+    amqp_end_frame(corpus, off);
+    commit_seg(corpus, MESSAGE_REQUEST);
+
+    off = amqp_begin_frame(corpus, 1);
+    put_be16(corpus, 85);               // confirm.select-ok
+    put_be16(corpus, 11);
+    amqp_end_frame(corpus, off);
+    commit_seg(corpus, MESSAGE_RESPONSE);
+
+    for (int i = 0; i < BENCH_MSG_PAIRS; i++) {
+        off = amqp_begin_frame(corpus, 1);
+        put_be16(corpus, 60);           // basic.publish
+        put_be16(corpus, 40);
+        put_be16(corpus, 0);
+        put_u8(corpus, 6);
+        put_str(corpus, "orders");
+        put_u8(corpus, 7);
+        put_str(corpus, "created");
+        put_u8(corpus, 0);
+        amqp_end_frame(corpus, off);
+
+        off = amqp_begin_frame(corpus, 2);
+        put_be16(corpus, 60);
+        put_be16(corpus, 0);
+        put_be64(corpus, sizeof(body) - 1);
+        put_be16(corpus, 0);
+        amqp_end_frame(corpus, off);
+
+        off = amqp_begin_frame(corpus, 3);
+        put_str(corpus, body);
+        amqp_end_frame(corpus, off);
+        commit_seg(corpus, MESSAGE_REQUEST);
+
+        off = amqp_begin_frame(corpus, 1);
+        put_be16(corpus, 60);           // basic.ack
+        put_be16(corpus, 80);
+        put_be64(corpus, (u64)i + 1);
+        put_u8(corpus, 0);
+        amqp_end_frame(corpus, off);
+        commit_seg(corpus, MESSAGE_RESPONSE);
+    }
+}
+
+/* CRPC: one message per segment, see __get_crpc_type() for header fmt */
+static void crpc_put_msg(struct bench_corpus_s *corpus, int seq, int is_req, size_t body_len)
+{
+    char req_id[CRPC_HEADER_REQUEST_ID_LEN + 1];
+    const size_t head_len = CRPC_REQUEST_HEADER_MIN_LEN;
+    size_t start = corpus->cur_len;
+
+    put_u8(corpus, CRPC_HEADER_BEGIN_FLAG1);
+    put_u8(corpus, CRPC_HEADER_BEGIN_FLAG2);
+    put_be32(corpus, (u32)(head_len + body_len - CRPC_HEADER_MSGLEN_OFFSET));
+    put_be16(corpus, (u16)(head_len - CRPC_HEADER_HEADLEN_OFFSET));
+    put_u8(corpus, 0x01);                       // headVer
+    put_u8(corpus, is_req ? 0x80 : 0x00);       // property: rqFlag, Hessian
+    put_u8(corpus, 0);
+    put_u8(corpus, 0);
+    (void)snprintf(req_id, sizeof(req_id), "req-%012d", seq);
+    put_bytes(corpus, req_id, CRPC_HEADER_REQUEST_ID_LEN);
+    while (corpus->cur_len - start < head_len + body_len) {
+        put_u8(corpus, (u8)('a' + (corpus->cur_len - start) % 26));
+    }
+}
+
+static void build_crpc(struct bench_corpus_s *corpus)
+{
+    for (int i = 0; i < BENCH_MSG_PAIRS; i++) {
+        crpc_put_msg(corpus, i, 1, 256);
+        commit_seg(corpus, MESSAGE_REQUEST);
+        crpc_put_msg(corpus, i, 0, 512);
+        commit_seg(corpus, MESSAGE_RESPONSE);
+    }
+}
+
+struct bench_corpus_def_s {
+    const char *proto_name;
+    const char *name;
+    enum proto_type_t proto;
+    void (*build)(struct bench_corpus_s *corpus);
+};
+
+static const struct bench_corpus_def_s g_corpus_defs[] = {
+    {"http",  "keepalive",       PROTO_HTTP,  build_http_keepalive},
+    {"http",  "chunked",         PROTO_HTTP,  build_http_chunked},
+    {"redis", "pipeline",        PROTO_REDIS, build_redis_pipeline},
+    {"pgsql", "extended_query",  PROTO_PGSQL, build_pgsql_extended},
+    {"mysql", "prepared_stmt",   PROTO_MYSQL, build_mysql_stmt},
+    {"kafka", "produce_fetch",   PROTO_KAFKA, build_kafka_produce_fetch},
+    {"amqp",  "publish_confirm", PROTO_AMQP,  build_amqp_publish_confirm},
+    {"crpc",  "request_response", PROTO_CRPC, build_crpc}
+};
+
+static void push_frame(struct frame_buf_s *frame_buf, struct frame_data_s *frame_data)
+{
+    if (frame_buf->frame_buf_size >= __FRAME_BUF_SIZE) {
+        fprintf(stderr, "frame buffer overflow\n");
+        exit(EXIT_FAILURE);
+    }
+    frame_buf->frames[frame_buf->frame_buf_size++] = frame_data;
+}
+
+/*
+ * Split one segment into frames, following data_stream_parse_frames() without
+ * the overlay path: corpus segments always carry whole frames.
+ */
+static void bench_parse_seg(const struct bench_corpus_s *corpus, struct raw_data_s *raw_data,
+                            enum message_type_t msg_type, struct frame_buf_s *frame_buf, struct bench_stat_s stats[])
+{
+    unsigned long long t, allocs;
+    struct frame_data_s *frame_data;
+    parse_state_t state;
+    size_t pos, old_pos, skipped;
+
+    while (raw_data->current_pos < raw_data->data_len) {
+        allocs = g_alloc_count;
+        t = now_ns();
+        pos = proto_find_frame_boundary(corpus->proto, msg_type, raw_data);
+        stats[BENCH_STAGE_BOUNDARY].ns += now_ns() - t;
+        stats[BENCH_STAGE_BOUNDARY].allocs += g_alloc_count - allocs;
+        if (pos == PARSER_INVALID_BOUNDARY_INDEX) {
+            break;
+        }
+        skipped = pos - raw_data->current_pos;
+        raw_data->current_pos = pos;
+
+        old_pos = raw_data->current_pos;
+        frame_data = NULL;
+        allocs = g_alloc_count;
+        t = now_ns();
+        state = proto_parse_frame(corpus->proto, msg_type, raw_data, &frame_data);
+        stats[BENCH_STAGE_PARSE].ns += now_ns() - t;
+        stats[BENCH_STAGE_PARSE].allocs += g_alloc_count - allocs;
+        if (state != STATE_SUCCESS || frame_data == NULL) {
+            break;
+        }
+        stats[BENCH_STAGE_PARSE].bytes += raw_data->current_pos - old_pos;
+        stats[BENCH_STAGE_BOUNDARY].bytes += skipped + raw_data->current_pos - old_pos;
+        stats[BENCH_STAGE_PARSE].frames++;
+        stats[BENCH_STAGE_BOUNDARY].frames++;
+        push_frame(frame_buf, frame_data);
+        if (raw_data->current_pos == old_pos) {
+            break;
+        }
+    }
+}
+
+static void bench_reset_bufs(enum proto_type_t proto, struct frame_buf_s *req_frames, struct frame_buf_s *resp_frames,
+                             struct record_buf_s *record_buf)
+{
+    struct frame_buf_s *bufs[] = {req_frames, resp_frames};
+
+    for (int i = 0; i < record_buf->record_buf_size && i < RECORD_BUF_SIZE; i++) {
+        if (record_buf->records[i] != NULL) {
+            free_record_data(proto, record_buf->records[i]);
+        }
+    }
+    if (record_buf->api_stats != NULL) {
+        destroy_api_stats(record_buf->api_stats);
+    }
+    (void)memset(record_buf, 0, sizeof(struct record_buf_s));
+
+    for (int i = 0; i < sizeof(bufs) / sizeof(bufs[0]); i++) {
+        for (int j = 0; j < bufs[i]->frame_buf_size; j++) {
+            if (bufs[i]->frames[j] != NULL) {
+                free_frame_data_s(proto, bufs[i]->frames[j]);
+            }
+        }
+        bufs[i]->frame_buf_size = 0;
+        bufs[i]->current_pos = 0;
+    }
+}
+
+static void bench_report(const struct bench_corpus_s *corpus, enum bench_stage_e stage,
+                         const struct bench_stat_s *stat, unsigned int iterations, unsigned long long records)
+{
+    double sec = (double)stat->ns / NSEC_PER_SEC;
+    double mb_per_s = sec > 0 ? (double)stat->bytes / (1024 * 1024) / sec : 0;
+    double frames_per_s = sec > 0 ? (double)stat->frames / sec : 0;
+    double allocs_per_frame = stat->frames > 0 ? (double)stat->allocs / stat->frames : 0;
+
+    fprintf(stdout, "{\"proto\":\"%s\",\"corpus\":\"%s\",\"stage\":\"%s\",\"iterations\":%u,"
+            "\"bytes\":%llu,\"frames\":%llu,\"records\":%llu,\"ns\":%llu,"
+            "\"mb_per_s\":%.3f,\"frames_per_s\":%.1f,\"allocs\":%llu,\"allocs_per_frame\":%.3f}\n",
+            corpus->proto_name, corpus->name, g_stage_names[stage], iterations,
+            stat->bytes, stat->frames, records, stat->ns,
+            mb_per_s, frames_per_s, stat->allocs, allocs_per_frame);
+}
+
+static int bench_corpus(const struct bench_corpus_def_s *def, unsigned int iterations)
+{
+    struct bench_stat_s stats[BENCH_STAGE_MAX] = {0};
+    struct raw_data_s *raw_datas[BENCH_SEG_MAX] = {0};
+    struct bench_corpus_s *corpus;
+    struct frame_buf_s *req_frames, *resp_frames;
+    struct record_buf_s *record_buf;
+    unsigned long long records = 0, t, allocs;
+    int ret = -1;
+
+    corpus = __libc_calloc(1, sizeof(struct bench_corpus_s));
+    req_frames = __libc_calloc(1, sizeof(struct frame_buf_s));
+    resp_frames = __libc_calloc(1, sizeof(struct frame_buf_s));
+    record_buf = __libc_calloc(1, sizeof(struct record_buf_s));
+    if (corpus == NULL || req_frames == NULL || resp_frames == NULL || record_buf == NULL) {
+        goto out;
+    }
+    corpus->proto_name = def->proto_name;
+    corpus->name = def->name;
+    corpus->proto = def->proto;
+    def->build(corpus);
+
+    for (size_t i = 0; i < corpus->seg_num; i++) {
+        raw_datas[i] = __libc_malloc(sizeof(struct raw_data_s) + corpus->segs[i].len);
+        if (raw_datas[i] == NULL) {
+            goto out;
+        }
+        (void)memset(raw_datas[i], 0, sizeof(struct raw_data_s));
+        raw_datas[i]->data_len = corpus->segs[i].len;
+        (void)memcpy(raw_datas[i]->data, corpus->segs[i].data, corpus->segs[i].len);
+    }
+
+    for (unsigned int iter = 0; iter < iterations; iter++) {
+        for (size_t i = 0; i < corpus->seg_num; i++) {
+            struct bench_seg_s *seg = &corpus->segs[i];
+
+            raw_datas[i]->current_pos = 0;
+            raw_datas[i]->flags = 0;
+            raw_datas[i]->timestamp_ns = (u64)i * 1000 + 1;
+            bench_parse_seg(corpus, raw_datas[i], seg->msg_type,
+                            seg->msg_type == MESSAGE_REQUEST ? req_frames : resp_frames, stats);
+        }
+
+        allocs = g_alloc_count;
+        t = now_ns();
+        proto_match_frames(corpus->proto, req_frames, resp_frames, record_buf);
+        stats[BENCH_STAGE_MATCH].ns += now_ns() - t;
+        stats[BENCH_STAGE_MATCH].allocs += g_alloc_count - allocs;
+        stats[BENCH_STAGE_MATCH].frames += req_frames->frame_buf_size + resp_frames->frame_buf_size;
+        records += record_buf->record_buf_size;
+
+        bench_reset_bufs(corpus->proto, req_frames, resp_frames, record_buf);
+    }
+    stats[BENCH_STAGE_MATCH].bytes = stats[BENCH_STAGE_PARSE].bytes;
+
+    for (int stage = 0; stage < BENCH_STAGE_MAX; stage++) {
+        bench_report(corpus, (enum bench_stage_e)stage, &stats[stage], iterations, records);
+    }
+    ret = 0;
+
+out:
+    for (size_t i = 0; i < BENCH_SEG_MAX; i++) {
+        __libc_free(raw_datas[i]);
+    }
+    if (corpus != NULL) {
+        for (size_t i = 0; i < corpus->seg_num; i++) {
+            __libc_free(corpus->segs[i].data);
+        }
+    }
+    __libc_free(corpus);
+    __libc_free(req_frames);
+    __libc_free(resp_frames);
+    __libc_free(record_buf);
+    return ret;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n iterations] [-p protocol]\n"
+            "  -n  iterations per corpus, default %d\n"
+            "  -p  only run corpora of protocol: http|redis|pgsql|mysql|kafka|amqp|crpc\n",
+            prog, BENCH_ITERATIONS_DEFAULT);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int iterations = BENCH_ITERATIONS_DEFAULT;
+    const char *proto_filter = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:p:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                proto_filter = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : -1;
+        }
+    }
+    if (iterations == 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(g_corpus_defs) / sizeof(g_corpus_defs[0]); i++) {
+        if (proto_filter != NULL && strcmp(proto_filter, g_corpus_defs[i].proto_name) != 0) {
+            continue;
+        }
+        if (bench_corpus(&g_corpus_defs[i], iterations)) {
+            fprintf(stderr, "bench %s/%s failed\n", g_corpus_defs[i].proto_name, g_corpus_defs[i].name);
+            return -1;
+        }
+    }
+    return 0;
+}
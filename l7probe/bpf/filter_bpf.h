@@ -61,6 +61,12 @@ static __always_inline __maybe_unused char is_filter_id(enum filter_type_t type,
     return 0;
 }
 
+static __always_inline __maybe_unused struct filter_args_s* get_filter_args(void)
+{
+    int key = 0;
+    return (struct filter_args_s *)bpf_map_lookup_elem(&filter_args_tbl, &key);
+}
+
 static __always_inline __maybe_unused u32 get_filter_proto(void)
 {
     int key = 0;
@@ -411,6 +411,7 @@ static __always_inline __maybe_unused int submit_conn_open(void *ctx, struct soc
 
     struct conn_ctl_s* e = bpfbuf_reserve(&conn_tracker_events, sizeof(struct conn_ctl_s));
     if (!e) {
+        add_tracker_evt_stats(TRACKER_EVT_CTRL, 1);
         return -1;
     }
 
@@ -429,6 +430,7 @@ static __always_inline __maybe_unused int submit_conn_open(void *ctx, struct soc
     }
 
     bpfbuf_submit(ctx, &conn_tracker_events, e, sizeof(struct conn_ctl_s));
+    add_tracker_evt_stats(TRACKER_EVT_CTRL, 0);
     sock_conn->info.is_reported = 1;
     return 0;
 }
@@ -444,6 +446,7 @@ static __always_inline __maybe_unused int submit_conn_close(void *ctx, conn_ctx_
 
     struct conn_ctl_s* e = bpfbuf_reserve(&conn_tracker_events, sizeof(struct conn_ctl_s));
     if (!e) {
+        add_tracker_evt_stats(TRACKER_EVT_CTRL, 1);
         goto end;
     }
 
@@ -456,6 +459,7 @@ static __always_inline __maybe_unused int submit_conn_close(void *ctx, conn_ctx_
 
     // submit conn open event.
     bpfbuf_submit(ctx, &conn_tracker_events, e, sizeof(struct conn_ctl_s));
+    add_tracker_evt_stats(TRACKER_EVT_CTRL, 0);
 
 end:
     /* We should do "bpf_map_delete_elem(&conn_tbl, &conn_id)" here,
@@ -126,6 +126,163 @@ struct {
     __uint(max_entries, 8192 * 1024);
 } conn_tracker_events SEC(".maps");
 
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(key_size, sizeof(u32));
+    __uint(value_size, sizeof(struct tracker_evt_stats_s));
+    __uint(max_entries, TRACKER_EVT_MAX);
+} tracker_evt_stats SEC(".maps");
+
+static __always_inline __maybe_unused void add_tracker_evt_stats(enum tracker_evt_e evt, char dropped)
+{
+    u32 key = (u32)evt;
+    struct tracker_evt_stats_s *stats = bpf_map_lookup_elem(&tracker_evt_stats, &key);
+    if (stats == NULL) {
+        return;
+    }
+
+    if (dropped) {
+        stats->dropped++;
+    } else {
+        stats->submitted++;
+    }
+}
+
+static __always_inline __maybe_unused void add_budget_evt_stats(u32 evts, u64 bytes)
+{
+    u32 key = (u32)TRACKER_EVT_DATA;
+    struct tracker_evt_stats_s *stats = bpf_map_lookup_elem(&tracker_evt_stats, &key);
+    if (stats == NULL) {
+        return;
+    }
+
+    stats->budget_dropped += evts;
+    stats->budget_dropped_bytes += bytes;
+}
+
+#define BUDGET_WINDOW_NS    1000000000ULL
+
+// Payload budget of each process, the budget of each connection is kept in 'sock_conn_s'.
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(key_size, sizeof(u32));
+    __uint(value_size, sizeof(struct budget_s));
+    __uint(max_entries, __MAX_CONCURRENCY);
+} proc_budget_tbl SEC(".maps");
+
+static __always_inline u32 refill_budget_tokens(u32 tokens, u32 rate, u64 elapsed)
+{
+    u64 total;
+
+    if (elapsed >= BUDGET_WINDOW_NS) {
+        return rate;
+    }
+    total = (u64)tokens + elapsed * rate / BUDGET_WINDOW_NS;
+    return (total > rate) ? rate : (u32)total;
+}
+
+// The bucket holds at most one second of tokens, so a burst never exceeds the rate.
+static __always_inline void refill_budget(struct budget_s *budget, u32 bytes_rate, u32 evts_rate, u64 ts)
+{
+    u64 elapsed = (budget->ts == 0 || ts < budget->ts) ? BUDGET_WINDOW_NS : (ts - budget->ts);
+
+    budget->bytes = refill_budget_tokens(budget->bytes, bytes_rate, elapsed);
+    budget->evts = refill_budget_tokens(budget->evts, evts_rate, elapsed);
+    budget->ts = ts;
+}
+
+static __always_inline char is_budget_enough(struct budget_s *budget, u32 bytes_rate, u32 evts_rate,
+                                             u32 bytes, u32 evts)
+{
+    if (bytes_rate != 0 && budget->bytes < bytes) {
+        return 0;
+    }
+    if (evts_rate != 0 && budget->evts < evts) {
+        return 0;
+    }
+    return 1;
+}
+
+static __always_inline void consume_budget(struct budget_s *budget, u32 bytes_rate, u32 evts_rate,
+                                           u32 bytes, u32 evts)
+{
+    if (bytes_rate != 0) {
+        budget->bytes = (budget->bytes > bytes) ? (budget->bytes - bytes) : 0;
+    }
+    if (evts_rate != 0) {
+        budget->evts = (budget->evts > evts) ? (budget->evts - evts) : 0;
+    }
+}
+
+static __always_inline struct budget_s* get_proc_budget(u32 tgid)
+{
+    struct budget_s *budget = bpf_map_lookup_elem(&proc_budget_tbl, &tgid);
+    if (budget != NULL) {
+        return budget;
+    }
+
+    struct budget_s new_budget = {0};
+    (void)bpf_map_update_elem(&proc_budget_tbl, &tgid, &new_budget, BPF_NOEXIST);
+    return bpf_map_lookup_elem(&proc_budget_tbl, &tgid);
+}
+
+/*
+    Charge the payload of one send/recv against the connection and process budget.
+    Return the number of bytes allowed to be submitted:
+    bytes_count if both budgets are enough; otherwise at most BUDGET_HDR_SIZE bytes
+    in BUDGET_MODE_HDR_ONLY while one data event is still affordable; 0 else.
+*/
+static __always_inline __maybe_unused size_t apply_capture_budget(struct sock_conn_s* sock_conn, size_t bytes_count)
+{
+    struct filter_args_s *args = get_filter_args();
+    if (args == NULL) {
+        return bytes_count;
+    }
+
+    struct budget_args_s *rate = &(args->budget);
+    if (rate->conn_bytes_rate == 0 && rate->conn_evts_rate == 0 &&
+        rate->proc_bytes_rate == 0 && rate->proc_evts_rate == 0) {
+        return bytes_count;
+    }
+
+    struct budget_s *proc_budget = get_proc_budget(sock_conn->info.id.tgid);
+    if (proc_budget == NULL) {
+        return bytes_count;
+    }
+
+    u64 ts = bpf_ktime_get_ns();
+    u32 bytes = (u32)min(bytes_count, (size_t)(LOOP_LIMIT * CONN_DATA_MAX_SIZE));
+    u32 evts = (bytes + CONN_DATA_MAX_SIZE - 1) / CONN_DATA_MAX_SIZE;
+    size_t captured = 0;
+
+    refill_budget(&(sock_conn->budget), rate->conn_bytes_rate, rate->conn_evts_rate, ts);
+    refill_budget(proc_budget, rate->proc_bytes_rate, rate->proc_evts_rate, ts);
+
+    if (is_budget_enough(&(sock_conn->budget), rate->conn_bytes_rate, rate->conn_evts_rate, bytes, evts) &&
+        is_budget_enough(proc_budget, rate->proc_bytes_rate, rate->proc_evts_rate, bytes, evts)) {
+        captured = bytes_count;
+    } else if (args->budget_mode == BUDGET_MODE_HDR_ONLY &&
+        is_budget_enough(&(sock_conn->budget), 0, rate->conn_evts_rate, 0, 1) &&
+        is_budget_enough(proc_budget, 0, rate->proc_evts_rate, 0, 1)) {
+        captured = min(bytes_count, (size_t)BUDGET_HDR_SIZE);
+        bytes = (u32)captured;
+        evts = 1;
+    } else {
+        bytes = 0;
+        evts = 0;
+    }
+
+    consume_budget(&(sock_conn->budget), rate->conn_bytes_rate, rate->conn_evts_rate, bytes, evts);
+    consume_budget(proc_budget, rate->proc_bytes_rate, rate->proc_evts_rate, bytes, evts);
+
+    if (captured < bytes_count) {
+        u32 total_evts = (u32)((min(bytes_count, (size_t)(LOOP_LIMIT * CONN_DATA_MAX_SIZE)) +
+                                CONN_DATA_MAX_SIZE - 1) / CONN_DATA_MAX_SIZE);
+        add_budget_evt_stats(total_evts - evts, (u64)(bytes_count - captured));
+    }
+    return captured;
+}
+
 // Use the BPF map to cache socket data to avoid the restriction
 // that the BPF program stack does not exceed 512 bytes.
 
@@ -152,6 +309,7 @@ static __always_inline void submit_perf_buf(void* ctx, const char *buf, size_t b
     conn_data->msg.evt = TRACKER_EVT_DATA;
 
     bpfbuf_submit(ctx, &conn_tracker_events, conn_data, sizeof(struct conn_data_msg_s) + (copied_size & CONN_DATA_MAX_SIZE));
+    add_tracker_evt_stats(TRACKER_EVT_DATA, 0);
     return;
 }
 
@@ -160,6 +318,7 @@ static __always_inline __maybe_unused struct conn_data_s* store_conn_data_buf(en
     struct conn_data_s* conn_data = bpfbuf_reserve(&conn_tracker_events, sizeof(struct conn_data_s));
 
     if (conn_data == NULL) {
+        add_tracker_evt_stats(TRACKER_EVT_DATA, 1);
         return NULL;
     }
 
@@ -186,6 +345,7 @@ static __always_inline __maybe_unused void submit_sock_conn_stats(void *ctx, str
 
     struct conn_stats_s* e = bpfbuf_reserve(&conn_tracker_events, sizeof(struct conn_stats_s));
     if (!e) {
+        add_tracker_evt_stats(TRACKER_EVT_STATS, 1);
         return;
     }
 
@@ -197,13 +357,16 @@ static __always_inline __maybe_unused void submit_sock_conn_stats(void *ctx, str
 
     // submit conn stats event.
     bpfbuf_submit(ctx, &conn_tracker_events, e, sizeof(struct conn_stats_s));
+    add_tracker_evt_stats(TRACKER_EVT_STATS, 0);
     return;
 }
 
+// Submit 'bytes_count' bytes of the data, starting after its first 'skip' bytes.
 static __always_inline __maybe_unused void submit_conn_data(void* ctx, struct sock_data_args_s* args,
-                                        size_t bytes_count, enum l7_direction_t direction, struct sock_conn_s* sock_conn)
+                                        size_t skip, size_t bytes_count, enum l7_direction_t direction,
+                                        struct sock_conn_s* sock_conn, u64 elided_size)
 {
-    int i;
+    int i, index = 0;
     int bytes_sent = 0, bytes_remaining = 0, bytes_truncated = 0;
 
     struct conn_data_s* conn_data;
@@ -222,10 +385,11 @@ static __always_inline __maybe_unused void submit_conn_data(void* ctx, struct so
                 return;
             }
 
-            // summit perf buf
+            // summit perf buf, the elided body follows the last chunk only.
             conn_data->msg.index = i;
+            conn_data->msg.elided_size = (bytes_sent + bytes_truncated >= (int)bytes_count) ? elided_size : 0;
             conn_data->msg.offset_pos = (u64)(bytes_truncated + bytes_sent);
-            submit_perf_buf(ctx, args->buf + bytes_sent, (size_t)bytes_truncated, conn_data);
+            submit_perf_buf(ctx, args->buf + skip + bytes_sent, (size_t)bytes_truncated, conn_data);
             bytes_sent += bytes_truncated;
         }
     } else if (args->iov) {
@@ -233,6 +397,13 @@ static __always_inline __maybe_unused void submit_conn_data(void* ctx, struct so
         for (i = 0; i < LOOP_LIMIT && i < args->iovlen && bytes_sent < bytes_count; ++i) {
             struct iovec iov_cpy = {0};
             bpf_probe_read_user(&iov_cpy, sizeof(iov_cpy), &args->iov[i]);
+            if (skip >= iov_cpy.iov_len) {
+                skip -= iov_cpy.iov_len;
+                continue;
+            }
+            iov_cpy.iov_base = (char *)iov_cpy.iov_base + skip;
+            iov_cpy.iov_len -= skip;
+            skip = 0;
             bytes_remaining = (int)bytes_count - bytes_sent;
             bytes_truncated = (bytes_remaining > CONN_DATA_MAX_SIZE && (i != LOOP_LIMIT - 1)) ? CONN_DATA_MAX_SIZE : bytes_remaining;
             if (bytes_truncated <= 0) {
@@ -245,8 +416,10 @@ static __always_inline __maybe_unused void submit_conn_data(void* ctx, struct so
             }
             size_t iov_len = min(iov_cpy.iov_len, (size_t)bytes_remaining);
 
-            // summit perf buf
-            conn_data->msg.index = i;
+            // summit perf buf, the elided body follows the last chunk only.
+            conn_data->msg.index = index++;
+            conn_data->msg.elided_size = (bytes_sent + iov_len >= bytes_count || i + 1 >= args->iovlen ||
+                                          i == LOOP_LIMIT - 1) ? elided_size : 0;
             conn_data->msg.offset_pos = (u64)(iov_len + bytes_sent);
             submit_perf_buf(ctx, (char *)iov_cpy.iov_base, iov_len, conn_data);
             bytes_sent += iov_len;
@@ -254,6 +427,327 @@ static __always_inline __maybe_unused void submit_conn_data(void* ctx, struct so
     }
 }
 
+/*
+    Header-only capture scans the HTTP headers with a bounded loop, which needs kernel 5.3 or later.
+    It is built only with L7_HDR_ONLY_CAPTURE=1, otherwise all the payload is captured.
+*/
+#ifdef L7_HDR_ONLY_CAPTURE
+#define HTTP_CONTENT_LENGTH_KEY_LEN     15  // strlen("content-length:")
+#define HTTP_HDR_SCAN_MAX               512 // Longer headers are captured in full
+#define REDIS_BULK_LEN_DIGITS           12
+
+static __always_inline char get_content_length_key(u32 i)
+{
+    switch (i) {
+        case 0: return 'c';
+        case 1: return 'o';
+        case 2: return 'n';
+        case 3: return 't';
+        case 4: return 'e';
+        case 5: return 'n';
+        case 6: return 't';
+        case 7: return '-';
+        case 8: return 'l';
+        case 9: return 'e';
+        case 10: return 'n';
+        case 11: return 'g';
+        case 12: return 't';
+        case 13: return 'h';
+        case 14: return ':';
+        default: return 0;
+    }
+}
+
+/*
+    Get the total length of the HTTP message starting at 'buf', and the length of its headers.
+    Return 0 if the headers are not complete in 'buf', or there is no Content-Length(e.g. chunked).
+*/
+static __always_inline u64 get_http_msg_len(const char *buf, size_t count, u32 *prefix)
+{
+    u32 match = 0, crlf = 0, hdr_len = 0;
+    char line_start = 1, in_value = 0, has_len = 0;
+    u64 content_len = 0;
+    char c;
+
+    for (u32 i = 0; i < HTTP_HDR_SCAN_MAX; i++) {
+        if (i >= count) {
+            break;
+        }
+        c = buf[i & L7_DATA_BUFFER_IDX_MASK];
+
+        // End of headers: "\r\n\r\n"
+        if (c == ((crlf & 1) ? '\n' : '\r')) {
+            crlf++;
+            if (crlf == 4) {
+                hdr_len = i + 1;
+                break;
+            }
+        } else {
+            crlf = (c == '\r') ? 1 : 0;
+        }
+
+        if (in_value) {
+            if (c >= '0' && c <= '9') {
+                content_len = content_len * 10 + (u64)(c - '0');
+                has_len = 1;
+            } else if (c != ' ' || has_len) {
+                in_value = 0;
+            }
+        } else if (match > 0 || line_start) {
+            if ((c | 0x20) == get_content_length_key(match)) {
+                match++;
+                in_value = (match == HTTP_CONTENT_LENGTH_KEY_LEN);
+            } else {
+                match = 0;
+            }
+        }
+        line_start = (c == '\n');
+    }
+
+    if (hdr_len == 0 || !has_len) {
+        return 0;
+    }
+    *prefix = hdr_len;
+    return (u64)hdr_len + content_len;
+}
+
+// Only the bulk string('$<len>\r\n<data>\r\n'), which carries the large value, is supported.
+static __always_inline u64 get_redis_msg_len(const char *buf, size_t count, u32 *prefix)
+{
+    u64 len = 0;
+    char c;
+
+    if (count < 4 || buf[0] != '$') {
+        return 0;
+    }
+
+    #pragma unroll
+    for (u32 i = 1; i < REDIS_BULK_LEN_DIGITS; i++) {
+        if (i + 1 >= count) {
+            return 0;
+        }
+        c = buf[i & L7_DATA_BUFFER_IDX_MASK];
+        if (c == '\r') {
+            if (i == 1) {
+                return 0;
+            }
+            *prefix = i + 2 + (u32)min(len, (u64)HDR_ONLY_BODY_PREFIX);
+            return (u64)(i + 2) + len + 2;
+        }
+        if (c < '0' || c > '9') {
+            return 0;
+        }
+        len = len * 10 + (u64)(c - '0');
+    }
+    return 0;
+}
+
+// Regular message: tag(1 byte) + len(4 bytes, including itself) + payload
+static __always_inline u64 get_pgsql_msg_len(const char *buf, size_t count, u32 *prefix)
+{
+    u32 len;
+
+    if (count < PGSQL_REGULAR_PACKET_MIN_LEN) {
+        return 0;
+    }
+
+    len = ((u32)(u8)buf[1] << 24) | ((u32)(u8)buf[2] << 16) | ((u32)(u8)buf[3] << 8) | (u32)(u8)buf[4];
+    if (len < 4) {
+        return 0;
+    }
+    *prefix = 5 + (u32)min(len - 4, (u32)HDR_ONLY_BODY_PREFIX);
+    return (u64)len + 1;
+}
+
+/*
+    Header-only capture: once the protocol is known, submit only a protocol-specific prefix of a message
+    which spans to the end of this send/recv, and skip the rest of its body in the following send/recv.
+    Return the number of bytes to be submitted after the first '*skip' bytes of the data, and set '*elided'
+    to the body bytes not submitted.
+*/
+static __always_inline __maybe_unused size_t apply_hdr_only_capture(struct sock_conn_s* sock_conn,
+    enum l7_direction_t direction, const char *buf, size_t buf_len, size_t bytes_count, size_t *skip, u64 *elided)
+{
+    struct filter_args_s *args = get_filter_args();
+    u64 *remain = (direction == L7_EGRESS) ? &(sock_conn->wr_body_remain) : &(sock_conn->rd_body_remain);
+    u64 msg_len;
+    u32 prefix = 0;
+
+    *skip = 0;
+    *elided = 0;
+    if (args == NULL || args->capture_policy != CAPTURE_POLICY_HDR_ONLY) {
+        *remain = 0;
+        return bytes_count;
+    }
+
+    if (*remain > 0) {
+        if (bytes_count <= *remain) {
+            *remain -= bytes_count;
+            return 0;
+        }
+        /*
+            The elided body ends in this data. It was reported as elided with the head of its message,
+            so skip it and submit the data from the next message on.
+        */
+        *skip = (size_t)*remain;
+        *remain = 0;
+        return bytes_count - *skip;
+    }
+
+    switch (sock_conn->info.protocol) {
+        case PROTO_HTTP:
+            msg_len = get_http_msg_len(buf, buf_len, &prefix);
+            break;
+        case PROTO_REDIS:
+            msg_len = get_redis_msg_len(buf, buf_len, &prefix);
+            break;
+        case PROTO_PGSQL:
+            msg_len = get_pgsql_msg_len(buf, buf_len, &prefix);
+            break;
+        default:
+            return bytes_count;
+    }
+
+    // Length unknown, or more messages follow in this data.
+    if (msg_len == 0 || msg_len < bytes_count || prefix >= bytes_count) {
+        return bytes_count;
+    }
+
+    *remain = msg_len - bytes_count;
+    *elided = msg_len - prefix;
+    return (size_t)prefix;
+}
+#else
+static __always_inline __maybe_unused size_t apply_hdr_only_capture(struct sock_conn_s* sock_conn,
+    enum l7_direction_t direction, const char *buf, size_t buf_len, size_t bytes_count, size_t *skip, u64 *elided)
+{
+    *skip = 0;
+    *elided = 0;
+    return bytes_count;
+}
+#endif
+
+static __always_inline __maybe_unused char is_rpc_sample_capture(struct sock_conn_s* sock_conn)
+{
+    struct filter_args_s *args = get_filter_args();
+    if (args == NULL || args->capture_policy != CAPTURE_POLICY_RPC_SAMPLE || sock_conn->rpc.pipelined) {
+        return 0;
+    }
+
+    // Only for strictly request-reply protocols.
+    switch (sock_conn->info.protocol) {
+        case PROTO_HTTP:
+        case PROTO_REDIS:
+        case PROTO_MYSQL:
+            return (sock_conn->info.l7_role != L7_UNKNOW);
+        default:
+            return 0;
+    }
+}
+
+// Copy at most RPC_SAMPLE_HDR_SIZE bytes of the data, the rest of 'hdr' is zeroed.
+static __always_inline void read_rpc_sample_hdr(char *hdr, const char *buf, size_t buf_len)
+{
+    __builtin_memset(hdr, 0, RPC_SAMPLE_HDR_SIZE);
+    if (buf_len >= RPC_SAMPLE_HDR_SIZE) {
+        bpf_probe_read(hdr, RPC_SAMPLE_HDR_SIZE, buf);
+    } else if (buf_len > 0) {
+        bpf_probe_read(hdr, buf_len & (RPC_SAMPLE_HDR_SIZE - 1), buf);
+    }
+}
+
+// Whether the request data starts a new message of the protocol.
+static __always_inline char is_rpc_request_start(struct sock_conn_s* sock_conn, const char *buf, size_t buf_len)
+{
+    const char *hdr = sock_conn->rpc.req_hdr;
+    u32 req_len;
+
+    switch (sock_conn->info.protocol) {
+        case PROTO_HTTP:
+            return (__get_http_type(buf, buf_len) == MESSAGE_REQUEST);
+        case PROTO_REDIS:
+            return (buf[0] == '*' && __get_redis_type(buf, buf_len) == MESSAGE_REQUEST);
+        case PROTO_MYSQL:
+            // A command packet(sequence id 0) after the whole packet of the pending request.
+            req_len = (u32)(u8)hdr[0] | ((u32)(u8)hdr[1] << 8) | ((u32)(u8)hdr[2] << 16);
+            return (buf_len > 4 && buf[3] == 0 && sock_conn->rpc.req_size >= req_len + 4);
+        default:
+            return 0;
+    }
+}
+
+/*
+    RPC sample capture applies to non-pipelined connections only. Once a new request is sent while
+    one is still pending, the connection falls back to payload capture, and user space parses it.
+*/
+static __always_inline __maybe_unused char is_rpc_pipelined(struct sock_conn_s* sock_conn,
+    enum l7_direction_t direction, const char *buf, size_t buf_len)
+{
+    struct rpc_pending_s *rpc = &(sock_conn->rpc);
+
+    if (rpc->req_ts == 0 || get_message_type(sock_conn->info.l7_role, direction) != MESSAGE_REQUEST) {
+        return 0;
+    }
+
+    if (!is_rpc_request_start(sock_conn, buf, buf_len)) {
+        return 0;
+    }
+
+    rpc->pipelined = 1;
+    rpc->req_ts = 0;
+    return 1;
+}
+
+/*
+    RPC sample capture: record the timestamp and head of the first request data, and submit one
+    'conn_rpc_s' when the response starts, instead of submitting the payload to user space.
+    'buf' holds the first 'buf_len' bytes of the data.
+*/
+static __always_inline __maybe_unused void submit_rpc_sample(void *ctx, struct sock_conn_s* sock_conn,
+    enum l7_direction_t direction, const char *buf, size_t buf_len, size_t bytes_count)
+{
+    struct rpc_pending_s *rpc = &(sock_conn->rpc);
+    enum message_type_t msg_type = get_message_type(sock_conn->info.l7_role, direction);
+
+    if (msg_type == MESSAGE_REQUEST) {
+        if (rpc->req_ts == 0) {
+            rpc->req_ts = bpf_ktime_get_ns();
+            rpc->req_size = 0;
+            read_rpc_sample_hdr(rpc->req_hdr, buf, buf_len);
+        }
+        rpc->req_size += (u32)bytes_count;
+        return;
+    }
+
+    // Following data of the response, or a response without request.
+    if (rpc->req_ts == 0) {
+        return;
+    }
+
+    struct conn_rpc_s* e = bpfbuf_reserve(&conn_tracker_events, sizeof(struct conn_rpc_s));
+    if (!e) {
+        add_tracker_evt_stats(TRACKER_EVT_RPC, 1);
+        rpc->req_ts = 0;
+        return;
+    }
+
+    e->evt = TRACKER_EVT_RPC;
+    e->proto = sock_conn->info.protocol;
+    e->l7_role = sock_conn->info.l7_role;
+    e->conn_id = sock_conn->info.id;
+    e->timestamp_ns = bpf_ktime_get_ns();
+    e->latency_ns = (e->timestamp_ns > rpc->req_ts) ? (e->timestamp_ns - rpc->req_ts) : 0;
+    e->req_size = rpc->req_size;
+    e->resp_size = (u32)bytes_count;
+    __builtin_memcpy(e->req_hdr, rpc->req_hdr, RPC_SAMPLE_HDR_SIZE);
+    read_rpc_sample_hdr(e->resp_hdr, buf, buf_len);
+    rpc->req_ts = 0;
+
+    bpfbuf_submit(ctx, &conn_tracker_events, e, sizeof(struct conn_rpc_s));
+    add_tracker_evt_stats(TRACKER_EVT_RPC, 0);
+    return;
+}
+
 static __always_inline __maybe_unused char *read_from_buf_ptr(const char* buf)
 {
     u32 key = 0;
@@ -268,6 +762,8 @@ static __always_inline __maybe_unused void submit_sock_data(void *ctx, struct so
             enum l7_direction_t direction, struct sock_data_args_s* args, size_t bytes_count)
 {
     char *buffer;
+    size_t buf_len, captured, budget_captured, skip;
+    u64 elided;
 
     if (sock_conn->info.is_ssl != args->is_ssl) {
         return;
@@ -283,6 +779,7 @@ static __always_inline __maybe_unused void submit_sock_data(void *ctx, struct so
         if (update_sock_conn_proto(sock_conn, direction, buffer, bytes_count, proto)) {
             return;
         }
+        buf_len = bytes_count;
     } else if (args->iov) {
         struct iovec iov_cpy = {0};
         // Using bpf_core_read will get error: failed to resolve CO-RE relocation <byte_off> [xx] struct sock_data_args_s.iov
@@ -295,11 +792,23 @@ static __always_inline __maybe_unused void submit_sock_data(void *ctx, struct so
         if (update_sock_conn_proto(sock_conn, direction, buffer, iov_len, proto)) {
             return;
         }
+        buf_len = iov_len;
     } else {
         return;
     }
 
-    submit_conn_data(ctx, args, bytes_count, direction, sock_conn);
+    if (is_rpc_sample_capture(sock_conn) && !is_rpc_pipelined(sock_conn, direction, buffer, buf_len)) {
+        submit_rpc_sample(ctx, sock_conn, direction, buffer, buf_len, bytes_count);
+        submit_sock_conn_stats(ctx, sock_conn, direction, bytes_count);
+        return;
+    }
+
+    captured = apply_hdr_only_capture(sock_conn, direction, buffer, buf_len, bytes_count, &skip, &elided);
+    budget_captured = (captured > 0) ? apply_capture_budget(sock_conn, captured) : 0;
+    if (budget_captured > 0) {
+        elided += (u64)(captured - budget_captured);
+        submit_conn_data(ctx, args, skip, budget_captured, direction, sock_conn, elided);
+    }
 
     submit_sock_conn_stats(ctx, sock_conn, direction, bytes_count);
 
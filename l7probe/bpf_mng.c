@@ -38,6 +38,8 @@
 #define L7_TCP_PATH              "/sys/fs/bpf/gala-gopher/__l7_tcp_tbl"
 #define L7_FILTER_ARGS_PATH      "/sys/fs/bpf/gala-gopher/__l7_filter_args"
 #define L7_PROC_OBJ_PATH         "/sys/fs/bpf/gala-gopher/__l7_proc_obj_map"
+#define L7_EVT_STATS_PATH        "/sys/fs/bpf/gala-gopher/__l7_evt_stats"
+#define L7_PROC_BUDGET_PATH      "/sys/fs/bpf/gala-gopher/__l7_proc_budget"
 
 #define __LOAD_PROBE(probe_name, end, load, buffer) \
     INIT_OPEN_OPTS(probe_name); \
@@ -48,6 +50,8 @@
     MAP_SET_PIN_PATH(probe_name, conn_tbl, L7_CONN_CONN_PATH, load); \
     MAP_SET_PIN_PATH(probe_name, l7_tcp, L7_TCP_PATH, load); \
     MAP_SET_PIN_PATH(probe_name, filter_args_tbl, L7_FILTER_ARGS_PATH, load); \
+    MAP_SET_PIN_PATH(probe_name, tracker_evt_stats, L7_EVT_STATS_PATH, load); \
+    MAP_SET_PIN_PATH(probe_name, proc_budget_tbl, L7_PROC_BUDGET_PATH, load); \
     LOAD_ATTACH(l7probe, probe_name, end, load)
 
 int l7_load_probe_libssl(struct l7_mng_s *l7_mng, struct bpf_prog_s *prog, const char *libssl_path)
@@ -130,6 +134,10 @@ int l7_load_probe_libssl(struct l7_mng_s *l7_mng, struct bpf_prog_s *prog, const
         l7_mng->bpf_progs.proc_obj_map_fd = GET_MAP_FD(libssl, proc_obj_map);
     }
 
+    if (l7_mng->bpf_progs.evt_stats_fd <= 0) {
+        l7_mng->bpf_progs.evt_stats_fd = GET_MAP_FD(libssl, tracker_evt_stats);
+    }
+
     DEBUG("[L7PROBE]: init lib_ssl bpf prog succeed.\n");
     return 0;
 err:
@@ -174,6 +182,10 @@ int l7_load_probe_kern_sock(struct l7_mng_s *l7_mng, struct bpf_prog_s *prog)
         l7_mng->bpf_progs.proc_obj_map_fd = GET_MAP_FD(kern_sock, proc_obj_map);
     }
 
+    if (l7_mng->bpf_progs.evt_stats_fd <= 0) {
+        l7_mng->bpf_progs.evt_stats_fd = GET_MAP_FD(kern_sock, tracker_evt_stats);
+    }
+
     INFO("[L7PROBE]: init kern_sock bpf prog succeed.\n");
     return 0;
 err:
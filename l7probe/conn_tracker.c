@@ -17,6 +17,7 @@
 #include <signal.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include <pthread.h>
 
 #ifdef BPF_PROG_KERN
@@ -46,6 +47,8 @@
 #define L7_TBL_LINK     "l7_link"
 #define L7_TBL_RPC      "l7_rpc"
 #define L7_TBL_RPC_API  "l7_rpc_api"
+#define L7_TBL_PROBE    "l7_probe"
+#define L7_TBL_PARSE    "l7_probe_parse"
 
 
 const char *proto_name[PROTO_MAX] = {
@@ -59,7 +62,9 @@ const char *proto_name[PROTO_MAX] = {
     "nats",
     "cql",
     "mongo",
-    "kafka"
+    "kafka",
+    "crpc",
+    "amqp"
 };
 
 const char *l7_role_name[L7_ROLE_MAX] = {
@@ -93,6 +98,7 @@ static void destroy_tracker_record(struct conn_tracker_s* tracker)
     tracker->records.resp_count = 0;
     tracker->records.msg_error_count = 0;
     tracker->records.msg_total_count = 0;
+    tracker->records.overflow_count = 0;
     return;
 }
 
@@ -528,7 +534,8 @@ static int proc_conn_data_msg(struct l7_mng_s *l7_mng, struct conn_data_msg_s *c
                                             (const char *)conn_data_buf,
                                             (size_t)conn_data_msg->data_size,
                                             conn_data_msg->timestamp_ns,
-                                            conn_data_msg->index);
+                                            conn_data_msg->index,
+                                            (size_t)conn_data_msg->elided_size);
             break;
         }
         case L7_INGRESS:
@@ -538,7 +545,8 @@ static int proc_conn_data_msg(struct l7_mng_s *l7_mng, struct conn_data_msg_s *c
                                             (const char *)conn_data_buf,
                                             (size_t)conn_data_msg->data_size,
                                             conn_data_msg->timestamp_ns,
-                                            conn_data_msg->index);
+                                            conn_data_msg->index,
+                                            (size_t)conn_data_msg->elided_size);
             break;
         }
         default:
@@ -550,6 +558,92 @@ static int proc_conn_data_msg(struct l7_mng_s *l7_mng, struct conn_data_msg_s *c
     return ret;
 }
 
+#define HTTP_STATUS_OFFSET  9   // "HTTP/1.1 200"
+#define MYSQL_HDR_SIZE      4
+#define MYSQL_ERR_PACKET    0xff
+
+// Return 1 if the response head of rpc sample indicates an error, 'is_client_err' is set for client errors.
+static char is_rpc_sample_err(const struct conn_rpc_s *conn_rpc_msg, char *is_client_err)
+{
+    const char *resp = conn_rpc_msg->resp_hdr;
+    size_t resp_size = min((size_t)conn_rpc_msg->resp_size, (size_t)RPC_SAMPLE_HDR_SIZE);
+
+    *is_client_err = 0;
+    switch (conn_rpc_msg->proto) {
+        case PROTO_HTTP:
+        {
+            if (resp_size <= HTTP_STATUS_OFFSET || strncmp(resp, "HTTP/", strlen("HTTP/")) != 0) {
+                return 0;
+            }
+            if (resp[HTTP_STATUS_OFFSET] == '4') {
+                *is_client_err = 1;
+                return 1;
+            }
+            return (resp[HTTP_STATUS_OFFSET] == '5');
+        }
+        case PROTO_REDIS:
+        {
+            return (resp_size > 0 && resp[0] == '-');
+        }
+        case PROTO_MYSQL:
+        {
+            return (resp_size > MYSQL_HDR_SIZE && (u8)resp[MYSQL_HDR_SIZE] == MYSQL_ERR_PACKET);
+        }
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+// Kernel-computed request/response latency, which bypasses data stream reassembly and parsing.
+static int proc_conn_rpc_msg(struct l7_mng_s *l7_mng, struct conn_rpc_s *conn_rpc_msg)
+{
+    int ret;
+    char is_client_err;
+    struct conn_tracker_s* tracker;
+    struct tracker_id_s tracker_id = {0};
+    struct l7_link_s* link;
+
+    tracker_id.fd = conn_rpc_msg->conn_id.fd;
+    tracker_id.tgid = conn_rpc_msg->conn_id.tgid;
+    tracker = lkup_conn_tracker(l7_mng, (const struct tracker_id_s *)&tracker_id);
+    if (tracker == NULL) {
+        ERROR("[L7Probe]: Conn tracker[%d:%d] is not found when proc rpc msg.\n", tracker_id.tgid, tracker_id.fd);
+        return -1;
+    }
+
+    if (tracker->protocol == PROTO_UNKNOW) {
+        tracker->protocol = conn_rpc_msg->proto;
+        tracker->send_stream.type = tracker->protocol;
+        tracker->recv_stream.type = tracker->protocol;
+    }
+
+    if (tracker->l7_role == L7_UNKNOW) {
+        tracker->l7_role = conn_rpc_msg->l7_role;
+    }
+
+    link = add_l7_link(l7_mng, (const struct conn_tracker_s *)tracker);
+    if (link == NULL) {
+        return -1;
+    }
+    link->last_rcv_data = time(NULL);
+
+    link->stats[REQ_COUNT]++;
+    link->stats[RSP_COUNT]++;
+    if (is_rpc_sample_err(conn_rpc_msg, &is_client_err)) {
+        link->stats[ERR_COUNT]++;
+        link->stats[is_client_err ? CLIENT_ERR_COUNT : SERVER_ERR_COUNT]++;
+    }
+
+    link->latency_sum += conn_rpc_msg->latency_ns;
+    ret = histo_bucket_add_value(l7_mng->latency_buckets, &link->latency_buckets, __MAX_LT_RANGE, conn_rpc_msg->latency_ns);
+    if (ret) {
+        ERROR("[L7PROBE] Failed to add latency to histo bucket, value: %lu\n", conn_rpc_msg->latency_ns);
+    }
+    return 0;
+}
+
 // Calculate api-level metrics for l7_statistics
 static void add_tracker_l7_stats(struct bucket_range_s bucket_range[], struct conn_tracker_s* tracker, struct l7_link_s* link)
 {
@@ -621,21 +715,59 @@ static void add_tracker_stats(struct l7_mng_s *l7_mng, struct conn_tracker_s* tr
     return;
 }
 
+static u64 get_mono_time_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static void add_data_stream_telemetry(struct l7_telemetry_s *telemetry, struct data_stream_s *data_stream)
+{
+    struct data_stream_stats_s *stats = &(data_stream->stats);
+
+    if (data_stream->type < PROTO_MAX) {
+        for (int i = 0; i < PARSE_STATE_MAX; i++) {
+            telemetry->parse_states[data_stream->type][i] += stats->parse_states[i];
+        }
+    }
+    telemetry->raw_buf_overflow += stats->raw_buf_overflow;
+    telemetry->raw_buf_hwm = max(telemetry->raw_buf_hwm, stats->raw_buf_hwm);
+    telemetry->frame_buf_hwm = max(telemetry->frame_buf_hwm, stats->frame_buf_hwm);
+
+    (void)memset(stats, 0, sizeof(struct data_stream_stats_s));
+    return;
+}
+
 static void l7_parser_tracker(struct l7_mng_s *l7_mng, struct conn_tracker_s* tracker)
 {
     enum message_type_t msg_type;
+    struct l7_telemetry_s *telemetry = &(l7_mng->telemetry);
+    u64 start_ns, end_ns;
 
+    start_ns = get_mono_time_ns();
     msg_type = get_message_type(tracker->l7_role, L7_EGRESS);
     data_stream_parse_frames(msg_type, &(tracker->send_stream));
 
     msg_type = get_message_type(tracker->l7_role, L7_INGRESS);
     data_stream_parse_frames(msg_type, &(tracker->recv_stream));
+    end_ns = get_mono_time_ns();
+    telemetry->time_ns[TELM_TIME_PARSE] += end_ns - start_ns;
 
     // TODO: match frames
+    start_ns = end_ns;
     proto_match_frames(tracker->protocol,
                        get_req_frames(tracker),
                        get_resp_frames(tracker),
                        &tracker->records);
+    telemetry->time_ns[TELM_TIME_MATCH] += get_mono_time_ns() - start_ns;
+
+    add_data_stream_telemetry(telemetry, &(tracker->send_stream));
+    add_data_stream_telemetry(telemetry, &(tracker->recv_stream));
+    if (tracker->protocol < PROTO_MAX) {
+        telemetry->record_buf_overflow[tracker->protocol] += tracker->records.overflow_count;
+    }
 
     // add stats
     add_tracker_stats(l7_mng, tracker);
@@ -914,6 +1046,163 @@ static void report_l7_stats(struct l7_mng_s *l7_mng)
     return;
 }
 
+#define __KERN_COUNTER_DELTA(total, last, field) \
+    (((total).field >= (last)->field) ? ((total).field - (last)->field) : (total).field)
+
+static void calc_kern_evt_stats(struct l7_mng_s *l7_mng)
+{
+    int fd = l7_mng->bpf_progs.evt_stats_fd;
+    int cpus = libbpf_num_possible_cpus();
+    struct tracker_evt_stats_s *values, total;
+    struct tracker_evt_stats_s *last;
+    struct l7_telemetry_s *telemetry = &(l7_mng->telemetry);
+
+    if (fd <= 0 || cpus <= 0) {
+        return;
+    }
+
+    values = (struct tracker_evt_stats_s *)calloc(cpus, sizeof(struct tracker_evt_stats_s));
+    if (values == NULL) {
+        return;
+    }
+
+    for (u32 evt = TRACKER_EVT_STATS; evt < TRACKER_EVT_MAX; evt++) {
+        if (bpf_map_lookup_elem(fd, &evt, values) < 0) {
+            continue;
+        }
+
+        (void)memset(&total, 0, sizeof(total));
+        for (int cpu = 0; cpu < cpus; cpu++) {
+            total.submitted += values[cpu].submitted;
+            total.dropped += values[cpu].dropped;
+            total.budget_dropped += values[cpu].budget_dropped;
+            total.budget_dropped_bytes += values[cpu].budget_dropped_bytes;
+        }
+
+        // Kernel counters are cumulative, and restart from zero when the bpf map is recreated.
+        last = &(telemetry->evt_kern_last[evt]);
+        telemetry->evt_submitted[evt] = __KERN_COUNTER_DELTA(total, last, submitted);
+        telemetry->evt_dropped[evt] = __KERN_COUNTER_DELTA(total, last, dropped);
+        telemetry->evt_budget_dropped[evt] = __KERN_COUNTER_DELTA(total, last, budget_dropped);
+        telemetry->budget_dropped_bytes += __KERN_COUNTER_DELTA(total, last, budget_dropped_bytes);
+        *last = total;
+    }
+
+    free(values);
+    return;
+}
+
+static void calc_user_evt_stats(struct l7_mng_s *l7_mng)
+{
+    struct l7_telemetry_s *telemetry = &(l7_mng->telemetry);
+
+    for (u32 evt = TRACKER_EVT_STATS; evt < TRACKER_EVT_MAX; evt++) {
+        telemetry->evt_drb_dropped[evt] = __atomic_exchange_n(&(telemetry->evt_drb_dropped_cnt[evt]), 0,
+                                                              __ATOMIC_RELAXED);
+    }
+}
+
+static void report_l7_telemetry(struct l7_mng_s *l7_mng)
+{
+    struct l7_telemetry_s *telemetry = &(l7_mng->telemetry);
+    int tgid = (int)getpid();
+    u64 *states;
+
+    (void)fprintf(stdout, "|%s|%d"
+        "|%llu|%llu|%llu"
+        "|%llu|%llu|%llu"
+        "|%llu|%llu|%llu"
+        "|%llu|%llu"
+        "|%llu|%llu"
+        "|%llu|%llu|%u|%u"
+        "|%llu|%llu|%llu"
+        "|%llu|%llu|%llu|\n",
+
+        L7_TBL_PROBE,
+        tgid,
+
+        telemetry->evt_submitted[TRACKER_EVT_DATA],
+        telemetry->evt_submitted[TRACKER_EVT_CTRL],
+        telemetry->evt_submitted[TRACKER_EVT_STATS],
+
+        telemetry->evt_dropped[TRACKER_EVT_DATA],
+        telemetry->evt_dropped[TRACKER_EVT_CTRL],
+        telemetry->evt_dropped[TRACKER_EVT_STATS],
+
+        telemetry->evt_drb_dropped[TRACKER_EVT_DATA],
+        telemetry->evt_drb_dropped[TRACKER_EVT_CTRL],
+        telemetry->evt_drb_dropped[TRACKER_EVT_STATS],
+
+        telemetry->evt_budget_dropped[TRACKER_EVT_DATA],
+        telemetry->budget_dropped_bytes,
+
+        telemetry->evt_submitted[TRACKER_EVT_RPC],
+        telemetry->evt_dropped[TRACKER_EVT_RPC],
+
+        __atomic_load_n(&(telemetry->drb_occupancy), __ATOMIC_RELAXED),
+        __atomic_load_n(&(telemetry->drb_hwm), __ATOMIC_RELAXED),
+        H_COUNT(l7_mng->trackers),
+        l7_mng->l7_links_capability,
+
+        (u64)telemetry->raw_buf_hwm,
+        (u64)telemetry->frame_buf_hwm,
+        telemetry->raw_buf_overflow,
+
+        telemetry->time_ns[TELM_TIME_PARSE],
+        telemetry->time_ns[TELM_TIME_MATCH],
+        telemetry->time_ns[TELM_TIME_REPORT]);
+
+    for (int proto = PROTO_UNKNOW + 1; proto < PROTO_MAX; proto++) {
+        states = telemetry->parse_states[proto];
+        if (telemetry->record_buf_overflow[proto] == 0 &&
+            states[STATE_SUCCESS] == 0 && states[STATE_INVALID] == 0 && states[STATE_NEEDS_MORE_DATA] == 0 &&
+            states[STATE_IGNORE] == 0 && states[STATE_EOS] == 0 && states[STATE_NOT_FOUND] == 0 &&
+            states[STATE_UNKNOWN] == 0) {
+            continue;
+        }
+
+        (void)fprintf(stdout, "|%s|%d|%s"
+            "|%llu|%llu|%llu|%llu"
+            "|%llu|%llu|%llu|%llu|\n",
+
+            L7_TBL_PARSE,
+            tgid,
+            proto_name[proto],
+
+            states[STATE_SUCCESS],
+            states[STATE_INVALID],
+            states[STATE_NEEDS_MORE_DATA],
+            states[STATE_IGNORE],
+
+            states[STATE_EOS],
+            states[STATE_NOT_FOUND],
+            states[STATE_UNKNOWN],
+            telemetry->record_buf_overflow[proto]);
+    }
+
+    (void)fflush(stdout);
+}
+
+static void reset_l7_telemetry(struct l7_mng_s *l7_mng)
+{
+    struct l7_telemetry_s *telemetry = &(l7_mng->telemetry);
+
+    // Keep the cumulative state, and reset all the per-period metrics.
+    (void)memset(telemetry->evt_submitted, 0, sizeof(telemetry->evt_submitted));
+    (void)memset(telemetry->evt_dropped, 0, sizeof(telemetry->evt_dropped));
+    (void)memset(telemetry->evt_drb_dropped, 0, sizeof(telemetry->evt_drb_dropped));
+    (void)memset(telemetry->evt_budget_dropped, 0, sizeof(telemetry->evt_budget_dropped));
+    telemetry->budget_dropped_bytes = 0;
+    (void)memset(telemetry->parse_states, 0, sizeof(telemetry->parse_states));
+    (void)memset(telemetry->record_buf_overflow, 0, sizeof(telemetry->record_buf_overflow));
+    (void)memset(telemetry->time_ns, 0, sizeof(telemetry->time_ns));
+    __atomic_store_n(&(telemetry->drb_hwm), __atomic_load_n(&(telemetry->drb_occupancy), __ATOMIC_RELAXED),
+                     __ATOMIC_RELAXED);
+    telemetry->raw_buf_hwm = 0;
+    telemetry->frame_buf_hwm = 0;
+    telemetry->raw_buf_overflow = 0;
+}
+
 static char is_report_tmout(struct l7_mng_s *l7_mng)
 {
     time_t current = (time_t)time(NULL);
@@ -933,15 +1222,26 @@ static char is_report_tmout(struct l7_mng_s *l7_mng)
 void report_l7(void *ctx)
 {
     struct l7_mng_s *l7_mng = ctx;
+    u64 start_ns;
 
     if (!is_report_tmout(l7_mng)) {
         return;
     }
 
+    start_ns = get_mono_time_ns();
     calc_l7_stats(l7_mng);
     report_l7_stats(l7_mng);
     aging_l7_stats(l7_mng);
     reset_l7_stats(l7_mng);
+
+    // Report time of this period includes l7_link/l7_rpc/l7_rpc_api only.
+    l7_mng->telemetry.time_ns[TELM_TIME_REPORT] += get_mono_time_ns() - start_ns;
+    calc_user_evt_stats(l7_mng);
+    if (l7_mng->ipc_body.probe_range_flags & PROBE_RANGE_L7BYTES_METRICS) {
+        calc_kern_evt_stats(l7_mng);
+        report_l7_telemetry(l7_mng);
+    }
+    reset_l7_telemetry(l7_mng);
     return;
 }
 
@@ -1011,8 +1311,23 @@ void l7_parser(void *ctx)
 int tracker_msg(void *ctx, void *data, u32 size)
 {
     struct l7_mng_s *l7_mng = ctx;
+    struct l7_telemetry_s *telemetry = &(l7_mng->telemetry);
+    enum tracker_evt_e evt = (size >= sizeof(enum tracker_evt_e)) ? *(enum tracker_evt_e *)data : 0;
+
+    u64 occupancy, hwm;
+
     if (drb_put(l7_mng->drb, data, size)) {
-        WARN("[L7PROBE] Not enough space to put event into the ring buffer. Event is discarded.\n");
+        // Not enough space to put event into the ring buffer. Event is discarded.
+        if (evt > 0 && evt < TRACKER_EVT_MAX) {
+            __atomic_fetch_add(&(telemetry->evt_drb_dropped_cnt[evt]), 1, __ATOMIC_RELAXED);
+        }
+        return 0;
+    }
+
+    occupancy = __atomic_add_fetch(&(telemetry->drb_occupancy), 1, __ATOMIC_RELAXED);
+    hwm = __atomic_load_n(&(telemetry->drb_hwm), __ATOMIC_RELAXED);
+    while (occupancy > hwm && !__atomic_compare_exchange_n(&(telemetry->drb_hwm), &hwm, occupancy,
+                                                           0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
     }
     return 0;
 }
@@ -1029,6 +1344,7 @@ int tracker_msg_continue(void *ctx, void *data, u32 size)
 
     step_size = min(sizeof(struct conn_stats_s), sizeof(struct conn_ctl_s));
     step_size = min(step_size, sizeof(struct conn_data_msg_s));
+    step_size = min(step_size, sizeof(struct conn_rpc_s));
 
     do {
         if (remain_size < step_size) {
@@ -1071,6 +1387,16 @@ int tracker_msg_continue(void *ctx, void *data, u32 size)
                 walk_size = sizeof(struct conn_data_msg_s) + conn_data_msg->payload_size;
                 break;
             }
+            case TRACKER_EVT_RPC:
+            {
+                if (remain_size < sizeof(struct conn_rpc_s)) {
+                    ERROR("[L7Probe]: Invalid conn tracker rpc msg.\n");
+                    return 0;
+                }
+                (void)proc_conn_rpc_msg(l7_mng, (struct conn_rpc_s *)p);
+                walk_size = sizeof(struct conn_rpc_s);
+                break;
+            }
             default:
             {
                 ERROR("[L7Probe]: Unknown conn tracker msg.\n");
@@ -36,6 +36,9 @@ static int push_frame_data(struct data_stream_s *data_stream, const struct frame
 
     frame_buf->frames[frame_buf->frame_buf_size] = (struct frame_data_s *)frame_data;
     frame_buf->frame_buf_size++;
+    if (frame_buf->frame_buf_size > data_stream->stats.frame_buf_hwm) {
+        data_stream->stats.frame_buf_hwm = frame_buf->frame_buf_size;
+    }
     return 0;
 }
 
@@ -84,12 +87,15 @@ static int push_raw_data(struct data_stream_s *data_stream, const struct raw_dat
     struct raw_buf_s *raw_buf = &(data_stream->raw_bufs);
 
     if (raw_buf->raw_buf_size >= __RAW_BUF_SIZE) {
-        ERROR("raw_buf->raw_buf_size = %u\n", raw_buf->raw_buf_size);
+        data_stream->stats.raw_buf_overflow++;
         return -1;
     }
 
     raw_buf->raw_datas[raw_buf->raw_buf_size] = (struct raw_data_s *)raw_data;
     raw_buf->raw_buf_size++;
+    if (raw_buf->raw_buf_size > data_stream->stats.raw_buf_hwm) {
+        data_stream->stats.raw_buf_hwm = raw_buf->raw_buf_size;
+    }
     return 0;
 }
 
@@ -163,6 +169,7 @@ static struct raw_data_s* __do_overlay_raw_data(const struct raw_data_s* dst_dat
     new_raw_data->index = src_data->index;
     new_raw_data->flags = 0;
     new_raw_data->isBrokeData = 0;
+    new_raw_data->elided_len = src_data->elided_len;
 
     p = new_raw_data->data;
     (void)memcpy(p, dst_data->data, dst_data->data_len);
@@ -294,6 +301,9 @@ static enum parse_rslt_e __do_parse_frames(enum message_type_t msg_type, struct
 
     frame_data = NULL;
     parse_state = proto_parse_frame(data_stream->type, msg_type, raw_data, &frame_data);
+    if (parse_state < PARSE_STATE_MAX) {
+        data_stream->stats.parse_states[parse_state]++;
+    }
     switch (parse_state) {
         case STATE_SUCCESS:
         {
@@ -420,7 +430,8 @@ repeat:
     return 0;
 }
 
-int data_stream_add_raw_data(struct data_stream_s *data_stream, const char *data, size_t data_len, u64 timestamp_ns, u32 index)
+int data_stream_add_raw_data(struct data_stream_s *data_stream, const char *data, size_t data_len, u64 timestamp_ns,
+                             u32 index, size_t elided_len)
 {
     int ret;
     struct raw_data_s *new_raw_data = create_raw_data(data_len);
@@ -433,6 +444,7 @@ int data_stream_add_raw_data(struct data_stream_s *data_stream, const char *data
     new_raw_data->flags = 0;
     new_raw_data->index = index;
     new_raw_data->isBrokeData = 0;
+    new_raw_data->elided_len = elided_len;
     (void)memcpy(new_raw_data->data, data, data_len);
 
     ret = push_raw_data(data_stream, (const struct raw_data_s *)new_raw_data);
@@ -189,6 +189,48 @@ struct java_proc_s {
     int proc_id;
 };
 
+enum l7_telm_time_t {
+    TELM_TIME_PARSE = 0,
+    TELM_TIME_MATCH,
+    TELM_TIME_REPORT,
+
+    __MAX_TELM_TIME
+};
+
+/**
+ * Self telemetry of l7probe, reported and reset every period.
+ * tracker_msg() also runs in the JSSE message thread, so the counters it updates
+ * (evt_drb_dropped_cnt, drb_occupancy, drb_hwm) are only accessed atomically.
+ */
+struct l7_telemetry_s {
+    u64 evt_submitted[TRACKER_EVT_MAX];     // events submitted into bpf buffer by kernel
+    u64 evt_dropped[TRACKER_EVT_MAX];       // events failed to reserve bpf buffer in kernel
+    u64 evt_drb_dropped[TRACKER_EVT_MAX];   // events discarded because delaying ring buffer is full
+    u64 evt_drb_dropped_cnt[TRACKER_EVT_MAX];   // evt_drb_dropped accumulated since last report
+    u64 evt_budget_dropped[TRACKER_EVT_MAX];    // events not submitted because payload budget is exhausted
+    u64 budget_dropped_bytes;
+    struct tracker_evt_stats_s evt_kern_last[TRACKER_EVT_MAX];  // kernel counters at last report
+
+    u64 drb_occupancy;                      // events currently cached in delaying ring buffer
+    u64 drb_hwm;                            // high-water mark of drb_occupancy
+    size_t raw_buf_hwm;                     // high-water mark of raw buffer among all data streams
+    size_t frame_buf_hwm;                   // high-water mark of frame buffer among all data streams
+    u64 raw_buf_overflow;
+
+    u64 parse_states[PROTO_MAX][PARSE_STATE_MAX];
+    u64 record_buf_overflow[PROTO_MAX];
+    u64 time_ns[__MAX_TELM_TIME];
+};
+
+static inline void l7_telemetry_drb_pop(struct l7_telemetry_s *telemetry)
+{
+    u64 occupancy = __atomic_load_n(&telemetry->drb_occupancy, __ATOMIC_RELAXED);
+
+    while (occupancy > 0 && !__atomic_compare_exchange_n(&telemetry->drb_occupancy, &occupancy, occupancy - 1,
+                                                         0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
 void destroy_trackers(void *ctx);
 void destroy_links(void *ctx);
 void destroy_unprobed_trackers_links(void *ctx);
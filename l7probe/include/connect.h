@@ -25,7 +25,17 @@
 enum tracker_evt_e {
     TRACKER_EVT_STATS = 1,
     TRACKER_EVT_CTRL,
-    TRACKER_EVT_DATA
+    TRACKER_EVT_DATA,
+    TRACKER_EVT_RPC
+};
+#define TRACKER_EVT_MAX (TRACKER_EVT_RPC + 1)
+
+// Per-cpu counters of 'conn_tracker_events', indexed by 'enum tracker_evt_e'.
+struct tracker_evt_stats_s {
+    u64 submitted;
+    u64 dropped;    // Failed to reserve space from bpf buffer
+    u64 budget_dropped;         // Not submitted because the payload budget is exhausted
+    u64 budget_dropped_bytes;
 };
 
 
@@ -96,11 +106,28 @@ struct conn_data_msg_s {
 
     u64 timestamp_ns;    // The timestamp when syscall completed.
     u64 offset_pos;      // The position is for the first data of this message.
+    u64 elided_size;     // The size of message body following this data, which is not submitted.
     u32 data_size;       // The actually data size, maybe less than msg_size.
     u32 payload_size;    // The size that bpf will submit to the map.
     u32 index;           // Identificate msg index
 };
 
+// Exchange data between user mode/kernel using
+// 'conn_tracker_events' channel in rpc sample capture.
+struct conn_rpc_s {
+    enum tracker_evt_e evt; // Head field must be placed
+    enum proto_type_t proto;
+    enum l7_role_t l7_role;     // RPC client or server
+    struct conn_id_s conn_id;
+
+    u64 timestamp_ns;    // The timestamp when the response starts.
+    u64 latency_ns;      // From the first request byte to the first response byte.
+    u32 req_size;
+    u32 resp_size;       // The size of the first response data.
+    char req_hdr[RPC_SAMPLE_HDR_SIZE];
+    char resp_hdr[RPC_SAMPLE_HDR_SIZE];
+};
+
 struct conn_data_buf_s {
     char data[CONN_DATA_MAX_SIZE];
 };
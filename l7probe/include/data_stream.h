@@ -49,6 +49,8 @@ typedef enum parse_state_t {
     STATE_UNKNOWN
 } parse_state_t;
 
+#define PARSE_STATE_MAX (STATE_UNKNOWN + 1)
+
 struct frame_data_s {
     enum message_type_t msg_type;
     void *frame;
@@ -77,6 +79,9 @@ struct raw_data_s {
     u32 index;
     u32 isBrokeData;
 
+    // Body bytes following data[] which are elided by header-only capture in kernel.
+    size_t elided_len;
+
     // current_pos有效值：[0, data_len - 1]，current_pos = data_len时，证明已解析完当前data[]
     size_t current_pos;
     char data[0];
@@ -134,6 +139,7 @@ struct record_buf_s {
     size_t resp_count;  // raw response frame count
     size_t msg_total_count; // protocol's msg total count for calculating error rate.
     size_t msg_error_count; // protocol's msg error count for calculating error rate.
+    size_t overflow_count;  // records discarded because the record buffer is full
 };
 
 /*
@@ -145,6 +151,16 @@ struct raw_buf_s {
     struct raw_data_s *raw_datas[__RAW_BUF_SIZE];
 };
 
+/*
+  Internal statistics of a data stream, collected and cleared by conn tracker.
+*/
+struct data_stream_stats_s {
+    u64 parse_states[PARSE_STATE_MAX];  // results of proto_parse_frame()
+    u64 raw_buf_overflow;               // raw data discarded because the raw buffer is full
+    size_t raw_buf_hwm;                 // high-water mark of raw_bufs
+    size_t frame_buf_hwm;               // high-water mark of frame_bufs
+};
+
 /*
   Used to Manages data(raw and parsed) in tx OR rx direction on a connection.
 */
@@ -153,12 +169,14 @@ struct data_stream_s {
     struct frame_buf_s frame_bufs;
 
     enum proto_type_t type;
+    struct data_stream_stats_s stats;
 };
 
 int init_data_stream(struct data_stream_s *data_stream);
 void deinit_data_stream(struct data_stream_s *data_stream);
 void data_stream_pop_frames(struct data_stream_s *data_stream);
 int data_stream_parse_frames(enum message_type_t msg_type, struct data_stream_s *data_stream);
-int data_stream_add_raw_data(struct data_stream_s *data_stream, const char *data, size_t data_len, u64 timestamp_ns, u32 index);
+int data_stream_add_raw_data(struct data_stream_s *data_stream, const char *data, size_t data_len, u64 timestamp_ns,
+                             u32 index, size_t elided_len);
 
 #endif
@@ -24,6 +24,32 @@ enum filter_type_t {
     FILTER_CGRPID,
 };
 
+// Capture mode of connections which exceed the payload budget.
+enum budget_mode_t {
+    BUDGET_MODE_HDR_ONLY = 0,   // Submit only the head of each send/recv
+    BUDGET_MODE_STATS_ONLY      // Submit connection stats only
+};
+
+// Payload capture policy of connections whose l7 protocol is known.
+enum capture_policy_t {
+    CAPTURE_POLICY_FULL = 0,    // Submit all the payload
+    CAPTURE_POLICY_HDR_ONLY,    // Submit a protocol-specific prefix of each message(HTTP/Redis/PGSQL)
+    CAPTURE_POLICY_RPC_SAMPLE   // Submit one rpc sample per request-reply instead of payload(HTTP/Redis/MySQL)
+};
+
+#define HDR_ONLY_BODY_PREFIX        128     // Body bytes kept per message in CAPTURE_POLICY_HDR_ONLY
+#define CAPTURE_POLICY_DEFAULT      CAPTURE_POLICY_FULL
+
+#define BUDGET_HDR_SIZE             256     // Bytes submitted per send/recv in BUDGET_MODE_HDR_ONLY
+
+// Token bucket rates of payload capture, 0 means unlimited(default).
+struct budget_args_s {
+    u32 conn_bytes_rate;        // Bytes per second of each connection
+    u32 conn_evts_rate;         // Data events per second of each connection
+    u32 proc_bytes_rate;        // Bytes per second of each process
+    u32 proc_evts_rate;         // Data events per second of each process
+};
+
 struct filter_args_s {
     char is_tracing;            // Support for L7 protocol tracing
     char is_support_ssl;        // Support for libSSL or GoSSL
@@ -31,8 +57,10 @@ struct filter_args_s {
     char is_report_raw;         // Report raw metrics data.
     char is_report_res;         // Report pod/container resource data(eg. network tx/rx, vm/rss, i/o rd/wr).
     char is_filter_by_cgrp;     // Support for filter by cgroup of pod/container
-    char pad[2];
+    char budget_mode;           // enum budget_mode_t
+    char capture_policy;        // enum capture_policy_t
     u32 proto_flags;
+    struct budget_args_s budget;
 };
 
 #endif
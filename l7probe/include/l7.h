@@ -122,12 +122,35 @@ struct conn_info_s {
 };
 
 // The information of socket connection
+// Token bucket of payload capture budget.
+struct budget_s {
+    u64 ts;             // Timestamp(ns) of the last refill
+    u32 bytes;          // Remaining bytes tokens
+    u32 evts;           // Remaining data events tokens
+};
+
+// Pending request of rpc sample capture.
+#define RPC_SAMPLE_HDR_SIZE 32
+struct rpc_pending_s {
+    u64 req_ts;         // Timestamp(ns) of the first request byte, 0 means no request is pending
+    u32 req_size;
+    u32 pipelined;      // A new request was sent before the response, the connection falls back to payload capture
+    char req_hdr[RPC_SAMPLE_HDR_SIZE];
+};
+
 struct sock_conn_s {
     struct conn_info_s info;
 
     // The number of bytes written/read on this socket connection.
     u64 wr_bytes;
     u64 rd_bytes;
+
+    // Body bytes of the current message to be skipped in header-only capture.
+    u64 wr_body_remain;
+    u64 rd_body_remain;
+
+    struct budget_s budget;
+    struct rpc_pending_s rpc;
 };
 
 #define __HTTP_MIN_SIZE  16     // Smallest HTTP size
@@ -717,6 +740,24 @@ static __inline enum message_type_t __get_mysql_type(const char *buf, size_t cou
     return MESSAGE_UNKNOW;
 }
 
+static __inline enum message_type_t __get_amqp_type(const char* buf, size_t count)
+{
+    // AMQP协议头识别: "AMQP" + 0 + 0 + 9 + 1
+    if (count >= 8 && 
+        buf[0] == 'A' && buf[1] == 'M' && buf[2] == 'Q' && buf[3] == 'P' &&
+        buf[4] == 0x00 && buf[5] == 0x00 && buf[6] == 0x09 && buf[7] == 0x01) {
+        return MESSAGE_REQUEST;  // 协议头视为请求
+    }
+    
+    // 方法帧识别：帧类型为1
+    if (count >= 7 && buf[0] == 0x01) {
+        // 方法帧最小长度为7字节(帧类型1字节+信道2字节+长度4字节)
+        return MESSAGE_REQUEST;  // 暂时视为请求，后续在parse_frame中再细分
+    }
+    
+    return MESSAGE_UNKNOW;
+}
+
 static __inline int get_l7_protocol(const char *buf, size_t count, u32 flags, enum l7_direction_t direction,
     struct l7_proto_s *l7pro, struct sock_conn_s *sock_conn){
     enum message_type_t type;
@@ -822,23 +863,5 @@ static __inline int get_l7_protocol(const char *buf, size_t count, u32 flags, en
     return -1;
 }
 
-static __inline enum message_type_t __get_amqp_type(const char* buf, size_t count)
-{
-    // AMQP协议头识别: "AMQP" + 0 + 0 + 9 + 1
-    if (count >= 8 && 
-        buf[0] == 'A' && buf[1] == 'M' && buf[2] == 'Q' && buf[3] == 'P' &&
-        buf[4] == 0x00 && buf[5] == 0x00 && buf[6] == 0x09 && buf[7] == 0x01) {
-        return MESSAGE_REQUEST;  // 协议头视为请求
-    }
-    
-    // 方法帧识别：帧类型为1
-    if (count >= 7 && buf[0] == 0x01) {
-        // 方法帧最小长度为7字节(帧类型1字节+信道2字节+长度4字节)
-        return MESSAGE_REQUEST;  // 暂时视为请求，后续在parse_frame中再细分
-    }
-    
-    return MESSAGE_UNKNOW;
-}
-
 #endif
 
@@ -42,6 +42,7 @@ struct l7_ebpf_prog_s {
     int l7_tcp_fd;
     int filter_args_fd;
     int proc_obj_map_fd;
+    int evt_stats_fd;
     struct bpf_prog_s* kern_sock_prog;
     struct libssl_prog_s libssl_progs[LIBSSL_EBPF_PROG_MAX];
 };
@@ -63,6 +64,7 @@ struct l7_mng_s {
     struct conn_data_s conn_data;
     struct java_proc_s *java_procs;
     struct delaying_ring_buffer *drb;
+    struct l7_telemetry_s telemetry;
 };
 
 #endif
\ No newline at end of file
@@ -13,6 +13,8 @@
  * Description: l7probe probe main program
  ******************************************************************************/
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
@@ -22,6 +24,7 @@
 #include <sys/stat.h>
 #include <sched.h>
 #include <fcntl.h>
+#include <getopt.h>
 
 #ifdef BPF_PROG_KERN
 #undef BPF_PROG_KERN
@@ -221,6 +224,7 @@ static void unload_kern_sock_prog(struct l7_mng_s *l7_mng)
     l7_mng->bpf_progs.l7_tcp_fd = -1;
     l7_mng->bpf_progs.filter_args_fd = -1;
     l7_mng->bpf_progs.proc_obj_map_fd = -1;
+    l7_mng->bpf_progs.evt_stats_fd = -1;
 }
 
 static void unload_l7_prog(struct l7_mng_s *l7_mng)
@@ -381,6 +385,7 @@ static void poll_drb(struct l7_mng_s *l7_mng)
     while ((item = drb_look(l7_mng->drb))) {
         tracker_msg_continue(l7_mng, item->data, item->size);
         drb_pop(l7_mng->drb);
+        l7_telemetry_drb_pop(&(l7_mng->telemetry));
     }
 }
 
@@ -394,6 +399,89 @@ static void save_filter_proto(int fd, u32 proto)
     (void)bpf_map_update_elem(fd, &key, &args, BPF_ANY);
 }
 
+static void save_filter_capture(int fd, const struct filter_args_s *capture_args)
+{
+    u32 key = 0;
+    struct filter_args_s args = {0};
+
+    (void)bpf_map_lookup_elem(fd, &key, &args);
+    args.capture_policy = capture_args->capture_policy;
+    args.budget_mode = capture_args->budget_mode;
+    args.budget = capture_args->budget;
+    (void)bpf_map_update_elem(fd, &key, &args, BPF_ANY);
+}
+
+static void usage(const char *prog)
+{
+    (void)fprintf(stderr,
+        "usage: %s [-a full|hdr|rpc] [-m hdr|stats] [-c bytes] [-C evts] [-p bytes] [-P evts]\n"
+        "  -a  payload capture policy: full(default)|hdr(protocol headers, needs L7_HDR_ONLY_CAPTURE build)"
+        "|rpc(one sample per request-reply)\n"
+        "  payload capture budget per second, 0(default) means unlimited:\n"
+        "  -c  bytes of each connection\n"
+        "  -C  data events of each connection\n"
+        "  -p  bytes of each process\n"
+        "  -P  data events of each process\n"
+        "  -m  capture of connections over budget: hdr(first %d bytes of each send/recv, default)|stats(none)\n",
+        prog, BUDGET_HDR_SIZE);
+}
+
+/*
+    By default, all the payload is captured without limit. The capture options are given in the
+    command line of the probe, and kept in 'l7_mng->filter_args'.
+*/
+static int parse_capture_args(int argc, char **argv, struct filter_args_s *args)
+{
+    int opt;
+
+    args->capture_policy = CAPTURE_POLICY_DEFAULT;
+    args->budget_mode = BUDGET_MODE_HDR_ONLY;
+    while ((opt = getopt(argc, argv, "a:m:c:C:p:P:h")) != -1) {
+        switch (opt) {
+            case 'a':
+                if (strcmp(optarg, "full") == 0) {
+                    args->capture_policy = CAPTURE_POLICY_FULL;
+#ifdef L7_HDR_ONLY_CAPTURE
+                } else if (strcmp(optarg, "hdr") == 0) {
+                    args->capture_policy = CAPTURE_POLICY_HDR_ONLY;
+#endif
+                } else if (strcmp(optarg, "rpc") == 0) {
+                    args->capture_policy = CAPTURE_POLICY_RPC_SAMPLE;
+                } else {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'm':
+                if (strcmp(optarg, "hdr") == 0) {
+                    args->budget_mode = BUDGET_MODE_HDR_ONLY;
+                } else if (strcmp(optarg, "stats") == 0) {
+                    args->budget_mode = BUDGET_MODE_STATS_ONLY;
+                } else {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'c':
+                args->budget.conn_bytes_rate = (u32)strtoul(optarg, NULL, 10);
+                break;
+            case 'C':
+                args->budget.conn_evts_rate = (u32)strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                args->budget.proc_bytes_rate = (u32)strtoul(optarg, NULL, 10);
+                break;
+            case 'P':
+                args->budget.proc_evts_rate = (u32)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     int ret = 0, is_load_prog = 0;
@@ -413,6 +501,9 @@ int main(int argc, char **argv)
     }
 
     (void)memset(l7_mng, 0, sizeof(struct l7_mng_s));
+    if (parse_capture_args(argc, argv, &(l7_mng->filter_args))) {
+        return -1;
+    }
 
     l7_mng->drb = drb_new(CAPACITY, DELAY_MS);
     if (!l7_mng->drb) {
@@ -458,6 +549,7 @@ int main(int argc, char **argv)
             destroy_ipc_body(&(l7_mng->ipc_body));
 
             save_filter_proto(l7_mng->bpf_progs.filter_args_fd, ipc_body.probe_param.l7_probe_proto_flags);
+            save_filter_capture(l7_mng->bpf_progs.filter_args_fd, &(l7_mng->filter_args));
 
             (void)memcpy(&(l7_mng->ipc_body), &ipc_body, sizeof(ipc_body));
             l7_unload_tcp_fd(l7_mng);
@@ -33,7 +33,7 @@ static void add_match_record(struct amqp_message_s* req_msg, struct amqp_message
     if (record_buf->record_buf_size < RECORD_BUF_SIZE) {
         record_buf->records[record_buf->record_buf_size++] = record_data;
     } else {
-        ERROR("[AMQP Matcher] Record buffer is full.\n");
+        ++record_buf->overflow_count;
         free(record_data);
         free_amqp_record(record);
     }
@@ -25,6 +25,7 @@ struct raw_data_s *parser_copy_raw_data(struct raw_data_s *raw_data)
     }
     copied_raw_data->timestamp_ns = raw_data->timestamp_ns;
     copied_raw_data->current_pos = raw_data->current_pos;
+    copied_raw_data->elided_len = raw_data->elided_len;
 
     size_t raw_data_len = raw_data->data_len;
     copied_raw_data->data_len = raw_data_len;
@@ -40,10 +41,24 @@ struct raw_data_s *init_raw_data_with_str(char *str, size_t str_len)
     }
     raw_data->data_len = str_len;
     raw_data->current_pos = 0;
+    raw_data->elided_len = 0;
     memcpy(raw_data->data, str, str_len);
     return raw_data;
 }
 
+bool parser_raw_data_is_elided(struct raw_data_s *raw_data, size_t len)
+{
+    size_t unconsumed_len = raw_data->data_len - raw_data->current_pos;
+
+    return (raw_data->elided_len > 0) && (len > unconsumed_len) && (len - unconsumed_len <= raw_data->elided_len);
+}
+
+void parser_raw_data_skip_elided(struct raw_data_s *raw_data)
+{
+    raw_data->current_pos = raw_data->data_len;
+    raw_data->elided_len = 0;
+}
+
 void parser_raw_data_offset(struct raw_data_s *raw_data, size_t offset)
 {
     size_t real_offset = offset;
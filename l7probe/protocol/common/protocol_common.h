@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include "data_stream.h"
 
 /**
@@ -45,4 +46,20 @@ struct raw_data_s *init_raw_data_with_str(char *str, size_t str_len);
  */
 void parser_raw_data_offset(struct raw_data_s *raw_data, size_t offset);
 
+/**
+ * 判断从当前位置起len长度的数据是否被内核header-only采集模式省略了尾部（消息体）
+ *
+ * @param raw_data 字符串缓存
+ * @param len 期望的数据长度
+ * @return bool
+ */
+bool parser_raw_data_is_elided(struct raw_data_s *raw_data, size_t len);
+
+/**
+ * 跳过被省略的消息体：消费raw_data剩余数据，并清除省略长度
+ *
+ * @param raw_data 字符串缓存
+ */
+void parser_raw_data_skip_elided(struct raw_data_s *raw_data);
+
 #endif
@@ -170,7 +170,7 @@ static void crpc_matcher_add_record(struct crpc_record_s *match_record, struct r
     }
 
     if (record_buf->record_buf_size >= RECORD_BUF_SIZE) {
-        CRPC_WARN("The record buffer is full.\n");
+        ++record_buf->overflow_count;
         return;
     }
 
@@ -74,7 +74,7 @@ static void add_http_record_into_buf(http_record *record, struct record_buf_s *r
     http_record *rcd_cp;
 
     if (record_buf->record_buf_size >= RECORD_BUF_SIZE) {
-        WARN("[HTTP1.x MATCHER] The record buffer is full.\n");
+        ++record_buf->overflow_count;
         return;
     }
 
@@ -16,6 +16,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "common/protocol_common.h"
 #include "http_parse_wrapper.h"
 #include "http_parser.h"
 
@@ -144,6 +145,11 @@ static parse_state_t parse_request_body(struct raw_data_s *raw_data, struct http
             return STATE_INVALID;
         }
         if (content_len > raw_data->data_len - raw_data->current_pos) {
+            if (parser_raw_data_is_elided(raw_data, content_len)) {
+                frame_data->body_size = content_len;
+                parser_raw_data_skip_elided(raw_data);
+                return STATE_SUCCESS;
+            }
             DEBUG("[HTTP1.x PARSER] Parsing request body needs more data.\n");
             return STATE_NEEDS_MORE_DATA;
         }
@@ -213,6 +219,11 @@ static parse_state_t parse_response_body(struct raw_data_s *raw_data, struct htt
             return STATE_INVALID;
         }
         if (content_len > raw_data->data_len - raw_data->current_pos) {
+            if (parser_raw_data_is_elided(raw_data, content_len)) {
+                frame_data->body_size = content_len;
+                parser_raw_data_skip_elided(raw_data);
+                return STATE_SUCCESS;
+            }
             DEBUG("[HTTP1.x PARSER] Parsing response body needs more data.\n");
             return STATE_NEEDS_MORE_DATA;
         }
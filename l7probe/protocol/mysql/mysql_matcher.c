@@ -218,7 +218,7 @@ static void mysql_matcher_add_record(struct mysql_packet_msg_s *req, u64 rsp_tim
     struct mysql_command_req_resp_s *mysql_record;
     struct record_data_s *record_data;
     if (record_buf->record_buf_size >= RECORD_BUF_SIZE) {
-        WARN("[MYSQL MATCHER] The record buffer is full.\n");
+        ++record_buf->overflow_count;
         ++record_buf->err_count;
         return;
     }
@@ -48,6 +48,18 @@ parse_state_t pgsql_parse_regular_msg(struct raw_data_s *raw_data, struct pgsql_
     }
 
     payload_len = msg->len - PGSQL_REGULAR_MSG_MIN_LEN;
+
+    // The tail of payload is elided by header-only capture, keep the captured head as payload.
+    if (parser_raw_data_is_elided(raw_data, payload_len)) {
+        extract_payload_state = decoder_extract_raw_data_with_len(raw_data, raw_data->data_len - raw_data->current_pos,
+                                                                  &msg->payload_data);
+        if (extract_payload_state != STATE_SUCCESS) {
+            goto more_data;
+        }
+        parser_raw_data_skip_elided(raw_data);
+        return STATE_SUCCESS;
+    }
+
     extract_payload_state = decoder_extract_raw_data_with_len(raw_data, payload_len, &msg->payload_data);
     if (extract_payload_state != STATE_SUCCESS) {
         goto more_data;
@@ -87,6 +87,12 @@ static void add_redis_record_to_buf(struct record_buf_s *record_buf, struct redi
         return;
     }
 
+    if (record_buf->record_buf_size >= RECORD_BUF_SIZE) {
+        ++record_buf->overflow_count;
+        free_redis_record(record);
+        return;
+    }
+
     struct record_data_s *record_data = (struct record_data_s *)malloc(sizeof(struct record_data_s));
     if (record_data == NULL) {
         ERROR("[Redis Match] Malloc record_data failed.\n");
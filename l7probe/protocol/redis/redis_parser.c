@@ -115,6 +115,19 @@ static parse_state_t parse_bulk_string_msg(struct raw_data_s *raw_data_buf, stru
         return STATE_SUCCESS;
     }
 
+    // The tail of bulk string is elided by header-only capture, keep the captured head as payload.
+    if (parser_raw_data_is_elided(raw_data_buf, len + strlen(TERMINAL_SEQUENCE))) {
+        state = decoder_extract_string(raw_data_buf, &payload, raw_data_buf->data_len - raw_data_buf->current_pos);
+        if (state != STATE_SUCCESS) {
+            return state;
+        }
+        parser_raw_data_skip_elided(raw_data_buf);
+        free(msg->payload);
+
+        msg->payload = payload;
+        return STATE_SUCCESS;
+    }
+
     state = decoder_extract_string(raw_data_buf, &payload, len + strlen(TERMINAL_SEQUENCE));
     if (state != STATE_SUCCESS) {
         return state;
@@ -272,7 +285,6 @@ parse_state_t redis_parse_frame(enum message_type_t msg_type, struct raw_data_s
 {
     // 校验raw_data缓存长度是否合法
     if ((raw_data->data_len == 0 || raw_data->current_pos == raw_data->data_len)) {
-        ERROR("[Redis Parse] The raw_data length is insufficient.\n");
         return STATE_NEEDS_MORE_DATA;
     }
 
@@ -25,7 +25,6 @@
 parse_state_t decoder_extract_char(struct raw_data_s *raw_data, char *res)
 {
     if ((raw_data->data_len - raw_data->current_pos) < sizeof(char)) {
-        ERROR("[Binary Decoder] Buffer bytes are insufficient.\n");
         return STATE_NEEDS_MORE_DATA;
     }
 
@@ -38,7 +37,6 @@ parse_state_t decoder_extract_char(struct raw_data_s *raw_data, char *res)
 parse_state_t decoder_extract_char_array(struct raw_data_s *raw_data, char *res, size_t decode_len)
 {
     if ((raw_data->data_len - raw_data->current_pos) < decode_len) {
-        ERROR("[Binary Decoder] Buffer bytes are insufficient.\n");
         return STATE_NEEDS_MORE_DATA;
     }
 
@@ -104,7 +102,6 @@ BIG_ENDIAN_BYTES_TO_INT(u_int64_t)
 parse_state_t decoder_extract_##INT_TYPE(struct raw_data_s *raw_data, INT_TYPE *res) \
 {                                                                                    \
     if ((raw_data->data_len - raw_data->current_pos) < sizeof(INT_TYPE)) {           \
-        ERROR("[Binary Decoder] Buffer bytes are insufficient.\n");                  \
         return STATE_NEEDS_MORE_DATA;                                                \
     }                                                                                \
     *res = big_endian_bytes_to_##INT_TYPE(&raw_data->data[raw_data->current_pos]);   \
@@ -175,6 +172,7 @@ parse_state_t decoder_extract_raw_data_with_len(struct raw_data_s *src_raw_data,
     }
     raw_data->data_len = decode_len;
     raw_data->current_pos = 0;
+    raw_data->elided_len = 0;
     memcpy(raw_data->data, &src_raw_data->data[src_raw_data->current_pos], decode_len);
 
     *dst_raw_data = raw_data;
@@ -188,7 +186,6 @@ parse_state_t decoder_extract_raw_data_with_len(struct raw_data_s *src_raw_data,
 parse_state_t decoder_extract_string(struct raw_data_s *raw_data, char **res, size_t decode_len)
 {
     if ((raw_data->data_len - raw_data->current_pos) < decode_len) {
-        ERROR("[Binary Decoder] Buffer bytes are insufficient.\n");
         return STATE_NEEDS_MORE_DATA;
     }
     if (!extract_prefix_bytes_string(raw_data, res, decode_len, decode_len)) {
@@ -266,7 +263,6 @@ parse_state_t decoder_extract_str_until_str(struct raw_data_s *raw_data, char **
 parse_state_t decoder_extract_prefix_ignore(struct raw_data_s *raw_data, size_t prefix_len)
 {
     if ((raw_data->data_len - raw_data->current_pos) < prefix_len) {
-        ERROR("[Binary Decoder] Buffer bytes are insufficient for decoder_extract_prefix_ignore.\n");
         return STATE_NEEDS_MORE_DATA;
     }
     parser_raw_data_offset(raw_data, prefix_len);